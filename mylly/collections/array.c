@@ -26,6 +26,36 @@ void arr_resize(char **arr, size_t *count, size_t *capacity, size_t data_size)
 	*capacity = new_capacity;
 }
 
+void arr_reserve_capacity(char **arr, size_t *count, size_t *capacity, size_t data_size,
+                          size_t num_items)
+{
+	if (*capacity >= (*count) + num_items) {
+
+		// Enough space for the requested number of elements already.
+		return;
+	}
+
+	// Grow the array in one step so pushing the items won't cause several reallocations.
+	size_t new_capacity = (*capacity == 0 ? INITIAL_CAPACITY : *capacity);
+
+	while (new_capacity < (*count) + num_items) {
+		new_capacity <<= 1;
+	}
+
+	void *new_arr = mem_alloc_fast(new_capacity * data_size);
+
+	// Copy entries from the old array.
+	if (*arr && *count != 0) {
+		memcpy(new_arr, *arr, (*count) * data_size);
+	}
+
+	// Delete the old array.
+	DESTROY(*arr);
+
+	*arr = new_arr;
+	*capacity = new_capacity;
+}
+
 void arr_splice(char **arr, size_t *count, size_t *capacity, size_t data_size, int start, int items)
 {
 	UNUSED(capacity);
@@ -43,6 +43,10 @@
 	(arr).items[(arr).count++] = item;\
 }
 
+#define arr_reserve(arr, num) \
+	arr_reserve_capacity((char **)&(arr).items, &(arr).count, &(arr).capacity,\
+		sizeof((arr).items[0]), (num))
+
 #define arr_set(arr, idx, val) \
 	(arr).items[(idx)] = (val)
 
@@ -83,6 +87,13 @@
 	}\
 }
 
+#define arr_remove_range(arr, idx, num) {\
+	if ((idx) + (num) <= (arr).count) {\
+		arr_splice((char **)&(arr).items, &(arr).count, &(arr).capacity,\
+			sizeof((arr).items[0]), (idx), (num));\
+	}\
+}
+
 #define arr_find_empty(arr, var) {\
 	(var) = INVALID_INDEX;\
 	for (size_t __i = 0; __i < (arr).count; ++__i) {\
@@ -110,6 +121,8 @@
 BEGIN_DECLARATIONS;
 
 void arr_resize(char **arr, size_t *count, size_t *capacity, size_t data_size);
+void arr_reserve_capacity(char **arr, size_t *count, size_t *capacity, size_t data_size,
+                          size_t num_items);
 void arr_splice(char **arr, size_t *count, size_t *capacity, size_t data_size, int start, int items);
 
 END_DECLARATIONS;
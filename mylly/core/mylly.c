@@ -4,15 +4,18 @@
 #include "io/log.h"
 #include "io/input.h"
 #include "platform/thread.h"
+#include "platform/timer.h"
 #include "platform/window.h"
 #include "platform/inputhook.h"
 #include "platform/platform.h"
 #include "renderer/rendersystem.h"
 #include "renderer/renderer.h"
+#include "renderer/texture.h"
 #include "renderer/debug.h"
 #include "renderer/splashscreen.h"
 #include "resources/resources.h"
 #include "scene/scene.h"
+#include "scene/scenemanager.h"
 #include "mgui/mgui.h"
 #include "audio/audiosystem.h"
 #include <stdio.h>
@@ -20,10 +23,14 @@
 
 // -------------------------------------------------------------------------------------------------
 
+#define SHADER_RELOAD_INTERVAL 1000000 // How often modified shader files are looked for [us]
+
+// -------------------------------------------------------------------------------------------------
+
 static mylly_params_t parameters; // Engine initialization parameters
-static scene_t *current_scene;
 static bool is_running = true;
 static monitor_info_t monitor; // Info about the monitor the engine is running on
+static uint64_t next_shader_reload; // Time of the next check for modified shader files [us]
 
 // -------------------------------------------------------------------------------------------------
 
@@ -74,6 +81,7 @@ bool mylly_initialize(int argc, char **argv, const mylly_params_t *params)
 
 	// Initialize other subsystems.
 	parallel_initialize();
+	scenemgr_initialize();
 	input_initialize();
 	audio_initialize();
 
@@ -114,6 +122,7 @@ static void mylly_shutdown(void)
 	audio_shutdown();
 	input_shutdown();
 	rsys_shutdown();
+	scenemgr_shutdown();
 	parallel_shutdown();
 }
 
@@ -129,6 +138,21 @@ void mylly_main_loop(void)
 		// Process parallel jobs.
 		parallel_process();
 
+		// Swap in textures which have been uploaded in the background.
+		texture_process_uploads();
+
+		// Recompile shaders whose files have been modified. The files are checked only every
+		// now and then, because it requires reading the modification time of each file.
+		if (parameters.renderer.reload_changed_shaders &&
+			timer_get_microseconds() >= next_shader_reload) {
+
+			res_reload_changed_shaders();
+			next_shader_reload = timer_get_microseconds() + SHADER_RELOAD_INTERVAL;
+		}
+
+		// Swap scenes at the frame boundary and continue unloading old scenes.
+		scenemgr_process();
+
 		// Render the current scene.
 		rsys_begin_frame();
 
@@ -137,6 +161,8 @@ void mylly_main_loop(void)
 			parameters.callbacks.on_loop();
 		}
 
+		scene_t *current_scene = scenemgr_get_active_scene();
+
 		if (current_scene != NULL) {
 
 			// Pre-process all objects in the current scene before rendering.
@@ -153,6 +179,9 @@ void mylly_main_loop(void)
 		// Ending the frame will issue the actual draw calls.
 		rsys_end_frame(current_scene);
 
+		// Destroy objects which were removed from the scene during this frame.
+		scene_flush_destroy_queue(current_scene);
+
 		time_tick();
 
 		thread_sleep(10);
@@ -169,8 +198,7 @@ void mylly_main_loop(void)
 
 void mylly_set_scene(scene_t *scene)
 {
-	// TODO: Create a proper scene manager for scenes!
-	current_scene = scene;
+	scenemgr_set_active_scene(scene);
 }
 
 void mylly_exit(void)
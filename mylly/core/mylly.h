@@ -27,8 +27,19 @@ typedef struct mylly_params_t {
 	struct {
 
 		bool use_deferred_lighting; // When set to true, deferred lighting is used
+		bool use_null_backend; // Record draws instead of drawing them (for testing without a GPU)
+		bool use_render_thread; // Draw on a dedicated thread while the next frame is being built
 		char ambient_stage_shader[100]; // Name of the deferred ambient lighting shader
 		char light_stage_shader[100]; // Name of the deferred light shader
+		float texture_mip_bias; // Bias added to the mip level of textures, negative is sharper
+		uint8_t max_texture_mip_levels; // Maximum number of mip levels of a texture, 0 for no limit
+		float max_texture_anisotropy; // Anisotropy of anisotropic textures, 0 for driver maximum
+		bool use_compressed_textures; // Cook textures into block compressed files and load those
+		bool use_sprite_atlas; // Pack sprite sheets into shared atlas textures
+		bool load_textures_async; // Decode and upload textures in the background
+		uint32_t texture_upload_budget; // Bytes of texture data uploaded per frame, 0 for default
+		uint32_t texture_streaming_budget; // GPU memory for streamed textures, 0 disables streaming
+		bool reload_changed_shaders; // Recompile shaders when their source or include files change
 
 	} renderer;
 
@@ -21,11 +21,32 @@ typedef struct job_t {
 static lock_t job_sync; // Used to control access to the parallel job list
 static list_t(job_t) jobs; // A linked list of parallel jobs to be completed
 static list_t(job_t) completed; // A list of completed jobs
-static bool is_thread_running; // Status flag for the worker thread
+static bool is_thread_running; // Status flag for the worker and task threads
+
+static thread_handle_t worker_thread; // Thread executing the parallel jobs
+static event_t job_event; // Wakes up the worker thread when jobs are submitted
+
+static thread_handle_t task_threads[NUM_TASK_THREADS]; // Threads processing parallel_for() batches
+static event_t task_events[NUM_TASK_THREADS]; // Wakes up each task thread for a new batch
+
+static struct {
+
+	lock_t lock; // Used to control access to the batch
+	job_for_t execute; // Method to be executed for each index
+	void *context; // User context passed to the method
+	uint32_t count; // Total number of indices in the batch
+	uint32_t next; // The next index to be processed
+	uint32_t completed; // Number of indices processed so far
+	event_t done; // Signaled when the last index of the batch has been processed
+
+} batch;
 
 // -------------------------------------------------------------------------------------------------
 
 THREAD(parallel_worker_thread);
+THREAD(parallel_task_thread);
+
+static bool parallel_process_batch_index(void);
 
 // -------------------------------------------------------------------------------------------------
 
@@ -37,21 +58,46 @@ void parallel_initialize(void)
 	// Initialize a sync object.
 	thread_init_lock(&job_sync);
 
+	thread_init_event(&job_event);
+
+	thread_init_lock(&batch.lock);
+	thread_init_event(&batch.done);
+
 	// Start a worker thread.
 	is_thread_running = true;
-	thread_create(parallel_worker_thread, NULL);
+	worker_thread = thread_create_joinable(parallel_worker_thread, NULL);
+
+	// Start threads for processing batches. Each thread waits for its own event, so a new batch
+	// can wake up all of them.
+	for (int i = 0; i < NUM_TASK_THREADS; i++) {
+
+		thread_init_event(&task_events[i]);
+		task_threads[i] = thread_create_joinable(parallel_task_thread, &task_events[i]);
+	}
 }
 
 void parallel_shutdown(void)
 {
 	is_thread_running = false;
 
-	// Give the worker thread a while to shut down.
-	thread_sleep(100);
+	// Wake up the idle threads and wait for them to exit. The job being executed is finished first.
+	thread_signal_event(&job_event);
+	thread_join(worker_thread);
 
-	// Destroy the sync object.
-	thread_lock(&job_sync);
+	for (int i = 0; i < NUM_TASK_THREADS; i++) {
+
+		thread_signal_event(&task_events[i]);
+		thread_join(task_threads[i]);
+
+		thread_destroy_event(&task_events[i]);
+	}
+
+	// Destroy the sync objects.
 	thread_destroy_lock(&job_sync);
+	thread_destroy_event(&job_event);
+
+	thread_destroy_lock(&batch.lock);
+	thread_destroy_event(&batch.done);
 
 	// Remove all remaining jobs from the list.
 	job_t *job;
@@ -99,13 +145,111 @@ void parallel_submit_job(job_execute_t execute, job_completed_t completed, void
 		list_push(jobs, job);
 	}
 	thread_unlock(&job_sync);
+
+	thread_signal_event(&job_event);
+}
+
+void parallel_for(job_for_t execute, void *context, uint32_t count)
+{
+	if (execute == NULL || count == 0) {
+		return;
+	}
+
+	thread_lock(&batch.lock);
+	{
+		batch.execute = execute;
+		batch.context = context;
+		batch.count = count;
+		batch.next = 0;
+		batch.completed = 0;
+	}
+	thread_unlock(&batch.lock);
+
+	for (int i = 0; i < NUM_TASK_THREADS; i++) {
+		thread_signal_event(&task_events[i]);
+	}
+
+	// Help the task threads until there is nothing left to start.
+	while (parallel_process_batch_index()) {}
+
+	// Wait for the indices still being processed by the task threads. The event may also have been
+	// left signaled by the previous batch, so the state of the batch is checked after each wake up.
+	for (;;) {
+
+		bool is_done;
+
+		thread_lock(&batch.lock);
+		{
+			is_done = (batch.completed >= batch.count);
+		}
+		thread_unlock(&batch.lock);
+
+		if (is_done) {
+			break;
+		}
+
+		thread_wait_event(&batch.done);
+	}
+}
+
+static bool parallel_process_batch_index(void)
+{
+	job_for_t execute;
+	void *context;
+	uint32_t index;
+
+	// Claim the next unprocessed index.
+	thread_lock(&batch.lock);
+	{
+		if (batch.next >= batch.count) {
+
+			thread_unlock(&batch.lock);
+			return false;
+		}
+
+		execute = batch.execute;
+		context = batch.context;
+		index = batch.next++;
+	}
+	thread_unlock(&batch.lock);
+
+	execute(context, index);
+
+	bool is_last;
+
+	thread_lock(&batch.lock);
+	{
+		is_last = (++batch.completed == batch.count);
+	}
+	thread_unlock(&batch.lock);
+
+	if (is_last) {
+		thread_signal_event(&batch.done);
+	}
+
+	return true;
+}
+
+THREAD(parallel_task_thread)
+{
+	event_t *event = args;
+
+	while (is_thread_running) {
+
+		// Process batch indices as long as there are any, otherwise wait for a new batch.
+		if (!parallel_process_batch_index()) {
+			thread_wait_event(event);
+		}
+	}
+
+	return 0;
 }
 
 THREAD(parallel_worker_thread)
 {
 	UNUSED(args);
 
-	for (;;) {
+	while (is_thread_running) {
 		
 		job_t *job;
 
@@ -141,7 +285,8 @@ THREAD(parallel_worker_thread)
 
 		} while (job != NULL);
 
-		thread_sleep(1);
+		// Wait until more jobs are submitted.
+		thread_wait_event(&job_event);
 	}
 
 	return 0;
@@ -8,6 +8,10 @@
 
 typedef void (*job_execute_t)(void *context);
 typedef void (*job_completed_t)(void *context);
+typedef void (*job_for_t)(void *context, uint32_t index);
+
+// Number of worker threads processing parallel_for() batches in addition to the calling thread.
+#define NUM_TASK_THREADS 3
 
 // -------------------------------------------------------------------------------------------------
 
@@ -19,6 +23,11 @@ void parallel_process(void);
 
 void parallel_submit_job(job_execute_t execute, job_completed_t completed, void *context);
 
+// Execute a method for each index in [0, count), splitting the work between the task threads and
+// the calling thread. Returns once every index has been processed. Should only be called from the
+// main thread, and never from inside another parallel_for() batch.
+void parallel_for(job_for_t execute, void *context, uint32_t count);
+
 END_DECLARATIONS;
 
 #endif
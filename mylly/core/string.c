@@ -29,6 +29,23 @@ char *string_duplicate(const char *text)
 	return buf;
 }
 
+uint32_t string_hash(const char *text)
+{
+	uint32_t hash = 2166136261u;
+
+	if (text == NULL) {
+		return hash;
+	}
+
+	while (*text) {
+
+		hash ^= (uint8_t)*text++;
+		hash *= 16777619u;
+	}
+
+	return hash;
+}
+
 size_t string_tokenize(const char *text, char delimiter, char *dst, size_t dst_len)
 {
 	return string_tokenize_filter(text, delimiter, dst, dst_len, true);
@@ -26,6 +26,9 @@ BEGIN_DECLARATIONS;
 void string_copy(char *dst, const char *src, size_t dst_len);
 char *string_duplicate(const char *text);
 
+// Calculate a 32-bit FNV-1a hash of a string.
+uint32_t string_hash(const char *text);
+
 size_t string_tokenize(const char *text, char delimiter, char *dst, size_t dst_len);
 size_t string_tokenize_filter(const char *text, char delimiter, char *dst, size_t dst_len,
                               bool filter_empty);
@@ -26,6 +26,7 @@ typedef struct emitter_t emitter_t;
 typedef struct light_t light_t;
 typedef struct model_t model_t;
 typedef struct object_t object_t;
+typedef struct prefab_t prefab_t;
 typedef struct scene_t scene_t;
 typedef struct sprite_t sprite_t;
 typedef struct sprite_anim_t sprite_anim_t;
@@ -2,9 +2,15 @@
 #include "core/string.h"
 #include "core/memory.h"
 #include <stdio.h>
+#include <string.h>
 
 #ifndef _WIN32
 	#include <dirent.h>
+	#include <errno.h>
+	#include <fcntl.h>
+	#include <unistd.h>
+	#include <sys/mman.h>
+	#include <sys/stat.h>
 	#include <sys/sysinfo.h>
 
 	#ifndef DT_DIR
@@ -204,6 +210,88 @@ bool file_read_all_data(const char *path, void **buf, size_t *bytes_read)
 	return true;
 }
 
+bool file_write_all_data(const char *path, const void *buf, size_t size)
+{
+	if (string_is_null_or_empty(path) || (buf == NULL && size != 0)) {
+		return false;
+	}
+
+	// Open the file for writing.
+	FILE *f = fopen(path, "wb");
+	if (f == NULL) {
+		return false;
+	}
+
+	// Write the buffer and close the handle.
+	bool success = (size == 0 || fwrite(buf, size, 1, f) == 1);
+	fclose(f);
+
+	return success;
+}
+
+void *file_map(const char *path, size_t *size)
+{
+	*size = 0;
+
+	if (string_is_null_or_empty(path)) {
+		return NULL;
+	}
+
+#ifdef _WIN32
+
+	// TODO: Use file mapping objects on Windows, for now just read the whole file.
+	void *data;
+
+	if (!file_read_all_data(path, &data, size)) {
+		return NULL;
+	}
+
+	return data;
+
+#else
+
+	int fd = open(path, O_RDONLY);
+
+	if (fd < 0) {
+		return NULL;
+	}
+
+	struct stat info;
+
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+
+		close(fd);
+		return NULL;
+	}
+
+	// The mapping stays valid after the file descriptor has been closed.
+	void *data = mmap(NULL, (size_t)info.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+
+	if (data == MAP_FAILED) {
+		return NULL;
+	}
+
+	*size = (size_t)info.st_size;
+	return data;
+
+#endif
+}
+
+void file_unmap(void *data, size_t size)
+{
+	if (data == NULL) {
+		return;
+	}
+
+#ifdef _WIN32
+	UNUSED(size);
+	mem_free(data);
+#else
+	munmap(data, size);
+#endif
+}
+
 bool file_exists(const char *path)
 {
 	if (string_is_null_or_empty(path)) {
@@ -221,6 +309,84 @@ bool file_exists(const char *path)
 	return false;
 }
 
+bool file_get_modified_time(const char *path, uint64_t *time)
+{
+	if (string_is_null_or_empty(path) || time == NULL) {
+		return false;
+	}
+
+#ifndef _WIN32
+
+	struct stat info;
+
+	if (stat(path, &info) != 0) {
+		return false;
+	}
+
+	*time = (uint64_t)info.st_mtime;
+
+#else
+
+	WIN32_FILE_ATTRIBUTE_DATA info;
+
+	if (!GetFileAttributesExA(path, GetFileExInfoStandard, &info)) {
+		return false;
+	}
+
+	// Convert from 100 nanosecond intervals since 1601 to seconds since 1970.
+	uint64_t ticks = ((uint64_t)info.ftLastWriteTime.dwHighDateTime << 32) |
+	                 info.ftLastWriteTime.dwLowDateTime;
+
+	*time = ticks / 10000000 - 11644473600ULL;
+
+#endif
+
+	return true;
+}
+
+bool file_create_directory(const char *path)
+{
+	if (string_is_null_or_empty(path)) {
+		return false;
+	}
+
+	char directory[260];
+	size_t length = strlen(path);
+
+	if (length >= sizeof(directory)) {
+		return false;
+	}
+
+	memcpy(directory, path, length + 1);
+
+	// Create each parent directory in order. Directories which already exist are not an error.
+	for (size_t i = 1; i <= length; ++i) {
+
+		if (directory[i] != '/' && directory[i] != '\\' && directory[i] != 0) {
+			continue;
+		}
+
+		char separator = directory[i];
+		directory[i] = 0;
+
+#ifndef _WIN32
+		bool success = (mkdir(directory, 0755) == 0 || errno == EEXIST);
+#else
+		bool success = (CreateDirectoryA(directory, NULL) ||
+		                GetLastError() == ERROR_ALREADY_EXISTS);
+#endif
+
+		directory[i] = separator;
+
+		// Drive letters and the like can't be created, only the last directory has to succeed.
+		if (!success && separator == 0) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
 static size_t file_get_size(FILE *file)
 {
 	fseek(file, 0, SEEK_END);
@@ -18,8 +18,23 @@ bool file_for_each_line(const char *path,
 bool file_read_all_text(const char *path, char **buf, size_t *bytes_read);
 bool file_read_all_data(const char *path, void **buf, size_t *bytes_read);
 
+bool file_write_all_data(const char *path, const void *buf, size_t size);
+
+// Map the contents of a file into memory for reading. The mapping must be released with
+// file_unmap() using the returned size.
+void *file_map(const char *path, size_t *size);
+void file_unmap(void *data, size_t size);
+
 bool file_exists(const char *path);
 
+// Get the time the file was last modified, in seconds since the epoch. Returns false if the file
+// doesn't exist.
+bool file_get_modified_time(const char *path, uint64_t *time);
+
+// Create a directory and all of its missing parent directories. Returns true if the directory
+// exists after the call.
+bool file_create_directory(const char *path);
+
 END_DECLARATIONS;
 
 #endif
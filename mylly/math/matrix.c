@@ -32,6 +32,57 @@ quat_t mat_to_quat(mat_t mat)
 	return quat;
 }
 
+void mat_from_trs(mat_t *out, vec3_t position, quat_t rotation, vec3_t scale)
+{
+	float rx = rotation.x;
+	float ry = rotation.y;
+	float rz = rotation.z;
+	float rw = rotation.w;
+	float wx, wy, wz;
+	float xx, yy, yz;
+	float xy, xz, zz;
+	float x2, y2, z2;
+
+	x2 = rx + rx;
+	y2 = ry + ry;
+	z2 = rz + rz;
+
+	xx = rx * x2;
+	xy = rx * y2;
+	xz = rx * z2;
+
+	yy = ry * y2;
+	yz = ry * z2;
+	zz = rz * z2;
+
+	wx = rw * x2;
+	wy = rw * y2;
+	wz = rw * z2;
+
+	mat_set(out,
+
+		scale.x * (1.0f - (yy + zz)),
+		scale.x * (xy + wz),
+		scale.x * (xz - wy),
+		0,
+
+		scale.y * (xy - wz),
+		scale.y * (1.0f - (xx + zz)),
+		scale.y * (yz + wx),
+		0,
+
+		scale.z * (xz + wy),
+		scale.z * (yz - wx),
+		scale.z * (1.0f - (xx + yy)),
+		0,
+
+		position.x,
+		position.y,
+		position.z,
+		1
+	);
+}
+
 mat_t mat_invert(mat_t mat)
 {
 	mat_t dest;
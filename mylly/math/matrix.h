@@ -34,6 +34,9 @@ vec4_t mat_multiply4(mat_t mat, vec4_t v);
 void mat_multiply(mat_t mat1, mat_t mat2, mat_t *out);
 quat_t mat_to_quat(mat_t mat);
 
+// Compose a transform matrix from position, rotation and scale.
+void mat_from_trs(mat_t *out, vec3_t position, quat_t rotation, vec3_t scale);
+
 mat_t mat_invert(mat_t mat);
 
 // --------------------------------------------------------------------------------
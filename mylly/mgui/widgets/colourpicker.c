@@ -64,6 +64,15 @@ widget_t *colourpicker_create(widget_t *parent)
 
 	// Render the colour picker with a custom shader.
 	widget_set_custom_shader(widget, res_get_shader("default-colour-picker"));
+
+	colourpicker_t *picker = &widget->colour_picker;
+	shader_t *shader = widget->custom_shader;
+
+	picker->brightness_uniform = shader_get_uniform_handle(shader, "Brightness");
+	picker->alpha_uniform = shader_get_uniform_handle(shader, "Alpha");
+	picker->position_x_uniform = shader_get_uniform_handle(shader, "WidgetPosX");
+	picker->position_y_uniform = shader_get_uniform_handle(shader, "WidgetPosY");
+
 	colourpicker_set_brightness_alpha(widget, 1.0f, 1.0f);
 
 	return widget;
@@ -96,8 +105,10 @@ void colourpicker_set_brightness_alpha(widget_t *picker, float brightness, float
 	picker->colour_picker.brightness = brightness;
 	picker->colour_picker.alpha = (uint8_t)(255 * alpha);
 
-	shader_set_uniform_float(picker->custom_shader, "Brightness", brightness);
-	shader_set_uniform_float(picker->custom_shader, "Alpha", alpha);
+	shader_set_uniform_float_by_handle(picker->custom_shader,
+	                                   picker->colour_picker.brightness_uniform, brightness);
+	shader_set_uniform_float_by_handle(picker->custom_shader,
+	                                   picker->colour_picker.alpha_uniform, alpha);
 }
 
 void colourpicker_set_selected_handler(widget_t *picker, on_colour_selected_t handler)
@@ -171,8 +182,11 @@ static void on_colourpicker_refresh_vertices(widget_t *picker)
 
 	vec2i_t position = widget_get_world_position(picker);
 
-	shader_set_uniform_float(picker->custom_shader, "WidgetPosX", position.x);
-	shader_set_uniform_float(picker->custom_shader, "WidgetPosY", mgui_parameters.height - position.y);
+	shader_set_uniform_float_by_handle(picker->custom_shader,
+	                                   picker->colour_picker.position_x_uniform, position.x);
+	shader_set_uniform_float_by_handle(picker->custom_shader,
+	                                   picker->colour_picker.position_y_uniform,
+	                                   mgui_parameters.height - position.y);
 }
 
 static void colourpicker_handle_click(widget_t *picker, int16_t click_x, int16_t click_y)
@@ -4,6 +4,7 @@
 
 #include "mgui/mgui.h"
 #include "renderer/colour.h"
+#include "renderer/shader.h"
 
 // -------------------------------------------------------------------------------------------------
 
@@ -18,6 +19,12 @@ typedef struct colourpicker_t {
 	float brightness; // The brightness of the selector colour map
 	float alpha; // The alpha of the selector colour map
 
+	// Uniforms of the custom shader, which are updated whenever the widget moves.
+	shader_uniform_handle_t brightness_uniform;
+	shader_uniform_handle_t alpha_uniform;
+	shader_uniform_handle_t position_x_uniform;
+	shader_uniform_handle_t position_y_uniform;
+
 } colourpicker_t;
 
 // -------------------------------------------------------------------------------------------------
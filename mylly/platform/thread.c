@@ -14,6 +14,21 @@ void thread_create(thread_t method, void *args)
 	}
 }
 
+thread_handle_t thread_create_joinable(thread_t method, void *args)
+{
+	uint32_t thread_addr;
+	return (HANDLE)_beginthreadex(NULL, 0, method, args, 0, &thread_addr);
+}
+
+void thread_join(thread_handle_t thread)
+{
+	if (thread != NULL) {
+
+		WaitForSingleObject(thread, INFINITE);
+		CloseHandle(thread);
+	}
+}
+
 void thread_sleep(uint32_t ms)
 {
 	Sleep(ms);
@@ -39,6 +54,26 @@ void thread_destroy_lock(lock_t *lock)
 	DeleteCriticalSection(lock);
 }
 
+void thread_init_event(event_t *event)
+{
+	*event = CreateEvent(NULL, FALSE, FALSE, NULL);
+}
+
+void thread_signal_event(event_t *event)
+{
+	SetEvent(*event);
+}
+
+void thread_wait_event(event_t *event)
+{
+	WaitForSingleObject(*event, INFINITE);
+}
+
+void thread_destroy_event(event_t *event)
+{
+	CloseHandle(*event);
+}
+
 #else
 
 #include <time.h>
@@ -53,6 +88,19 @@ void thread_create(thread_t method, void *args)
 	pthread_create(&thread, &attr, method, args);
 }
 
+thread_handle_t thread_create_joinable(thread_t method, void *args)
+{
+	pthread_t thread;
+	pthread_create(&thread, NULL, method, args);
+
+	return thread;
+}
+
+void thread_join(thread_handle_t thread)
+{
+	pthread_join(thread, NULL);
+}
+
 void thread_sleep(uint32_t ms)
 {
 	long seconds = (long)ms / 1000L;
@@ -85,4 +133,41 @@ void thread_destroy_lock(lock_t *lock)
 	pthread_mutex_destroy(lock);
 }
 
+void thread_init_event(event_t *event)
+{
+	pthread_mutex_init(&event->mutex, NULL);
+	pthread_cond_init(&event->condition, NULL);
+
+	event->is_set = false;
+}
+
+void thread_signal_event(event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+
+	event->is_set = true;
+	pthread_cond_signal(&event->condition);
+
+	pthread_mutex_unlock(&event->mutex);
+}
+
+void thread_wait_event(event_t *event)
+{
+	pthread_mutex_lock(&event->mutex);
+
+	while (!event->is_set) {
+		pthread_cond_wait(&event->condition, &event->mutex);
+	}
+
+	event->is_set = false;
+
+	pthread_mutex_unlock(&event->mutex);
+}
+
+void thread_destroy_event(event_t *event)
+{
+	pthread_cond_destroy(&event->condition);
+	pthread_mutex_destroy(&event->mutex);
+}
+
 #endif
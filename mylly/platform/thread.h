@@ -12,17 +12,32 @@ BEGIN_DECLARATIONS;
 	typedef uint32_t (__stdcall *thread_t)(void *args);
 	#define THREAD(x) static uint32_t __stdcall x(void *args)
 
+	typedef HANDLE thread_handle_t;
 	typedef CRITICAL_SECTION lock_t;
+	typedef HANDLE event_t;
 #else
 	#include <pthread.h>
 
 	typedef void *(*thread_t)(void *args);
 	#define THREAD(x) static void *x(void *args)
 
+	typedef pthread_t thread_handle_t;
 	typedef pthread_mutex_t lock_t;
+
+	typedef struct event_t {
+		pthread_mutex_t mutex;
+		pthread_cond_t condition;
+		bool is_set;
+	} event_t;
 #endif
 
 void thread_create(thread_t method, void *args);
+
+// Start a thread which has to be waited for with thread_join(). Joining a thread waits until it
+// has returned and releases the thread.
+thread_handle_t thread_create_joinable(thread_t method, void *args);
+void thread_join(thread_handle_t thread);
+
 void thread_sleep(uint32_t ms);
 
 void thread_init_lock(lock_t *lock);
@@ -30,6 +45,13 @@ void thread_lock(lock_t *lock);
 void thread_unlock(lock_t *lock);
 void thread_destroy_lock(lock_t *lock);
 
+// Events are used to wake up a waiting thread. A signaled event stays set until a single waiting
+// thread has been released, after which it is reset automatically.
+void thread_init_event(event_t *event);
+void thread_signal_event(event_t *event);
+void thread_wait_event(event_t *event);
+void thread_destroy_event(event_t *event);
+
 END_DECLARATIONS;
 
 #endif
@@ -50,6 +50,17 @@ uint64_t timer_get_ticks(void)
 	return GetTickCount64();
 }
 
+uint64_t timer_get_microseconds(void)
+{
+	LARGE_INTEGER frequency, counter;
+
+	QueryPerformanceFrequency(&frequency);
+	QueryPerformanceCounter(&counter);
+
+	return (uint64_t)(counter.QuadPart / frequency.QuadPart * 1000000 +
+	                  counter.QuadPart % frequency.QuadPart * 1000000 / frequency.QuadPart);
+}
+
 #else
 
 #include <time.h>
@@ -62,4 +73,12 @@ uint64_t timer_get_ticks(void)
 	return (uint64_t)((now.tv_sec * 1000000000LL + now.tv_nsec) / 1000000LL);
 }
 
+uint64_t timer_get_microseconds(void)
+{
+	struct timespec now;
+	clock_gettime(CLOCK_MONOTONIC, &now);
+
+	return (uint64_t)(now.tv_sec * 1000000LL + now.tv_nsec / 1000LL);
+}
+
 #endif
@@ -16,6 +16,9 @@ float timer_get_factor(timeout_t *timer, uint64_t interval_ms);
 
 uint64_t timer_get_ticks(void);
 
+// High resolution timestamp in microseconds. Intended for profiling.
+uint64_t timer_get_microseconds(void);
+
 END_DECLARATIONS;
 
 #endif
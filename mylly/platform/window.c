@@ -146,6 +146,7 @@ HWND window_get_handle(void)
 #include <X11/extensions/Xrandr.h>
 #include <GL/gl.h>
 #include <GL/glx.h>
+#include "core/mylly.h"
 
 // -------------------------------------------------------------------------------------------------
 
@@ -165,6 +166,12 @@ bool window_create(bool fullscreen, int monitor, int x, int y, int width, int he
 		return false;
 	}
 
+	// The render thread swaps buffers while the main thread processes window events, so Xlib has
+	// to be made thread safe before it is used for anything else.
+	if (mylly_get_parameters()->renderer.use_render_thread) {
+		XInitThreads();
+	}
+
 	// Connect to the X server.
 	display = XOpenDisplay(NULL);
 
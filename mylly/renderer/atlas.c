@@ -0,0 +1,683 @@
+#include "atlas.h"
+#include "renderer/renderer.h"
+#include "renderer/texcompress.h"
+#include "scene/sprite.h"
+#include "core/memory.h"
+#include "core/string.h"
+#include "io/file.h"
+#include "io/log.h"
+#include "math/math.h"
+#include <stdlib.h>
+#include <stdio.h>
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+#define ATLAS_LAYOUT_MAGIC 0x534C5441 // "ATLS"
+#define ATLAS_LAYOUT_VERSION 1
+#define ATLAS_LAYOUT_NAME_LENGTH 64
+
+// Layout file header. The header is followed by the shelves of each page (the number of shelves
+// followed by the shelves) and the entries.
+typedef struct atlas_layout_header_t {
+
+	uint32_t magic; // Always ATLAS_LAYOUT_MAGIC
+	uint16_t version; // Version of the file format
+	uint16_t page_size; // Settings of the atlas the layout was saved from
+	uint16_t padding;
+	uint16_t num_pages;
+	uint32_t num_entries;
+
+} atlas_layout_header_t;
+
+typedef struct atlas_layout_entry_t {
+
+	char name[ATLAS_LAYOUT_NAME_LENGTH]; // Resource name of the texture
+	uint16_t page;
+	uint16_t x, y;
+	uint16_t width, height;
+	uint16_t reserved;
+
+} atlas_layout_entry_t;
+
+STATIC_ASSERT(sizeof(atlas_layout_header_t) == 16, atlas_layout_header_size);
+STATIC_ASSERT(sizeof(atlas_layout_entry_t) == 76, atlas_layout_entry_size);
+STATIC_ASSERT(sizeof(atlas_shelf_t) == 6, atlas_shelf_size);
+
+// -------------------------------------------------------------------------------------------------
+
+static atlas_page_t *atlas_create_page(atlas_t *atlas);
+static bool atlas_allocate(atlas_t *atlas, atlas_page_t *page, atlas_entry_t *entry);
+static bool atlas_place(atlas_t *atlas, atlas_entry_t *entry);
+static void atlas_repack_page(atlas_t *atlas, uint16_t page_index);
+static void atlas_copy_pixels(atlas_t *atlas, atlas_entry_t *entry);
+static void atlas_move_sprites(atlas_t *atlas, atlas_entry_t *entry);
+static void atlas_release_entry(atlas_t *atlas, size_t index);
+static uint32_t atlas_get_padded_area(atlas_t *atlas, const atlas_entry_t *entry);
+static int atlas_compare_entries(const void *a, const void *b);
+
+// -------------------------------------------------------------------------------------------------
+
+atlas_t *atlas_create(const char *name, uint16_t page_size, uint16_t padding, TEX_FILTER filter)
+{
+	NEW(atlas_t, atlas);
+
+	atlas->name = string_duplicate(name);
+	atlas->page_size = page_size;
+	atlas->padding = padding;
+	atlas->filter = filter;
+
+	arr_init(atlas->pages);
+	arr_init(atlas->entries);
+
+	return atlas;
+}
+
+void atlas_destroy(atlas_t *atlas)
+{
+	if (atlas == NULL) {
+		return;
+	}
+
+	// Move the sprites back to their own textures, they may outlive the atlas.
+	while (atlas->entries.count != 0) {
+		atlas_release_entry(atlas, atlas->entries.count - 1);
+	}
+
+	atlas_page_t *page;
+
+	arr_foreach(atlas->pages, page) {
+
+		texture_destroy(page->texture);
+		arr_clear(page->shelves);
+
+		DESTROY(page);
+	}
+
+	arr_clear(atlas->pages);
+	arr_clear(atlas->entries);
+
+	DESTROY(atlas->name);
+	DESTROY(atlas);
+}
+
+bool atlas_add_texture(atlas_t *atlas, texture_t *texture)
+{
+	if (atlas == NULL || texture == NULL || texture->data == NULL ||
+		texcomp_is_compressed(texture->format)) {
+		return false;
+	}
+
+	// Textures which take most of a page don't benefit from being packed.
+	if (texture->width + 2 * atlas->padding > atlas->page_size ||
+		texture->height + 2 * atlas->padding > atlas->page_size) {
+		return false;
+	}
+
+	atlas_entry_t *entry = NULL;
+
+	for (size_t i = 0; i < atlas->entries.count; i++) {
+
+		atlas_entry_t *existing = &atlas->entries.items[i];
+
+		if (existing->source == texture) {
+			return true;
+		}
+
+		if (existing->source == NULL && string_equals(existing->name, texture->resource.res_name)) {
+
+			// Reuse the saved position of the texture if its size hasn't changed.
+			if (existing->width == texture->width && existing->height == texture->height) {
+				entry = existing;
+			}
+			else {
+				atlas_release_entry(atlas, i);
+			}
+
+			break;
+		}
+	}
+
+	if (entry == NULL) {
+
+		atlas_entry_t new_entry = { 0 };
+
+		new_entry.name = string_duplicate(texture->resource.res_name);
+		new_entry.width = texture->width;
+		new_entry.height = texture->height;
+
+		if (!atlas_place(atlas, &new_entry)) {
+
+			log_warning("Atlas", "Could not fit texture %s into atlas %s.",
+			            texture->resource.res_name, atlas->name);
+
+			DESTROY(new_entry.name);
+			return false;
+		}
+
+		arr_push(atlas->entries, new_entry);
+		entry = &arr_last(atlas->entries);
+	}
+
+	entry->source = texture;
+
+	atlas_copy_pixels(atlas, entry);
+	atlas_move_sprites(atlas, entry);
+
+	return true;
+}
+
+void atlas_remove_texture(atlas_t *atlas, texture_t *texture)
+{
+	if (atlas == NULL || texture == NULL) {
+		return;
+	}
+
+	for (size_t i = 0; i < atlas->entries.count; i++) {
+
+		if (atlas->entries.items[i].source == texture) {
+
+			atlas_release_entry(atlas, i);
+			return;
+		}
+	}
+}
+
+void atlas_commit(atlas_t *atlas)
+{
+	if (atlas == NULL) {
+		return;
+	}
+
+	// Saved positions of textures which were not added again are now holes in their pages.
+	for (size_t i = atlas->entries.count; i-- > 0;) {
+
+		if (atlas->entries.items[i].source == NULL) {
+			atlas_release_entry(atlas, i);
+		}
+	}
+
+	for (uint16_t i = 0; i < atlas->pages.count; i++) {
+
+		if (atlas_get_fragmentation(atlas, i) > ATLAS_REPACK_THRESHOLD) {
+			atlas_repack_page(atlas, i);
+		}
+	}
+
+	// Upload the pages which have changed. The sprites refer to the page texture object, so they
+	// pick up the new GPU texture automatically.
+	atlas_page_t *page;
+
+	arr_foreach(atlas->pages, page) {
+
+		if (!page->is_dirty) {
+			continue;
+		}
+
+		texture_t *texture = page->texture;
+
+		if (texture->gpu_texture != (texture_name_t)-1) {
+			rend_delete_texture(texture->gpu_texture);
+		}
+
+		texture->gpu_texture = rend_generate_texture(texture->data, texture->width,
+		                                             texture->height, TEX_FORMAT_RGBA,
+		                                             atlas->filter);
+
+		texture->resource.is_loaded = true;
+		page->is_dirty = false;
+	}
+}
+
+float atlas_get_fragmentation(atlas_t *atlas, uint16_t page)
+{
+	if (atlas == NULL || page >= atlas->pages.count) {
+		return 0;
+	}
+
+	atlas_page_t *atlas_page = atlas->pages.items[page];
+
+	if (atlas_page->used_area == 0) {
+		return 0;
+	}
+
+	return (float)atlas_page->wasted_area / atlas_page->used_area;
+}
+
+bool atlas_load_layout(atlas_t *atlas, const char *path)
+{
+	if (atlas == NULL || path == NULL || atlas->entries.count != 0 || !file_exists(path)) {
+		return false;
+	}
+
+	void *buffer;
+	size_t length;
+
+	if (!file_read_all_data(path, &buffer, &length)) {
+		return false;
+	}
+
+	const uint8_t *data = buffer;
+	const uint8_t *end = data + length;
+	const atlas_layout_header_t *header = (const atlas_layout_header_t *)data;
+
+	// A layout saved with different settings can't be reused.
+	if (length < sizeof(*header) ||
+		header->magic != ATLAS_LAYOUT_MAGIC ||
+		header->version != ATLAS_LAYOUT_VERSION ||
+		header->page_size != atlas->page_size ||
+		header->padding != atlas->padding ||
+		header->num_pages > ATLAS_MAX_PAGES) {
+
+		mem_free(buffer);
+		return false;
+	}
+
+	data += sizeof(*header);
+
+	// Validate the rest of the file before creating any pages.
+	const uint8_t *shelves = data;
+	bool is_valid = true;
+
+	for (uint16_t i = 0; i < header->num_pages && is_valid; i++) {
+
+		uint32_t num_shelves;
+
+		if ((size_t)(end - data) < sizeof(num_shelves)) {
+
+			is_valid = false;
+			break;
+		}
+
+		memcpy(&num_shelves, data, sizeof(num_shelves));
+		data += sizeof(num_shelves);
+
+		if ((size_t)(end - data) < num_shelves * sizeof(atlas_shelf_t)) {
+			is_valid = false;
+		}
+
+		data += (is_valid ? num_shelves * sizeof(atlas_shelf_t) : 0);
+	}
+
+	const atlas_layout_entry_t *entries = (const atlas_layout_entry_t *)data;
+
+	if (!is_valid ||
+		(size_t)(end - data) < header->num_entries * sizeof(atlas_layout_entry_t)) {
+
+		log_warning("Atlas", "%s is not a valid atlas layout.", path);
+
+		mem_free(buffer);
+		return false;
+	}
+
+	// Restore the pages and their shelves.
+	data = shelves;
+
+	for (uint16_t i = 0; i < header->num_pages; i++) {
+
+		atlas_page_t *page = atlas_create_page(atlas);
+		uint32_t num_shelves;
+
+		memcpy(&num_shelves, data, sizeof(num_shelves));
+		data += sizeof(num_shelves);
+
+		for (uint32_t j = 0; j < num_shelves; j++) {
+
+			atlas_shelf_t shelf;
+			memcpy(&shelf, data, sizeof(shelf));
+
+			arr_push(page->shelves, shelf);
+			data += sizeof(shelf);
+		}
+	}
+
+	// Restore the entries. They are waiting for their textures to be added.
+	for (uint32_t i = 0; i < header->num_entries; i++) {
+
+		atlas_layout_entry_t saved;
+		memcpy(&saved, &entries[i], sizeof(saved));
+
+		if (saved.page >= atlas->pages.count) {
+			continue;
+		}
+
+		saved.name[ATLAS_LAYOUT_NAME_LENGTH - 1] = 0;
+
+		atlas_entry_t entry = { 0 };
+
+		entry.name = string_duplicate(saved.name);
+		entry.page = saved.page;
+		entry.x = saved.x;
+		entry.y = saved.y;
+		entry.width = saved.width;
+		entry.height = saved.height;
+
+		atlas->pages.items[entry.page]->used_area += atlas_get_padded_area(atlas, &entry);
+
+		arr_push(atlas->entries, entry);
+	}
+
+	mem_free(buffer);
+	return true;
+}
+
+bool atlas_save_layout(atlas_t *atlas, const char *path)
+{
+	if (atlas == NULL || path == NULL) {
+		return false;
+	}
+
+	size_t size = sizeof(atlas_layout_header_t) +
+	              atlas->entries.count * sizeof(atlas_layout_entry_t);
+
+	atlas_page_t *page;
+
+	arr_foreach(atlas->pages, page) {
+		size += sizeof(uint32_t) + page->shelves.count * sizeof(atlas_shelf_t);
+	}
+
+	uint8_t *buffer = mem_alloc(size);
+	uint8_t *data = buffer;
+
+	atlas_layout_header_t header = { 0 };
+
+	header.magic = ATLAS_LAYOUT_MAGIC;
+	header.version = ATLAS_LAYOUT_VERSION;
+	header.page_size = atlas->page_size;
+	header.padding = atlas->padding;
+	header.num_pages = (uint16_t)atlas->pages.count;
+	header.num_entries = (uint32_t)atlas->entries.count;
+
+	memcpy(data, &header, sizeof(header));
+	data += sizeof(header);
+
+	arr_foreach(atlas->pages, page) {
+
+		uint32_t num_shelves = (uint32_t)page->shelves.count;
+
+		memcpy(data, &num_shelves, sizeof(num_shelves));
+		data += sizeof(num_shelves);
+
+		memcpy(data, page->shelves.items, num_shelves * sizeof(atlas_shelf_t));
+		data += num_shelves * sizeof(atlas_shelf_t);
+	}
+
+	for (size_t i = 0; i < atlas->entries.count; i++) {
+
+		const atlas_entry_t *entry = &atlas->entries.items[i];
+		atlas_layout_entry_t saved;
+		memset(&saved, 0, sizeof(saved));
+
+		string_copy(saved.name, entry->name, sizeof(saved.name));
+
+		saved.page = entry->page;
+		saved.x = entry->x;
+		saved.y = entry->y;
+		saved.width = entry->width;
+		saved.height = entry->height;
+
+		memcpy(data, &saved, sizeof(saved));
+		data += sizeof(saved);
+	}
+
+	bool success = file_write_all_data(path, buffer, size);
+
+	if (!success) {
+		log_warning("Atlas", "Could not save the layout of atlas %s.", atlas->name);
+	}
+
+	mem_free(buffer);
+	return success;
+}
+
+static atlas_page_t *atlas_create_page(atlas_t *atlas)
+{
+	char name[200];
+	snprintf(name, sizeof(name), "%s-%u", atlas->name, (uint32_t)atlas->pages.count);
+
+	NEW(atlas_page_t, page);
+
+	// The page is uploaded when the atlas is committed.
+	page->texture = texture_create(name, NULL);
+	page->texture->width = atlas->page_size;
+	page->texture->height = atlas->page_size;
+	page->texture->format = TEX_FORMAT_RGBA;
+	page->texture->data = mem_alloc(4 * atlas->page_size * atlas->page_size);
+
+	arr_init(page->shelves);
+	arr_push(atlas->pages, page);
+
+	return page;
+}
+
+static bool atlas_allocate(atlas_t *atlas, atlas_page_t *page, atlas_entry_t *entry)
+{
+	uint32_t width = entry->width + 2 * atlas->padding;
+	uint32_t height = entry->height + 2 * atlas->padding;
+
+	// Find the shelf which wastes the least height, like the font packer's next-fit decreasing
+	// height algorithm, but any open shelf can be used so that textures can be added one by one.
+	atlas_shelf_t *best_shelf = NULL;
+
+	for (size_t i = 0; i < page->shelves.count; i++) {
+
+		atlas_shelf_t *shelf = &page->shelves.items[i];
+
+		if (shelf->height >= height && shelf->x + width <= atlas->page_size &&
+			(best_shelf == NULL || shelf->height < best_shelf->height)) {
+
+			best_shelf = shelf;
+		}
+	}
+
+	// Open a new shelf below the last one.
+	if (best_shelf == NULL) {
+
+		uint32_t y = 0;
+
+		if (!arr_is_empty(page->shelves)) {
+			y = arr_last(page->shelves).y + arr_last(page->shelves).height;
+		}
+
+		if (y + height > atlas->page_size) {
+			return false;
+		}
+
+		atlas_shelf_t shelf = { (uint16_t)y, (uint16_t)height, 0 };
+		arr_push(page->shelves, shelf);
+
+		best_shelf = &arr_last(page->shelves);
+	}
+
+	entry->x = best_shelf->x + atlas->padding;
+	entry->y = best_shelf->y + atlas->padding;
+
+	best_shelf->x += width;
+	page->used_area += width * height;
+	page->is_dirty = true;
+
+	return true;
+}
+
+static bool atlas_place(atlas_t *atlas, atlas_entry_t *entry)
+{
+	for (uint16_t i = 0; i < atlas->pages.count; i++) {
+
+		if (atlas_allocate(atlas, atlas->pages.items[i], entry)) {
+
+			entry->page = i;
+			return true;
+		}
+	}
+
+	if (atlas->pages.count >= ATLAS_MAX_PAGES) {
+		return false;
+	}
+
+	atlas_page_t *page = atlas_create_page(atlas);
+	entry->page = (uint16_t)arr_last_index(atlas->pages);
+
+	return atlas_allocate(atlas, page, entry);
+}
+
+static void atlas_repack_page(atlas_t *atlas, uint16_t page_index)
+{
+	atlas_page_t *page = atlas->pages.items[page_index];
+
+	// Collect the textures on the page, tallest first.
+	size_t num_entries = 0;
+	atlas_entry_t **entries = mem_alloc_fast(atlas->entries.count * sizeof(atlas_entry_t *));
+
+	for (size_t i = 0; i < atlas->entries.count; i++) {
+
+		if (atlas->entries.items[i].page == page_index) {
+			entries[num_entries++] = &atlas->entries.items[i];
+		}
+	}
+
+	qsort(entries, num_entries, sizeof(entries[0]), atlas_compare_entries);
+
+	// Clear the page and pack its textures into it again. Textures which don't fit anymore are
+	// moved onto other pages.
+	arr_clear(page->shelves);
+
+	page->used_area = 0;
+	page->wasted_area = 0;
+	page->is_dirty = true;
+
+	memset(page->texture->data, 0, 4 * atlas->page_size * atlas->page_size);
+
+	for (size_t i = 0; i < num_entries; i++) {
+
+		atlas_entry_t *entry = entries[i];
+
+		if (!atlas_allocate(atlas, page, entry) && !atlas_place(atlas, entry)) {
+
+			// There is no room for the texture on any page, so its sprites use the texture.
+			log_warning("Atlas", "Could not repack texture %s into atlas %s.",
+			            entry->name, atlas->name);
+
+			entry->page = ATLAS_MAX_PAGES;
+			continue;
+		}
+
+		atlas_copy_pixels(atlas, entry);
+		atlas_move_sprites(atlas, entry);
+	}
+
+	// Remove the textures which were left out.
+	for (size_t i = atlas->entries.count; i-- > 0;) {
+
+		if (atlas->entries.items[i].page == ATLAS_MAX_PAGES) {
+
+			atlas->entries.items[i].page = page_index;
+			atlas_release_entry(atlas, i);
+		}
+	}
+
+	// Nothing on the page has been removed after repacking.
+	page->wasted_area = 0;
+
+	mem_free(entries);
+}
+
+static void atlas_copy_pixels(atlas_t *atlas, atlas_entry_t *entry)
+{
+	texture_t *source = entry->source;
+	atlas_page_t *page = atlas->pages.items[entry->page];
+
+	uint8_t *pixels = page->texture->data;
+	const uint8_t *source_pixels = source->data;
+
+	size_t channels = (source->format == TEX_FORMAT_GRAYSCALE ? 1 :
+	                   source->format == TEX_FORMAT_RGB ? 3 : 4);
+
+	int padding = atlas->padding;
+
+	// Copy the texture and extend its edge pixels into the padding around it.
+	for (int y = -padding; y < entry->height + padding; y++) {
+
+		int source_y = CLAMP(y, 0, entry->height - 1);
+		uint8_t *dst = &pixels[4 * ((entry->y + y) * atlas->page_size + entry->x - padding)];
+
+		for (int x = -padding; x < entry->width + padding; x++) {
+
+			int source_x = CLAMP(x, 0, entry->width - 1);
+			const uint8_t *src = &source_pixels[channels * (source_y * entry->width + source_x)];
+
+			switch (channels) {
+
+				case 1:
+					dst[0] = dst[1] = dst[2] = src[0];
+					dst[3] = 255;
+					break;
+
+				case 3:
+					dst[0] = src[0];
+					dst[1] = src[1];
+					dst[2] = src[2];
+					dst[3] = 255;
+					break;
+
+				default:
+					memcpy(dst, src, 4);
+					break;
+			}
+
+			dst += 4;
+		}
+	}
+
+	page->is_dirty = true;
+}
+
+static void atlas_move_sprites(atlas_t *atlas, atlas_entry_t *entry)
+{
+	texture_t *page_texture = atlas->pages.items[entry->page]->texture;
+	sprite_t *sprite;
+
+	arr_foreach(entry->source->sprites, sprite) {
+		sprite_set_atlas_region(sprite, page_texture, vec2(entry->x, entry->y));
+	}
+}
+
+static void atlas_release_entry(atlas_t *atlas, size_t index)
+{
+	atlas_entry_t *entry = &atlas->entries.items[index];
+
+	// The space of the texture can't be reused until the page is repacked.
+	if (entry->page < atlas->pages.count) {
+		atlas->pages.items[entry->page]->wasted_area += atlas_get_padded_area(atlas, entry);
+	}
+
+	// Move the sprites back to the texture they were loaded from.
+	if (entry->source != NULL) {
+
+		sprite_t *sprite;
+
+		arr_foreach(entry->source->sprites, sprite) {
+			sprite_set_atlas_region(sprite, entry->source, vec2_zero());
+		}
+	}
+
+	DESTROY(entry->name);
+	arr_remove_at(atlas->entries, index);
+}
+
+static uint32_t atlas_get_padded_area(atlas_t *atlas, const atlas_entry_t *entry)
+{
+	return (uint32_t)(entry->width + 2 * atlas->padding) * (entry->height + 2 * atlas->padding);
+}
+
+static int atlas_compare_entries(const void *a, const void *b)
+{
+	const atlas_entry_t *entry1 = *(const atlas_entry_t **)a;
+	const atlas_entry_t *entry2 = *(const atlas_entry_t **)b;
+
+	if (entry1->height > entry2->height) return -1;
+	if (entry1->height < entry2->height) return 1;
+	if (entry1->width > entry2->width) return -1;
+	if (entry1->width < entry2->width) return 1;
+
+	return 0;
+}
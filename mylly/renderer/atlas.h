@@ -0,0 +1,109 @@
+#pragma once
+#ifndef __ATLAS_H
+#define __ATLAS_H
+
+#include "core/types.h"
+#include "collections/array.h"
+#include "renderer/texture.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Texture atlas
+
+	Packs many small textures (usually sprite sheets and UI images) into shared atlas pages, so
+	the sprites on them can be drawn with the same texture. The sprites of each packed texture are
+	moved onto the page and their texture coordinates are remapped.
+
+	Textures are packed into horizontal shelves, similarly to the font packer. Each texture is
+	surrounded by padding into which its edge pixels are extended (bleed), so filtering doesn't
+	pick up colours from the neighbouring textures.
+
+	Textures can be added and removed at any time. Removed textures leave a hole in their shelf,
+	and pages whose holes take more than ATLAS_REPACK_THRESHOLD of the packed area are repacked
+	when the changes are committed.
+
+	The packing result can be saved and loaded, so the layout stays the same between runs and
+	textures don't have to be packed again.
+
+====================================================================================================
+*/
+
+#define ATLAS_MAX_PAGES 16
+#define ATLAS_REPACK_THRESHOLD 0.25f // Fraction of wasted space which causes a page to be repacked
+
+// -------------------------------------------------------------------------------------------------
+
+// A horizontal strip of a page into which textures are placed from left to right.
+typedef struct atlas_shelf_t {
+
+	uint16_t y; // Top of the shelf
+	uint16_t height; // Height of the tallest texture the shelf fits
+	uint16_t x; // The position where the next texture is placed
+
+} atlas_shelf_t;
+
+typedef struct atlas_page_t {
+
+	texture_t *texture; // Atlas texture, the pixels of the page are stored in its data
+	arr_t(atlas_shelf_t) shelves; // Shelves from top to bottom
+	uint32_t used_area; // Area taken by packed textures including their padding
+	uint32_t wasted_area; // Area left behind by removed textures
+	bool is_dirty; // The pixels have changed since they were uploaded
+
+} atlas_page_t;
+
+typedef struct atlas_entry_t {
+
+	char *name; // Resource name of the packed texture
+	texture_t *source; // The packed texture, NULL if a loaded entry hasn't been added yet
+	uint16_t page; // Index of the page the texture is on
+	uint16_t x, y; // Position of the texture on the page, not including the padding
+	uint16_t width, height; // Size of the texture in pixels
+
+} atlas_entry_t;
+
+typedef struct atlas_t {
+
+	char *name; // Name of the atlas, used for naming the page textures
+	uint16_t page_size; // Width and height of each page in pixels
+	uint16_t padding; // Number of pixels around each texture
+	TEX_FILTER filter; // Filter used for sampling the pages
+
+	arr_t(atlas_page_t*) pages;
+	arr_t(atlas_entry_t) entries;
+
+} atlas_t;
+
+// -------------------------------------------------------------------------------------------------
+
+atlas_t *atlas_create(const char *name, uint16_t page_size, uint16_t padding, TEX_FILTER filter);
+void atlas_destroy(atlas_t *atlas);
+
+// Pack a texture into the atlas and move its sprites onto the atlas page. The texture must have
+// uncompressed pixel data and fit on a page. Returns false if the texture could not be packed.
+bool atlas_add_texture(atlas_t *atlas, texture_t *texture);
+
+// Remove a texture from the atlas. The sprites of the texture are moved back to it.
+void atlas_remove_texture(atlas_t *atlas, texture_t *texture);
+
+// Repack fragmented pages and upload the pages which have changed. Should be called after adding
+// or removing a batch of textures.
+void atlas_commit(atlas_t *atlas);
+
+// Returns the fraction of the packed area of a page which is wasted by removed textures.
+float atlas_get_fragmentation(atlas_t *atlas, uint16_t page);
+
+// Load a packing result saved by atlas_save_layout(). Textures added to the atlas afterwards are
+// placed into their saved positions if their size hasn't changed. Must be called before adding
+// any textures.
+bool atlas_load_layout(atlas_t *atlas, const char *path);
+
+// Save the current packing result of the atlas.
+bool atlas_save_layout(atlas_t *atlas, const char *path);
+
+END_DECLARATIONS;
+
+#endif
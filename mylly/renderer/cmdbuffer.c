@@ -0,0 +1,352 @@
+#include "cmdbuffer.h"
+#include "core/memory.h"
+#include "io/file.h"
+#include "io/log.h"
+#include "math/math.h"
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+#define MIN_CMDBUF_CAPACITY 4096 // Initial size of a command buffer in bytes
+
+// -------------------------------------------------------------------------------------------------
+
+static void *cmdbuf_push(cmdbuf_t *buffer, cmd_type_t type, size_t size);
+static void cmdbuf_reserve(cmdbuf_t *buffer, size_t capacity);
+static bool cmdbuf_validate(const uint8_t *data, size_t size, uint32_t num_commands,
+                            uint32_t *num_objects, uint32_t *num_instances);
+
+// -------------------------------------------------------------------------------------------------
+
+// Command sizes have to be a multiple of 4 so every command stays aligned.
+STATIC_ASSERT(sizeof(cmd_set_pipeline_t) % 4 == 0, cmd_set_pipeline_size);
+STATIC_ASSERT(sizeof(cmd_bind_textures_t) % 4 == 0, cmd_bind_textures_size);
+STATIC_ASSERT(sizeof(cmd_bind_buffers_t) % 4 == 0, cmd_bind_buffers_size);
+STATIC_ASSERT(sizeof(cmd_set_uniform_t) % 4 == 0, cmd_set_uniform_size);
+STATIC_ASSERT(sizeof(cmd_set_object_t) % 4 == 0, cmd_set_object_size);
+STATIC_ASSERT(sizeof(cmd_draw_t) % 4 == 0, cmd_draw_size);
+STATIC_ASSERT(sizeof(cmd_draw_instanced_t) % 4 == 0, cmd_draw_instanced_size);
+STATIC_ASSERT(sizeof(cmd_draw_instanced_t) + CMD_MAX_INSTANCES * sizeof(mat_t) <= UINT16_MAX,
+              cmd_draw_instanced_max_size);
+STATIC_ASSERT(sizeof(cmdbuf_file_header_t) == 16, cmdbuf_file_header_size);
+
+// -------------------------------------------------------------------------------------------------
+
+void cmdbuf_init(cmdbuf_t *buffer)
+{
+	buffer->data = NULL;
+	buffer->size = 0;
+	buffer->capacity = 0;
+	buffer->num_commands = 0;
+	buffer->num_objects = 0;
+	buffer->num_instances = 0;
+}
+
+void cmdbuf_destroy(cmdbuf_t *buffer)
+{
+	if (buffer->data != NULL) {
+		mem_free(buffer->data);
+	}
+
+	cmdbuf_init(buffer);
+}
+
+void cmdbuf_reset(cmdbuf_t *buffer)
+{
+	buffer->size = 0;
+	buffer->num_commands = 0;
+	buffer->num_objects = 0;
+	buffer->num_instances = 0;
+}
+
+void cmdbuf_set_pipeline(cmdbuf_t *buffer, shader_program_t program, bool depth_write)
+{
+	cmd_set_pipeline_t *command = cmdbuf_push(buffer, CMD_SET_PIPELINE, sizeof(*command));
+
+	command->program = program;
+	command->depth_write = (depth_write ? 1 : 0);
+}
+
+void cmdbuf_bind_textures(cmdbuf_t *buffer, texture_name_t texture, texture_name_t normal_map)
+{
+	cmd_bind_textures_t *command = cmdbuf_push(buffer, CMD_BIND_TEXTURES, sizeof(*command));
+
+	command->texture = texture;
+	command->normal_map = normal_map;
+}
+
+void cmdbuf_bind_buffers(cmdbuf_t *buffer, vbindex_t vertices, vbindex_t indices,
+                         vertex_type_t vertex_type)
+{
+	cmd_bind_buffers_t *command = cmdbuf_push(buffer, CMD_BIND_BUFFERS, sizeof(*command));
+
+	command->vertices = vertices;
+	command->indices = indices;
+	command->vertex_type = (uint32_t)vertex_type;
+}
+
+void cmdbuf_set_uniform(cmdbuf_t *buffer, const shader_uniform_t *uniform)
+{
+	cmd_set_uniform_t *command = cmdbuf_push(buffer, CMD_SET_UNIFORM, sizeof(*command));
+
+	command->location = uniform->position;
+	command->type = (uint32_t)uniform->type;
+	command->value.vec = uniform->value.vec;
+}
+
+void cmdbuf_set_object(cmdbuf_t *buffer, const mat_t *mvp, const mat_t *model)
+{
+	cmd_set_object_t *command = cmdbuf_push(buffer, CMD_SET_OBJECT, sizeof(*command));
+
+	command->mvp = *mvp;
+	command->model = *model;
+
+	buffer->num_objects++;
+}
+
+void cmdbuf_draw(cmdbuf_t *buffer, cmd_primitive_t primitive, uint32_t first_index,
+                 uint32_t num_indices)
+{
+	cmd_draw_t *command = cmdbuf_push(buffer, CMD_DRAW, sizeof(*command));
+
+	command->primitive = (uint32_t)primitive;
+	command->first_index = first_index;
+	command->num_indices = num_indices;
+}
+
+mat_t *cmdbuf_draw_instanced(cmdbuf_t *buffer, cmd_primitive_t primitive, uint32_t first_index,
+                             uint32_t num_indices, uint32_t num_instances)
+{
+	cmd_draw_instanced_t *command = cmdbuf_push(buffer, CMD_DRAW_INSTANCED,
+	                                            sizeof(*command) + num_instances * sizeof(mat_t));
+
+	command->primitive = (uint32_t)primitive;
+	command->first_index = first_index;
+	command->num_indices = num_indices;
+	command->num_instances = num_instances;
+
+	buffer->num_instances += num_instances;
+
+	return (mat_t *)(command + 1);
+}
+
+const cmd_t *cmdbuf_first(const cmdbuf_t *buffer)
+{
+	if (buffer == NULL || buffer->size == 0) {
+		return NULL;
+	}
+
+	return (const cmd_t *)buffer->data;
+}
+
+const cmd_t *cmdbuf_next(const cmdbuf_t *buffer, const cmd_t *command)
+{
+	const uint8_t *next = (const uint8_t *)command + command->size;
+
+	if (next >= buffer->data + buffer->size) {
+		return NULL;
+	}
+
+	return (const cmd_t *)next;
+}
+
+bool cmdbuf_save(const cmdbuf_t *buffer, const char *path)
+{
+	if (buffer == NULL || path == NULL) {
+		return false;
+	}
+
+	cmdbuf_file_header_t header = { 0 };
+
+	header.magic = CMDBUF_FILE_MAGIC;
+	header.version = CMDBUF_FILE_VERSION;
+	header.num_commands = buffer->num_commands;
+	header.size = (uint32_t)buffer->size;
+
+	size_t size = sizeof(header) + buffer->size;
+	NEW_ARRAY(uint8_t, data, size);
+
+	memcpy(data, &header, sizeof(header));
+
+	if (buffer->size != 0) {
+		memcpy(&data[sizeof(header)], buffer->data, buffer->size);
+	}
+
+	bool success = file_write_all_data(path, data, size);
+
+	if (!success) {
+		log_warning("Renderer", "Could not write command buffer file %s.", path);
+	}
+
+	mem_free(data);
+	return success;
+}
+
+bool cmdbuf_load(cmdbuf_t *buffer, const char *path)
+{
+	if (buffer == NULL || path == NULL) {
+		return false;
+	}
+
+	size_t size;
+	uint8_t *data = file_map(path, &size);
+
+	if (data == NULL) {
+
+		log_warning("Renderer", "Could not open command buffer file %s.", path);
+		return false;
+	}
+
+	// Validate the header and every command before accepting the file, so replaying the buffer
+	// can never read past the end of it.
+	const cmdbuf_file_header_t *header = (const cmdbuf_file_header_t *)data;
+	uint32_t num_objects = 0;
+	uint32_t num_instances = 0;
+
+	if (size < sizeof(cmdbuf_file_header_t) ||
+		header->magic != CMDBUF_FILE_MAGIC ||
+		header->version != CMDBUF_FILE_VERSION ||
+		sizeof(cmdbuf_file_header_t) + (uint64_t)header->size > size ||
+		!cmdbuf_validate(&data[sizeof(cmdbuf_file_header_t)], header->size,
+		                 header->num_commands, &num_objects, &num_instances)) {
+
+		log_warning("Renderer", "%s is not a valid command buffer file.", path);
+
+		file_unmap(data, size);
+		return false;
+	}
+
+	cmdbuf_reset(buffer);
+	cmdbuf_reserve(buffer, header->size);
+
+	memcpy(buffer->data, &data[sizeof(cmdbuf_file_header_t)], header->size);
+
+	buffer->size = header->size;
+	buffer->num_commands = header->num_commands;
+	buffer->num_objects = num_objects;
+	buffer->num_instances = num_instances;
+
+	file_unmap(data, size);
+	return true;
+}
+
+const char *cmdbuf_get_command_name(cmd_type_t type)
+{
+	static const char *names[NUM_CMD_TYPES] = {
+		"SetPipeline",
+		"BindTextures",
+		"BindBuffers",
+		"SetUniform",
+		"SetObject",
+		"Draw",
+		"DrawInstanced",
+	};
+
+	if (type >= NUM_CMD_TYPES) {
+		return "Unknown";
+	}
+
+	return names[type];
+}
+
+static void *cmdbuf_push(cmdbuf_t *buffer, cmd_type_t type, size_t size)
+{
+	if (buffer->size + size > buffer->capacity) {
+		cmdbuf_reserve(buffer, MAX(2 * buffer->capacity, buffer->size + size));
+	}
+
+	cmd_t *command = (cmd_t *)&buffer->data[buffer->size];
+
+	command->type = (uint16_t)type;
+	command->size = (uint16_t)size;
+
+	buffer->size += size;
+	buffer->num_commands++;
+
+	return command;
+}
+
+static void cmdbuf_reserve(cmdbuf_t *buffer, size_t capacity)
+{
+	if (capacity <= buffer->capacity) {
+		return;
+	}
+
+	capacity = MAX(capacity, MIN_CMDBUF_CAPACITY);
+
+	uint8_t *data = mem_alloc_fast(capacity);
+
+	if (buffer->data != NULL) {
+
+		memcpy(data, buffer->data, buffer->size);
+		mem_free(buffer->data);
+	}
+
+	buffer->data = data;
+	buffer->capacity = capacity;
+}
+
+static bool cmdbuf_validate(const uint8_t *data, size_t size, uint32_t num_commands,
+                            uint32_t *num_objects, uint32_t *num_instances)
+{
+	static const size_t sizes[NUM_CMD_TYPES] = {
+		sizeof(cmd_set_pipeline_t),
+		sizeof(cmd_bind_textures_t),
+		sizeof(cmd_bind_buffers_t),
+		sizeof(cmd_set_uniform_t),
+		sizeof(cmd_set_object_t),
+		sizeof(cmd_draw_t),
+		sizeof(cmd_draw_instanced_t),
+	};
+
+	size_t offset = 0;
+	uint32_t count = 0;
+
+	*num_objects = 0;
+	*num_instances = 0;
+
+	while (offset < size) {
+
+		if (offset + sizeof(cmd_t) > size) {
+			return false;
+		}
+
+		const cmd_t *command = (const cmd_t *)&data[offset];
+
+		if (command->type >= NUM_CMD_TYPES ||
+			command->size < sizes[command->type] ||
+			offset + command->size > size) {
+
+			return false;
+		}
+
+		// Instanced draws are followed by the model matrices of the instances, other commands
+		// have a fixed size.
+		size_t expected_size = sizes[command->type];
+
+		if (command->type == CMD_DRAW_INSTANCED) {
+
+			uint32_t instances = ((const cmd_draw_instanced_t *)command)->num_instances;
+
+			if (instances > CMD_MAX_INSTANCES) {
+				return false;
+			}
+
+			expected_size += instances * sizeof(mat_t);
+			*num_instances += instances;
+		}
+
+		if (command->size != expected_size) {
+			return false;
+		}
+
+		if (command->type == CMD_SET_OBJECT) {
+			(*num_objects)++;
+		}
+
+		offset += command->size;
+		count++;
+	}
+
+	return (count == num_commands);
+}
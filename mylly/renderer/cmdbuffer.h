@@ -0,0 +1,211 @@
+#pragma once
+#ifndef __CMDBUFFER_H
+#define __CMDBUFFER_H
+
+#include "core/defines.h"
+#include "renderer/shader.h"
+#include "renderer/texture.h"
+#include "renderer/buffer.h"
+#include "renderer/vertex.h"
+#include "math/matrix.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Render command buffer
+
+	A compact list of draw commands recorded by the render system and replayed by the renderer
+	backend. Each render view records the meshes of each render queue into its own buffer, so the
+	buffers can be recorded in parallel and the backend only has to walk a flat list of plain data
+	instead of the meshes, objects and materials of the scene.
+
+	Commands only refer to objects by their renderer names and store all the values they need, so
+	a buffer is self contained and can be saved to a file and replayed later (for example to
+	replay a captured frame in a test). The file stores the commands in the byte order of the
+	machine they were recorded on.
+
+	The memory of a buffer is kept when the buffer is reset, so once a buffer has grown large
+	enough, recording commands does not allocate any memory.
+
+	Instanced draws store the model matrix of each instance right after the command. The size of
+	a command is stored in 16 bits, so a single command can draw at most CMD_MAX_INSTANCES
+	instances.
+
+====================================================================================================
+*/
+
+#define CMDBUF_FILE_MAGIC 0x444D4359 // "YCMD"
+#define CMDBUF_FILE_VERSION 2
+
+#define CMD_MAX_INSTANCES 1000 // Maximum number of instances drawn by a single command
+
+// -------------------------------------------------------------------------------------------------
+
+typedef enum cmd_type_t {
+
+	CMD_SET_PIPELINE, // Select a shader program and depth write mode
+	CMD_BIND_TEXTURES, // Bind the main texture and the normal map
+	CMD_BIND_BUFFERS, // Bind the vertex and index buffers used by the following draws
+	CMD_SET_UNIFORM, // Set the value of a custom material uniform of the current program
+	CMD_SET_OBJECT, // Set the per-object constants of the following draw
+	CMD_DRAW, // Draw indexed primitives from the bound buffers
+	CMD_DRAW_INSTANCED, // Draw several instances of indexed primitives with their own model matrix
+
+	NUM_CMD_TYPES
+
+} cmd_type_t;
+
+typedef enum cmd_primitive_t {
+
+	CMD_PRIMITIVE_TRIANGLES,
+	CMD_PRIMITIVE_LINES,
+
+} cmd_primitive_t;
+
+// Each command starts with a header which tells the type and the size of the command in bytes.
+typedef struct cmd_t {
+
+	uint16_t type; // See cmd_type_t above
+	uint16_t size; // Size of the command including the header
+
+} cmd_t;
+
+typedef struct cmd_set_pipeline_t {
+
+	cmd_t header;
+	shader_program_t program; // Shader program to use
+	uint32_t depth_write; // 1 when the draws write to the depth buffer
+
+} cmd_set_pipeline_t;
+
+typedef struct cmd_bind_textures_t {
+
+	cmd_t header;
+	texture_name_t texture; // Main texture, 0 to keep the previous texture bound
+	texture_name_t normal_map; // Normal map, 0 to keep the previous normal map bound
+
+} cmd_bind_textures_t;
+
+typedef struct cmd_bind_buffers_t {
+
+	cmd_t header;
+	vbindex_t vertices; // Vertex buffer object
+	vbindex_t indices; // Index buffer object
+	uint32_t vertex_type; // Layout of the vertices (see vertex_type_t)
+
+} cmd_bind_buffers_t;
+
+typedef struct cmd_set_uniform_t {
+
+	cmd_t header;
+	int32_t location; // Location of the uniform in the current program
+	uint32_t type; // Type of the value (see UNIFORM_TYPE)
+
+	union {
+		int32_t i;
+		float f;
+		vec4_t vec;
+	} value;
+
+} cmd_set_uniform_t;
+
+typedef struct cmd_set_object_t {
+
+	cmd_t header;
+	mat_t mvp; // Model-view-projection matrix
+	mat_t model; // Model matrix
+
+} cmd_set_object_t;
+
+typedef struct cmd_draw_t {
+
+	cmd_t header;
+	uint32_t primitive; // Type of the drawn primitives (see cmd_primitive_t)
+	uint32_t first_index; // Index of the first drawn index in the index buffer
+	uint32_t num_indices; // Number of drawn indices
+
+} cmd_draw_t;
+
+// The command is followed by the model matrix of each instance.
+typedef struct cmd_draw_instanced_t {
+
+	cmd_t header;
+	uint32_t primitive; // Type of the drawn primitives (see cmd_primitive_t)
+	uint32_t first_index; // Index of the first drawn index in the index buffer
+	uint32_t num_indices; // Number of drawn indices
+	uint32_t num_instances; // Number of drawn instances
+
+} cmd_draw_instanced_t;
+
+// -------------------------------------------------------------------------------------------------
+
+typedef struct cmdbuf_t {
+
+	uint8_t *data; // Recorded commands
+	size_t size; // Size of the recorded commands in bytes
+	size_t capacity; // Size of the allocated memory in bytes
+
+	uint32_t num_commands; // Number of recorded commands
+	uint32_t num_objects; // Number of CMD_SET_OBJECT commands
+	uint32_t num_instances; // Number of instances drawn by CMD_DRAW_INSTANCED commands
+
+} cmdbuf_t;
+
+// File header of a saved command buffer. The header is followed by the recorded commands.
+typedef struct cmdbuf_file_header_t {
+
+	uint32_t magic; // Always CMDBUF_FILE_MAGIC
+	uint32_t version; // Version of the file format
+	uint32_t num_commands; // Number of commands in the file
+	uint32_t size; // Size of the commands in bytes
+
+} cmdbuf_file_header_t;
+
+// -------------------------------------------------------------------------------------------------
+
+void cmdbuf_init(cmdbuf_t *buffer);
+void cmdbuf_destroy(cmdbuf_t *buffer);
+
+// Remove all the commands from the buffer. The memory of the buffer is kept for reuse.
+void cmdbuf_reset(cmdbuf_t *buffer);
+
+// Record commands to the end of the buffer.
+void cmdbuf_set_pipeline(cmdbuf_t *buffer, shader_program_t program, bool depth_write);
+void cmdbuf_bind_textures(cmdbuf_t *buffer, texture_name_t texture, texture_name_t normal_map);
+void cmdbuf_bind_buffers(cmdbuf_t *buffer, vbindex_t vertices, vbindex_t indices,
+                         vertex_type_t vertex_type);
+void cmdbuf_set_uniform(cmdbuf_t *buffer, const shader_uniform_t *uniform);
+void cmdbuf_set_object(cmdbuf_t *buffer, const mat_t *mvp, const mat_t *model);
+void cmdbuf_draw(cmdbuf_t *buffer, cmd_primitive_t primitive, uint32_t first_index,
+                 uint32_t num_indices);
+
+// Record an instanced draw. Returns the memory for the model matrices of the instances, which the
+// caller has to fill. The number of instances must not exceed CMD_MAX_INSTANCES.
+mat_t *cmdbuf_draw_instanced(cmdbuf_t *buffer, cmd_primitive_t primitive, uint32_t first_index,
+                             uint32_t num_indices, uint32_t num_instances);
+
+// Iterate the recorded commands in the order they were recorded. Returns NULL after the last
+// command.
+const cmd_t *cmdbuf_first(const cmdbuf_t *buffer);
+const cmd_t *cmdbuf_next(const cmdbuf_t *buffer, const cmd_t *command);
+
+// Save the commands of a buffer to a file, or replace the contents of a buffer with the commands
+// stored in a file.
+bool cmdbuf_save(const cmdbuf_t *buffer, const char *path);
+bool cmdbuf_load(cmdbuf_t *buffer, const char *path);
+
+// Returns a printable name for a command type.
+const char *cmdbuf_get_command_name(cmd_type_t type);
+
+// Returns the model matrices of the instances of an instanced draw.
+#define cmdbuf_get_instances(command)\
+	((const mat_t *)((const cmd_draw_instanced_t *)(command) + 1))
+
+#define cmdbuf_foreach(buffer, command)\
+	for (command = cmdbuf_first(buffer); command != NULL; command = cmdbuf_next(buffer, command))
+
+END_DECLARATIONS;
+
+#endif
@@ -0,0 +1,289 @@
+#include "lightgrid.h"
+#include "renderview.h"
+#include "scene/light.h"
+#include "scene/object.h"
+#include "core/memory.h"
+#include "core/parallel.h"
+#include "math/math.h"
+
+// -------------------------------------------------------------------------------------------------
+
+#define MIN_SLICE_DEPTH 0.01f // Depth of the first slice if the near plane is closer than this
+
+// -------------------------------------------------------------------------------------------------
+
+// The range of clusters affected by a single light.
+typedef struct grid_light_t {
+
+	uint16_t index; // Index of the light in the grid's light array
+	uint8_t min_x, max_x; // Inclusive range of tiles and slices overlapped by the light
+	uint8_t min_y, max_y;
+	uint8_t min_z, max_z;
+
+} grid_light_t;
+
+// Temporary data used while assigning lights to clusters.
+typedef struct grid_build_t {
+
+	light_grid_t *grid;
+
+	grid_light_t *lights; // Lights which are potentially visible in the view
+	uint32_t num_lights;
+
+	uint16_t (*cluster_lights)[MAX_LIGHTS_PER_CLUSTER]; // Light list of each cluster
+	uint8_t *cluster_counts; // Number of lights in each cluster
+	uint32_t dropped[LIGHT_GRID_Z]; // Number of dropped lights per depth slice
+
+} grid_build_t;
+
+// -------------------------------------------------------------------------------------------------
+
+static bool lightgrid_get_light_bounds(const light_grid_t *grid, const rview_t *view,
+                                       const light_t *light, grid_light_t *bounds);
+
+static uint8_t lightgrid_get_slice(const light_grid_t *grid, float depth);
+static void lightgrid_assign_slice(void *context, uint32_t slice);
+
+// -------------------------------------------------------------------------------------------------
+
+light_grid_t *lightgrid_create(const rview_t *view, rlight_t **lights, uint32_t num_lights)
+{
+	if (view == NULL) {
+		return NULL;
+	}
+
+	NEW(light_grid_t, grid);
+
+	// Depth slices are distributed exponentially between the near and far clip planes, so each
+	// cluster is roughly as deep as it is wide.
+	float near_plane = MAX(view->near_plane, MIN_SLICE_DEPTH);
+	float far_plane = MAX(view->far_plane, near_plane + 1.0f);
+	float log_range = logf(far_plane / near_plane);
+
+	grid->depth_scale = LIGHT_GRID_Z / log_range;
+	grid->depth_bias = -LIGHT_GRID_Z * logf(near_plane) / log_range;
+
+	// Copy the shader parameters of the lights and find the clusters each light overlaps. Lights
+	// outside the view are culled first, and visible lights past the maximum are ignored.
+	uint32_t max_lights = MIN(num_lights, MAX_GRID_LIGHTS);
+
+	grid_build_t build = { 0 };
+	build.grid = grid;
+
+	if (max_lights != 0) {
+
+		grid->lights = mem_alloc_fast(max_lights * sizeof(mat_t));
+		build.lights = mem_alloc_fast(max_lights * sizeof(grid_light_t));
+	}
+
+	for (uint32_t i = 0; i < num_lights && build.num_lights < max_lights; i++) {
+
+		grid_light_t *bounds = &build.lights[build.num_lights];
+
+		if (!lightgrid_get_light_bounds(grid, view, lights[i]->light, bounds)) {
+			continue;
+		}
+
+		bounds->index = (uint16_t)grid->num_lights;
+		grid->lights[grid->num_lights++] = lights[i]->shader_params;
+
+		build.num_lights++;
+	}
+
+	// Assign the lights to clusters one depth slice at a time. Each slice has its own clusters, so
+	// the slices can be processed in parallel.
+	if (build.num_lights != 0) {
+
+		build.cluster_lights = mem_alloc_fast(NUM_LIGHT_CLUSTERS * sizeof(build.cluster_lights[0]));
+		build.cluster_counts = mem_alloc(NUM_LIGHT_CLUSTERS * sizeof(build.cluster_counts[0]));
+
+		parallel_for(lightgrid_assign_slice, &build, LIGHT_GRID_Z);
+	}
+
+	// Pack the light lists of the clusters back to back.
+	uint32_t num_indices = 0;
+
+	for (uint32_t cluster = 0; cluster < NUM_LIGHT_CLUSTERS && build.num_lights != 0; cluster++) {
+		num_indices += build.cluster_counts[cluster];
+	}
+
+	grid->num_index_rows = (num_indices + LIGHT_INDEX_ROW_LENGTH - 1) / LIGHT_INDEX_ROW_LENGTH;
+	grid->num_index_rows = MAX(grid->num_index_rows, 1);
+
+	grid->indices = mem_alloc(grid->num_index_rows * LIGHT_INDEX_ROW_LENGTH * sizeof(uint16_t));
+
+	for (uint32_t cluster = 0; cluster < NUM_LIGHT_CLUSTERS && build.num_lights != 0; cluster++) {
+
+		uint32_t count = build.cluster_counts[cluster];
+
+		grid->clusters[cluster][0] = grid->num_indices;
+		grid->clusters[cluster][1] = count;
+
+		memcpy(&grid->indices[grid->num_indices], build.cluster_lights[cluster],
+		       count * sizeof(uint16_t));
+
+		grid->num_indices += count;
+	}
+
+	for (uint32_t slice = 0; slice < LIGHT_GRID_Z; slice++) {
+		grid->num_dropped += build.dropped[slice];
+	}
+
+	// Release temporary data.
+	if (build.lights != NULL) {
+		mem_free(build.lights);
+	}
+
+	if (build.cluster_lights != NULL) {
+
+		mem_free(build.cluster_lights);
+		mem_free(build.cluster_counts);
+	}
+
+	return grid;
+}
+
+void lightgrid_destroy(light_grid_t *grid)
+{
+	if (grid == NULL) {
+		return;
+	}
+
+	if (grid->lights != NULL) {
+		mem_free(grid->lights);
+	}
+
+	DESTROY(grid->indices);
+	DESTROY(grid);
+}
+
+bool lightgrid_get_light_extents(const rview_t *view, const light_t *light, vec4_t *rect,
+                                 float *min_depth, float *max_depth)
+{
+	// Directional lights affect the entire view.
+	*rect = vec4(-1, -1, 1, 1);
+	*min_depth = view->near_plane;
+	*max_depth = view->far_plane;
+
+	if (light->type == LIGHT_DIRECTIONAL) {
+		return true;
+	}
+
+	// Point and spot lights are bounded by a sphere the size of their range. Ignore lights which
+	// are entirely in front of the near plane or behind the far plane.
+	vec3_t centre = mat_multiply3(view->view, obj_get_position(light->parent));
+
+	float radius = light->range;
+	float depth = centre.z;
+
+	if (depth + radius < view->near_plane ||
+		depth - radius > view->far_plane) {
+
+		return false;
+	}
+
+	*min_depth = MAX(depth - radius, view->near_plane);
+	*max_depth = MIN(depth + radius, view->far_plane);
+
+	// If the sphere intersects the near plane, the projection of its bounds is not reliable.
+	// Conservatively use the entire screen in that case.
+	if (depth - radius <= view->near_plane) {
+		return true;
+	}
+
+	// Project the corners of the sphere's bounding box to the screen.
+	vec2_t min = vec2(1, 1);
+	vec2_t max = vec2(-1, -1);
+
+	for (int i = 0; i < 8; i++) {
+
+		vec4_t corner = vec4(
+			centre.x + ((i & 1) ? radius : -radius),
+			centre.y + ((i & 2) ? radius : -radius),
+			centre.z + ((i & 4) ? radius : -radius),
+			1
+		);
+
+		vec4_t clip = mat_multiply4(view->projection, corner);
+
+		float x = clip.x / clip.w;
+		float y = clip.y / clip.w;
+
+		min.x = MIN(min.x, x);
+		min.y = MIN(min.y, y);
+		max.x = MAX(max.x, x);
+		max.y = MAX(max.y, y);
+	}
+
+	// The light is not visible on the screen.
+	if (max.x < -1 || max.y < -1 || min.x > 1 || min.y > 1) {
+		return false;
+	}
+
+	*rect = vec4(MAX(min.x, -1), MAX(min.y, -1), MIN(max.x, 1), MIN(max.y, 1));
+
+	return true;
+}
+
+static bool lightgrid_get_light_bounds(const light_grid_t *grid, const rview_t *view,
+                                       const light_t *light, grid_light_t *bounds)
+{
+	vec4_t rect;
+	float min_depth, max_depth;
+
+	if (!lightgrid_get_light_extents(view, light, &rect, &min_depth, &max_depth)) {
+		return false;
+	}
+
+	// Convert the extents of the light into a range of clusters.
+	bounds->min_x = (uint8_t)CLAMP((int)((0.5f * rect.x + 0.5f) * LIGHT_GRID_X), 0, LIGHT_GRID_X - 1);
+	bounds->max_x = (uint8_t)CLAMP((int)((0.5f * rect.z + 0.5f) * LIGHT_GRID_X), 0, LIGHT_GRID_X - 1);
+	bounds->min_y = (uint8_t)CLAMP((int)((0.5f * rect.y + 0.5f) * LIGHT_GRID_Y), 0, LIGHT_GRID_Y - 1);
+	bounds->max_y = (uint8_t)CLAMP((int)((0.5f * rect.w + 0.5f) * LIGHT_GRID_Y), 0, LIGHT_GRID_Y - 1);
+	bounds->min_z = lightgrid_get_slice(grid, min_depth);
+	bounds->max_z = lightgrid_get_slice(grid, max_depth);
+
+	return true;
+}
+
+static uint8_t lightgrid_get_slice(const light_grid_t *grid, float depth)
+{
+	if (depth <= 0) {
+		return 0;
+	}
+
+	int slice = (int)(logf(depth) * grid->depth_scale + grid->depth_bias);
+	return (uint8_t)CLAMP(slice, 0, LIGHT_GRID_Z - 1);
+}
+
+static void lightgrid_assign_slice(void *context, uint32_t slice)
+{
+	grid_build_t *build = (grid_build_t *)context;
+
+	// Executed on a task thread. Only the clusters of this slice are modified.
+	for (uint32_t i = 0; i < build->num_lights; i++) {
+
+		const grid_light_t *light = &build->lights[i];
+
+		if (slice < light->min_z || slice > light->max_z) {
+			continue;
+		}
+
+		for (uint32_t y = light->min_y; y <= light->max_y; y++) {
+			for (uint32_t x = light->min_x; x <= light->max_x; x++) {
+
+				uint32_t cluster = (slice * LIGHT_GRID_Y + y) * LIGHT_GRID_X + x;
+				uint8_t count = build->cluster_counts[cluster];
+
+				if (count >= MAX_LIGHTS_PER_CLUSTER) {
+
+					build->dropped[slice]++;
+					continue;
+				}
+
+				build->cluster_lights[cluster][count] = light->index;
+				build->cluster_counts[cluster] = count + 1;
+			}
+		}
+	}
+}
@@ -0,0 +1,74 @@
+#pragma once
+#ifndef __LIGHTGRID_H
+#define __LIGHTGRID_H
+
+#include "core/defines.h"
+#include "math/matrix.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Light grid
+
+	Clustered forward lighting. The view frustum is split into a grid of clusters (screen space
+	tiles along x and y, exponential depth slices along z) and each light is assigned to the
+	clusters its range overlaps. A fragment shader finds its cluster from the fragment position and
+	only evaluates the lights in the cluster's light list.
+
+	NOTE: If the grid dimensions are changed, they have to be changed in lighting.glinc as well!
+
+====================================================================================================
+*/
+
+#define LIGHT_GRID_X 16 // Number of screen space tiles horizontally
+#define LIGHT_GRID_Y 9 // Number of screen space tiles vertically
+#define LIGHT_GRID_Z 24 // Number of depth slices
+#define NUM_LIGHT_CLUSTERS (LIGHT_GRID_X * LIGHT_GRID_Y * LIGHT_GRID_Z)
+
+#define MAX_LIGHTS_PER_CLUSTER 32 // Maximum number of lights assigned to a single cluster
+#define MAX_GRID_LIGHTS 256 // Maximum number of lights in a single view
+
+// Light index lists are passed to shaders as a 2D texture with rows of this length.
+#define LIGHT_INDEX_ROW_LENGTH 1024
+
+// -------------------------------------------------------------------------------------------------
+
+struct rview_t;
+struct rlight_t;
+
+typedef struct light_grid_t {
+
+	uint32_t clusters[NUM_LIGHT_CLUSTERS][2]; // Offset and length of the light list of each cluster
+
+	uint16_t *indices; // Light lists of all clusters stored back to back, padded to a full row
+	uint32_t num_indices; // Number of used light indices
+	uint32_t num_index_rows; // Number of LIGHT_INDEX_ROW_LENGTH long rows in the index array
+
+	mat_t *lights; // Shader parameters of each light referred to by the light lists
+	uint32_t num_lights; // Number of lights in the array
+
+	float depth_scale; // Parameters for converting the log of view depth into a depth slice
+	float depth_bias;
+
+	uint32_t num_dropped; // Number of light assignments dropped because a cluster was full
+
+} light_grid_t;
+
+// -------------------------------------------------------------------------------------------------
+
+// Assign lights to the clusters of a view. The view's matrices and clip planes must be set.
+light_grid_t *lightgrid_create(const struct rview_t *view, struct rlight_t **lights,
+                               uint32_t num_lights);
+void lightgrid_destroy(light_grid_t *grid);
+
+// Find the part of a view affected by a light. The screen space rectangle is returned in normalized
+// device coordinates (min x, min y, max x, max y) along with the range of view space depth. Returns
+// false if the light can not affect anything visible in the view.
+bool lightgrid_get_light_extents(const struct rview_t *view, const light_t *light, vec4_t *rect,
+                                 float *min_depth, float *max_depth);
+
+END_DECLARATIONS;
+
+#endif
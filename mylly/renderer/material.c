@@ -5,10 +5,21 @@
 
 // -------------------------------------------------------------------------------------------------
 
+static void material_set_uniform_value(material_t *material, shader_uniform_t *uniform,
+                                       UNIFORM_TYPE type, const material_param_t *param);
+
+// -------------------------------------------------------------------------------------------------
+
+static uint32_t next_material_id = 1; // 0 is reserved for meshes without a material
+
+// -------------------------------------------------------------------------------------------------
+
 material_t *material_create(const char *name, const char *path)
 {
 	NEW(material_t, material);
 
+	material->id = next_material_id++;
+
 	material->resource.name = string_duplicate(name);
 
 	// The name of the material is formatted <mtl file name>/<material>.
@@ -29,6 +40,7 @@ material_t *material_create(const char *name, const char *path)
 	}
 
 	arr_init(material->parameters);
+	arr_init(material->uniforms);
 
 	return material;
 }
@@ -43,14 +55,9 @@ void material_destroy(material_t *material)
 		DESTROY(material->parameters.items[i].name);
 	}
 
-	// TODO: Add reference counting to duplicated resources!
-	// We're assuming here that a shader without a source code path is a duplicated shader and can
-	// be destroyed whenever the material is as well.
-	if (string_is_null_or_empty(material->shader->resource.path)) {
-		shader_destroy(material->shader);
-	}
-
+	// The shader is shared with other materials and owned by the resource system.
 	arr_clear(material->parameters);
+	arr_clear(material->uniforms);
 
 	DESTROY(material->resource.name);
 	DESTROY(material->resource.res_name);
@@ -64,24 +71,44 @@ void material_apply_parameters(material_t *material)
 		return;
 	}
 
-	// Commit each parameter defined in the material to the shader.
+	shader_t *shader = material->shader;
+
+	arr_clear(material->uniforms);
+
+	// The block starts with the values stored in the shader, so uniforms which the material doesn't
+	// define keep their default values. The names belong to the shader.
+	for (uint32_t i = 0; i < shader->material_uniforms.count; i++) {
+		arr_push(material->uniforms, shader->material_uniforms.items[i]);
+	}
+
+	// Commit each parameter defined in the material to the block.
 	for (uint32_t i = 0; i < material->parameters.count; i++) {
 
 		material_param_t *param = &material->parameters.items[i];
+		shader_uniform_handle_t index = shader_get_uniform_handle(shader, param->name);
+
+		if (index == SHADER_UNIFORM_INVALID) {
+
+			log_warning("Material", "Uniform '%s' does not exist in shader %s (material %s).",
+			            param->name, shader->resource.name, material->resource.name);
+			continue;
+		}
+
+		shader_uniform_t *uniform = &material->uniforms.items[index];
 
 		switch (param->type) {
 
 			case UNIFORM_TYPE_FLOAT:
-				shader_set_uniform_float(material->shader, param->name, param->value.f);
+				material_set_uniform_value(material, uniform, UNIFORM_TYPE_FLOAT, param);
 				break;
 
 			case UNIFORM_TYPE_INT:
-				shader_set_uniform_int(material->shader, param->name, param->value.i);
+				material_set_uniform_value(material, uniform, UNIFORM_TYPE_INT, param);
 				break;
 
 			case UNIFORM_TYPE_VECTOR4:
 			case UNIFORM_TYPE_COLOUR:
-				shader_set_uniform_vector(material->shader, param->name, param->value.vec);
+				material_set_uniform_value(material, uniform, UNIFORM_TYPE_VECTOR4, param);
 				break;
 
 			default:
@@ -90,4 +117,35 @@ void material_apply_parameters(material_t *material)
 				break;
 		}
 	}
+
+	// The values stored in the shader's programs are now overridden by the materials using it.
+	shader->is_shared_by_materials = true;
+}
+
+static void material_set_uniform_value(material_t *material, shader_uniform_t *uniform,
+                                       UNIFORM_TYPE type, const material_param_t *param)
+{
+	if (uniform->type != type) {
+
+		log_warning("Material", "Uniform '%s' in shader %s does not match the type of the "
+		            "parameter in material %s.",
+		            param->name, material->shader->resource.name, material->resource.name);
+
+		return;
+	}
+
+	switch (type) {
+
+		case UNIFORM_TYPE_FLOAT:
+			uniform->value.f = param->value.f;
+			break;
+
+		case UNIFORM_TYPE_INT:
+			uniform->value.i = param->value.i;
+			break;
+
+		default:
+			uniform->value.vec = param->value.vec;
+			break;
+	}
 }
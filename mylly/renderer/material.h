@@ -30,10 +30,16 @@ typedef struct material_param_t {
 typedef struct material_t {
 
 	resource_t resource; // Resource info
+	uint32_t id; // Unique number of the material, used for sorting meshes by material
 
 	arr_t(material_param_t) parameters; // List of shader parameters defined by this material
 
-	shader_t *shader; // Material shader
+	shader_t *shader; // Material shader. Shared by every material using the same shader.
+
+	// Parameter block of the material: the values of every custom uniform of the shader, in the
+	// same order as the uniforms of the shader and its variants. The values are set whenever a mesh
+	// using the material is drawn, so materials don't need a shader program of their own.
+	arr_t(shader_uniform_t) uniforms;
 	texture_t *texture; // Texture/diffuse map. This is the main texture of the material.
 	texture_t *normal_map; // Normal map texture
 
@@ -46,6 +52,8 @@ BEGIN_DECLARATIONS;
 material_t *material_create(const char *name, const char *path);
 void material_destroy(material_t *material);
 
+// Build the parameter block of the material from its parameters. Has to be called after the
+// shader of the material has been set.
 void material_apply_parameters(material_t *material);
 
 END_DECLARATIONS;
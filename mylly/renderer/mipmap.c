@@ -0,0 +1,160 @@
+#include "mipmap.h"
+#include "core/memory.h"
+#include "math/math.h"
+
+// -------------------------------------------------------------------------------------------------
+
+#define LINEAR_TABLE_SIZE 4096 // Number of entries in the linear to sRGB conversion table
+
+// -------------------------------------------------------------------------------------------------
+
+static float mipmap_srgb_to_linear(float value);
+static float mipmap_linear_to_srgb(float value);
+
+// -------------------------------------------------------------------------------------------------
+
+static float srgb_to_linear[256]; // Linear value of each 8-bit sRGB value
+static uint8_t linear_to_srgb[LINEAR_TABLE_SIZE]; // 8-bit sRGB value of quantized linear values
+
+// -------------------------------------------------------------------------------------------------
+
+void mipmap_initialize(void)
+{
+	for (int i = 0; i < 256; i++) {
+		srgb_to_linear[i] = mipmap_srgb_to_linear(i / 255.0f);
+	}
+
+	for (int i = 0; i < LINEAR_TABLE_SIZE; i++) {
+
+		float value = mipmap_linear_to_srgb((float)i / (LINEAR_TABLE_SIZE - 1));
+		linear_to_srgb[i] = (uint8_t)(255 * value + 0.5f);
+	}
+}
+
+uint32_t mipmap_get_num_levels(size_t width, size_t height)
+{
+	size_t size = MAX(width, height);
+	uint32_t levels = 1;
+
+	while (size > 1 && levels < MIPMAP_MAX_LEVELS) {
+
+		size >>= 1;
+		levels++;
+	}
+
+	return levels;
+}
+
+void mipmap_get_level_size(size_t width, size_t height, uint32_t level,
+                           size_t *level_width, size_t *level_height)
+{
+	*level_width = MAX(width >> level, 1);
+	*level_height = MAX(height >> level, 1);
+}
+
+size_t mipmap_get_chain_size(size_t width, size_t height, size_t channels, uint32_t num_levels)
+{
+	size_t size = 0;
+
+	for (uint32_t level = 1; level < num_levels; level++) {
+
+		size_t level_width, level_height;
+		mipmap_get_level_size(width, height, level, &level_width, &level_height);
+
+		size += level_width * level_height * channels;
+	}
+
+	return size;
+}
+
+void mipmap_downsample(const uint8_t *src, size_t width, size_t height, size_t channels,
+                       bool is_srgb, uint8_t *dst)
+{
+	size_t dst_width, dst_height;
+	mipmap_get_level_size(width, height, 1, &dst_width, &dst_height);
+
+	// Only the colour channels are stored in sRGB.
+	size_t colour_channels = (is_srgb ? MIN(channels, 3) : 0);
+
+	for (size_t y = 0; y < dst_height; y++) {
+
+		// Rows and columns of an image which is only one pixel high or wide are sampled twice.
+		const uint8_t *row0 = &src[(2 * y) * width * channels];
+		const uint8_t *row1 = &src[MIN(2 * y + 1, height - 1) * width * channels];
+
+		uint8_t *out = &dst[y * dst_width * channels];
+
+		for (size_t x = 0; x < dst_width; x++) {
+
+			size_t x0 = (2 * x) * channels;
+			size_t x1 = MIN(2 * x + 1, width - 1) * channels;
+
+			size_t c = 0;
+
+			for (; c < colour_channels; c++) {
+
+				float sum = srgb_to_linear[row0[x0 + c]] + srgb_to_linear[row0[x1 + c]] +
+				            srgb_to_linear[row1[x0 + c]] + srgb_to_linear[row1[x1 + c]];
+
+				out[c] = linear_to_srgb[(size_t)(sum * 0.25f * (LINEAR_TABLE_SIZE - 1) + 0.5f)];
+			}
+
+			for (; c < channels; c++) {
+
+				uint32_t sum = row0[x0 + c] + row0[x1 + c] + row1[x0 + c] + row1[x1 + c];
+				out[c] = (uint8_t)((sum + 2) / 4);
+			}
+
+			out += channels;
+		}
+	}
+}
+
+uint8_t *mipmap_generate(const uint8_t *image, size_t width, size_t height, size_t channels,
+                         bool is_srgb, uint32_t num_levels)
+{
+	num_levels = MIN(num_levels, mipmap_get_num_levels(width, height));
+
+	if (image == NULL || num_levels <= 1) {
+		return NULL;
+	}
+
+	uint8_t *chain = mem_alloc_fast(mipmap_get_chain_size(width, height, channels, num_levels));
+
+	// Each level is generated from the previous one.
+	const uint8_t *src = image;
+	uint8_t *dst = chain;
+
+	for (uint32_t level = 1; level < num_levels; level++) {
+
+		size_t src_width, src_height, dst_width, dst_height;
+
+		mipmap_get_level_size(width, height, level - 1, &src_width, &src_height);
+		mipmap_get_level_size(width, height, level, &dst_width, &dst_height);
+
+		mipmap_downsample(src, src_width, src_height, channels, is_srgb, dst);
+
+		src = dst;
+		dst += dst_width * dst_height * channels;
+	}
+
+	return chain;
+}
+
+static float mipmap_srgb_to_linear(float value)
+{
+	if (value <= 0.04045f) {
+		return value / 12.92f;
+	}
+
+	return powf((value + 0.055f) / 1.055f, 2.4f);
+}
+
+static float mipmap_linear_to_srgb(float value)
+{
+	if (value <= 0.0031308f) {
+		return value * 12.92f;
+	}
+
+	return 1.055f * powf(value, 1 / 2.4f) - 0.055f;
+}
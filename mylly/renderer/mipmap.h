@@ -0,0 +1,58 @@
+#pragma once
+#ifndef __MIPMAP_H
+#define __MIPMAP_H
+
+#include "core/defines.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Mipmap generation
+
+	Builds the mip chain of an 8-bit image on the CPU. Each level is half the size of the previous
+	level (rounded down, but at least one pixel) and each pixel is the average of a 2x2 box of the
+	previous level. When the previous level has an odd size, the last row or column is not sampled.
+
+	Colour channels of sRGB images are averaged in linear space, so bright and dark details don't
+	darken the smaller levels. The alpha channel (the 4th channel) and images which are not sRGB
+	(data such as grayscale masks) are averaged as they are.
+
+	The methods don't use any renderer state, so they can be tested without a GPU.
+
+====================================================================================================
+*/
+
+#define MIPMAP_MAX_LEVELS 17 // Enough for a 65536 pixel texture
+
+// -------------------------------------------------------------------------------------------------
+
+// Build the sRGB conversion tables. Mip chains are generated on worker threads as well, so the
+// tables must be built once before any texture is loaded.
+void mipmap_initialize(void);
+
+// Returns the number of levels in a full mip chain, including the base level.
+uint32_t mipmap_get_num_levels(size_t width, size_t height);
+
+// Returns the size of a level of the mip chain of an image.
+void mipmap_get_level_size(size_t width, size_t height, uint32_t level,
+                           size_t *level_width, size_t *level_height);
+
+// Returns the number of bytes needed for the levels 1...num_levels-1 of a mip chain.
+size_t mipmap_get_chain_size(size_t width, size_t height, size_t channels, uint32_t num_levels);
+
+// Downsample an image into the next level of its mip chain. The destination must have room for
+// the size returned by mipmap_get_level_size() for level 1.
+void mipmap_downsample(const uint8_t *src, size_t width, size_t height, size_t channels,
+                       bool is_srgb, uint8_t *dst);
+
+// Generate the levels 1...num_levels-1 of the mip chain of an image into a single buffer, smallest
+// level last. Returns NULL if the image has only one level. The buffer must be released with
+// mem_free().
+uint8_t *mipmap_generate(const uint8_t *image, size_t width, size_t height, size_t channels,
+                         bool is_srgb, uint32_t num_levels);
+
+END_DECLARATIONS;
+
+#endif
@@ -0,0 +1,726 @@
+#include "nullrenderer.h"
+#include "renderer/rendbackend.h"
+#include "renderer/buffercache.h"
+#include "renderer/mesh.h"
+#include "renderer/texture.h"
+#include "renderer/rendersystem.h"
+#include "collections/array.h"
+#include "platform/timer.h"
+#include "math/math.h"
+#include "resources/resources.h"
+#include "core/mylly.h"
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+#define UNKNOWN_OBJECT 0xFFFFFFFF // Object name used when the bound object is not known
+#define UNKNOWN_STATE -1 // Value used when a toggleable state is not known
+
+#define MAX_LIGHTS_PER_PASS 8 // Lights drawn in a single deferred lighting pass
+
+// -------------------------------------------------------------------------------------------------
+
+static bool is_recording = true;
+static arr_t(nullrend_command_t) commands;
+
+static uint32_t frame_index; // Index of the frame being drawn
+static uint32_t next_object_name = 1; // Name given to the next created buffer, texture or shader
+static int next_uniform_location; // Location given to the next queried uniform
+
+static bool is_using_deferred_lighting;
+
+// Statistics of the previous and the current frame.
+static rend_stats_t stats;
+static rend_stats_t frame_stats;
+
+// Currently bound state. Only changes to the state are recorded.
+static struct {
+
+	shader_program_t program;
+	texture_name_t textures[2];
+	vbindex_t vertex_buffer;
+	int blend;
+	int depth_write;
+
+} state;
+
+// -------------------------------------------------------------------------------------------------
+
+static void nullrend_record(const nullrend_command_t *command);
+static void nullrend_invalidate_state(void);
+
+static void nullrend_replay_commands(const cmdbuf_t *buffer);
+static void nullrend_set_pipeline(const cmd_set_pipeline_t *command);
+static void nullrend_set_texture(uint32_t unit, texture_name_t texture);
+static void nullrend_set_buffers(const cmd_bind_buffers_t *command);
+static void nullrend_set_uniform(const cmd_set_uniform_t *command);
+static void nullrend_set_object(const cmd_set_object_t *command);
+static void nullrend_draw(const cmd_draw_t *command);
+static void nullrend_draw_instanced(const cmd_draw_instanced_t *command);
+static void nullrend_set_blend(bool enabled);
+static void nullrend_set_depth_write(bool enabled);
+static void nullrend_draw_pass(shader_t *shader, uint32_t num_lights);
+
+static bool nullrend_initialize(void);
+static void nullrend_shutdown(void);
+static void nullrend_preload_shaders(void);
+static void nullrend_begin_draw(void);
+static void nullrend_end_draw(void);
+static void nullrend_draw_views(rview_t *first_view);
+static void nullrend_execute_commands(const cmdbuf_t *buffer);
+static const rend_stats_t *nullrend_get_stats(void);
+
+static vbindex_t nullrend_generate_buffer(void);
+static void nullrend_destroy_buffer(vbindex_t vbo);
+static void nullrend_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index,
+                                        bool is_static);
+static void nullrend_update_buffer_subdata(vbindex_t vbo, const void *data, size_t offset,
+                                           size_t size, bool is_index);
+
+static shader_object_t nullrend_create_shader(SHADER_TYPE type, const char **lines,
+                                              size_t num_lines, const char **compiler_log);
+static shader_program_t nullrend_create_shader_program(shader_object_t *shaders,
+                                                       size_t num_shaders);
+static shader_program_t nullrend_load_program_binary(const char **lines, size_t num_lines);
+static void nullrend_save_program_binary(shader_program_t program, const char **lines,
+                                         size_t num_lines);
+static void nullrend_destroy_shader(shader_object_t shader);
+static void nullrend_destroy_shader_program(shader_program_t program);
+static int nullrend_get_program_uniform_location(shader_program_t program, const char *name);
+static bool nullrend_bind_program_uniform_block(shader_program_t program, const char *name,
+                                                uint32_t binding);
+static void nullrend_bind_program_samplers(shader_t *shader);
+static int nullrend_get_program_attribute_location(shader_program_t program, const char *name);
+static const char *nullrend_get_default_shader_source(default_shader_t shader);
+
+static texture_name_t nullrend_generate_texture(void *image, size_t width, size_t height,
+                                                TEX_FORMAT fmt, TEX_FILTER filter);
+static texture_name_t nullrend_generate_compressed_texture(const void *data, size_t width,
+                                                           size_t height, uint32_t num_levels,
+                                                           TEX_FORMAT fmt, TEX_FILTER filter);
+static void nullrend_delete_texture(texture_name_t texture);
+static void nullrend_upload_texture(texture_upload_t *upload);
+static bool nullrend_is_texture_upload_complete(texture_upload_t *upload);
+
+static void nullrend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background);
+static void nullrend_override_draw_gbuffer(gbuffer_component_t buffer);
+
+// -------------------------------------------------------------------------------------------------
+
+const rend_backend_t *rend_null_backend(void)
+{
+	static const rend_backend_t backend = {
+		"null",
+		false,
+		nullrend_initialize,
+		nullrend_shutdown,
+		nullrend_preload_shaders,
+		nullrend_begin_draw,
+		nullrend_end_draw,
+		nullrend_draw_views,
+		nullrend_execute_commands,
+		nullrend_get_stats,
+		nullrend_generate_buffer,
+		nullrend_destroy_buffer,
+		nullrend_upload_buffer_data,
+		nullrend_update_buffer_subdata,
+		nullrend_create_shader,
+		nullrend_create_shader_program,
+		nullrend_load_program_binary,
+		nullrend_save_program_binary,
+		nullrend_destroy_shader,
+		nullrend_destroy_shader_program,
+		nullrend_get_program_uniform_location,
+		nullrend_bind_program_uniform_block,
+		nullrend_bind_program_samplers,
+		nullrend_get_program_attribute_location,
+		nullrend_get_default_shader_source,
+		nullrend_generate_texture,
+		nullrend_generate_compressed_texture,
+		nullrend_delete_texture,
+		nullrend_upload_texture,
+		nullrend_is_texture_upload_complete,
+		nullrend_draw_splash_screen,
+		nullrend_override_draw_gbuffer,
+	};
+
+	return &backend;
+}
+
+void nullrend_set_recording(bool enabled)
+{
+	is_recording = enabled;
+}
+
+const nullrend_command_t *nullrend_get_commands(size_t *num_commands)
+{
+	if (num_commands != NULL) {
+		*num_commands = commands.count;
+	}
+
+	return commands.items;
+}
+
+void nullrend_clear_commands(void)
+{
+	arr_clear(commands);
+}
+
+size_t nullrend_count_commands(nullrend_command_type_t type)
+{
+	size_t count = 0;
+
+	for (size_t i = 0; i < commands.count; i++) {
+
+		if (commands.items[i].type == type) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+const char *nullrend_get_command_name(nullrend_command_type_t type)
+{
+	static const char *names[NUM_NULLREND_COMMANDS] = {
+		"BEGIN_FRAME",
+		"END_FRAME",
+		"BEGIN_VIEW",
+		"SET_SHADER",
+		"SET_TEXTURE",
+		"SET_BUFFER",
+		"SET_BLEND",
+		"SET_DEPTH_WRITE",
+		"SET_UNIFORM",
+		"SET_OBJECT",
+		"DRAW",
+		"DRAW_PASS",
+		"UPLOAD_BUFFER"
+	};
+
+	if (type < 0 || type >= NUM_NULLREND_COMMANDS) {
+		return "UNKNOWN";
+	}
+
+	return names[type];
+}
+
+static void nullrend_record(const nullrend_command_t *command)
+{
+	if (!is_recording) {
+		return;
+	}
+
+	nullrend_command_t entry = *command;
+	entry.frame = frame_index;
+
+	arr_push(commands, entry);
+}
+
+static void nullrend_invalidate_state(void)
+{
+	state.program = UNKNOWN_OBJECT;
+	state.textures[0] = UNKNOWN_OBJECT;
+	state.textures[1] = UNKNOWN_OBJECT;
+	state.vertex_buffer = UNKNOWN_OBJECT;
+	state.blend = UNKNOWN_STATE;
+	state.depth_write = UNKNOWN_STATE;
+}
+
+static bool nullrend_initialize(void)
+{
+	is_using_deferred_lighting = mylly_get_parameters()->renderer.use_deferred_lighting;
+
+	frame_index = 0;
+	nullrend_invalidate_state();
+
+	return true;
+}
+
+static void nullrend_shutdown(void)
+{
+	arr_clear(commands);
+}
+
+static void nullrend_preload_shaders(void)
+{
+}
+
+static void nullrend_begin_draw(void)
+{
+	nullrend_invalidate_state();
+	frame_stats = (rend_stats_t){ 0 };
+
+	nullrend_command_t command = { .type = NULLREND_BEGIN_FRAME };
+	nullrend_record(&command);
+}
+
+static void nullrend_end_draw(void)
+{
+	nullrend_command_t command = { .type = NULLREND_END_FRAME };
+	nullrend_record(&command);
+
+	stats = frame_stats;
+	frame_index++;
+}
+
+static void nullrend_draw_views(rview_t *first_view)
+{
+	uint64_t submit_start = timer_get_microseconds();
+
+	list_t(rview_t) views;
+	list_init(views);
+
+	views.first = first_view;
+
+	rview_t *view;
+
+	// Walk through the render queues in the same order as the OpenGL backend.
+	for (int queue = 0; queue < NUM_QUEUES; queue++) {
+
+		list_foreach(views, view) {
+
+			const cmdbuf_t *buffer = view->commands[queue];
+
+			if (buffer == NULL || buffer->num_commands == 0) {
+				continue;
+			}
+
+			nullrend_command_t command = { .type = NULLREND_BEGIN_VIEW };
+			command.params.view.view = view;
+			command.params.view.queue = queue;
+
+			nullrend_record(&command);
+
+			// Background and opaque geometry is drawn without blending.
+			nullrend_set_blend(queue != QUEUE_BACKGROUND && queue != QUEUE_GEOMETRY);
+
+			nullrend_replay_commands(buffer);
+		}
+
+		if (first_view == NULL) {
+			continue;
+		}
+
+		// Screen space passes are applied to the first view.
+		if (queue == QUEUE_GEOMETRY && is_using_deferred_lighting) {
+
+			const mylly_params_t *params = mylly_get_parameters();
+
+			nullrend_draw_pass(res_get_shader(params->renderer.ambient_stage_shader), 0);
+
+			// Lights are drawn in batches.
+			shader_t *light_shader = res_get_shader(params->renderer.light_stage_shader);
+			uint32_t num_lights = first_view->num_lights;
+
+			for (uint32_t i = 0; i < num_lights; i += MAX_LIGHTS_PER_PASS) {
+				nullrend_draw_pass(light_shader, MIN(num_lights - i, MAX_LIGHTS_PER_PASS));
+			}
+		}
+		else if (queue == QUEUE_TRANSPARENT) {
+
+			if (first_view->post_processing_effects.count != 0) {
+
+				for (uint32_t i = 0; i < first_view->post_processing_effects.count; i++) {
+					nullrend_draw_pass(first_view->post_processing_effects.items[i], 0);
+				}
+			}
+			else {
+				nullrend_draw_pass(NULL, 0);
+			}
+		}
+	}
+
+	frame_stats.submit_time = (uint32_t)(timer_get_microseconds() - submit_start);
+}
+
+static void nullrend_execute_commands(const cmdbuf_t *buffer)
+{
+	if (buffer != NULL) {
+		nullrend_replay_commands(buffer);
+	}
+}
+
+static const rend_stats_t *nullrend_get_stats(void)
+{
+	return &stats;
+}
+
+static void nullrend_replay_commands(const cmdbuf_t *buffer)
+{
+	const cmd_t *command;
+
+	cmdbuf_foreach(buffer, command) {
+
+		switch (command->type) {
+
+		case CMD_SET_PIPELINE:
+			nullrend_set_pipeline((const cmd_set_pipeline_t *)command);
+			break;
+
+		case CMD_BIND_TEXTURES:
+			nullrend_set_texture(0, ((const cmd_bind_textures_t *)command)->texture);
+			nullrend_set_texture(1, ((const cmd_bind_textures_t *)command)->normal_map);
+			break;
+
+		case CMD_BIND_BUFFERS:
+			nullrend_set_buffers((const cmd_bind_buffers_t *)command);
+			break;
+
+		case CMD_SET_UNIFORM:
+			nullrend_set_uniform((const cmd_set_uniform_t *)command);
+			break;
+
+		case CMD_SET_OBJECT:
+			nullrend_set_object((const cmd_set_object_t *)command);
+			break;
+
+		case CMD_DRAW:
+			nullrend_draw((const cmd_draw_t *)command);
+			break;
+
+		case CMD_DRAW_INSTANCED:
+			nullrend_draw_instanced((const cmd_draw_instanced_t *)command);
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+static void nullrend_set_pipeline(const cmd_set_pipeline_t *command)
+{
+	if (command->program != state.program) {
+
+		nullrend_command_t record = { .type = NULLREND_SET_SHADER };
+		record.params.shader.program = command->program;
+
+		nullrend_record(&record);
+
+		state.program = command->program;
+		frame_stats.shader_changes++;
+	}
+
+	nullrend_set_depth_write(command->depth_write != 0);
+}
+
+static void nullrend_set_texture(uint32_t unit, texture_name_t texture)
+{
+	// Like the OpenGL backend, the previous texture is left bound if the mesh has none.
+	if (texture == 0 || texture == state.textures[unit]) {
+		return;
+	}
+
+	nullrend_command_t command = { .type = NULLREND_SET_TEXTURE };
+	command.params.texture.unit = unit;
+	command.params.texture.texture = texture;
+
+	nullrend_record(&command);
+
+	state.textures[unit] = texture;
+	frame_stats.texture_changes++;
+}
+
+static void nullrend_set_buffers(const cmd_bind_buffers_t *command)
+{
+	if (command->vertices == state.vertex_buffer) {
+		return;
+	}
+
+	nullrend_command_t record = { .type = NULLREND_SET_BUFFER };
+	record.params.buffer.vertices = command->vertices;
+	record.params.buffer.indices = command->indices;
+
+	nullrend_record(&record);
+
+	state.vertex_buffer = command->vertices;
+	frame_stats.buffer_changes++;
+}
+
+static void nullrend_set_uniform(const cmd_set_uniform_t *command)
+{
+	nullrend_command_t record = { .type = NULLREND_SET_UNIFORM };
+	record.params.uniform.program = state.program;
+	record.params.uniform.location = command->location;
+	record.params.uniform.type = (UNIFORM_TYPE)command->type;
+	record.params.uniform.value.vec = command->value.vec;
+
+	nullrend_record(&record);
+
+	frame_stats.uniform_calls++;
+}
+
+static void nullrend_set_object(const cmd_set_object_t *command)
+{
+	// Per-object constants are selected for every draw.
+	nullrend_command_t record = { .type = NULLREND_SET_OBJECT };
+	record.params.object.mvp = command->mvp;
+	record.params.object.model = command->model;
+
+	nullrend_record(&record);
+}
+
+static void nullrend_draw(const cmd_draw_t *command)
+{
+	nullrend_command_t record = { .type = NULLREND_DRAW };
+	record.params.draw.primitive = (cmd_primitive_t)command->primitive;
+	record.params.draw.first_index = command->first_index;
+	record.params.draw.num_indices = command->num_indices;
+	record.params.draw.num_instances = 1;
+
+	nullrend_record(&record);
+
+	frame_stats.draw_calls++;
+}
+
+static void nullrend_draw_instanced(const cmd_draw_instanced_t *command)
+{
+	nullrend_command_t record = { .type = NULLREND_DRAW };
+	record.params.draw.primitive = (cmd_primitive_t)command->primitive;
+	record.params.draw.first_index = command->first_index;
+	record.params.draw.num_indices = command->num_indices;
+	record.params.draw.num_instances = command->num_instances;
+
+	nullrend_record(&record);
+
+	frame_stats.draw_calls++;
+}
+
+static void nullrend_set_blend(bool enabled)
+{
+	if (state.blend == (int)enabled) {
+		return;
+	}
+
+	nullrend_command_t command = { .type = NULLREND_SET_BLEND };
+	command.params.enabled = enabled;
+
+	nullrend_record(&command);
+
+	state.blend = (int)enabled;
+}
+
+static void nullrend_set_depth_write(bool enabled)
+{
+	if (state.depth_write == (int)enabled) {
+		return;
+	}
+
+	nullrend_command_t command = { .type = NULLREND_SET_DEPTH_WRITE };
+	command.params.enabled = enabled;
+
+	nullrend_record(&command);
+
+	state.depth_write = (int)enabled;
+}
+
+static void nullrend_draw_pass(shader_t *shader, uint32_t num_lights)
+{
+	nullrend_command_t command = { .type = NULLREND_DRAW_PASS };
+	command.params.pass.shader = shader;
+	command.params.pass.num_lights = num_lights;
+
+	nullrend_record(&command);
+
+	// Passes use their own shaders and textures.
+	nullrend_invalidate_state();
+}
+
+static vbindex_t nullrend_generate_buffer(void)
+{
+	return next_object_name++;
+}
+
+static void nullrend_destroy_buffer(vbindex_t vbo)
+{
+	UNUSED(vbo);
+}
+
+static void nullrend_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index,
+                                        bool is_static)
+{
+	UNUSED(is_static);
+
+	nullrend_update_buffer_subdata(vbo, data, 0, size, is_index);
+}
+
+static void nullrend_update_buffer_subdata(vbindex_t vbo, const void *data, size_t offset,
+                                           size_t size, bool is_index)
+{
+	UNUSED(data);
+
+	nullrend_command_t command = { .type = NULLREND_UPLOAD_BUFFER };
+	command.params.upload.buffer = vbo;
+	command.params.upload.offset = offset;
+	command.params.upload.size = size;
+	command.params.upload.is_index = is_index;
+
+	nullrend_record(&command);
+}
+
+static shader_object_t nullrend_create_shader(SHADER_TYPE type, const char **lines,
+                                              size_t num_lines, const char **compiler_log)
+{
+	UNUSED(type);
+	UNUSED(lines);
+	UNUSED(num_lines);
+
+	// Shaders are not compiled, so they always succeed.
+	if (compiler_log != NULL) {
+		*compiler_log = "";
+	}
+
+	return next_object_name++;
+}
+
+static shader_program_t nullrend_create_shader_program(shader_object_t *shaders,
+                                                       size_t num_shaders)
+{
+	if (shaders == NULL || num_shaders == 0) {
+		return 0;
+	}
+
+	return next_object_name++;
+}
+
+static shader_program_t nullrend_load_program_binary(const char **lines, size_t num_lines)
+{
+	UNUSED(lines);
+	UNUSED(num_lines);
+
+	// Nothing is compiled, so there is nothing to cache either.
+	return 0;
+}
+
+static void nullrend_save_program_binary(shader_program_t program, const char **lines,
+                                         size_t num_lines)
+{
+	UNUSED(program);
+	UNUSED(lines);
+	UNUSED(num_lines);
+}
+
+static void nullrend_destroy_shader(shader_object_t shader)
+{
+	UNUSED(shader);
+}
+
+static void nullrend_destroy_shader_program(shader_program_t program)
+{
+	UNUSED(program);
+}
+
+static int nullrend_get_program_uniform_location(shader_program_t program, const char *name)
+{
+	UNUSED(name);
+
+	// Every uniform is assumed to be used by the program.
+	if (program == 0) {
+		return -1;
+	}
+
+	return next_uniform_location++;
+}
+
+static bool nullrend_bind_program_uniform_block(shader_program_t program, const char *name,
+                                                uint32_t binding)
+{
+	UNUSED(name);
+	UNUSED(binding);
+
+	return (program != 0);
+}
+
+static void nullrend_bind_program_samplers(shader_t *shader)
+{
+	UNUSED(shader);
+}
+
+static int nullrend_get_program_attribute_location(shader_program_t program, const char *name)
+{
+	if (program == 0 || name == NULL) {
+		return -1;
+	}
+
+	// Vertex attributes use the same fixed locations as in the OpenGL backend.
+	for (int i = 0; i < NUM_SHADER_ATTRIBUTES; i++) {
+
+		if (strcmp(shader_get_attribute_name(i), name) == 0) {
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+static const char *nullrend_get_default_shader_source(default_shader_t shader)
+{
+	UNUSED(shader);
+
+	// Shaders are never compiled, so the source code is not needed.
+	return "\n";
+}
+
+static texture_name_t nullrend_generate_texture(void *image, size_t width, size_t height,
+                                                TEX_FORMAT fmt, TEX_FILTER filter)
+{
+	UNUSED(image);
+	UNUSED(width);
+	UNUSED(height);
+	UNUSED(fmt);
+	UNUSED(filter);
+
+	return next_object_name++;
+}
+
+static texture_name_t nullrend_generate_compressed_texture(const void *data, size_t width,
+                                                           size_t height, uint32_t num_levels,
+                                                           TEX_FORMAT fmt, TEX_FILTER filter)
+{
+	UNUSED(data);
+	UNUSED(width);
+	UNUSED(height);
+	UNUSED(num_levels);
+	UNUSED(fmt);
+	UNUSED(filter);
+
+	return next_object_name++;
+}
+
+static void nullrend_delete_texture(texture_name_t texture)
+{
+	UNUSED(texture);
+}
+
+static void nullrend_upload_texture(texture_upload_t *upload)
+{
+	// There is no GPU to wait for, so uploads complete immediately.
+	mem_free(upload->image);
+
+	if (upload->mip_chain != NULL) {
+		mem_free(upload->mip_chain);
+	}
+
+	upload->image = NULL;
+	upload->mip_chain = NULL;
+	upload->texture = next_object_name++;
+	upload->is_complete = true;
+}
+
+static bool nullrend_is_texture_upload_complete(texture_upload_t *upload)
+{
+	return upload->is_complete;
+}
+
+static void nullrend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background)
+{
+	UNUSED(texture);
+	UNUSED(shader);
+	UNUSED(background);
+}
+
+static void nullrend_override_draw_gbuffer(gbuffer_component_t buffer)
+{
+	UNUSED(buffer);
+}
@@ -0,0 +1,141 @@
+#pragma once
+#ifndef __NULL_RENDERER_H
+#define __NULL_RENDERER_H
+
+#include "core/defines.h"
+#include "renderer/renderview.h"
+#include "renderer/shader.h"
+#include "renderer/texture.h"
+#include "renderer/buffer.h"
+#include "renderer/cmdbuffer.h"
+#include "math/matrix.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Null renderer backend
+
+	A renderer backend which does not need a GPU or a rendering context. Resources are given
+	unique names but no data is stored. Instead of drawing, the backend replays the recorded
+	command buffers of the views and records the stream of commands the OpenGL backend would
+	submit: state changes, uniform values and draw calls. The commands can be inspected by tests
+	or used to profile the CPU side of the render pipeline. Captured command buffers can be
+	replayed with rend_execute_commands().
+
+	Select the backend with rend_set_backend(rend_null_backend()) before the renderer is
+	initialized, or by setting use_null_backend in the engine parameters.
+
+	Only changes to the state are recorded, in the same way the OpenGL state cache filters them.
+	The recorded commands are kept until they are cleared, so long runs should either clear them
+	every frame or disable recording.
+
+====================================================================================================
+*/
+
+typedef enum nullrend_command_type_t {
+
+	NULLREND_BEGIN_FRAME, // A new frame was started
+	NULLREND_END_FRAME, // The frame was finished
+	NULLREND_BEGIN_VIEW, // The meshes of a view in a render queue are drawn next
+	NULLREND_SET_SHADER, // The active shader program was changed
+	NULLREND_SET_TEXTURE, // A texture was bound to a texture unit
+	NULLREND_SET_BUFFER, // The vertex and index buffers were changed
+	NULLREND_SET_BLEND, // Blending was enabled or disabled
+	NULLREND_SET_DEPTH_WRITE, // Depth writes were enabled or disabled
+	NULLREND_SET_UNIFORM, // A custom material uniform was updated
+	NULLREND_SET_OBJECT, // The per-object constants (model and MVP matrix) of the next draw
+	NULLREND_DRAW, // A mesh or several instances of it were drawn
+	NULLREND_DRAW_PASS, // A screen space pass (deferred lighting, post processing) was drawn
+	NULLREND_UPLOAD_BUFFER, // Vertex or index data was uploaded
+
+	NUM_NULLREND_COMMANDS
+
+} nullrend_command_type_t;
+
+typedef struct nullrend_command_t {
+
+	nullrend_command_type_t type; // Type of the command, determines which parameters are valid
+	uint32_t frame; // Index of the frame the command was recorded on
+
+	union {
+
+		struct {
+			const rview_t *view;
+			int queue;
+		} view;
+
+		struct {
+			shader_program_t program;
+		} shader;
+
+		struct {
+			uint32_t unit;
+			texture_name_t texture;
+		} texture;
+
+		struct {
+			vbindex_t vertices;
+			vbindex_t indices;
+		} buffer;
+
+		bool enabled; // Blending and depth write
+
+		struct {
+			shader_program_t program;
+			int location;
+			UNIFORM_TYPE type;
+			union {
+				int i;
+				float f;
+				vec4_t vec;
+			} value;
+		} uniform;
+
+		struct {
+			mat_t mvp;
+			mat_t model;
+		} object;
+
+		struct {
+			cmd_primitive_t primitive;
+			uint32_t first_index;
+			uint32_t num_indices;
+			uint32_t num_instances; // Number of instances, 1 for draws which are not instanced
+		} draw;
+
+		struct {
+			const shader_t *shader; // NULL when the framebuffer is copied without an effect
+			uint32_t num_lights; // Number of lights drawn by a deferred light pass
+		} pass;
+
+		struct {
+			vbindex_t buffer;
+			size_t offset;
+			size_t size;
+			bool is_index;
+		} upload;
+
+	} params;
+
+} nullrend_command_t;
+
+// -------------------------------------------------------------------------------------------------
+
+// Recording is enabled by default.
+void nullrend_set_recording(bool enabled);
+
+// Returns the commands recorded since the commands were last cleared.
+const nullrend_command_t *nullrend_get_commands(size_t *num_commands);
+void nullrend_clear_commands(void);
+
+// Count the recorded commands of a certain type.
+size_t nullrend_count_commands(nullrend_command_type_t type);
+
+// Returns a printable name for a command type.
+const char *nullrend_get_command_name(nullrend_command_type_t type);
+
+END_DECLARATIONS;
+
+#endif
@@ -7,7 +7,10 @@
 // Used when no valid shaders are available.
 const char *default_shader_source =
 
-"uniform mat4 MatrixArr[1];\n"
+"layout(std140) uniform ObjectData {\n"
+"	mat4 ObjectMVP;\n"
+"	mat4 ObjectModel;\n"
+"};\n"
 "\n"
 "#if defined(VERTEX_SHADER)\n"
 "\n"
@@ -15,7 +18,7 @@ const char *default_shader_source =
 "\n"
 "void main()\n"
 "{\n"
-"	gl_Position = MatrixArr[0] * vec4(Vertex, 1.0);\n"
+"	gl_Position = ObjectMVP * vec4(Vertex, 1.0);\n"
 "}\n"
 "\n"
 "#elif defined(FRAGMENT_SHADER)\n"
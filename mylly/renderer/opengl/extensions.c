@@ -1,5 +1,6 @@
 #include "extensions.h"
 #include "io/log.h"
+#include "math/math.h"
 #include <string.h>
 
 typedef void (*extension_t)(void);
@@ -25,6 +26,7 @@ PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
 PFNGLCREATEPROGRAMPROC glCreateProgram;
 PFNGLDELETEPROGRAMPROC glDeleteProgram;
 PFNGLLINKPROGRAMPROC glLinkProgram;
+PFNGLGETPROGRAMIVPROC glGetProgramiv;
 PFNGLATTACHSHADERPROC glAttachShader;
 PFNGLBINDFRAGDATALOCATIONPROC glBindFragDataLocation;
 PFNGLBINDATTRIBLOCATIONARBPROC glBindAttribLocation;
@@ -42,6 +44,16 @@ PFNGLVERTEXATTRIBPOINTERARBPROC glVertexAttribPointer;
 PFNGLENABLEVERTEXATTRIBARRAYARBPROC glEnableVertexAttribArray;
 PFNGLDISABLEVERTEXATTRIBARRAYARBPROC glDisableVertexAttribArray;
 
+// Vertex array objects
+PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
+PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays;
+PFNGLBINDVERTEXARRAYPROC glBindVertexArray;
+
+// Uniform buffer objects
+PFNGLGETUNIFORMBLOCKINDEXPROC glGetUniformBlockIndex;
+PFNGLUNIFORMBLOCKBINDINGPROC glUniformBlockBinding;
+PFNGLBINDBUFFERRANGEPROC glBindBufferRange;
+
 // Render buffers
 PFNGLBINDRENDERBUFFEREXTPROC glBindRenderbuffer;
 PFNGLGENRENDERBUFFERSEXTPROC glGenRenderbuffers;
@@ -61,8 +73,34 @@ PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparate;
 
 PFNGLDRAWRANGEELEMENTSPROC glDrawRangeElementsARB;
 
+// Instancing
+PFNGLDRAWELEMENTSINSTANCEDARBPROC glDrawElementsInstanced;
+PFNGLVERTEXATTRIBDIVISORARBPROC glVertexAttribDivisor;
+PFNGLVERTEXATTRIB4FVPROC glVertexAttrib4fv;
+
+// Program binaries
+PFNGLGETPROGRAMBINARYPROC glGetProgramBinary;
+PFNGLPROGRAMBINARYPROC glProgramBinary;
+PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+
+// Pixel buffer objects
+PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+
+// Sync objects
+PFNGLFENCESYNCPROC glFenceSync;
+PFNGLCLIENTWAITSYNCPROC glClientWaitSync;
+PFNGLDELETESYNCPROC glDeleteSync;
+
+static bool is_instancing_supported = false;
+static bool is_program_binary_supported = false;
+static float max_anisotropy = 1;
+static bool is_s3tc_supported = false;
+static bool is_sync_supported = false;
+
 #ifdef _WIN32
 PFNGLACTIVETEXTUREARBPROC glActiveTexture;
+PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
 #endif
 
 // --------------------------------------------------------------------------------
@@ -79,11 +117,13 @@ bool glext_initialize(void)
 	bool ARB_shader_objects = glext_is_supported("GL_ARB_shader_objects");
 	bool ARB_vertex_shader = glext_is_supported("GL_ARB_vertex_shader");
 	bool ARB_fragment_shader = glext_is_supported("GL_ARB_fragment_shader");
+	bool ARB_uniform_buffer_object = glext_is_supported("GL_ARB_uniform_buffer_object");
 
 	if (!ARB_vertex_buffer_object ||
 		!ARB_shader_objects ||
 		!ARB_vertex_shader ||
-		!ARB_fragment_shader) {
+		!ARB_fragment_shader ||
+		!ARB_uniform_buffer_object) {
 
 		log_error("OpenGL", "Missing essential extensions.");
 		return false;
@@ -107,6 +147,7 @@ bool glext_initialize(void)
 	glCreateProgram = (PFNGLCREATEPROGRAMPROC)glext_get_method("glCreateProgram");
 	glDeleteProgram = (PFNGLDELETEPROGRAMPROC)glext_get_method("glDeleteProgram");
 	glLinkProgram = (PFNGLLINKPROGRAMPROC)glext_get_method("glLinkProgram");
+	glGetProgramiv = (PFNGLGETPROGRAMIVPROC)glext_get_method("glGetProgramiv");
 	glAttachShader = (PFNGLATTACHSHADERPROC)glext_get_method("glAttachShader");
 	glBindFragDataLocation = (PFNGLBINDFRAGDATALOCATIONPROC)glext_get_method("glBindFragDataLocation");
 	glBindAttribLocation = (PFNGLBINDATTRIBLOCATIONARBPROC)glext_get_method("glBindAttribLocation");
@@ -124,6 +165,16 @@ bool glext_initialize(void)
 	glEnableVertexAttribArray = (PFNGLENABLEVERTEXATTRIBARRAYARBPROC)glext_get_method("glEnableVertexAttribArray");
 	glDisableVertexAttribArray = (PFNGLDISABLEVERTEXATTRIBARRAYARBPROC)glext_get_method("glDisableVertexAttribArray");
 
+	// Vertex array objects
+	glGenVertexArrays = (PFNGLGENVERTEXARRAYSPROC)glext_get_method("glGenVertexArrays");
+	glDeleteVertexArrays = (PFNGLDELETEVERTEXARRAYSPROC)glext_get_method("glDeleteVertexArrays");
+	glBindVertexArray = (PFNGLBINDVERTEXARRAYPROC)glext_get_method("glBindVertexArray");
+
+	// GL_ARB_uniform_buffer_object
+	glGetUniformBlockIndex = (PFNGLGETUNIFORMBLOCKINDEXPROC)glext_get_method("glGetUniformBlockIndex");
+	glUniformBlockBinding = (PFNGLUNIFORMBLOCKBINDINGPROC)glext_get_method("glUniformBlockBinding");
+	glBindBufferRange = (PFNGLBINDBUFFERRANGEPROC)glext_get_method("glBindBufferRange");
+
 	// Render buffers
 	glBindRenderbuffer = (PFNGLBINDRENDERBUFFEREXTPROC)glext_get_method("glBindRenderbuffer");
 	glGenRenderbuffers = (PFNGLGENRENDERBUFFERSEXTPROC)glext_get_method("glGenRenderbuffers");
@@ -144,13 +195,96 @@ bool glext_initialize(void)
 
 	glDrawRangeElementsARB = (PFNGLDRAWRANGEELEMENTSPROC)glext_get_method("glDrawRangeElements");
 
+	// Instancing is optional. Without it instanced meshes are drawn one instance at a time.
+	glVertexAttrib4fv = (PFNGLVERTEXATTRIB4FVPROC)glext_get_method("glVertexAttrib4fv");
+
+	if (glext_is_supported("GL_ARB_draw_instanced") &&
+		glext_is_supported("GL_ARB_instanced_arrays")) {
+
+		glDrawElementsInstanced = (PFNGLDRAWELEMENTSINSTANCEDARBPROC)glext_get_method("glDrawElementsInstancedARB");
+		glVertexAttribDivisor = (PFNGLVERTEXATTRIBDIVISORARBPROC)glext_get_method("glVertexAttribDivisorARB");
+
+		is_instancing_supported = (glDrawElementsInstanced != NULL && glVertexAttribDivisor != NULL);
+	}
+
+	// Program binaries are optional as well. Without them every program is compiled from source.
+	if (glext_is_supported("GL_ARB_get_program_binary")) {
+
+		glGetProgramBinary = (PFNGLGETPROGRAMBINARYPROC)glext_get_method("glGetProgramBinary");
+		glProgramBinary = (PFNGLPROGRAMBINARYPROC)glext_get_method("glProgramBinary");
+		glProgramParameteri = (PFNGLPROGRAMPARAMETERIPROC)glext_get_method("glProgramParameteri");
+
+		// Drivers may support the extension without supporting any binary formats.
+		GLint num_formats = 0;
+		glGetIntegerv(GL_NUM_PROGRAM_BINARY_FORMATS, &num_formats);
+
+		is_program_binary_supported = (glGetProgramBinary != NULL &&
+		                               glProgramBinary != NULL &&
+		                               glProgramParameteri != NULL &&
+		                               num_formats > 0);
+	}
+
+	// Anisotropic filtering is optional, textures fall back to trilinear filtering without it.
+	if (glext_is_supported("GL_EXT_texture_filter_anisotropic") ||
+		glext_is_supported("GL_ARB_texture_filter_anisotropic")) {
+
+		glGetFloatv(GL_MAX_TEXTURE_MAX_ANISOTROPY_EXT, &max_anisotropy);
+		max_anisotropy = MAX(max_anisotropy, 1);
+	}
+
+	// Pixel buffer objects are used for uploading textures in the background.
+	glMapBufferRange = (PFNGLMAPBUFFERRANGEPROC)glext_get_method("glMapBufferRange");
+	glUnmapBuffer = (PFNGLUNMAPBUFFERPROC)glext_get_method("glUnmapBuffer");
+
+	// Sync objects are optional. Without them uploads are assumed to complete after a few frames.
+	if (glext_is_supported("GL_ARB_sync")) {
+
+		glFenceSync = (PFNGLFENCESYNCPROC)glext_get_method("glFenceSync");
+		glClientWaitSync = (PFNGLCLIENTWAITSYNCPROC)glext_get_method("glClientWaitSync");
+		glDeleteSync = (PFNGLDELETESYNCPROC)glext_get_method("glDeleteSync");
+
+		is_sync_supported = (glFenceSync != NULL &&
+		                     glClientWaitSync != NULL &&
+		                     glDeleteSync != NULL);
+	}
+
+	// BC1 and BC3 textures require S3TC, BC4 and BC5 (RGTC) are a part of the core profile.
+	is_s3tc_supported = glext_is_supported("GL_EXT_texture_compression_s3tc");
+
 #ifdef _WIN32
 	glActiveTexture = (PFNGLACTIVETEXTUREPROC)glext_get_method("glActiveTexture");
+	glCompressedTexImage2D =
+		(PFNGLCOMPRESSEDTEXIMAGE2DPROC)glext_get_method("glCompressedTexImage2D");
 #endif
 
 	return true;
 }
 
+bool glext_is_instancing_supported(void)
+{
+	return is_instancing_supported;
+}
+
+bool glext_is_program_binary_supported(void)
+{
+	return is_program_binary_supported;
+}
+
+float glext_get_max_anisotropy(void)
+{
+	return max_anisotropy;
+}
+
+bool glext_is_s3tc_supported(void)
+{
+	return is_s3tc_supported;
+}
+
+bool glext_is_sync_supported(void)
+{
+	return is_sync_supported;
+}
+
 static bool glext_is_supported(const char *name)
 {
 	const char *extensions = (const char *)glGetString(GL_EXTENSIONS);
@@ -31,6 +31,7 @@ extern PFNGLGETSHADERINFOLOGPROC glGetShaderInfoLog;
 extern PFNGLCREATEPROGRAMPROC glCreateProgram;
 extern PFNGLDELETEPROGRAMPROC glDeleteProgram;
 extern PFNGLLINKPROGRAMPROC glLinkProgram;
+extern PFNGLGETPROGRAMIVPROC glGetProgramiv;
 extern PFNGLATTACHSHADERPROC glAttachShader;
 extern PFNGLBINDFRAGDATALOCATIONPROC glBindFragDataLocation;
 extern PFNGLBINDATTRIBLOCATIONARBPROC glBindAttribLocation;
@@ -48,6 +49,16 @@ extern PFNGLVERTEXATTRIBPOINTERARBPROC glVertexAttribPointer;
 extern PFNGLENABLEVERTEXATTRIBARRAYARBPROC glEnableVertexAttribArray;
 extern PFNGLDISABLEVERTEXATTRIBARRAYARBPROC glDisableVertexAttribArray;
 
+// Vertex array objects
+extern PFNGLGENVERTEXARRAYSPROC glGenVertexArrays;
+extern PFNGLDELETEVERTEXARRAYSPROC glDeleteVertexArrays;
+extern PFNGLBINDVERTEXARRAYPROC glBindVertexArray;
+
+// Uniform buffer objects
+extern PFNGLGETUNIFORMBLOCKINDEXPROC glGetUniformBlockIndex;
+extern PFNGLUNIFORMBLOCKBINDINGPROC glUniformBlockBinding;
+extern PFNGLBINDBUFFERRANGEPROC glBindBufferRange;
+
 // Render buffers
 extern PFNGLBINDRENDERBUFFEREXTPROC glBindRenderbuffer;
 extern PFNGLGENRENDERBUFFERSEXTPROC glGenRenderbuffers;
@@ -68,14 +79,49 @@ extern PFNGLBLENDFUNCSEPARATEPROC glBlendFuncSeparate;
 
 extern PFNGLDRAWRANGEELEMENTSPROC glDrawRangeElementsARB;
 
+// Instancing (only available when glext_is_instancing_supported() returns true)
+extern PFNGLDRAWELEMENTSINSTANCEDARBPROC glDrawElementsInstanced;
+extern PFNGLVERTEXATTRIBDIVISORARBPROC glVertexAttribDivisor;
+extern PFNGLVERTEXATTRIB4FVPROC glVertexAttrib4fv;
+
+// Program binaries (only available when glext_is_program_binary_supported() returns true)
+extern PFNGLGETPROGRAMBINARYPROC glGetProgramBinary;
+extern PFNGLPROGRAMBINARYPROC glProgramBinary;
+extern PFNGLPROGRAMPARAMETERIPROC glProgramParameteri;
+
+// Pixel buffer objects
+extern PFNGLMAPBUFFERRANGEPROC glMapBufferRange;
+extern PFNGLUNMAPBUFFERPROC glUnmapBuffer;
+
+// Sync objects (only available when glext_is_sync_supported() returns true)
+extern PFNGLFENCESYNCPROC glFenceSync;
+extern PFNGLCLIENTWAITSYNCPROC glClientWaitSync;
+extern PFNGLDELETESYNCPROC glDeleteSync;
+
 #ifdef _WIN32
 extern PFNGLACTIVETEXTUREPROC glActiveTexture;
+extern PFNGLCOMPRESSEDTEXIMAGE2DPROC glCompressedTexImage2D;
 #endif
 
 // --------------------------------------------------------------------------------
 
 bool glext_initialize(void);
 
+// Returns true when instanced draw calls and per-instance vertex attributes are supported.
+bool glext_is_instancing_supported(void);
+
+// Returns true when linked shader programs can be saved and loaded as binaries.
+bool glext_is_program_binary_supported(void);
+
+// Returns the maximum anisotropy of anisotropic texture filtering, 1 if it is not supported.
+float glext_get_max_anisotropy(void);
+
+// Returns true when BC1 and BC3 (S3TC) compressed textures are supported.
+bool glext_is_s3tc_supported(void);
+
+// Returns true when fence sync objects are supported.
+bool glext_is_sync_supported(void);
+
 END_DECLARATIONS;
 
 #endif
@@ -0,0 +1,447 @@
+#include "glstate.h"
+#include "extensions.h"
+#include "core/memory.h"
+
+// -------------------------------------------------------------------------------------------------
+
+#define UNKNOWN_OBJECT 0xFFFFFFFF // Object name used when the bound object is not known
+#define UNKNOWN_STATE -1 // Value used when a toggleable state is not known
+
+#define MIN_VERTEX_ARRAY_CAPACITY 64 // Initial size of the vertex array table
+
+// -------------------------------------------------------------------------------------------------
+
+// An entry in the vertex array table.
+typedef struct vertex_array_t {
+
+	GLuint vertex_buffer; // Buffers and format the vertex array was set up for
+	GLuint index_buffer;
+	vertex_type_t format;
+
+	GLuint object; // Vertex array object, 0 if the entry is not in use
+
+} vertex_array_t;
+
+// -------------------------------------------------------------------------------------------------
+
+static struct {
+
+	GLuint program; // Currently used shader program
+	GLuint vertex_array; // Currently bound vertex array object
+	GLuint array_buffer; // Buffer bound to GL_ARRAY_BUFFER
+
+	uint32_t texture_unit; // Active texture unit
+	GLuint textures[GLSTATE_MAX_TEXTURE_UNITS]; // Texture bound to each texture unit
+
+	GLuint uniform_buffers[GLSTATE_MAX_UNIFORM_BUFFERS]; // Buffer bound to each uniform block binding
+	size_t uniform_offsets[GLSTATE_MAX_UNIFORM_BUFFERS]; // Offset of the bound range in the buffer
+
+	int blend; // Toggleable states (1 = enabled, 0 = disabled, -1 = unknown)
+	int depth_test;
+	int depth_write;
+	int cull_face;
+
+	GLenum blend_source; // Blend function factors
+	GLenum blend_destination;
+
+} state;
+
+static glstate_stats_t stats;
+
+// Open addressing hash table of vertex arrays.
+static vertex_array_t *vertex_arrays;
+static uint32_t vertex_array_capacity;
+
+// -------------------------------------------------------------------------------------------------
+
+static uint32_t glstate_hash_vertex_array(GLuint vertex_buffer, GLuint index_buffer,
+                                          vertex_type_t format);
+static void glstate_insert_vertex_array(const vertex_array_t *entry);
+static void glstate_resize_vertex_arrays(uint32_t capacity);
+static bool glstate_set_toggle(int *current, bool enabled, GLenum capability);
+
+// -------------------------------------------------------------------------------------------------
+
+void glstate_initialize(void)
+{
+	glstate_resize_vertex_arrays(MIN_VERTEX_ARRAY_CAPACITY);
+	glstate_invalidate();
+}
+
+void glstate_shutdown(void)
+{
+	glstate_bind_vertex_array(0);
+
+	for (uint32_t i = 0; i < vertex_array_capacity; i++) {
+
+		if (vertex_arrays[i].object != 0) {
+			glDeleteVertexArrays(1, &vertex_arrays[i].object);
+		}
+	}
+
+	DESTROY(vertex_arrays);
+
+	vertex_array_capacity = 0;
+	stats.vertex_arrays = 0;
+}
+
+void glstate_invalidate(void)
+{
+	state.program = UNKNOWN_OBJECT;
+	state.vertex_array = UNKNOWN_OBJECT;
+	state.array_buffer = UNKNOWN_OBJECT;
+	state.texture_unit = UNKNOWN_OBJECT;
+
+	for (uint32_t i = 0; i < GLSTATE_MAX_TEXTURE_UNITS; i++) {
+		state.textures[i] = UNKNOWN_OBJECT;
+	}
+
+	for (uint32_t i = 0; i < GLSTATE_MAX_UNIFORM_BUFFERS; i++) {
+		state.uniform_buffers[i] = UNKNOWN_OBJECT;
+	}
+
+	state.blend = UNKNOWN_STATE;
+	state.depth_test = UNKNOWN_STATE;
+	state.depth_write = UNKNOWN_STATE;
+	state.cull_face = UNKNOWN_STATE;
+
+	state.blend_source = GL_NONE;
+	state.blend_destination = GL_NONE;
+}
+
+void glstate_reset_stats(void)
+{
+	stats.calls = 0;
+	stats.skipped = 0;
+}
+
+const glstate_stats_t *glstate_get_stats(void)
+{
+	return &stats;
+}
+
+void glstate_count_calls(uint32_t count)
+{
+	stats.calls += count;
+}
+
+bool glstate_use_program(GLuint program)
+{
+	if (state.program == program) {
+
+		stats.skipped++;
+		return false;
+	}
+
+	glUseProgram(program);
+	state.program = program;
+
+	stats.calls++;
+	return true;
+}
+
+bool glstate_bind_texture(uint32_t unit, GLuint texture)
+{
+	if (unit >= GLSTATE_MAX_TEXTURE_UNITS) {
+		return false;
+	}
+
+	if (state.textures[unit] == texture) {
+
+		stats.skipped++;
+		return false;
+	}
+
+	if (state.texture_unit != unit) {
+
+		glActiveTexture(GL_TEXTURE0 + unit);
+		state.texture_unit = unit;
+
+		stats.calls++;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, texture);
+	state.textures[unit] = texture;
+
+	stats.calls++;
+	return true;
+}
+
+bool glstate_bind_vertex_array(GLuint vertex_array)
+{
+	if (state.vertex_array == vertex_array) {
+
+		stats.skipped++;
+		return false;
+	}
+
+	glBindVertexArray(vertex_array);
+	state.vertex_array = vertex_array;
+
+	stats.calls++;
+	return true;
+}
+
+bool glstate_bind_array_buffer(GLuint buffer)
+{
+	if (state.array_buffer == buffer) {
+
+		stats.skipped++;
+		return false;
+	}
+
+	glBindBufferARB(GL_ARRAY_BUFFER_ARB, buffer);
+	state.array_buffer = buffer;
+
+	stats.calls++;
+	return true;
+}
+
+void glstate_bind_index_buffer(GLuint buffer)
+{
+	// Binding an index buffer would modify the currently bound vertex array.
+	glstate_bind_vertex_array(0);
+
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, buffer);
+	stats.calls++;
+}
+
+bool glstate_bind_uniform_buffer(uint32_t index, GLuint buffer, size_t offset, size_t size)
+{
+	if (index >= GLSTATE_MAX_UNIFORM_BUFFERS) {
+		return false;
+	}
+
+	// The size of a binding is always the size of the uniform block, so it does not need to be
+	// compared.
+	if (state.uniform_buffers[index] == buffer &&
+		state.uniform_offsets[index] == offset) {
+
+		stats.skipped++;
+		return false;
+	}
+
+	glBindBufferRange(GL_UNIFORM_BUFFER, index, buffer, (GLintptr)offset, (GLsizeiptr)size);
+
+	state.uniform_buffers[index] = buffer;
+	state.uniform_offsets[index] = offset;
+
+	stats.calls++;
+	return true;
+}
+
+bool glstate_set_blend(bool enabled, GLenum source_factor, GLenum destination_factor)
+{
+	bool changed = glstate_set_toggle(&state.blend, enabled, GL_BLEND);
+
+	if (state.blend_source == source_factor &&
+		state.blend_destination == destination_factor) {
+
+		stats.skipped++;
+		return changed;
+	}
+
+	glBlendFunc(source_factor, destination_factor);
+
+	state.blend_source = source_factor;
+	state.blend_destination = destination_factor;
+
+	stats.calls++;
+	return true;
+}
+
+bool glstate_set_depth_test(bool enabled)
+{
+	return glstate_set_toggle(&state.depth_test, enabled, GL_DEPTH_TEST);
+}
+
+bool glstate_set_depth_write(bool enabled)
+{
+	if (state.depth_write == (int)enabled) {
+
+		stats.skipped++;
+		return false;
+	}
+
+	glDepthMask(enabled ? GL_TRUE : GL_FALSE);
+	state.depth_write = (int)enabled;
+
+	stats.calls++;
+	return true;
+}
+
+bool glstate_set_cull_face(bool enabled)
+{
+	return glstate_set_toggle(&state.cull_face, enabled, GL_CULL_FACE);
+}
+
+GLuint glstate_get_vertex_array(GLuint vertex_buffer, GLuint index_buffer, vertex_type_t format,
+                                bool *is_new)
+{
+	*is_new = false;
+
+	if (vertex_array_capacity == 0) {
+		glstate_resize_vertex_arrays(MIN_VERTEX_ARRAY_CAPACITY);
+	}
+
+	uint32_t mask = vertex_array_capacity - 1;
+	uint32_t index = glstate_hash_vertex_array(vertex_buffer, index_buffer, format) & mask;
+
+	// Find an existing vertex array for the buffers.
+	while (vertex_arrays[index].object != 0) {
+
+		vertex_array_t *entry = &vertex_arrays[index];
+
+		if (entry->vertex_buffer == vertex_buffer &&
+			entry->index_buffer == index_buffer &&
+			entry->format == format) {
+
+			return entry->object;
+		}
+
+		index = (index + 1) & mask;
+	}
+
+	// Keep the table at most three quarters full.
+	if (4 * (stats.vertex_arrays + 1) > 3 * vertex_array_capacity) {
+		glstate_resize_vertex_arrays(2 * vertex_array_capacity);
+	}
+
+	// Create a new vertex array and bind the buffers to it.
+	vertex_array_t entry;
+
+	entry.vertex_buffer = vertex_buffer;
+	entry.index_buffer = index_buffer;
+	entry.format = format;
+
+	glGenVertexArrays(1, &entry.object);
+	glstate_bind_vertex_array(entry.object);
+
+	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, index_buffer);
+	glstate_bind_array_buffer(vertex_buffer);
+
+	stats.calls += 2;
+
+	glstate_insert_vertex_array(&entry);
+	stats.vertex_arrays++;
+
+	*is_new = true;
+	return entry.object;
+}
+
+void glstate_delete_vertex_arrays(GLuint buffer)
+{
+	if (vertex_array_capacity == 0 || buffer == 0) {
+		return;
+	}
+
+	// Delete every vertex array using the buffer and rebuild the table from the remaining ones.
+	// Buffers are rarely deleted, so there's no need to support removing single entries.
+	uint32_t capacity = vertex_array_capacity;
+	vertex_array_t *entries = vertex_arrays;
+
+	vertex_arrays = NULL;
+	vertex_array_capacity = 0;
+
+	glstate_resize_vertex_arrays(capacity);
+	stats.vertex_arrays = 0;
+
+	for (uint32_t i = 0; i < capacity; i++) {
+
+		vertex_array_t *entry = &entries[i];
+
+		if (entry->object == 0) {
+			continue;
+		}
+
+		if (entry->vertex_buffer == buffer || entry->index_buffer == buffer) {
+
+			if (state.vertex_array == entry->object) {
+				glstate_bind_vertex_array(0);
+			}
+
+			glDeleteVertexArrays(1, &entry->object);
+			stats.calls++;
+		}
+		else {
+
+			glstate_insert_vertex_array(entry);
+			stats.vertex_arrays++;
+		}
+	}
+
+	mem_free(entries);
+
+	// The array buffer binding is reset by OpenGL when the buffer is deleted.
+	if (state.array_buffer == buffer) {
+		state.array_buffer = UNKNOWN_OBJECT;
+	}
+}
+
+static uint32_t glstate_hash_vertex_array(GLuint vertex_buffer, GLuint index_buffer,
+                                          vertex_type_t format)
+{
+	uint32_t hash = vertex_buffer * 2654435761u;
+
+	hash ^= index_buffer * 2246822519u + (hash << 6) + (hash >> 2);
+	hash ^= (uint32_t)format * 3266489917u + (hash << 6) + (hash >> 2);
+
+	return hash;
+}
+
+static void glstate_insert_vertex_array(const vertex_array_t *entry)
+{
+	uint32_t mask = vertex_array_capacity - 1;
+	uint32_t index = glstate_hash_vertex_array(entry->vertex_buffer, entry->index_buffer,
+	                                           entry->format) & mask;
+
+	while (vertex_arrays[index].object != 0) {
+		index = (index + 1) & mask;
+	}
+
+	vertex_arrays[index] = *entry;
+}
+
+static void glstate_resize_vertex_arrays(uint32_t capacity)
+{
+	vertex_array_t *entries = vertex_arrays;
+	uint32_t old_capacity = vertex_array_capacity;
+
+	// The capacity must be a power of two.
+	vertex_arrays = mem_alloc(capacity * sizeof(vertex_array_t));
+	vertex_array_capacity = capacity;
+
+	if (entries == NULL) {
+		return;
+	}
+
+	for (uint32_t i = 0; i < old_capacity; i++) {
+
+		if (entries[i].object != 0) {
+			glstate_insert_vertex_array(&entries[i]);
+		}
+	}
+
+	mem_free(entries);
+}
+
+static bool glstate_set_toggle(int *current, bool enabled, GLenum capability)
+{
+	if (*current == (int)enabled) {
+
+		stats.skipped++;
+		return false;
+	}
+
+	if (enabled) {
+		glEnable(capability);
+	}
+	else {
+		glDisable(capability);
+	}
+
+	*current = (int)enabled;
+
+	stats.calls++;
+	return true;
+}
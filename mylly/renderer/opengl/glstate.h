@@ -0,0 +1,79 @@
+#pragma once
+#ifndef __OPENGL_GLSTATE_H
+#define __OPENGL_GLSTATE_H
+
+#include "renderer/opengl/opengl.h"
+#include "renderer/vertex.h"
+#include "core/defines.h"
+
+/*
+====================================================================================================
+
+	OpenGL state cache
+
+	Keeps track of the state bound to the OpenGL context and skips calls which would not change
+	it. Vertex array objects are cached per vertex buffer, index buffer and vertex format, so the
+	vertex attributes of a buffer only have to be set up once.
+
+	All state changes made while drawing should go through the cache. Code which changes the
+	tracked state directly has to call glstate_invalidate() afterwards.
+
+	NOTE: Index buffer bindings are a part of the bound vertex array object. Use
+	glstate_bind_index_buffer() when uploading index data, it switches to the default vertex
+	array before binding the buffer.
+
+====================================================================================================
+*/
+
+#define GLSTATE_MAX_TEXTURE_UNITS 8
+#define GLSTATE_MAX_UNIFORM_BUFFERS 4
+
+// -------------------------------------------------------------------------------------------------
+
+typedef struct glstate_stats_t {
+
+	uint32_t calls; // Number of GL calls made through the cache, including counted calls
+	uint32_t skipped; // Number of redundant GL calls skipped by the cache
+	uint32_t vertex_arrays; // Number of vertex array objects in the cache
+
+} glstate_stats_t;
+
+// -------------------------------------------------------------------------------------------------
+
+void glstate_initialize(void);
+void glstate_shutdown(void);
+
+// Forget all cached state. The next state change is always passed on to OpenGL.
+void glstate_invalidate(void);
+
+// Statistics are collected until they are reset.
+void glstate_reset_stats(void);
+const glstate_stats_t *glstate_get_stats(void);
+
+// Count GL calls which are not tracked by the cache (draw calls, uniform updates etc.).
+void glstate_count_calls(uint32_t count);
+
+// Each method returns true if the state was changed.
+bool glstate_use_program(GLuint program);
+bool glstate_bind_texture(uint32_t unit, GLuint texture); // Leaves the texture unit active
+bool glstate_bind_vertex_array(GLuint vertex_array);
+bool glstate_bind_array_buffer(GLuint buffer);
+void glstate_bind_index_buffer(GLuint buffer);
+bool glstate_bind_uniform_buffer(uint32_t index, GLuint buffer, size_t offset, size_t size);
+
+bool glstate_set_blend(bool enabled, GLenum source_factor, GLenum destination_factor);
+bool glstate_set_depth_test(bool enabled);
+bool glstate_set_depth_write(bool enabled);
+bool glstate_set_cull_face(bool enabled);
+
+// Get a vertex array object for drawing from a pair of buffers. is_new is set when the vertex
+// array was created by the call, in which case the vertex array is bound and the caller should
+// set up its vertex attributes.
+GLuint glstate_get_vertex_array(GLuint vertex_buffer, GLuint index_buffer, vertex_type_t format,
+                                bool *is_new);
+
+// Delete all vertex arrays referring to a buffer object. Must be called before the buffer is
+// deleted, because buffer names are reused.
+void glstate_delete_vertex_arrays(GLuint buffer);
+
+#endif
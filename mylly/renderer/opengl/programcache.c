@@ -0,0 +1,193 @@
+#include "programcache.h"
+#include "extensions.h"
+#include "core/memory.h"
+#include "io/file.h"
+#include "io/log.h"
+#include <stdio.h>
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+#define PROGCACHE_FILE_MAGIC 0x47505943 // "CYPG"
+#define PROGCACHE_FILE_VERSION 1
+
+#define FNV_OFFSET_BASIS 0xCBF29CE484222325ULL
+#define FNV_PRIME 0x100000001B3ULL
+
+// -------------------------------------------------------------------------------------------------
+
+// File header of a cached program. The header is followed by the program binary.
+typedef struct progcache_file_header_t {
+
+	uint32_t magic; // Always PROGCACHE_FILE_MAGIC
+	uint32_t version; // Version of the file format
+	uint64_t key; // Key of the program, guards against renamed files
+	uint32_t format; // Binary format returned by the driver
+	uint32_t size; // Size of the program binary in bytes
+
+} progcache_file_header_t;
+
+STATIC_ASSERT(sizeof(progcache_file_header_t) == 24, progcache_file_header_size);
+
+// -------------------------------------------------------------------------------------------------
+
+static bool is_enabled = false;
+static uint64_t device_key = FNV_OFFSET_BASIS;
+
+// -------------------------------------------------------------------------------------------------
+
+static void progcache_get_path(uint64_t key, char *path, size_t size);
+static bool progcache_is_linked(GLuint program);
+
+// -------------------------------------------------------------------------------------------------
+
+void progcache_initialize(void)
+{
+	is_enabled = glext_is_program_binary_supported();
+
+	if (!is_enabled) {
+
+		log_message("Renderer", "Program binaries are not supported, shaders are not cached.");
+		return;
+	}
+
+	// Binaries are only valid for the driver which created them.
+	const GLenum strings[] = { GL_VENDOR, GL_RENDERER, GL_VERSION };
+
+	device_key = FNV_OFFSET_BASIS;
+
+	for (size_t i = 0; i < LENGTH(strings); ++i) {
+
+		const char *value = (const char *)glGetString(strings[i]);
+
+		if (value != NULL) {
+			device_key = progcache_hash(device_key, value, strlen(value) + 1);
+		}
+	}
+}
+
+bool progcache_is_enabled(void)
+{
+	return is_enabled;
+}
+
+uint64_t progcache_hash(uint64_t hash, const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+
+	for (size_t i = 0; i < size; ++i) {
+
+		hash ^= bytes[i];
+		hash *= FNV_PRIME;
+	}
+
+	return hash;
+}
+
+uint64_t progcache_get_device_key(void)
+{
+	return device_key;
+}
+
+GLuint progcache_load(uint64_t key)
+{
+	if (!is_enabled) {
+		return 0;
+	}
+
+	char path[260];
+	progcache_get_path(key, path, sizeof(path));
+
+	size_t size;
+	uint8_t *data = file_map(path, &size);
+
+	if (data == NULL) {
+		return 0;
+	}
+
+	const progcache_file_header_t *header = (const progcache_file_header_t *)data;
+
+	if (size < sizeof(progcache_file_header_t) ||
+		header->magic != PROGCACHE_FILE_MAGIC ||
+		header->version != PROGCACHE_FILE_VERSION ||
+		header->key != key ||
+		sizeof(progcache_file_header_t) + (uint64_t)header->size > size) {
+
+		log_warning("Renderer", "%s is not a valid program binary.", path);
+
+		file_unmap(data, size);
+		return 0;
+	}
+
+	GLuint program = glCreateProgram();
+
+	glProgramBinary(program, header->format, &data[sizeof(progcache_file_header_t)],
+	                header->size);
+
+	file_unmap(data, size);
+
+	// The driver is allowed to reject any binary, in which case the program is compiled again.
+	if (!progcache_is_linked(program)) {
+
+		log_message("Renderer", "Program binary %s was rejected, compiling from source.", path);
+
+		glDeleteProgram(program);
+		return 0;
+	}
+
+	return program;
+}
+
+void progcache_save(uint64_t key, GLuint program)
+{
+	if (!is_enabled || program == 0 || !progcache_is_linked(program)) {
+		return;
+	}
+
+	GLint length = 0;
+	glGetProgramiv(program, GL_PROGRAM_BINARY_LENGTH, &length);
+
+	if (length <= 0) {
+		return;
+	}
+
+	size_t size = sizeof(progcache_file_header_t) + (size_t)length;
+	uint8_t *data = mem_alloc_fast(size);
+
+	progcache_file_header_t header = { 0 };
+	GLenum format = 0;
+
+	glGetProgramBinary(program, length, &length, &format, &data[sizeof(header)]);
+
+	header.magic = PROGCACHE_FILE_MAGIC;
+	header.version = PROGCACHE_FILE_VERSION;
+	header.key = key;
+	header.format = format;
+	header.size = (uint32_t)length;
+
+	memcpy(data, &header, sizeof(header));
+
+	char path[260];
+	progcache_get_path(key, path, sizeof(path));
+
+	if (!file_create_directory(PROGCACHE_DIRECTORY) ||
+		!file_write_all_data(path, data, sizeof(header) + header.size)) {
+
+		log_warning("Renderer", "Could not write program binary %s.", path);
+	}
+
+	mem_free(data);
+}
+
+static void progcache_get_path(uint64_t key, char *path, size_t size)
+{
+	snprintf(path, size, "%s/%016llx.bin", PROGCACHE_DIRECTORY, (unsigned long long)key);
+}
+
+static bool progcache_is_linked(GLuint program)
+{
+	GLint status = GL_FALSE;
+	glGetProgramiv(program, GL_LINK_STATUS, &status);
+
+	return (status == GL_TRUE);
+}
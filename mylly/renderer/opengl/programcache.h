@@ -0,0 +1,53 @@
+#pragma once
+#ifndef __OPENGL_PROGRAMCACHE_H
+#define __OPENGL_PROGRAMCACHE_H
+
+#include "renderer/opengl/opengl.h"
+#include "core/defines.h"
+
+/*
+====================================================================================================
+
+	Program binary cache
+
+	Stores linked shader programs on disk with ARB_get_program_binary, so the programs don't have
+	to be compiled and linked again on the next launch. Each program is stored in its own file in
+	PROGCACHE_DIRECTORY, named after the key of the program.
+
+	The key is a hash of everything the driver compiles: the source code of the program including
+	the defines added by the renderer. The device key (vendor, renderer and version strings of the
+	driver) is hashed into every key, so updating or changing the driver never loads a binary built
+	by another driver.
+
+	Drivers may still reject a binary (for example after an update which doesn't change the version
+	string). Rejected and otherwise invalid binaries are ignored and the program is compiled from
+	source, after which the cached binary is replaced.
+
+	The cache is disabled when the driver doesn't support any program binary formats.
+
+====================================================================================================
+*/
+
+#define PROGCACHE_DIRECTORY "./cache/shaders"
+
+// -------------------------------------------------------------------------------------------------
+
+// Enable the cache if the driver supports program binaries. Called after the OpenGL extensions
+// have been loaded.
+void progcache_initialize(void);
+
+bool progcache_is_enabled(void);
+
+// Hash a block of data into a key. Start with the device key and hash each piece of source code
+// the program is compiled from.
+uint64_t progcache_hash(uint64_t hash, const void *data, size_t size);
+uint64_t progcache_get_device_key(void);
+
+// Create a program from a cached binary. Returns 0 if the program is not in the cache or the
+// driver rejects the binary.
+GLuint progcache_load(uint64_t key);
+
+// Store the binary of a successfully linked program into the cache.
+void progcache_save(uint64_t key, GLuint program);
+
+#endif
@@ -1,17 +1,27 @@
-#include "renderer/renderer.h"
+#include "renderer/rendbackend.h"
 #include "extensions.h"
 #include "framebuffer.h"
+#include "glstate.h"
+#include "programcache.h"
+#include "textureupload.h"
 #include "renderer/vertex.h"
 #include "renderer/texture.h"
+#include "renderer/mipmap.h"
+#include "renderer/texcompress.h"
 #include "renderer/buffercache.h"
 #include "renderer/mesh.h"
 #include "renderer/rendersystem.h"
+#include "renderer/lightgrid.h"
+#include "renderer/cmdbuffer.h"
 #include "io/log.h"
 #include "platform/window.h"
+#include "platform/timer.h"
 #include "core/time.h"
+#include "math/math.h"
 #include "core/mylly.h"
 #include "resources/resources.h"
 #include <stdio.h>
+#include <string.h>
 
 // Include source code for default shaders.
 #include "defaultshaders.c"
@@ -26,26 +36,105 @@ static HGLRC gl_context;
 static GLXContext gl_context;
 #endif
 
-// Currently used shader and texture object.
-static GLuint active_shader = 0;
-static GLuint active_texture = 0;
-static GLuint active_normal_map = 0;
+// Draw call statistics of the previous and the current frame.
+static rend_stats_t stats;
+static rend_stats_t frame_stats;
 
-// Uniform arrays.
-static mat_t matrix_array[NUM_MAT_UNIFORMS];
-static vec4_t vector_array[NUM_VEC_UNIFORMS];
-static int sampler_array[NUM_SAMPLER_UNIFORMS];
+// Built-in shader constants are passed to shaders in uniform blocks (see UNIFORM_BLOCK_* in
+// shader.h). The layout of each block has to match its std140 declaration in mylly.glinc.
+typedef struct frame_uniforms_t {
 
-static int num_mesh_lights;
-static mat_t light_array[MAX_LIGHTS_PER_MESH];
+	vec4_t time; // 4-element vector containing time (see core/time.h)
+
+} frame_uniforms_t;
+
+typedef struct view_uniforms_t {
+
+	mat_t view;
+	mat_t view_inv;
+	mat_t projection;
+	mat_t projection_inv;
+	mat_t view_projection;
+	mat_t view_projection_inv;
+
+	vec4_t view_position; // The position of the rendered view (camera)
+	vec4_t screen; // Screen size in pixels and the near and far clip planes
+	vec4_t ambient_light; // Ambient light colour of the view
+	vec4_t light_grid; // Depth slice scale and bias of the view's light grid
+
+} view_uniforms_t;
+
+typedef struct object_uniforms_t {
+
+	mat_t mvp; // Model-view-projection matrix
+	mat_t model; // Model matrix
+
+} object_uniforms_t;
+
+// The constants of every view and drawn mesh are uploaded to a single uniform buffer once per
+// frame. Each frame writes into its own part of the buffer, so constants which the GPU may still
+// be reading for the previous frames are not overwritten.
+#define UNIFORM_BUFFER_FRAMES 3
+
+static GLuint uniform_buffer;
+static size_t uniform_buffer_capacity; // Size of a single frame's part of the buffer
+static uint32_t uniform_buffer_frame; // The part of the buffer used by the current frame
+static size_t uniform_frame_offset; // Offset of the current frame's constants in the buffer
+
+static uint8_t *uniform_data; // Constants of the current frame before they are uploaded
+static size_t uniform_data_capacity;
+
+static size_t uniform_alignment; // Required alignment of uniform buffer bindings
+static size_t frame_uniforms_size; // Aligned size of each uniform block
+static size_t view_uniforms_size;
+static size_t object_uniforms_size;
+
+static size_t object_uniforms_offset; // Offset of the first object's constants in the frame
+static uint32_t next_object_uniforms; // Index of the constants of the next drawn mesh
+
+// The model matrices of every instanced draw are uploaded to a single vertex buffer once per
+// frame, in the same order as the draws are replayed in.
+static GLuint instance_buffer;
+static uint8_t *instance_data; // Matrices of the current frame before they are uploaded
+static size_t instance_data_capacity;
+static size_t next_instance_offset; // Offset of the matrices of the next instanced draw
+static bool is_instancing_supported; // False when instances have to be drawn one at a time
+
+// Lights drawn in a single deferred lighting pass.
+// NOTE: Has to match the value in lighting.glinc!
+#define MAX_LIGHTS_PER_PASS 8
+
+static int num_pass_lights;
+static mat_t light_array[MAX_LIGHTS_PER_PASS];
+
+// Light grid textures for forward lighting. The textures are bound to dedicated texture units
+// which are not used for anything else.
+#define LIGHT_GRID_TEXTURE_UNIT 5
+#define LIGHT_INDEX_TEXTURE_UNIT 6
+#define LIGHT_DATA_TEXTURE_UNIT 7
+
+#define MAX_LIGHT_INDEX_ROWS\
+	((NUM_LIGHT_CLUSTERS * MAX_LIGHTS_PER_CLUSTER + LIGHT_INDEX_ROW_LENGTH - 1) / LIGHT_INDEX_ROW_LENGTH)
+
+static GLuint light_grid_texture; // Light list offset and length of each cluster
+static GLuint light_index_texture; // Light lists of all clusters
+static GLuint light_data_texture; // Shader parameters of each light
+static const light_grid_t *uploaded_light_grid; // The light grid currently stored in the textures
 
 // Vertices for covering the entire screen.
 static GLuint screen_vertices;
 static GLuint screen_indices;
 
+// Buffers for the screen space quads covering the area affected by deferred lights.
+static GLuint light_quad_vertices;
+static GLuint light_quad_indices;
+
 // Loading/splash screen FBOs.
 static GLuint splash_screen_vertices;
 static GLuint splash_screen_indices;
+static GLuint splash_program; // Program the uniform locations below were resolved for
+static GLint splash_texture_location;
+static GLint splash_colour_location;
 
 // Debug variables. Used to override normal rendering pipeline.
 static gbuffer_component_t override_gbuffer_component = GBUFFER_NONE;
@@ -55,31 +144,72 @@ static bool is_using_deferred_lighting = false; // Toggle for forward/deferred l
 static shader_t *ambient_shader;
 static shader_t *light_shader;
 
-// -------------------------------------------------------------------------------------------------
-
+// Shaders for drawing the contents of a framebuffer onto the screen.
+static shader_t *framebuffer_shader;
+static shader_t *framebuffer_alpha_shader;
 
-static void rend_draw_mesh(rview_t *view, rmesh_t *mesh);
-
-static void rend_set_active_material(shader_t *shader, texture_t *texture, texture_t *normal_map,
-                                     rview_t *view, rmesh_t *mesh, vertex_type_t vertex_type);
+// -------------------------------------------------------------------------------------------------
 
-static bool rend_bind_shader_attribute(shader_t *shader, int attr_type, GLint size, GLenum type,
-                                       GLboolean normalized, GLsizei stride, const GLvoid *pointer);
+static void rend_replay_commands(const cmdbuf_t *commands);
+static void rend_set_pipeline(const cmd_set_pipeline_t *command);
+static void rend_bind_textures(const cmd_bind_textures_t *command);
+static void rend_bind_buffers(const cmd_bind_buffers_t *command);
+static void rend_set_uniform(const cmd_set_uniform_t *command);
+static void rend_draw(const cmd_draw_t *command);
+static void rend_draw_instanced(const cmd_draw_instanced_t *command);
+
+static bool rend_bind_vertex_data(GLuint vertex_buffer, GLuint index_buffer,
+                                  vertex_type_t vertex_type);
+static void rend_set_vertex_attributes(vertex_type_t vertex_type);
+static void rend_set_instance_attributes(size_t offset);
+static void rend_set_vertex_attribute(int attr_type, GLint size, GLenum type, GLboolean normalized,
+                                      GLsizei stride, const GLvoid *pointer);
+static vbindex_t rend_gl_generate_buffer(void);
+static void rend_gl_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index,
+                                       bool is_static);
+static void rend_bind_buffer_for_upload(vbindex_t vbo, bool is_index);
+
+static void rend_gl_get_shader_defines(const char *shader_type_name, char *defines, size_t size);
+static uint64_t rend_gl_get_program_key(const char **lines, size_t num_lines);
 
 static void rend_update_material_uniforms(shader_t *shader);
-static void rend_update_uniforms(robject_t *parent_obj, rview_t *view, bool is_effect);
-static void rend_commit_uniforms(shader_t *shader);
 static void rend_clear_uniforms(void);
 
+static void rend_create_uniform_buffer(void);
+static void rend_upload_uniforms(rview_t *first_view, const cmdbuf_t *commands);
+static uint8_t *rend_write_object_uniforms(const cmdbuf_t *commands, uint8_t *data);
+static void rend_get_view_uniforms(const rview_t *view, view_uniforms_t *uniforms);
+static void rend_bind_view_uniforms(uint32_t view_index);
+static void rend_bind_object_uniforms(uint32_t object_index);
+static size_t rend_align_uniform_size(size_t size);
+
+static void rend_upload_instances(rview_t *first_view, const cmdbuf_t *commands);
+static uint8_t *rend_write_instances(const cmdbuf_t *commands, uint8_t *data);
+
 static void rend_draw_post_processing_effects(rview_t *view, int source_fb_index);
 static void rend_draw_framebuffer_with_shader(int source_fb_index, shader_t *shader,
                                               bool override_buffer);
+static void rend_begin_framebuffer_pass(int source_fb_index, shader_t *shader,
+                                        bool override_buffer);
+static void rend_draw_light_batch(rview_t *view, uint32_t first_light, uint32_t num_lights);
+static void rend_create_light_quad_buffers(void);
 
 static void rend_set_blend_mode(int queue, bool post_processing);
 
+static uint32_t rend_set_texture_filter(TEX_FILTER filter, uint32_t num_levels);
+static size_t rend_get_texture_format(TEX_FORMAT fmt, GLint *internal_format, GLenum *image_format);
+static GLuint rend_create_uploaded_texture(texture_upload_t *upload, const void *image,
+                                           const void *mip_chain);
+static bool rend_get_compressed_format(TEX_FORMAT fmt, GLenum *internal_format);
+
+static void rend_create_light_grid_textures(void);
+static void rend_upload_light_grid(const light_grid_t *grid);
+static GLuint rend_create_data_texture(GLint internal_format, GLsizei width, GLsizei height,
+                                       GLenum format, GLenum type);
+
 // -------------------------------------------------------------------------------------------------
 
-bool rend_initialize(void)
+static bool rend_gl_initialize(void)
 {
 	if (gl_context != NULL) {
 		return true;
@@ -141,6 +271,29 @@ bool rend_initialize(void)
 		return false;	
 	}
 
+	glstate_initialize();
+	progcache_initialize();
+	texupload_initialize();
+
+	// Create the uniform buffer for shader constants.
+	rend_create_uniform_buffer();
+
+	// Create the vertex buffer for the model matrices of instanced draws. The buffer always contains
+	// at least one matrix, so the instance attributes of every vertex array refer to valid data.
+	is_instancing_supported = glext_is_instancing_supported();
+
+	if (is_instancing_supported) {
+
+		mat_t identity = mat_identity();
+
+		glGenBuffersARB(1, &instance_buffer);
+		glstate_bind_array_buffer(instance_buffer);
+		glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(identity), &identity, GL_STREAM_DRAW_ARB);
+	}
+	else {
+		log_warning("Renderer", "Instanced arrays are not supported, drawing instances one by one.");
+	}
+
 	// Create two rotating framebuffers for deferred rendering and post-processing, as well as one
 	// buffer for the geometry pass.
 	// TODO: Resize the buffers every time rendering resolution changes!
@@ -150,6 +303,9 @@ bool rend_initialize(void)
 		return false;
 	}
 
+	// The framebuffer textures were bound without the state cache.
+	glstate_invalidate();
+
 	// Create a list of vertices covering the entire screen. This is used to render post-processing
 	// effects.
 	vertex_ui_t vertices[] = {
@@ -159,13 +315,13 @@ bool rend_initialize(void)
 		vertex_ui(vec2(1, 1),   vec2(1, 1), COL_WHITE)
 	};
 
-	screen_vertices = rend_generate_buffer();
-	rend_upload_buffer_data(screen_vertices, vertices, sizeof(vertices), false, true);
+	screen_vertices = rend_gl_generate_buffer();
+	rend_gl_upload_buffer_data(screen_vertices, vertices, sizeof(vertices), false, true);
 
 	vindex_t indices[] = { 0, 1, 2, 3 };
 
-	screen_indices = rend_generate_buffer();
-	rend_upload_buffer_data(screen_indices, indices, sizeof(indices), true, true);
+	screen_indices = rend_gl_generate_buffer();
+	rend_gl_upload_buffer_data(screen_indices, indices, sizeof(indices), true, true);
 
 	// Generate buffer objects for the splash screen.
 	glGenBuffersARB(1, &splash_screen_vertices);
@@ -176,15 +332,29 @@ bool rend_initialize(void)
 	log_message("Renderer", "OpenGL version: %s", glGetString(GL_VERSION));
 	log_message("Renderer", "GLSL version: %s", glGetString(GL_SHADING_LANGUAGE_VERSION));
 
-	glDisable(GL_DEPTH_TEST);
+	glstate_set_depth_test(false);
 
 	is_using_deferred_lighting = mylly_get_parameters()->renderer.use_deferred_lighting;
 
+	// Forward lighting passes the lights of each view to shaders in textures. Deferred lighting
+	// draws the lights as screen space quads.
+	if (!is_using_deferred_lighting) {
+		rend_create_light_grid_textures();
+	}
+	else {
+		rend_create_light_quad_buffers();
+	}
+
 	return true;
 }
 
-void rend_shutdown(void)
+static void rend_gl_shutdown(void)
 {
+	texupload_shutdown();
+
+	// Destroy vertex array objects before the buffers they refer to.
+	glstate_shutdown();
+
 	// Destroy framebuffers.
 	rend_fb_shutdown();
 
@@ -193,6 +363,32 @@ void rend_shutdown(void)
 
 	glDeleteBuffersARB(1, &splash_screen_vertices);
 	glDeleteBuffersARB(1, &splash_screen_indices);
+
+	glDeleteBuffersARB(1, &uniform_buffer);
+	DESTROY(uniform_data);
+
+	uniform_data_capacity = 0;
+
+	if (instance_buffer != 0) {
+		glDeleteBuffersARB(1, &instance_buffer);
+	}
+
+	DESTROY(instance_data);
+
+	instance_data_capacity = 0;
+
+	if (light_quad_vertices != 0) {
+
+		glDeleteBuffersARB(1, &light_quad_vertices);
+		glDeleteBuffersARB(1, &light_quad_indices);
+	}
+
+	if (light_grid_texture != 0) {
+
+		glDeleteTextures(1, &light_grid_texture);
+		glDeleteTextures(1, &light_index_texture);
+		glDeleteTextures(1, &light_data_texture);
+	}
 	
 	// Destroy the rendering context.
 #ifdef _WIN32
@@ -209,8 +405,11 @@ void rend_shutdown(void)
 #endif
 }
 
-void rend_preload_shaders(void)
+static void rend_gl_preload_shaders(void)
 {
+	framebuffer_shader = res_get_shader("default-draw-framebuffer");
+	framebuffer_alpha_shader = res_get_shader("default-draw-framebuffer-alpha");
+
 	if (!is_using_deferred_lighting) {
 		return;
 	}
@@ -223,18 +422,19 @@ void rend_preload_shaders(void)
 	}
 }
 
-void rend_begin_draw(void)
+static void rend_gl_begin_draw(void)
 {
+	glstate_reset_stats();
+
 	// Clear the framebuffers.
 	rend_clear_fbs();
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glstate_set_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	glstate_set_depth_test(true);
+	glstate_set_cull_face(false);
 
-	glEnable(GL_DEPTH_TEST);
 	glDepthFunc(GL_LEQUAL);
 
-	//glDisable(GL_CULL_FACE);
 	//glPolygonMode(GL_FRONT_AND_BACK, GL_LINE);
 
 	glEnableClientState(GL_VERTEX_ARRAY);
@@ -242,9 +442,14 @@ void rend_begin_draw(void)
 	glStencilMask(0x0);
 
 	rend_clear_uniforms();
+
+	frame_stats = (rend_stats_t){ 0 };
+
+	// Light grids are rebuilt every frame.
+	uploaded_light_grid = NULL;
 }
 
-void rend_end_draw(void)
+static void rend_gl_end_draw(void)
 {
 #ifdef _WIN32
 	SwapBuffers(context);
@@ -253,12 +458,30 @@ void rend_end_draw(void)
 #endif
 
 	glDisableClientState(GL_VERTEX_ARRAY);
+
+	// Start the texture uploads of the frame while the GPU is busy drawing it.
+	uint32_t upload_budget = mylly_get_parameters()->renderer.texture_upload_budget;
+
+	texupload_process((upload_budget != 0 ? upload_budget : TEXUPLOAD_DEFAULT_BUDGET),
+	                  rend_create_uploaded_texture, &frame_stats);
+
+	frame_stats.gl_calls = glstate_get_stats()->calls;
+	frame_stats.gl_calls_skipped = glstate_get_stats()->skipped;
+
+	stats = frame_stats;
+}
+
+static const rend_stats_t *rend_gl_get_stats(void)
+{
+	return &stats;
 }
 
-void rend_draw_views(rview_t *first_view)
+static void rend_gl_draw_views(rview_t *first_view)
 {
-	// Load a dummy shader for drawing contents of a framebuffer onto a screen unaltered.
-	shader_t *dummy = res_get_shader("default-draw-framebuffer");
+	uint64_t submit_start = timer_get_microseconds();
+
+	// A dummy shader for drawing contents of a framebuffer onto a screen unaltered.
+	shader_t *dummy = framebuffer_shader;
 
 	// Create a temporary list from which to render the views.
 	list_t(rview_t) views;
@@ -269,14 +492,12 @@ void rend_draw_views(rview_t *first_view)
 	// Ensure the geometry buffer is bound before drawing any actual geometry.
 	rend_bind_fb(FB_GEOMETRY);
 
-	rview_t *view;
-	rmesh_t *mesh;
-
-	// TODO: Group meshes by a) shader/texture and b) the vertex buffer used, in order to minimize
-	// draw calls. This could be done in render system before passing the renderer data to render.
+	// Upload the constants of every view and mesh at once. Drawing a mesh only selects the part of
+	// the uniform buffer containing its constants.
+	rend_upload_uniforms(first_view, NULL);
+	rend_upload_instances(first_view, NULL);
 
-	// TODO: See rend_draw_ui_view below - don't issue any draw call as long as the objects are
-	// using the same buffer object!
+	rview_t *view;
 
 	int meshes_drawn = 0;
 
@@ -310,17 +531,38 @@ void rend_draw_views(rview_t *first_view)
 			}
 		}
 
-		// Draw meshes from each view.
+		// Draw meshes from each view. The constants of the views are stored in the same order as the
+		// views are drawn.
+		uint32_t view_index = 0;
+
 		list_foreach(views, view) {
 
 			// Apply appropriate blending mode for the queue.
 			rend_set_blend_mode(queue, false);
 
-			// Draw the meshes of this queue.
-			list_foreach(view->meshes[queue], mesh) {
+			const cmdbuf_t *commands = view->commands[queue];
+			bool has_commands = (commands != NULL && commands->num_commands != 0);
+
+			// Select the constants of the view. They're shared by every mesh in the view.
+			if (has_commands) {
+				rend_bind_view_uniforms(view_index);
+			}
+
+			view_index++;
+
+			// Make the lights of the view available to forward lit shaders.
+			if (view->light_grid != NULL &&
+				view->light_grid != uploaded_light_grid &&
+				has_commands) {
+
+				rend_upload_light_grid(view->light_grid);
+			}
+
+			// Draw the meshes of this queue by replaying the commands recorded for it.
+			if (has_commands) {
 
-				rend_draw_mesh(view, mesh);
-				meshes_drawn++;
+				rend_replay_commands(commands);
+				meshes_drawn += commands->num_objects;
 			}
 		}
 
@@ -337,27 +579,19 @@ void rend_draw_views(rview_t *first_view)
 			last_used_fb_index = 0;
 			rend_bind_fb(last_used_fb_index);
 
-			rend_update_uniforms(NULL, view, true);
+			rend_bind_view_uniforms(0);
 			rend_draw_framebuffer_with_shader(FB_GEOMETRY, ambient_shader, false);
 
-			// Draw a separate pass for each light affecting the view.
-			for (uint32_t i = 0; i < view->num_lights; i++) {
-
-				// Copy light parameters to the light array. Since we're redrawing the view for
-				// each light (forward mode draws more than one light at once), we'll only use the
-				// first component of the light array and set the number of lights to 1.
-				mat_cpy(&light_array[0], &view->lights[i]->shader_params);
-				num_mesh_lights = 1;
-
-				rend_update_uniforms(NULL, view, true);
-
-				// Draw the view to one of the post processing framebuffers.
-				last_used_fb_index = (i + 1) & 1;
-				rend_bind_fb(last_used_fb_index);
+			// Add the contribution of the lights on top of the ambient pass. Lights are drawn in
+			// batches, each light only covering the part of the screen it can affect.
+			glstate_set_blend(true, GL_ONE, GL_ONE);
 
-				// Apply the current light to the previous lit view.
-				rend_draw_framebuffer_with_shader(i & 1, light_shader, false);
+			for (uint32_t i = 0; i < view->num_lights; i += MAX_LIGHTS_PER_PASS) {
+				rend_draw_light_batch(view, i, MIN(view->num_lights - i, MAX_LIGHTS_PER_PASS));
 			}
+
+			num_pass_lights = 0;
+			rend_set_blend_mode(queue, false);
 		}
 		else if (queue == QUEUE_TRANSPARENT) {
 
@@ -380,7 +614,7 @@ void rend_draw_views(rview_t *first_view)
 
 				// No post process effects to render. Render the contents of the geometry buffer
 				// onto the screen with a dummy shader.
-				rend_update_uniforms(NULL, view, true);
+				rend_bind_view_uniforms(0);
 
 				rend_bind_fb(FB_SCREEN);
 				rend_draw_framebuffer_with_shader(last_used_fb_index, dummy, false);
@@ -393,12 +627,14 @@ void rend_draw_views(rview_t *first_view)
 
 		// Use a different shader for drawing just the contents of the alpha channel.
 		if (override_gbuffer_component == GBUFFER_SHININESS) {
-			dummy = res_get_shader("default-draw-framebuffer-alpha");
+			dummy = framebuffer_alpha_shader;
 		}
 
 		rend_bind_fb(FB_SCREEN);
 		rend_draw_framebuffer_with_shader(FB_GEOMETRY, dummy, true);
 	}
+
+	frame_stats.submit_time = (uint32_t)(timer_get_microseconds() - submit_start);
 }
 /*
 void rend_draw_ui_view(rview_ui_t *view)
@@ -455,211 +691,301 @@ void rend_draw_ui_view(rview_ui_t *view)
 	}
 }
 */
-static void rend_draw_mesh(rview_t *view, rmesh_t *mesh)
+static void rend_gl_execute_commands(const cmdbuf_t *commands)
+{
+	if (commands == NULL || commands->num_commands == 0) {
+		return;
+	}
+
+	// Upload the per-object constants of the buffer. The frame and view constants of the previous
+	// frame are not overwritten, so the previously bound view stays valid.
+	rend_upload_uniforms(NULL, commands);
+	rend_upload_instances(NULL, commands);
+	rend_replay_commands(commands);
+}
+
+static void rend_replay_commands(const cmdbuf_t *commands)
 {
-	// Bind the meshes vertex buffer and set vertex data pointers.
-	if (mesh->handle_vertices != 0 && mesh->handle_indices != 0) {
+	const cmd_t *command;
 
-		// Mesh uses a buffer handle (i.e. only a part of the buffer is drawn).
-		bufcache_t *buffer = bufcache_get(BUFFER_GET_INDEX(mesh->handle_vertices));
+	cmdbuf_foreach(commands, command) {
 
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, buffer->vertex_buffer.object);
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, buffer->index_buffer.object);
-	}
-	else if (mesh->vertices != NULL && mesh->indices != NULL) {
+		switch (command->type) {
+
+		case CMD_SET_PIPELINE:
+			rend_set_pipeline((const cmd_set_pipeline_t *)command);
+			break;
 
-		// Mesh uses a buffer cache object (i.e. the entire buffer is drawn).
-		glBindBufferARB(GL_ARRAY_BUFFER_ARB, mesh->vertices->vbo);
-		glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, mesh->indices->vbo);
+		case CMD_BIND_TEXTURES:
+			rend_bind_textures((const cmd_bind_textures_t *)command);
+			break;
+
+		case CMD_BIND_BUFFERS:
+			rend_bind_buffers((const cmd_bind_buffers_t *)command);
+			break;
+
+		case CMD_SET_UNIFORM:
+			rend_set_uniform((const cmd_set_uniform_t *)command);
+			break;
+
+		case CMD_SET_OBJECT:
+
+			// The constants were uploaded in the same order as the commands are replayed, so
+			// each object only selects the next part of the uniform buffer.
+			rend_bind_object_uniforms(next_object_uniforms++);
+			break;
+
+		case CMD_DRAW:
+			rend_draw((const cmd_draw_t *)command);
+			break;
+
+		case CMD_DRAW_INSTANCED:
+			rend_draw_instanced((const cmd_draw_instanced_t *)command);
+			break;
+
+		default:
+			break;
+		}
 	}
-	else {
+}
 
-		// Mesh does not contain vertex data, unable to render.
-		return;
+static void rend_set_pipeline(const cmd_set_pipeline_t *command)
+{
+	// Select the active shader.
+	if (glstate_use_program(command->program)) {
+		frame_stats.shader_changes++;
 	}
 
-	// Check whether the shader or texture needs to be changed. Bind vertex attributes.
-	rend_set_active_material(mesh->shader, mesh->texture, mesh->normal_map,
-	                         view, mesh, mesh->vertex_type);
+	// Disable depth write for particles.
+	glstate_set_depth_write(command->depth_write != 0);
+}
 
-	// Draw the triangles of the mesh.
-	if (mesh->vertices != NULL && mesh->indices != NULL) {
-		glDrawElements(GL_TRIANGLES, mesh->indices->count, GL_UNSIGNED_SHORT, 0);
-	}
-	else {
+static void rend_bind_textures(const cmd_bind_textures_t *command)
+{
+	// Select the active texture and normal map. Meshes without one keep using the previous one.
+	if (command->texture != 0 &&
+		glstate_bind_texture(0, command->texture)) {
 
-		uint32_t offset = BUFFER_GET_OFFSET(mesh->handle_indices) / sizeof(vindex_t);
-		uint32_t length = BUFFER_GET_SIZE(mesh->handle_indices) / sizeof(vindex_t);
+		frame_stats.texture_changes++;
+	}
 
-		GLenum mode = (
-			BUFFER_GET_INDEX(mesh->handle_vertices) == BUFIDX_DEBUG_LINE ?
-			GL_LINES :
-			GL_TRIANGLES
-		);
+	if (command->normal_map != 0 &&
+		glstate_bind_texture(1, command->normal_map)) {
 
-		glDrawRangeElementsARB(mode, offset, offset + length, length,
-		                       GL_UNSIGNED_SHORT, (const GLvoid *)(sizeof(vindex_t) * offset));
+		frame_stats.texture_changes++;
 	}
 }
 
-static void rend_set_active_material(shader_t *shader, texture_t *texture, texture_t *normal_map,
-                                     rview_t *view, rmesh_t *mesh, vertex_type_t vertex_type)
+static void rend_bind_buffers(const cmd_bind_buffers_t *command)
 {
-	if (shader == NULL || mesh == NULL) {
-		return;
+	// The vertex array stays bound for the draws following the command.
+	if (rend_bind_vertex_data(command->vertices, command->indices,
+	                          (vertex_type_t)command->vertex_type)) {
+
+		frame_stats.buffer_changes++;
 	}
-	
-	// Select the active shader.
-	GLuint shader_id = shader->program;
+}
 
-	if (shader_id != active_shader) {
+static void rend_set_uniform(const cmd_set_uniform_t *command)
+{
+	switch (command->type) {
 
-		glUseProgram(shader_id);
-		active_shader = shader_id;
-	}
+		case UNIFORM_TYPE_INT:
+			glUniform1i(command->location, command->value.i);
+			break;
+
+		case UNIFORM_TYPE_FLOAT:
+			glUniform1f(command->location, command->value.f);
+			break;
+
+		case UNIFORM_TYPE_VECTOR4:
+		case UNIFORM_TYPE_COLOUR:
+			glUniform4fv(command->location, 1, &command->value.vec.x);
+			break;
 
-	// Update custom uniforms.
-	if (shader->has_updated_uniforms) {
-		rend_update_material_uniforms(shader);
+		default:
+			return;
 	}
 
-	// Select the active texture.
-	GLuint texture_id = (texture != NULL ? texture->gpu_texture : 0);
+	glstate_count_calls(1);
+	frame_stats.uniform_calls++;
+}
 
-	if (texture_id != 0 &&
-		texture_id != active_texture) {
+static void rend_draw(const cmd_draw_t *command)
+{
+	frame_stats.draw_calls++;
 
-		glActiveTexture(GL_TEXTURE0);
-		glBindTexture(GL_TEXTURE_2D, texture_id);
+	GLenum mode = (command->primitive == CMD_PRIMITIVE_LINES ? GL_LINES : GL_TRIANGLES);
+
+	glDrawElements(mode, command->num_indices, GL_UNSIGNED_SHORT,
+	               (const GLvoid *)(sizeof(vindex_t) * command->first_index));
+
+	glstate_count_calls(1);
+}
+
+static void rend_draw_instanced(const cmd_draw_instanced_t *command)
+{
+	GLenum mode = (command->primitive == CMD_PRIMITIVE_LINES ? GL_LINES : GL_TRIANGLES);
+	const GLvoid *indices = (const GLvoid *)(sizeof(vindex_t) * command->first_index);
+
+	if (is_instancing_supported) {
+
+		// The matrices were uploaded in the same order as the commands are replayed, so each draw
+		// only points the instance attributes to the next part of the instance buffer.
+		rend_set_instance_attributes(next_instance_offset);
+		next_instance_offset += command->num_instances * sizeof(mat_t);
+
+		glDrawElementsInstanced(mode, command->num_indices, GL_UNSIGNED_SHORT, indices,
+		                        command->num_instances);
 
-		active_texture = texture_id;
+		glstate_count_calls(1);
+		frame_stats.draw_calls++;
 	}
+	else {
+
+		// Without instanced arrays the model matrix of each instance is passed as a constant
+		// attribute value and every instance is drawn separately.
+		const mat_t *models = cmdbuf_get_instances(command);
 
-	// Select normal map.
-	GLuint normal_map_id = (normal_map != NULL ? normal_map->gpu_texture : 0);
+		for (uint32_t i = 0; i < command->num_instances; i++) {
+
+			for (int column = 0; column < 4; column++) {
+				glVertexAttrib4fv(ATTR_INSTANCE_MODEL + column, models[i].col[column]);
+			}
 
-	if (normal_map_id != 0 &&
-		normal_map_id != active_normal_map) {
+			glDrawElements(mode, command->num_indices, GL_UNSIGNED_SHORT, indices);
+		}
 
-		glActiveTexture(GL_TEXTURE1);
-		glBindTexture(GL_TEXTURE_2D, normal_map_id);
-		active_normal_map = normal_map_id;
+		glstate_count_calls(5 * command->num_instances);
+		frame_stats.draw_calls += command->num_instances;
 	}
+}
+
+static bool rend_bind_vertex_data(GLuint vertex_buffer, GLuint index_buffer,
+                                  vertex_type_t vertex_type)
+{
+	bool is_new;
+	GLuint vertex_array = glstate_get_vertex_array(vertex_buffer, index_buffer, vertex_type, &is_new);
 
-	// Disable vertex attributes to avoid using them when there is no such data available.
-	for (int i = 0; i < NUM_SHADER_ATTRIBUTES; i++) {
-		glDisableVertexAttribArray(i);
+	// The attribute layout is stored in the vertex array object, so it only has to be set once.
+	if (is_new) {
+		rend_set_vertex_attributes(vertex_type);
 	}
 
-	// Disable depth write for particles.
-	glDepthMask(vertex_type != VERTEX_PARTICLE);
+	// A new vertex array has been bound when it was created.
+	return glstate_bind_vertex_array(vertex_array) || is_new;
+}
 
-	// Set pointers to vertex attributes.
+static void rend_set_vertex_attributes(vertex_type_t vertex_type)
+{
+	// Vertex attributes are bound to the same location in every shader program, so the layout
+	// doesn't depend on the shader.
 	switch (vertex_type) {
 
 	// Normal vertex attributes.
 	case VERTEX_NORMAL:
 
-		rend_bind_shader_attribute(shader, ATTR_VERTEX, 3, GL_FLOAT, GL_FALSE,
-                                   sizeof(vertex_t), (void *)offsetof(vertex_t, pos));
+		rend_set_vertex_attribute(ATTR_VERTEX, 3, GL_FLOAT, GL_FALSE,
+		                          sizeof(vertex_t), (void *)offsetof(vertex_t, pos));
+
+		rend_set_vertex_attribute(ATTR_NORMAL, 3, GL_FLOAT, GL_FALSE,
+		                          sizeof(vertex_t), (void *)offsetof(vertex_t, normal));
 
-		rend_bind_shader_attribute(shader, ATTR_NORMAL, 3, GL_FLOAT, GL_FALSE,
-                                   sizeof(vertex_t), (void *)offsetof(vertex_t, normal));
+		rend_set_vertex_attribute(ATTR_TANGENT, 3, GL_FLOAT, GL_FALSE,
+		                          sizeof(vertex_t), (void *)offsetof(vertex_t, tangent));
 
-		rend_bind_shader_attribute(shader, ATTR_TANGENT, 3, GL_FLOAT, GL_FALSE,
-                                   sizeof(vertex_t), (void *)offsetof(vertex_t, tangent));
+		rend_set_vertex_attribute(ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+		                          sizeof(vertex_t), (void *)offsetof(vertex_t, uv));
 
-		rend_bind_shader_attribute(shader, ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
-                                   sizeof(vertex_t), (void *)offsetof(vertex_t, uv));
+		// Instanced draws read the model matrix from the instance buffer, one matrix per instance.
+		// The attributes are only used by the instanced variants of shaders.
+		if (is_instancing_supported) {
+
+			for (int column = 0; column < 4; column++) {
+				glVertexAttribDivisor(ATTR_INSTANCE_MODEL + column, 1);
+			}
+
+			rend_set_instance_attributes(0);
+			glstate_count_calls(4);
+		}
 
 		break;
 
 	// Debug vertex attributes.
 	case VERTEX_DEBUG:
 
-		rend_bind_shader_attribute(shader, ATTR_VERTEX, 3, GL_FLOAT, GL_FALSE,
-		                           sizeof(vertex_debug_t), (void *)offsetof(vertex_debug_t, pos));
+		rend_set_vertex_attribute(ATTR_VERTEX, 3, GL_FLOAT, GL_FALSE,
+		                          sizeof(vertex_debug_t), (void *)offsetof(vertex_debug_t, pos));
 
-		rend_bind_shader_attribute(shader, ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
-		                           sizeof(vertex_debug_t), (void *)offsetof(vertex_debug_t, colour));
+		rend_set_vertex_attribute(ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+		                          sizeof(vertex_debug_t), (void *)offsetof(vertex_debug_t, colour));
 
 		break;
 
 	// Bind vertex attributes.
 	case VERTEX_UI:
 
-		rend_bind_shader_attribute(shader, ATTR_VERTEX, 2, GL_FLOAT, GL_FALSE,
-	                               sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, pos));
+		rend_set_vertex_attribute(ATTR_VERTEX, 2, GL_FLOAT, GL_FALSE,
+		                          sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, pos));
 
-		rend_bind_shader_attribute(shader, ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
-	                               sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, uv));
+		rend_set_vertex_attribute(ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+		                          sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, uv));
 
-		rend_bind_shader_attribute(shader, ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
-	                               sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, colour));
+		rend_set_vertex_attribute(ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+		                          sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, colour));
 
 		break;
 	
 	// Particle vertex attributes.
 	case VERTEX_PARTICLE:
 		
-		rend_bind_shader_attribute(shader, ATTR_VERTEX, 3, GL_FLOAT, GL_FALSE,
+		rend_set_vertex_attribute(ATTR_VERTEX, 3, GL_FLOAT, GL_FALSE,
                         sizeof(vertex_particle_t), (void *)offsetof(vertex_particle_t, pos));
 
-		rend_bind_shader_attribute(shader, ATTR_CENTRE, 3, GL_FLOAT, GL_FALSE,
+		rend_set_vertex_attribute(ATTR_CENTRE, 3, GL_FLOAT, GL_FALSE,
                         sizeof(vertex_particle_t), (void *)offsetof(vertex_particle_t, centre));
 
-		rend_bind_shader_attribute(shader, ATTR_EMIT_POSITION, 4, GL_FLOAT, GL_FALSE,
+		rend_set_vertex_attribute(ATTR_EMIT_POSITION, 4, GL_FLOAT, GL_FALSE,
                         sizeof(vertex_particle_t), (void *)offsetof(vertex_particle_t, emit_position));
 
-		rend_bind_shader_attribute(shader, ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
+		rend_set_vertex_attribute(ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
                         sizeof(vertex_particle_t), (void *)offsetof(vertex_particle_t, uv));
 
-		rend_bind_shader_attribute(shader, ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
+		rend_set_vertex_attribute(ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
                         sizeof(vertex_particle_t), (void *)offsetof(vertex_particle_t, colour));
 
-		rend_bind_shader_attribute(shader, ATTR_ROTATION, 1, GL_FLOAT, GL_FALSE,
+		rend_set_vertex_attribute(ATTR_ROTATION, 1, GL_FLOAT, GL_FALSE,
                         sizeof(vertex_particle_t), (void *)offsetof(vertex_particle_t, rotation));
 
-		rend_bind_shader_attribute(shader, ATTR_SIZE, 1, GL_FLOAT, GL_FALSE,
+		rend_set_vertex_attribute(ATTR_SIZE, 1, GL_FLOAT, GL_FALSE,
                         sizeof(vertex_particle_t), (void *)offsetof(vertex_particle_t, size));
 
 		break;
 	}
+}
 
-	// Set per-draw shader uniforms.
-	// TODO: See if this can be optimized by setting per-view matrices separately.
-	rend_update_uniforms(mesh->parent, view, false);
-
-	// Copy lighting info.
-	if (shader_is_affected_by_light(shader)) {
-
-		num_mesh_lights = mesh->num_lights;
-
-		for (uint32_t i = 0; i < mesh->num_lights; i++) {
-			mat_cpy(&light_array[i], &mesh->lights[i]->shader_params);
-		}
-	}
+static void rend_set_vertex_attribute(int attr_type, GLint size, GLenum type, GLboolean normalized,
+                                      GLsizei stride, const GLvoid *pointer)
+{
+	glEnableVertexAttribArray(attr_type);
+	glVertexAttribPointer(attr_type, size, type, normalized, stride, pointer);
 
-	// Commit uniforms to shader program.
-	rend_commit_uniforms(shader);
+	glstate_count_calls(2);
 }
 
-static bool rend_bind_shader_attribute(shader_t *shader, int attr_type, GLint size, GLenum type,
-                                       GLboolean normalized, GLsizei stride, const GLvoid *pointer)
+static void rend_set_instance_attributes(size_t offset)
 {
-	if (!shader_uses_attribute(shader, attr_type)) {
-		return false;
-	}
-
-	int attribute = shader_get_attribute(shader, attr_type);
+	// Each matrix takes four attribute locations, one for each column.
+	glstate_bind_array_buffer(instance_buffer);
 
-	glEnableVertexAttribArray(attribute);
-	glVertexAttribPointer(attribute, size, type, normalized, stride, pointer);
+	for (int column = 0; column < 4; column++) {
 
-	return true;
+		rend_set_vertex_attribute(ATTR_INSTANCE_MODEL + column, 4, GL_FLOAT, GL_FALSE,
+		                          sizeof(mat_t), (void *)(offset + column * sizeof(vec4_t)));
+	}
 }
 
-vbindex_t rend_generate_buffer(void)
+static vbindex_t rend_gl_generate_buffer(void)
 {
 	GLuint vbo;
 
@@ -667,33 +993,46 @@ vbindex_t rend_generate_buffer(void)
 	return vbo;
 }
 
-void rend_destroy_buffer(vbindex_t vbo)
+static void rend_gl_destroy_buffer(vbindex_t vbo)
 {
 	if (vbo != 0) {
+
+		glstate_delete_vertex_arrays(vbo);
 		glDeleteBuffersARB(1, &vbo);
 	}
 }
 
-void rend_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index, bool is_static)
+static void rend_gl_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index,
+                                       bool is_static)
 {
 	GLenum target = (is_index ? GL_ELEMENT_ARRAY_BUFFER_ARB : GL_ARRAY_BUFFER_ARB);
 	GLenum usage = (is_static ? GL_STATIC_DRAW_ARB : GL_DYNAMIC_DRAW_ARB);
 
-	glBindBufferARB(target, vbo);
+	rend_bind_buffer_for_upload(vbo, is_index);
 	glBufferDataARB(target, size, data, usage);
 }
 
-void rend_update_buffer_subdata(vbindex_t vbo, const void *data, size_t offset, size_t size,
-	                            bool is_index)
+static void rend_gl_update_buffer_subdata(vbindex_t vbo, const void *data, size_t offset,
+                                          size_t size, bool is_index)
 {
 	GLenum target = (is_index ? GL_ELEMENT_ARRAY_BUFFER_ARB : GL_ARRAY_BUFFER_ARB);
 
-	glBindBufferARB(target, vbo);
+	rend_bind_buffer_for_upload(vbo, is_index);
 	glBufferSubDataARB(target, offset, size, data);
 }
 
-shader_object_t rend_create_shader(SHADER_TYPE type, const char **lines, size_t num_lines,
-								   const char **compiler_log)
+static void rend_bind_buffer_for_upload(vbindex_t vbo, bool is_index)
+{
+	if (is_index) {
+		glstate_bind_index_buffer(vbo);
+	}
+	else {
+		glstate_bind_array_buffer(vbo);
+	}
+}
+
+static shader_object_t rend_gl_create_shader(SHADER_TYPE type, const char **lines,
+                                             size_t num_lines, const char **compiler_log)
 {
 	GLenum shader_type;
 	const char *shader_type_name;
@@ -713,14 +1052,7 @@ shader_object_t rend_create_shader(SHADER_TYPE type, const char **lines, size_t
 
 	// Set the type of the shader and prepend GLSL version and some defines to the source.
 	char defines[1000];
-	int n = 0;
-
-	n += snprintf(&defines[n], sizeof(defines) - n, "#version %s\n", "130");
-	n += snprintf(&defines[n], sizeof(defines) - n, "#define %s\n", shader_type_name);
-
-	if (is_using_deferred_lighting) {
-		n += snprintf(&defines[n], sizeof(defines) - n, "#define DEFERRED_LIGHTING\n");
-	}
+	rend_gl_get_shader_defines(shader_type_name, defines, sizeof(defines));
 
 	// Create a shader object.
 	GLuint shader = glCreateShader(shader_type);
@@ -759,7 +1091,45 @@ shader_object_t rend_create_shader(SHADER_TYPE type, const char **lines, size_t
 	return shader;
 }
 
-shader_program_t rend_create_shader_program(shader_object_t *shaders, size_t num_shaders)
+static void rend_gl_get_shader_defines(const char *shader_type_name, char *defines, size_t size)
+{
+	int n = 0;
+
+	n += snprintf(&defines[n], size - n, "#version %s\n", "130");
+	n += snprintf(&defines[n], size - n, "#extension GL_ARB_uniform_buffer_object : require\n");
+	n += snprintf(&defines[n], size - n, "#define %s\n", shader_type_name);
+
+	if (is_using_deferred_lighting) {
+		n += snprintf(&defines[n], size - n, "#define DEFERRED_LIGHTING\n");
+	}
+}
+
+static uint64_t rend_gl_get_program_key(const char **lines, size_t num_lines)
+{
+	// The key covers the source of both stages exactly as the driver sees it.
+	static const char *shader_type_names[] = { "VERTEX_SHADER", "FRAGMENT_SHADER" };
+
+	uint64_t key = progcache_get_device_key();
+	char defines[1000];
+
+	for (size_t i = 0; i < LENGTH(shader_type_names); ++i) {
+
+		rend_gl_get_shader_defines(shader_type_names[i], defines, sizeof(defines));
+		key = progcache_hash(key, defines, strlen(defines));
+	}
+
+	// The first line is reserved for the defines.
+	for (size_t i = 1; i < num_lines; ++i) {
+
+		if (lines[i] != NULL) {
+			key = progcache_hash(key, lines[i], strlen(lines[i]));
+		}
+	}
+
+	return key;
+}
+
+static shader_program_t rend_gl_create_shader_program(shader_object_t *shaders, size_t num_shaders)
 {
 	if (shaders == NULL || num_shaders == 0) {
 		return 0;
@@ -773,26 +1143,56 @@ shader_program_t rend_create_shader_program(shader_object_t *shaders, size_t num
 		glAttachShader(program, shaders[i]);
 	}
 
+	// Use the same location for each vertex attribute in every program, so vertex array objects
+	// can be shared between programs.
+	for (int i = 0; i < NUM_SHADER_ATTRIBUTES; ++i) {
+		glBindAttribLocation(program, i, shader_get_attribute_name(i));
+	}
+
+	// Tell the driver the binary of the program will be retrieved for the program cache.
+	if (progcache_is_enabled()) {
+		glProgramParameteri(program, GL_PROGRAM_BINARY_RETRIEVABLE_HINT, GL_TRUE);
+	}
+
 	glLinkProgram(program);
 
 	return program;
 }
 
-void rend_destroy_shader(shader_object_t shader)
+static shader_program_t rend_gl_load_program_binary(const char **lines, size_t num_lines)
+{
+	if (!progcache_is_enabled() || lines == NULL || num_lines == 0) {
+		return 0;
+	}
+
+	return progcache_load(rend_gl_get_program_key(lines, num_lines));
+}
+
+static void rend_gl_save_program_binary(shader_program_t program, const char **lines,
+                                        size_t num_lines)
+{
+	if (!progcache_is_enabled() || lines == NULL || num_lines == 0) {
+		return;
+	}
+
+	progcache_save(rend_gl_get_program_key(lines, num_lines), program);
+}
+
+static void rend_gl_destroy_shader(shader_object_t shader)
 {
 	if (shader != 0) {
 		glDeleteShader(shader);
 	}
 }
 
-void rend_destroy_shader_program(shader_program_t program)
+static void rend_gl_destroy_shader_program(shader_program_t program)
 {
 	if (program != 0) {
 		glDeleteProgram(program);
 	}
 }
 
-int rend_get_program_uniform_location(shader_program_t program, const char *name)
+static int rend_gl_get_program_uniform_location(shader_program_t program, const char *name)
 {
 	if (program != 0) {
 		return glGetUniformLocation(program, name);
@@ -801,7 +1201,56 @@ int rend_get_program_uniform_location(shader_program_t program, const char *name
 	return -1;
 }
 
-int rend_get_program_program_attribute_location(shader_program_t program, const char *name)
+static bool rend_gl_bind_program_uniform_block(shader_program_t program, const char *name,
+                                               uint32_t binding)
+{
+	if (program == 0) {
+		return false;
+	}
+
+	GLuint index = glGetUniformBlockIndex(program, name);
+
+	if (index == GL_INVALID_INDEX) {
+		return false;
+	}
+
+	glUniformBlockBinding(program, index, binding);
+	return true;
+}
+
+static void rend_gl_bind_program_samplers(shader_t *shader)
+{
+	// Sampler uniforms are a part of the program's state and every sampler always reads the same
+	// texture unit, so they only have to be set once.
+	static const int sampler_units[NUM_SAMPLER_UNIFORMS] = {
+		UNIFORM_SAMPLER_MAIN,
+		UNIFORM_SAMPLER_NORMAL,
+		UNIFORM_SAMPLER_DEPTH,
+		UNIFORM_SAMPLER_DIFFUSE,
+		UNIFORM_SAMPLER_SPECULAR
+	};
+
+	if (shader == NULL || shader->program == 0) {
+		return;
+	}
+
+	glstate_use_program(shader->program);
+
+	if (shader->sampler_array >= 0) {
+		glUniform1iv(shader->sampler_array, NUM_SAMPLER_UNIFORMS, sampler_units);
+	}
+	if (shader->light_grid >= 0) {
+		glUniform1i(shader->light_grid, LIGHT_GRID_TEXTURE_UNIT);
+	}
+	if (shader->light_indices >= 0) {
+		glUniform1i(shader->light_indices, LIGHT_INDEX_TEXTURE_UNIT);
+	}
+	if (shader->light_data >= 0) {
+		glUniform1i(shader->light_data, LIGHT_DATA_TEXTURE_UNIT);
+	}
+}
+
+static int rend_gl_get_program_attribute_location(shader_program_t program, const char *name)
 {
 	if (program != 0) {
 		return glGetAttribLocation(program, name);
@@ -810,7 +1259,7 @@ int rend_get_program_program_attribute_location(shader_program_t program, const
 	return -1;
 }
 
-const char *rend_get_default_shader_source(default_shader_t shader)
+static const char *rend_gl_get_default_shader_source(default_shader_t shader)
 {
 	switch (shader) {
 
@@ -833,8 +1282,8 @@ const char *rend_get_splash_shader_source(void)
 	return splash_shader_source;
 }
 
-texture_name_t rend_generate_texture(void *image, size_t width, size_t height,
-                                     TEX_FORMAT fmt, TEX_FILTER filter)
+static texture_name_t rend_gl_generate_texture(void *image, size_t width, size_t height,
+                                               TEX_FORMAT fmt, TEX_FILTER filter)
 {
 	// Generate a texture name.
 	GLuint texture;
@@ -842,53 +1291,193 @@ texture_name_t rend_generate_texture(void *image, size_t width, size_t height,
 
 	// Upload the texture to the GPU.
 	glEnable(GL_TEXTURE_2D);
-	glBindTexture(GL_TEXTURE_2D, texture);
+	glstate_bind_texture(0, texture);
 
 	// Select a filter for interpolating the texture.
-	int filter_param = (filter == TEX_FILTER_POINT ? GL_NEAREST : GL_LINEAR);
+	uint32_t num_levels = rend_set_texture_filter(filter, mipmap_get_num_levels(width, height));
 
-	int internal_format;
-	int image_format;
+	GLint internal_format;
+	GLenum image_format;
+	size_t channels = rend_get_texture_format(fmt, &internal_format, &image_format);
 
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, filter_param);
-	glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, filter_param);
+	// Rows of the smaller levels are not aligned to 4 bytes.
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
 
-	switch (fmt) {
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0,
+	             image_format, GL_UNSIGNED_BYTE, image);
 
-		case TEX_FORMAT_GRAYSCALE:
+	// Generate the rest of the mip chain on the CPU. Colour textures are filtered in linear space,
+	// grayscale textures are used as data.
+	uint8_t *chain = mipmap_generate(image, width, height, channels,
+	                                 (fmt != TEX_FORMAT_GRAYSCALE), num_levels);
 
-			// Convert grayscale textures into 4-channel texture where the only colour is red.
-			internal_format = GL_RED;
-			image_format = GL_RED;
-			break;
+	if (chain != NULL) {
 
-		case TEX_FORMAT_RGB:
+		const uint8_t *level_data = chain;
 
-			// Assume 24bit RGB texture by default.
-			internal_format = GL_RGBA;
-			image_format = GL_RGB;
-			break;
+		for (uint32_t level = 1; level < num_levels; level++) {
 
-		default:
+			size_t level_width, level_height;
+			mipmap_get_level_size(width, height, level, &level_width, &level_height);
 
-			// Assume 32bit RGBA texture by default.
-			internal_format = GL_RGBA;
-			image_format = GL_RGBA;
-			break;
+			glTexImage2D(GL_TEXTURE_2D, level, internal_format, level_width, level_height, 0,
+			             image_format, GL_UNSIGNED_BYTE, level_data);
+
+			level_data += level_width * level_height * channels;
+		}
+
+		mem_free(chain);
 	}
 
-	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0,
-	             image_format, GL_UNSIGNED_BYTE, image);
+	return texture;
+}
+
+static texture_name_t rend_gl_generate_compressed_texture(const void *data, size_t width,
+                                                          size_t height, uint32_t num_levels,
+                                                          TEX_FORMAT fmt, TEX_FILTER filter)
+{
+	GLenum internal_format;
+
+	if (!rend_get_compressed_format(fmt, &internal_format)) {
+
+		// The driver can't sample the format, so decode the largest level and upload it
+		// uncompressed. The rest of the mip chain is regenerated from it.
+		size_t channels = texcomp_get_channels(fmt);
+		uint8_t *image = mem_alloc_fast(width * height * MAX(channels, 3));
+
+		texcomp_decode(data, width, height, fmt, image);
+
+		// There is no uncompressed two-channel format, so two-channel images are expanded to RGB.
+		if (channels == 2) {
+
+			for (size_t i = width * height; i-- > 0;) {
+
+				image[3 * i + 2] = 0;
+				image[3 * i + 1] = image[2 * i + 1];
+				image[3 * i + 0] = image[2 * i + 0];
+			}
+		}
+
+		TEX_FORMAT image_format = (channels == 1 ? TEX_FORMAT_GRAYSCALE :
+		                           channels == 4 ? TEX_FORMAT_RGBA : TEX_FORMAT_RGB);
+
+		texture_name_t texture =
+			rend_gl_generate_texture(image, width, height, image_format, filter);
+
+		mem_free(image);
+		return texture;
+	}
+
+	GLuint texture;
+	glGenTextures(1, &texture);
+
+	glEnable(GL_TEXTURE_2D);
+	glstate_bind_texture(0, texture);
+
+	// Only the levels stored in the data can be sampled.
+	num_levels = rend_set_texture_filter(filter, num_levels);
+
+	const uint8_t *level_data = data;
+
+	for (uint32_t level = 0; level < num_levels; level++) {
+
+		size_t level_width, level_height;
+		mipmap_get_level_size(width, height, level, &level_width, &level_height);
+
+		size_t size = texcomp_get_size(fmt, level_width, level_height);
+
+		glCompressedTexImage2D(GL_TEXTURE_2D, level, internal_format, level_width, level_height,
+		                       0, size, level_data);
+
+		level_data += size;
+	}
 
 	return texture;
 }
 
-void rend_delete_texture(texture_name_t texture)
+static void rend_gl_delete_texture(texture_name_t texture)
 {
 	glDeleteTextures(1, &texture);
 }
 
-void rend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background)
+static void rend_gl_upload_texture(texture_upload_t *upload)
+{
+	texupload_queue(upload);
+}
+
+static bool rend_gl_is_texture_upload_complete(texture_upload_t *upload)
+{
+	return texupload_is_complete(upload);
+}
+
+static GLuint rend_create_uploaded_texture(texture_upload_t *upload, const void *image,
+                                           const void *mip_chain)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+
+	glEnable(GL_TEXTURE_2D);
+	glstate_bind_texture(0, texture);
+
+	// Only the levels generated by the loader can be specified.
+	uint32_t num_levels = (upload->mip_chain != NULL ? upload->num_levels : 1);
+	num_levels = rend_set_texture_filter(upload->filter, num_levels);
+
+	GLint internal_format;
+	GLenum image_format;
+	size_t channels = rend_get_texture_format(upload->format, &internal_format, &image_format);
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, upload->width, upload->height, 0,
+	             image_format, GL_UNSIGNED_BYTE, image);
+
+	// The mip chain may be an offset into a pixel buffer rather than a valid pointer, so the
+	// address of each level is calculated as an integer.
+	uintptr_t level_data = (uintptr_t)mip_chain;
+
+	for (uint32_t level = 1; level < num_levels; level++) {
+
+		size_t level_width, level_height;
+		mipmap_get_level_size(upload->width, upload->height, level, &level_width, &level_height);
+
+		glTexImage2D(GL_TEXTURE_2D, level, internal_format, level_width, level_height, 0,
+		             image_format, GL_UNSIGNED_BYTE, (const void *)level_data);
+
+		level_data += level_width * level_height * channels;
+	}
+
+	return texture;
+}
+
+static size_t rend_get_texture_format(TEX_FORMAT fmt, GLint *internal_format, GLenum *image_format)
+{
+	switch (fmt) {
+
+		case TEX_FORMAT_GRAYSCALE:
+
+			// Convert grayscale textures into 4-channel texture where the only colour is red.
+			*internal_format = GL_RED;
+			*image_format = GL_RED;
+			return 1;
+
+		case TEX_FORMAT_RGB:
+
+			// Assume 24bit RGB texture by default.
+			*internal_format = GL_RGBA;
+			*image_format = GL_RGB;
+			return 3;
+
+		default:
+
+			// Assume 32bit RGBA texture by default.
+			*internal_format = GL_RGBA;
+			*image_format = GL_RGBA;
+			return 4;
+	}
+}
+
+static void rend_gl_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background)
 {
 	vec4_t colour = col_to_vec4(background);
 
@@ -924,6 +1513,9 @@ void rend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t back
 
 		glEnableClientState(GL_VERTEX_ARRAY);
 
+		// The splash screen is drawn without the state cache, using the default vertex array.
+		glBindVertexArray(0);
+
 		// Upload logo vertex data to the GPU.
 		glBindBufferARB(GL_ARRAY_BUFFER_ARB, splash_screen_vertices);
 		glBufferDataARB(GL_ARRAY_BUFFER_ARB, sizeof(vertices), vertices, GL_STATIC_DRAW_ARB);
@@ -941,9 +1533,17 @@ void rend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t back
 
 		if (shader != NULL) {
 
-			// Setup shader program uniforms and vertex attributes.
-			glUniform1i(glGetUniformLocation(shader->program, "Texture"), 0);
-			glUniform4fv(glGetUniformLocation(shader->program, "Colour"), 1, &colour.x);
+			// Setup shader program uniforms and vertex attributes. The splash screen is drawn every
+			// frame while loading, so the locations are only resolved when the program changes.
+			if (shader->program != splash_program) {
+
+				splash_program = shader->program;
+				splash_texture_location = glGetUniformLocation(splash_program, "Texture");
+				splash_colour_location = glGetUniformLocation(splash_program, "Colour");
+			}
+
+			glUniform1i(splash_texture_location, 0);
+			glUniform4fv(splash_colour_location, 1, &colour.x);
 
 			attr_vertex   = shader_get_attribute(shader, ATTR_VERTEX);
 			attr_texcoord = shader_get_attribute(shader, ATTR_TEXCOORD);
@@ -966,6 +1566,8 @@ void rend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t back
 		glDisableVertexAttribArray(attr_vertex);
 		glDisableVertexAttribArray(attr_texcoord);
 		glDisableClientState(GL_VERTEX_ARRAY);
+
+		glstate_invalidate();
 	}
 
 	// Swap buffers to draw immediately.
@@ -978,10 +1580,6 @@ void rend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t back
 
 static void rend_update_material_uniforms(shader_t *shader)
 {
-	if (!shader->has_updated_uniforms) {
-		return;
-	}
-
 	for (uint32_t i = 0; i < shader->material_uniforms.count; i++) {
 
 		shader_uniform_t *uniform = &shader->material_uniforms.items[i];
@@ -1006,86 +1604,297 @@ static void rend_update_material_uniforms(shader_t *shader)
 		}
 	}
 
-	shader->has_updated_uniforms = false;
+	glstate_count_calls(shader->material_uniforms.count);
+	frame_stats.uniform_calls += shader->material_uniforms.count;
 }
 
-static void rend_update_uniforms(robject_t *parent_obj, rview_t *view, bool is_effect)
+static void rend_clear_uniforms(void)
 {
-	if (parent_obj != NULL) {
-		matrix_array[UNIFORM_MAT_MVP] = parent_obj->mvp;
-		matrix_array[UNIFORM_MAT_MODEL] = parent_obj->matrix;
+	for (int i = 0; i < MAX_LIGHTS_PER_PASS; i++) {
+		light_array[i] = mat_identity();
 	}
 
-	matrix_array[UNIFORM_MAT_VIEW] = view->view;
-	matrix_array[UNIFORM_MAT_VIEW_INV] = view->view_inv;
-	matrix_array[UNIFORM_MAT_PROJECTION] = view->projection;
-	matrix_array[UNIFORM_MAT_PROJECTION_INV] = view->projection_inv;
-	matrix_array[UNIFORM_MAT_VIEWPROJ] = view->view_projection;
-	matrix_array[UNIFORM_MAT_VIEWPROJ_INV] = view->view_projection_inv;
+	num_pass_lights = 0;
+}
+
+static void rend_create_uniform_buffer(void)
+{
+	// Uniform buffer bindings must start at a multiple of the alignment required by the driver, so
+	// each block is padded to it.
+	GLint alignment;
+	glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
 
-	vector_array[UNIFORM_VEC_VIEW_POSITION] = view->view_position;
-	vector_array[UNIFORM_VEC_TIME] = get_shader_time();
-	vector_array[UNIFORM_VEC_COLOUR] = view->ambient_light;
+	uniform_alignment = (size_t)MAX(alignment, 16);
 
-	uint16_t width, height;
-	mylly_get_resolution(&width, &height);
-	vector_array[UNIFORM_VEC_SCREEN] = vec4(width, height, view->near_plane, view->far_plane);
+	frame_uniforms_size = rend_align_uniform_size(sizeof(frame_uniforms_t));
+	view_uniforms_size = rend_align_uniform_size(sizeof(view_uniforms_t));
+	object_uniforms_size = rend_align_uniform_size(sizeof(object_uniforms_t));
 
-	sampler_array[UNIFORM_SAMPLER_MAIN] = 0;
-	sampler_array[UNIFORM_SAMPLER_NORMAL] = 1;
-	sampler_array[UNIFORM_SAMPLER_DEPTH] = (is_effect ? 2 : 0);
-	sampler_array[UNIFORM_SAMPLER_DIFFUSE] = (is_effect ? 3 : 0);
-	sampler_array[UNIFORM_SAMPLER_SPECULAR] = (is_effect ? 4 : 0);
+	// The buffer's storage is allocated when the first frame is drawn.
+	glGenBuffersARB(1, &uniform_buffer);
+
+	uniform_buffer_capacity = 0;
+	uniform_buffer_frame = 0;
 }
 
-static void rend_commit_uniforms(shader_t *shader)
+static void rend_upload_uniforms(rview_t *first_view, const cmdbuf_t *commands)
 {
-	if (shader->matrix_array >= 0) {
-		glUniformMatrix4fv(shader->matrix_array, NUM_MAT_UNIFORMS, false, &matrix_array[0].col[0][0]);
+	list_t(rview_t) views;
+	list_init(views);
+
+	views.first = first_view;
+
+	rview_t *view;
+
+	// Calculate the size of the constants of this frame. The objects are either those of a single
+	// command buffer or those of all the views.
+	uint32_t num_views = 0;
+	uint32_t num_objects = (commands != NULL ? commands->num_objects : 0);
+
+	list_foreach(views, view) {
+
+		num_views++;
+
+		for (int queue = 0; queue < NUM_QUEUES && commands == NULL; queue++) {
+
+			if (view->commands[queue] != NULL) {
+				num_objects += view->commands[queue]->num_objects;
+			}
+		}
+	}
+
+	object_uniforms_offset = frame_uniforms_size + num_views * view_uniforms_size;
+	next_object_uniforms = 0;
+
+	size_t size = object_uniforms_offset + num_objects * object_uniforms_size;
+
+	if (size > uniform_data_capacity) {
+
+		if (uniform_data != NULL) {
+			mem_free(uniform_data);
+		}
+
+		uniform_data_capacity = 2 * size;
+		uniform_data = mem_alloc_fast(uniform_data_capacity);
 	}
-	if (shader->vector_array >= 0) {
-		glUniform4fv(shader->vector_array, NUM_VEC_UNIFORMS, &vector_array[0].vec[0]);
+
+	// Per-frame constants.
+	frame_uniforms_t *frame = (frame_uniforms_t *)uniform_data;
+	frame->time = get_shader_time();
+
+	// Per-view constants.
+	uint8_t *data = uniform_data + frame_uniforms_size;
+
+	list_foreach(views, view) {
+
+		rend_get_view_uniforms(view, (view_uniforms_t *)data);
+		data += view_uniforms_size;
 	}
-	if (shader->sampler_array >= 0) {
-		glUniform1iv(shader->sampler_array, NUM_SAMPLER_UNIFORMS, &sampler_array[0]);
+
+	// Per-object constants, in the same order the command buffers are replayed in.
+	if (commands != NULL) {
+		rend_write_object_uniforms(commands, data);
 	}
-	
-	if (shader_is_affected_by_light(shader)) {
-	
-		if (shader->light_array >= 0 && num_mesh_lights > 0) {
-			glUniformMatrix4fv(shader->light_array, num_mesh_lights, false, &light_array[0].col[0][0]);
+	else {
+
+		for (int queue = 0; queue < NUM_QUEUES; queue++) {
+			list_foreach(views, view) {
+				data = rend_write_object_uniforms(view->commands[queue], data);
+			}
 		}
-		if (shader->num_lights_position >= 0) {
-			glUniform1i(shader->num_lights_position, num_mesh_lights);
+	}
+
+	// Move on to the next part of the buffer. If the constants don't fit into it, reallocate the
+	// entire buffer. The old storage is orphaned, so the GPU can finish using it.
+	glBindBufferARB(GL_UNIFORM_BUFFER, uniform_buffer);
+
+	if (size > uniform_buffer_capacity) {
+
+		uniform_buffer_capacity = rend_align_uniform_size(2 * size);
+
+		glBufferDataARB(GL_UNIFORM_BUFFER, UNIFORM_BUFFER_FRAMES * uniform_buffer_capacity, NULL,
+		                GL_STREAM_DRAW_ARB);
+
+		glstate_count_calls(1);
+	}
+
+	uniform_buffer_frame = (uniform_buffer_frame + 1) % UNIFORM_BUFFER_FRAMES;
+	uniform_frame_offset = uniform_buffer_frame * uniform_buffer_capacity;
+
+	glBufferSubDataARB(GL_UNIFORM_BUFFER, uniform_frame_offset, size, uniform_data);
+
+	glstate_count_calls(2);
+	frame_stats.uniform_buffer_bytes += (uint32_t)size;
+
+	// Per-frame constants are bound for the entire frame.
+	glstate_bind_uniform_buffer(UNIFORM_BLOCK_FRAME, uniform_buffer, uniform_frame_offset,
+	                            sizeof(frame_uniforms_t));
+}
+
+static uint8_t *rend_write_object_uniforms(const cmdbuf_t *commands, uint8_t *data)
+{
+	if (commands == NULL || commands->num_objects == 0) {
+		return data;
+	}
+
+	const cmd_t *command;
+
+	cmdbuf_foreach(commands, command) {
+
+		if (command->type != CMD_SET_OBJECT) {
+			continue;
 		}
+
+		const cmd_set_object_t *set_object = (const cmd_set_object_t *)command;
+		object_uniforms_t *object = (object_uniforms_t *)data;
+
+		object->mvp = set_object->mvp;
+		object->model = set_object->model;
+
+		data += object_uniforms_size;
+	}
+
+	return data;
+}
+
+static void rend_get_view_uniforms(const rview_t *view, view_uniforms_t *uniforms)
+{
+	uniforms->view = view->view;
+	uniforms->view_inv = view->view_inv;
+	uniforms->projection = view->projection;
+	uniforms->projection_inv = view->projection_inv;
+	uniforms->view_projection = view->view_projection;
+	uniforms->view_projection_inv = view->view_projection_inv;
+
+	uniforms->view_position = view->view_position;
+	uniforms->ambient_light = view->ambient_light;
+
+	uint16_t width, height;
+	mylly_get_resolution(&width, &height);
+	uniforms->screen = vec4(width, height, view->near_plane, view->far_plane);
+
+	if (view->light_grid != NULL) {
+
+		uniforms->light_grid =
+			vec4(view->light_grid->depth_scale, view->light_grid->depth_bias, 0, 0);
+	}
+	else {
+		uniforms->light_grid = vec4_zero();
 	}
 }
 
-static void rend_clear_uniforms(void)
+static void rend_bind_view_uniforms(uint32_t view_index)
+{
+	size_t offset = uniform_frame_offset + frame_uniforms_size + view_index * view_uniforms_size;
+
+	glstate_bind_uniform_buffer(UNIFORM_BLOCK_VIEW, uniform_buffer, offset,
+	                            sizeof(view_uniforms_t));
+}
+
+static void rend_bind_object_uniforms(uint32_t object_index)
+{
+	size_t offset = uniform_frame_offset + object_uniforms_offset +
+	                object_index * object_uniforms_size;
+
+	glstate_bind_uniform_buffer(UNIFORM_BLOCK_OBJECT, uniform_buffer, offset,
+	                            sizeof(object_uniforms_t));
+}
+
+static size_t rend_align_uniform_size(size_t size)
+{
+	return (size + uniform_alignment - 1) / uniform_alignment * uniform_alignment;
+}
+
+static void rend_upload_instances(rview_t *first_view, const cmdbuf_t *commands)
 {
-	for (int i = 0; i < NUM_MAT_UNIFORMS; i++) {
-		matrix_array[i] = mat_identity();
+	list_t(rview_t) views;
+	list_init(views);
+
+	views.first = first_view;
+
+	rview_t *view;
+
+	// The instances are either those of a single command buffer or those of all the views.
+	uint32_t num_instances = (commands != NULL ? commands->num_instances : 0);
+
+	list_foreach(views, view) {
+		for (int queue = 0; queue < NUM_QUEUES && commands == NULL; queue++) {
+
+			if (view->commands[queue] != NULL) {
+				num_instances += view->commands[queue]->num_instances;
+			}
+		}
+	}
+
+	next_instance_offset = 0;
+
+	// Without instanced arrays the matrices are read straight from the commands.
+	if (num_instances == 0 || !is_instancing_supported) {
+		return;
 	}
 
-	for (int i = 0; i < NUM_VEC_UNIFORMS; i++) {
-		vector_array[i] = vec4_zero();
+	size_t size = num_instances * sizeof(mat_t);
+
+	if (size > instance_data_capacity) {
+
+		if (instance_data != NULL) {
+			mem_free(instance_data);
+		}
+
+		instance_data_capacity = 2 * size;
+		instance_data = mem_alloc_fast(instance_data_capacity);
 	}
 
-	for (int i = 0; i < NUM_SAMPLER_UNIFORMS; i++) {
-		sampler_array[i] = 0;
+	// Copy the matrices in the same order the command buffers are replayed in.
+	if (commands != NULL) {
+		rend_write_instances(commands, instance_data);
 	}
+	else {
 
-	for (int i = 0; i < MAX_LIGHTS_PER_MESH; i++) {
-		light_array[i] = mat_identity();
+		uint8_t *data = instance_data;
+
+		for (int queue = 0; queue < NUM_QUEUES; queue++) {
+			list_foreach(views, view) {
+				data = rend_write_instances(view->commands[queue], data);
+			}
+		}
+	}
+
+	// Orphan the previous contents of the buffer, so the GPU can finish using them while the
+	// matrices of this frame are uploaded.
+	glstate_bind_array_buffer(instance_buffer);
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB, size, instance_data, GL_STREAM_DRAW_ARB);
+
+	glstate_count_calls(1);
+}
+
+static uint8_t *rend_write_instances(const cmdbuf_t *commands, uint8_t *data)
+{
+	if (commands == NULL || commands->num_instances == 0) {
+		return data;
+	}
+
+	const cmd_t *command;
+
+	cmdbuf_foreach(commands, command) {
+
+		if (command->type != CMD_DRAW_INSTANCED) {
+			continue;
+		}
+
+		size_t size = ((const cmd_draw_instanced_t *)command)->num_instances * sizeof(mat_t);
+
+		memcpy(data, cmdbuf_get_instances(command), size);
+		data += size;
 	}
 
-	num_mesh_lights = 0;
+	return data;
 }
 
 static void rend_draw_post_processing_effects(rview_t *view, int source_fb_index)
 {
-	// Update relevant uniform arrays.
-	rend_update_uniforms(NULL, view, true);
+	// Effects are applied to the first view, whose constants are stored first.
+	rend_bind_view_uniforms(0);
 
 	// Apply each post processing effect in order.
 	for (uint32_t i = 0, c = view->post_processing_effects.count; i < c; i++) {
@@ -1110,10 +1919,22 @@ static void rend_draw_post_processing_effects(rview_t *view, int source_fb_index
 
 static void rend_draw_framebuffer_with_shader(int source_fb_index, shader_t *shader,
                                               bool override_buffer)
+{
+	rend_begin_framebuffer_pass(source_fb_index, shader, override_buffer);
+
+	// Post-processing shaders use the UI vertex format.
+	rend_bind_vertex_data(screen_vertices, screen_indices, VERTEX_UI);
+
+	// Draw the framebuffer's contents into a screen sized quad.
+	glstate_count_calls(1);
+	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT, 0);
+}
+
+static void rend_begin_framebuffer_pass(int source_fb_index, shader_t *shader,
+                                        bool override_buffer)
 {
 	// Switch to the post-processing shader.
-	glUseProgram(shader->program);
-	active_shader = shader->program;
+	glstate_use_program(shader->program);
 
 	// Select the framebuffer textures. Normal and depth textures are fetched from the geometry pass
 	// framebuffer.
@@ -1122,99 +1943,125 @@ static void rend_draw_framebuffer_with_shader(int source_fb_index, shader_t *sha
 
 	// Colour texture. The colour texture can be overriden with other G-buffer components for
 	// debugging purposes.
-	glActiveTexture(GL_TEXTURE0);
-
 	if (!override_buffer) {
-
-		glBindTexture(GL_TEXTURE_2D, source_buffer->colour);
-		active_texture = source_buffer->colour;
+		glstate_bind_texture(0, source_buffer->colour);
 	}
 	else {
 
 		switch (override_gbuffer_component) {
 
 			case GBUFFER_NORMAL:
-				glBindTexture(GL_TEXTURE_2D, geometry_buffer->normal);
-				active_texture = geometry_buffer->normal;
+				glstate_bind_texture(0, geometry_buffer->normal);
 				break;
 
 			case GBUFFER_DEPTH:
-				glBindTexture(GL_TEXTURE_2D, geometry_buffer->depth);
-				active_texture = geometry_buffer->depth;
+				glstate_bind_texture(0, geometry_buffer->depth);
 				break;
 
 			case GBUFFER_SPECULAR:
 			case GBUFFER_SHININESS:
-				glBindTexture(GL_TEXTURE_2D, geometry_buffer->specular);
-				active_texture = geometry_buffer->specular;
+				glstate_bind_texture(0, geometry_buffer->specular);
 				break;
 
 			default:
-				glBindTexture(GL_TEXTURE_2D, geometry_buffer->colour);
-				active_texture = geometry_buffer->colour;
+				glstate_bind_texture(0, geometry_buffer->colour);
 				break;
 		}
 	}
 
 	// Normal texture
-	glActiveTexture(GL_TEXTURE1);
-	glBindTexture(GL_TEXTURE_2D, geometry_buffer->normal);
-	active_normal_map = geometry_buffer->normal;
+	glstate_bind_texture(1, geometry_buffer->normal);
 
 	// Depth texture
-	glActiveTexture(GL_TEXTURE2);
-	glBindTexture(GL_TEXTURE_2D, geometry_buffer->depth);
+	glstate_bind_texture(2, geometry_buffer->depth);
 
 	// Diffuse texture
-	glActiveTexture(GL_TEXTURE3);
-	glBindTexture(GL_TEXTURE_2D, geometry_buffer->colour);
+	glstate_bind_texture(3, geometry_buffer->colour);
 
 	// Specular texture
-	glActiveTexture(GL_TEXTURE4);
-	glBindTexture(GL_TEXTURE_2D, geometry_buffer->specular);
+	glstate_bind_texture(4, geometry_buffer->specular);
+
+	// Update custom uniforms. Passes are only drawn a few times per frame, so their uniforms are
+	// set every time instead of tracking changes. This way the shader is only read while drawing,
+	// which is required when drawing on a render thread.
+	rend_update_material_uniforms(shader);
+
+	// The lights of a deferred lighting pass change for every batch, so they are passed as
+	// ordinary uniforms.
+	uint32_t calls = 0;
 
-	// Update custom uniforms.
-	if (shader->has_updated_uniforms) {
-		rend_update_material_uniforms(shader);
+	if (shader->light_array >= 0 && num_pass_lights > 0) {
+		glUniformMatrix4fv(shader->light_array, num_pass_lights, false, &light_array[0].col[0][0]);
+		calls++;
 	}
+	if (shader->num_lights_position >= 0) {
+		glUniform1i(shader->num_lights_position, num_pass_lights);
+		calls++;
+	}
+
+	glstate_count_calls(calls);
+	frame_stats.uniform_calls += calls;
+}
 
-	// Disable all vertex attributes.
-	for (int i = 0; i < NUM_SHADER_ATTRIBUTES; i++) {
-		glDisableVertexAttribArray(i);
+static void rend_draw_light_batch(rview_t *view, uint32_t first_light, uint32_t num_lights)
+{
+	// Copy the parameters of the lights in this batch to the light array.
+	for (uint32_t i = 0; i < num_lights; i++) {
+		mat_cpy(&light_array[i], &view->lights[first_light + i]->shader_params);
 	}
 
-	// Bind vertex buffers.
-	glBindBufferARB(GL_ARRAY_BUFFER_ARB, screen_vertices);
-	glBindBufferARB(GL_ELEMENT_ARRAY_BUFFER_ARB, screen_indices);
-	
-	// Bind vertex attributes. Post-processing shaders use the UI vertex format.
-	rend_bind_shader_attribute(shader, ATTR_VERTEX, 2, GL_FLOAT, GL_FALSE,
-	                           sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, pos));
+	num_pass_lights = (int)num_lights;
 
-	rend_bind_shader_attribute(shader, ATTR_TEXCOORD, 2, GL_FLOAT, GL_FALSE,
-	                           sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, uv));
+	rend_begin_framebuffer_pass(FB_GEOMETRY, light_shader, false);
 
-	rend_bind_shader_attribute(shader, ATTR_COLOUR, 4, GL_UNSIGNED_BYTE, GL_TRUE,
-	                           sizeof(vertex_ui_t), (void *)offsetof(vertex_ui_t, colour));
+	// Create a quad covering the screen space area of each light. The index of the light in the
+	// light array is passed to the shader in the red channel of the vertex colour.
+	vertex_ui_t vertices[4 * MAX_LIGHTS_PER_PASS];
 
-	// Apply relevant uniform arrays.
-	if (shader->vector_array >= 0) {
-		glUniform4fv(shader->vector_array, NUM_VEC_UNIFORMS, &vector_array[0].vec[0]);
-	}
-	if (shader->sampler_array >= 0) {
-		glUniform1iv(shader->sampler_array, NUM_SAMPLER_UNIFORMS, &sampler_array[0]);
-	}
-	if (shader->light_array >= 0) {
-		glUniformMatrix4fv(shader->light_array, num_mesh_lights, false, &light_array[0].col[0][0]);
+	for (uint32_t i = 0; i < num_lights; i++) {
+
+		vec4_t rect = view->light_rects[first_light + i];
+		vec4_t uv = vec4(0.5f * rect.x + 0.5f, 0.5f * rect.y + 0.5f,
+		                 0.5f * rect.z + 0.5f, 0.5f * rect.w + 0.5f);
+
+		colour_t colour = col((uint8_t)i, 0, 0);
+
+		vertices[4 * i + 0] = vertex_ui(vec2(rect.x, rect.y), vec2(uv.x, uv.y), colour);
+		vertices[4 * i + 1] = vertex_ui(vec2(rect.z, rect.y), vec2(uv.z, uv.y), colour);
+		vertices[4 * i + 2] = vertex_ui(vec2(rect.x, rect.w), vec2(uv.x, uv.w), colour);
+		vertices[4 * i + 3] = vertex_ui(vec2(rect.z, rect.w), vec2(uv.z, uv.w), colour);
 	}
-	if (shader->num_lights_position >= 0) {
-		glUniform1i(shader->num_lights_position, num_mesh_lights);
+
+	glstate_bind_array_buffer(light_quad_vertices);
+	glBufferDataARB(GL_ARRAY_BUFFER_ARB, num_lights * 4 * sizeof(vertex_ui_t), vertices,
+	                GL_STREAM_DRAW_ARB);
+
+	rend_bind_vertex_data(light_quad_vertices, light_quad_indices, VERTEX_UI);
+
+	// Draw every light in the batch with a single draw call.
+	glstate_count_calls(2);
+	glDrawElements(GL_TRIANGLES, 6 * num_lights, GL_UNSIGNED_SHORT, 0);
+}
+
+static void rend_create_light_quad_buffers(void)
+{
+	// The vertices are updated for every batch of lights, the indices never change.
+	vindex_t indices[6 * MAX_LIGHTS_PER_PASS];
+
+	for (int i = 0; i < MAX_LIGHTS_PER_PASS; i++) {
+
+		indices[6 * i + 0] = (vindex_t)(4 * i + 0);
+		indices[6 * i + 1] = (vindex_t)(4 * i + 1);
+		indices[6 * i + 2] = (vindex_t)(4 * i + 2);
+		indices[6 * i + 3] = (vindex_t)(4 * i + 2);
+		indices[6 * i + 4] = (vindex_t)(4 * i + 1);
+		indices[6 * i + 5] = (vindex_t)(4 * i + 3);
 	}
 
-	rend_commit_uniforms(shader);
+	light_quad_vertices = rend_gl_generate_buffer();
+	light_quad_indices = rend_gl_generate_buffer();
 
-	// Draw the framebuffer's contents into a screen sized quad.
-	glDrawElements(GL_TRIANGLE_STRIP, 4, GL_UNSIGNED_SHORT, 0);
+	rend_gl_upload_buffer_data(light_quad_indices, indices, sizeof(indices), true, true);
 }
 
 static void rend_set_blend_mode(int queue, bool post_processing)
@@ -1224,18 +2071,181 @@ static void rend_set_blend_mode(int queue, bool post_processing)
 		queue == QUEUE_GEOMETRY) {
 
 		// Disable blending for objects in the background and non-transparent geometry.
-		glDisable(GL_BLEND);
-		glBlendFunc(GL_ONE, GL_ZERO);
+		glstate_set_blend(false, GL_ONE, GL_ZERO);
 	}
 	else {
 
 		// Enable blending for everything that is or could be transparent.
-		glEnable(GL_BLEND);
-		glBlendFunc(GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+		glstate_set_blend(true, GL_SRC_ALPHA, GL_ONE_MINUS_SRC_ALPHA);
+	}
+}
+
+static uint32_t rend_set_texture_filter(TEX_FILTER filter, uint32_t num_levels)
+{
+	// Trilinear and anisotropic filtering sample the mip chain of the texture. Returns the number
+	// of mip levels the bound texture should have.
+	const mylly_params_t *params = mylly_get_parameters();
+
+	bool use_mipmaps = (filter == TEX_FILTER_TRILINEAR || filter == TEX_FILTER_ANISOTROPIC);
+
+	if (!use_mipmaps) {
+		num_levels = 1;
+	}
+	else if (params->renderer.max_texture_mip_levels != 0) {
+		num_levels = MIN(num_levels, params->renderer.max_texture_mip_levels);
+	}
+
+	num_levels = MAX(num_levels, 1);
+
+	int min_filter = (filter == TEX_FILTER_POINT ? GL_NEAREST :
+	                  use_mipmaps ? GL_LINEAR_MIPMAP_LINEAR : GL_LINEAR);
+	int mag_filter = (filter == TEX_FILTER_POINT ? GL_NEAREST : GL_LINEAR);
+
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, min_filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, mag_filter);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, num_levels - 1);
+
+	if (use_mipmaps) {
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_LOD_BIAS, params->renderer.texture_mip_bias);
+	}
+
+	if (filter == TEX_FILTER_ANISOTROPIC && glext_get_max_anisotropy() > 1) {
+
+		float anisotropy = params->renderer.max_texture_anisotropy;
+
+		if (anisotropy <= 0 || anisotropy > glext_get_max_anisotropy()) {
+			anisotropy = glext_get_max_anisotropy();
+		}
+
+		glTexParameterf(GL_TEXTURE_2D, GL_TEXTURE_MAX_ANISOTROPY_EXT, anisotropy);
+	}
+
+	return num_levels;
+}
+
+static bool rend_get_compressed_format(TEX_FORMAT fmt, GLenum *internal_format)
+{
+	switch (fmt) {
+
+		case TEX_FORMAT_BC1:
+			*internal_format = GL_COMPRESSED_RGB_S3TC_DXT1_EXT;
+			return glext_is_s3tc_supported();
+
+		case TEX_FORMAT_BC3:
+			*internal_format = GL_COMPRESSED_RGBA_S3TC_DXT5_EXT;
+			return glext_is_s3tc_supported();
+
+		case TEX_FORMAT_BC4:
+			*internal_format = GL_COMPRESSED_RED_RGTC1;
+			return true;
+
+		case TEX_FORMAT_BC5:
+			*internal_format = GL_COMPRESSED_RG_RGTC2;
+			return true;
+
+		default:
+			return false;
 	}
 }
 
-void rend_override_draw_gbuffer(gbuffer_component_t buffer)
+static void rend_gl_override_draw_gbuffer(gbuffer_component_t buffer)
 {
 	override_gbuffer_component = buffer;
 }
+
+static void rend_create_light_grid_textures(void)
+{
+	light_grid_texture = rend_create_data_texture(GL_RG32UI,
+		LIGHT_GRID_X * LIGHT_GRID_Y, LIGHT_GRID_Z, GL_RG_INTEGER, GL_UNSIGNED_INT);
+
+	light_index_texture = rend_create_data_texture(GL_R16UI,
+		LIGHT_INDEX_ROW_LENGTH, MAX_LIGHT_INDEX_ROWS, GL_RED_INTEGER, GL_UNSIGNED_SHORT);
+
+	// Each light takes four texels, one for each column of its parameter matrix.
+	light_data_texture = rend_create_data_texture(GL_RGBA32F,
+		4, MAX_GRID_LIGHTS, GL_RGBA, GL_FLOAT);
+
+}
+
+static void rend_upload_light_grid(const light_grid_t *grid)
+{
+	// The textures are bound to their own units.
+	glstate_bind_texture(LIGHT_GRID_TEXTURE_UNIT, light_grid_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_GRID_X * LIGHT_GRID_Y, LIGHT_GRID_Z,
+	                GL_RG_INTEGER, GL_UNSIGNED_INT, grid->clusters);
+
+	// Only upload as many rows of light indices as the grid uses.
+	glstate_bind_texture(LIGHT_INDEX_TEXTURE_UNIT, light_index_texture);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, LIGHT_INDEX_ROW_LENGTH,
+	                MIN(grid->num_index_rows, MAX_LIGHT_INDEX_ROWS),
+	                GL_RED_INTEGER, GL_UNSIGNED_SHORT, grid->indices);
+
+	if (grid->num_lights != 0) {
+
+		glstate_bind_texture(LIGHT_DATA_TEXTURE_UNIT, light_data_texture);
+		glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, 4, grid->num_lights,
+		                GL_RGBA, GL_FLOAT, grid->lights);
+	}
+
+	glstate_count_calls(3);
+
+	uploaded_light_grid = grid;
+}
+
+static GLuint rend_create_data_texture(GLint internal_format, GLsizei width, GLsizei height,
+                                       GLenum format, GLenum type)
+{
+	GLuint texture;
+	glGenTextures(1, &texture);
+
+	glstate_bind_texture(0, texture);
+
+	// Data textures are read with texelFetch(), so they must not be filtered.
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+
+	glTexImage2D(GL_TEXTURE_2D, 0, internal_format, width, height, 0, format, type, NULL);
+
+	return texture;
+}
+
+const rend_backend_t *rend_opengl_backend(void)
+{
+	static const rend_backend_t backend = {
+		"OpenGL",
+		false,
+		rend_gl_initialize,
+		rend_gl_shutdown,
+		rend_gl_preload_shaders,
+		rend_gl_begin_draw,
+		rend_gl_end_draw,
+		rend_gl_draw_views,
+		rend_gl_execute_commands,
+		rend_gl_get_stats,
+		rend_gl_generate_buffer,
+		rend_gl_destroy_buffer,
+		rend_gl_upload_buffer_data,
+		rend_gl_update_buffer_subdata,
+		rend_gl_create_shader,
+		rend_gl_create_shader_program,
+		rend_gl_load_program_binary,
+		rend_gl_save_program_binary,
+		rend_gl_destroy_shader,
+		rend_gl_destroy_shader_program,
+		rend_gl_get_program_uniform_location,
+		rend_gl_bind_program_uniform_block,
+		rend_gl_bind_program_samplers,
+		rend_gl_get_program_attribute_location,
+		rend_gl_get_default_shader_source,
+		rend_gl_generate_texture,
+		rend_gl_generate_compressed_texture,
+		rend_gl_delete_texture,
+		rend_gl_upload_texture,
+		rend_gl_is_texture_upload_complete,
+		rend_gl_draw_splash_screen,
+		rend_gl_override_draw_gbuffer,
+	};
+
+	return &backend;
+}
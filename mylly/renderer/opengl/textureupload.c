@@ -0,0 +1,242 @@
+#include "textureupload.h"
+#include "extensions.h"
+#include "renderer/mipmap.h"
+#include "collections/array.h"
+#include "platform/thread.h"
+#include "core/memory.h"
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+// A pixel buffer of the ring and the upload using it.
+typedef struct texupload_buffer_t {
+
+	GLuint buffer; // Pixel buffer object
+	size_t capacity; // Size of the pixel buffer's storage
+	texture_upload_t *upload; // Upload waiting for the GPU, NULL if the buffer is free
+	GLuint texture; // The texture object of the upload
+	GLsync fence; // Signaled when the GPU has finished reading the buffer
+	uint32_t frames; // Number of frames the upload has been waited for
+
+} texupload_buffer_t;
+
+// -------------------------------------------------------------------------------------------------
+
+static size_t texupload_get_channels(const texture_upload_t *upload);
+static size_t texupload_get_size(const texture_upload_t *upload);
+static bool texupload_is_finished(texupload_buffer_t *buffer);
+static void texupload_complete(texupload_buffer_t *buffer);
+static void texupload_start(texupload_buffer_t *buffer, texture_upload_t *upload, size_t size,
+                            texupload_create_t create);
+
+// -------------------------------------------------------------------------------------------------
+
+static texupload_buffer_t buffers[TEXUPLOAD_BUFFERS];
+static arr_t(texture_upload_t*) queue; // Uploads waiting for a free pixel buffer
+static lock_t completion_lock; // Guards the completion of uploads, which is read by other threads
+
+// -------------------------------------------------------------------------------------------------
+
+void texupload_initialize(void)
+{
+	arr_init(queue);
+	thread_init_lock(&completion_lock);
+
+	for (int i = 0; i < TEXUPLOAD_BUFFERS; i++) {
+
+		glGenBuffersARB(1, &buffers[i].buffer);
+
+		buffers[i].capacity = 0;
+		buffers[i].upload = NULL;
+		buffers[i].fence = NULL;
+	}
+}
+
+void texupload_shutdown(void)
+{
+	for (int i = 0; i < TEXUPLOAD_BUFFERS; i++) {
+
+		if (buffers[i].fence != NULL) {
+			glDeleteSync(buffers[i].fence);
+		}
+
+		glDeleteBuffersARB(1, &buffers[i].buffer);
+	}
+
+	arr_clear(queue);
+	thread_destroy_lock(&completion_lock);
+}
+
+void texupload_queue(texture_upload_t *upload)
+{
+	if (upload == NULL) {
+		return;
+	}
+
+	arr_push(queue, upload);
+}
+
+bool texupload_is_complete(texture_upload_t *upload)
+{
+	bool is_complete;
+
+	thread_lock(&completion_lock);
+	is_complete = upload->is_complete;
+	thread_unlock(&completion_lock);
+
+	return is_complete;
+}
+
+void texupload_process(size_t budget, texupload_create_t create, rend_stats_t *stats)
+{
+	// Complete the uploads the GPU has finished with, freeing their pixel buffers.
+	for (int i = 0; i < TEXUPLOAD_BUFFERS; i++) {
+
+		if (buffers[i].upload != NULL && texupload_is_finished(&buffers[i])) {
+			texupload_complete(&buffers[i]);
+		}
+	}
+
+	// Start as many queued uploads as there are free pixel buffers and budget left. The first
+	// upload of the frame is always started, so textures larger than the budget are uploaded too.
+	size_t uploaded = 0;
+	size_t next = 0;
+
+	for (int i = 0; i < TEXUPLOAD_BUFFERS && next < queue.count; i++) {
+
+		if (buffers[i].upload != NULL) {
+			continue;
+		}
+
+		texture_upload_t *upload = queue.items[next];
+		size_t size = texupload_get_size(upload);
+
+		if (uploaded != 0 && uploaded + size > budget) {
+			break;
+		}
+
+		texupload_start(&buffers[i], upload, size, create);
+
+		uploaded += size;
+		next++;
+
+		stats->texture_uploads++;
+	}
+
+	if (next != 0) {
+		arr_remove_range(queue, 0, next);
+	}
+
+	stats->texture_upload_bytes += (uint32_t)uploaded;
+	stats->pending_texture_uploads = (uint32_t)queue.count;
+
+	for (int i = 0; i < TEXUPLOAD_BUFFERS; i++) {
+
+		if (buffers[i].upload != NULL) {
+			stats->pending_texture_uploads++;
+		}
+	}
+}
+
+static size_t texupload_get_channels(const texture_upload_t *upload)
+{
+	return (upload->format == TEX_FORMAT_GRAYSCALE ? 1 : upload->format == TEX_FORMAT_RGB ? 3 : 4);
+}
+
+static size_t texupload_get_size(const texture_upload_t *upload)
+{
+	size_t channels = texupload_get_channels(upload);
+	size_t size = upload->width * upload->height * channels;
+
+	if (upload->mip_chain != NULL) {
+		size += mipmap_get_chain_size(upload->width, upload->height, channels, upload->num_levels);
+	}
+
+	return size;
+}
+
+static bool texupload_is_finished(texupload_buffer_t *buffer)
+{
+	if (buffer->fence == NULL) {
+		return (++buffer->frames >= TEXUPLOAD_FRAME_LATENCY);
+	}
+
+	// Poll the fence without waiting.
+	GLenum result = glClientWaitSync(buffer->fence, 0, 0);
+
+	return (result == GL_ALREADY_SIGNALED || result == GL_CONDITION_SATISFIED);
+}
+
+static void texupload_complete(texupload_buffer_t *buffer)
+{
+	if (buffer->fence != NULL) {
+
+		glDeleteSync(buffer->fence);
+		buffer->fence = NULL;
+	}
+
+	thread_lock(&completion_lock);
+	{
+		buffer->upload->texture = buffer->texture;
+		buffer->upload->is_complete = true;
+	}
+	thread_unlock(&completion_lock);
+
+	buffer->upload = NULL;
+}
+
+static void texupload_start(texupload_buffer_t *buffer, texture_upload_t *upload, size_t size,
+                            texupload_create_t create)
+{
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER, buffer->buffer);
+
+	// Grow the pixel buffer when needed. Otherwise the old storage is orphaned while mapping it,
+	// so the driver doesn't have to wait for the previous upload from the same buffer.
+	if (size > buffer->capacity) {
+
+		glBufferDataARB(GL_PIXEL_UNPACK_BUFFER, size, NULL, GL_STREAM_DRAW);
+		buffer->capacity = size;
+	}
+
+	uint8_t *pixels = glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, size,
+	                                   GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_BUFFER_BIT);
+
+	if (pixels != NULL) {
+
+		size_t image_size = upload->width * upload->height * texupload_get_channels(upload);
+
+		memcpy(pixels, upload->image, image_size);
+
+		if (upload->mip_chain != NULL) {
+			memcpy(pixels + image_size, upload->mip_chain, size - image_size);
+		}
+
+		glUnmapBuffer(GL_PIXEL_UNPACK_BUFFER);
+
+		// The pixels are now offsets into the pixel buffer.
+		buffer->texture = create(upload, NULL, (const void *)(uintptr_t)image_size);
+	}
+	else {
+
+		// Mapping failed (e.g. the driver ran out of memory), so upload from the client memory.
+		glBindBufferARB(GL_PIXEL_UNPACK_BUFFER, 0);
+		buffer->texture = create(upload, upload->image, upload->mip_chain);
+	}
+
+	glBindBufferARB(GL_PIXEL_UNPACK_BUFFER, 0);
+
+	// The pixels have been copied, so the renderer owns them no longer.
+	mem_free(upload->image);
+
+	if (upload->mip_chain != NULL) {
+		mem_free(upload->mip_chain);
+	}
+
+	upload->image = NULL;
+	upload->mip_chain = NULL;
+
+	buffer->upload = upload;
+	buffer->frames = 0;
+	buffer->fence = (glext_is_sync_supported() ?
+	                 glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0) : NULL);
+}
@@ -0,0 +1,54 @@
+#pragma once
+#ifndef __OPENGL_TEXTUREUPLOAD_H
+#define __OPENGL_TEXTUREUPLOAD_H
+
+#include "renderer/opengl/opengl.h"
+#include "renderer/renderer.h"
+#include "core/defines.h"
+
+/*
+====================================================================================================
+
+	Texture upload queue
+
+	Uploads textures queued with rend_upload_texture() through a ring of pixel buffer objects.
+	Once per frame the queued textures are copied into free pixel buffers until the frame's byte
+	budget has been used, and the texture levels are specified from the pixel buffers, so the
+	driver can transfer the pixels while the frame is being drawn.
+
+	A fence is inserted after each upload. The pixel buffer is reused and the upload is marked as
+	completed once the fence has signaled. Without sync object support the upload is assumed to
+	be complete after TEXUPLOAD_FRAME_LATENCY frames.
+
+	The queue is processed on the thread which owns the OpenGL context, but the completion of an
+	upload can be queried from any thread.
+
+====================================================================================================
+*/
+
+#define TEXUPLOAD_BUFFERS 4 // Number of pixel buffers in the ring
+#define TEXUPLOAD_DEFAULT_BUDGET (4 * 1024 * 1024) // Bytes uploaded per frame by default
+#define TEXUPLOAD_FRAME_LATENCY 3 // Frames to wait for an upload without sync objects
+
+// Creates the texture object of an upload and specifies its levels. The pixels of the first level
+// and the rest of the mip chain are offsets into the bound pixel buffer cast to pointers, or client
+// memory if no pixel buffer is bound.
+typedef GLuint (*texupload_create_t)(texture_upload_t *upload, const void *image,
+                                     const void *mip_chain);
+
+// -------------------------------------------------------------------------------------------------
+
+void texupload_initialize(void);
+void texupload_shutdown(void);
+
+// Add an upload to the end of the queue.
+void texupload_queue(texture_upload_t *upload);
+
+// Returns true when an upload has completed.
+bool texupload_is_complete(texture_upload_t *upload);
+
+// Complete the uploads whose fences have signaled and start new uploads within the byte budget.
+// Adds the uploads of the frame to the statistics.
+void texupload_process(size_t budget, texupload_create_t create, rend_stats_t *stats);
+
+#endif
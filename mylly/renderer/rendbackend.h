@@ -0,0 +1,79 @@
+#pragma once
+#ifndef __RENDBACKEND_H
+#define __RENDBACKEND_H
+
+#include "renderer/renderer.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Renderer backend
+
+	The rend_* methods declared in renderer.h are forwarded to the active renderer backend. Each
+	backend fills a table with its own implementation of every method. The backend is selected when
+	the renderer is initialized and can't be changed while it is running.
+
+====================================================================================================
+*/
+
+typedef struct rend_backend_t {
+
+	const char *name; // Name of the backend for logging
+	bool is_threaded; // Frames are drawn on another thread after rend_end_draw() returns
+
+	bool (*initialize)(void);
+	void (*shutdown)(void);
+	void (*preload_shaders)(void);
+
+	void (*begin_draw)(void);
+	void (*end_draw)(void);
+	void (*draw_views)(rview_t *first_view);
+	void (*execute_commands)(const cmdbuf_t *commands);
+	const rend_stats_t *(*get_stats)(void);
+
+	vbindex_t (*generate_buffer)(void);
+	void (*destroy_buffer)(vbindex_t vbo);
+	void (*upload_buffer_data)(vbindex_t vbo, void *data, size_t size, bool is_index,
+	                           bool is_static);
+	void (*update_buffer_subdata)(vbindex_t vbo, const void *data, size_t offset, size_t size,
+	                              bool is_index);
+
+	shader_object_t (*create_shader)(SHADER_TYPE type, const char **lines, size_t num_lines,
+	                                 const char **compiler_log);
+	shader_program_t (*create_shader_program)(shader_object_t *shaders, size_t num_shaders);
+	shader_program_t (*load_program_binary)(const char **lines, size_t num_lines);
+	void (*save_program_binary)(shader_program_t program, const char **lines, size_t num_lines);
+	void (*destroy_shader)(shader_object_t shader);
+	void (*destroy_shader_program)(shader_program_t program);
+	int (*get_program_uniform_location)(shader_program_t program, const char *name);
+	bool (*bind_program_uniform_block)(shader_program_t program, const char *name,
+	                                   uint32_t binding);
+	void (*bind_program_samplers)(shader_t *shader);
+	int (*get_program_attribute_location)(shader_program_t program, const char *name);
+	const char *(*get_default_shader_source)(default_shader_t shader);
+
+	texture_name_t (*generate_texture)(void *image, size_t width, size_t height,
+	                                   TEX_FORMAT fmt, TEX_FILTER filter);
+	texture_name_t (*generate_compressed_texture)(const void *data, size_t width, size_t height,
+	                                              uint32_t num_levels, TEX_FORMAT fmt,
+	                                              TEX_FILTER filter);
+	void (*delete_texture)(texture_name_t texture);
+	void (*upload_texture)(texture_upload_t *upload);
+	bool (*is_texture_upload_complete)(texture_upload_t *upload);
+
+	void (*draw_splash_screen)(texture_t *texture, shader_t *shader, colour_t background);
+	void (*override_draw_gbuffer)(gbuffer_component_t buffer);
+
+} rend_backend_t;
+
+// -------------------------------------------------------------------------------------------------
+
+// Built-in backends.
+const rend_backend_t *rend_opengl_backend(void); // Draws with OpenGL (see renderer/opengl)
+const rend_backend_t *rend_null_backend(void); // Records draws without a GPU (see nullrenderer.h)
+
+END_DECLARATIONS;
+
+#endif
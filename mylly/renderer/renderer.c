@@ -0,0 +1,208 @@
+#include "renderer.h"
+#include "rendbackend.h"
+#include "renderthread.h"
+#include "core/mylly.h"
+#include "io/log.h"
+
+// -------------------------------------------------------------------------------------------------
+
+static const rend_backend_t *backend; // The backend all renderer calls are forwarded to
+static bool is_initialized;
+
+// -------------------------------------------------------------------------------------------------
+
+void rend_set_backend(const rend_backend_t *new_backend)
+{
+	if (is_initialized) {
+
+		log_warning("Renderer", "The renderer backend can't be changed while it is running.");
+		return;
+	}
+
+	backend = new_backend;
+}
+
+const rend_backend_t *rend_get_backend(void)
+{
+	return backend;
+}
+
+bool rend_is_threaded(void)
+{
+	return (backend != NULL && backend->is_threaded);
+}
+
+bool rend_initialize(void)
+{
+	// Select the default backend unless one has been selected explicitly.
+	if (backend == NULL) {
+
+		backend = (mylly_get_parameters()->renderer.use_null_backend ?
+		           rend_null_backend() :
+		           rend_opengl_backend());
+	}
+
+	// Run the backend on a dedicated render thread if requested.
+	if (mylly_get_parameters()->renderer.use_render_thread) {
+		backend = rend_threaded_backend(backend);
+	}
+
+	log_message("Renderer", "Using %s renderer backend.", backend->name);
+
+	is_initialized = backend->initialize();
+	return is_initialized;
+}
+
+void rend_shutdown(void)
+{
+	if (is_initialized) {
+		backend->shutdown();
+	}
+
+	is_initialized = false;
+}
+
+void rend_preload_shaders(void)
+{
+	backend->preload_shaders();
+}
+
+void rend_begin_draw(void)
+{
+	backend->begin_draw();
+}
+
+void rend_end_draw(void)
+{
+	backend->end_draw();
+}
+
+void rend_draw_views(rview_t *first_view)
+{
+	backend->draw_views(first_view);
+}
+
+void rend_execute_commands(const cmdbuf_t *commands)
+{
+	backend->execute_commands(commands);
+}
+
+const rend_stats_t *rend_get_stats(void)
+{
+	return backend->get_stats();
+}
+
+vbindex_t rend_generate_buffer(void)
+{
+	return backend->generate_buffer();
+}
+
+void rend_destroy_buffer(vbindex_t vbo)
+{
+	backend->destroy_buffer(vbo);
+}
+
+void rend_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index, bool is_static)
+{
+	backend->upload_buffer_data(vbo, data, size, is_index, is_static);
+}
+
+void rend_update_buffer_subdata(vbindex_t vbo, const void *data, size_t offset, size_t size,
+	                            bool is_index)
+{
+	backend->update_buffer_subdata(vbo, data, offset, size, is_index);
+}
+
+shader_object_t rend_create_shader(SHADER_TYPE type, const char **lines, size_t num_lines,
+								   const char **compiler_log)
+{
+	return backend->create_shader(type, lines, num_lines, compiler_log);
+}
+
+shader_program_t rend_create_shader_program(shader_object_t *shaders, size_t num_shaders)
+{
+	return backend->create_shader_program(shaders, num_shaders);
+}
+
+shader_program_t rend_load_program_binary(const char **lines, size_t num_lines)
+{
+	return backend->load_program_binary(lines, num_lines);
+}
+
+void rend_save_program_binary(shader_program_t program, const char **lines, size_t num_lines)
+{
+	backend->save_program_binary(program, lines, num_lines);
+}
+
+void rend_destroy_shader(shader_object_t shader)
+{
+	backend->destroy_shader(shader);
+}
+
+void rend_destroy_shader_program(shader_program_t program)
+{
+	backend->destroy_shader_program(program);
+}
+
+int rend_get_program_uniform_location(shader_program_t program, const char *name)
+{
+	return backend->get_program_uniform_location(program, name);
+}
+
+bool rend_bind_program_uniform_block(shader_program_t program, const char *name, uint32_t binding)
+{
+	return backend->bind_program_uniform_block(program, name, binding);
+}
+
+void rend_bind_program_samplers(shader_t *shader)
+{
+	backend->bind_program_samplers(shader);
+}
+
+int rend_get_program_program_attribute_location(shader_program_t program, const char *name)
+{
+	return backend->get_program_attribute_location(program, name);
+}
+
+const char *rend_get_default_shader_source(default_shader_t shader)
+{
+	return backend->get_default_shader_source(shader);
+}
+
+texture_name_t rend_generate_texture(void *image, size_t width, size_t height,
+                                     TEX_FORMAT fmt, TEX_FILTER filter)
+{
+	return backend->generate_texture(image, width, height, fmt, filter);
+}
+
+texture_name_t rend_generate_compressed_texture(const void *data, size_t width, size_t height,
+                                                uint32_t num_levels, TEX_FORMAT fmt,
+                                                TEX_FILTER filter)
+{
+	return backend->generate_compressed_texture(data, width, height, num_levels, fmt, filter);
+}
+
+void rend_delete_texture(texture_name_t texture)
+{
+	backend->delete_texture(texture);
+}
+
+void rend_upload_texture(texture_upload_t *upload)
+{
+	backend->upload_texture(upload);
+}
+
+bool rend_is_texture_upload_complete(texture_upload_t *upload)
+{
+	return backend->is_texture_upload_complete(upload);
+}
+
+void rend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background)
+{
+	backend->draw_splash_screen(texture, shader, background);
+}
+
+void rend_override_draw_gbuffer(gbuffer_component_t buffer)
+{
+	backend->override_draw_gbuffer(buffer);
+}
@@ -13,6 +13,18 @@
 
 BEGIN_DECLARATIONS;
 
+struct rend_backend_t;
+
+// Select the backend which implements the methods below (see rendbackend.h). Has to be called
+// before the renderer is initialized. If no backend is selected, the renderer uses OpenGL unless
+// the engine parameters request the null backend.
+void rend_set_backend(const struct rend_backend_t *backend);
+const struct rend_backend_t *rend_get_backend(void);
+
+// Returns true when frames are drawn on a render thread. The views passed to rend_draw_views() must
+// then stay valid until the next frame has ended (see renderthread.h).
+bool rend_is_threaded(void);
+
 bool rend_initialize(void);
 void rend_shutdown(void);
 
@@ -21,8 +33,37 @@ void rend_preload_shaders(void);
 void rend_begin_draw(void);
 void rend_end_draw(void);
 
+// Draw the views by replaying the command buffers recorded for each of their render queues.
 void rend_draw_views(rview_t *first_view);
 
+// Replay a single command buffer on its own, using the constants of the previously drawn view.
+// Should be called between rend_begin_draw() and rend_end_draw(). Mainly used for replaying
+// captured command buffers in tests.
+void rend_execute_commands(const cmdbuf_t *commands);
+
+// Statistics about the draw calls of the previously drawn frame.
+typedef struct rend_stats_t {
+
+	uint32_t draw_calls; // Number of meshes drawn
+	uint32_t shader_changes; // Number of times the active shader program was changed
+	uint32_t texture_changes; // Number of times a mesh texture or normal map was changed
+	uint32_t buffer_changes; // Number of times the vertex buffer was changed between meshes
+
+	uint32_t gl_calls; // Number of OpenGL calls made while drawing
+	uint32_t gl_calls_skipped; // Number of redundant OpenGL calls skipped by the state cache
+
+	uint32_t uniform_calls; // Number of glUniform* calls
+	uint32_t uniform_buffer_bytes; // Amount of shader constants uploaded to uniform buffers
+	uint32_t submit_time; // CPU time spent submitting the views to OpenGL [us]
+
+	uint32_t texture_uploads; // Number of textures copied into pixel buffers for uploading
+	uint32_t texture_upload_bytes; // Amount of texture data copied into pixel buffers
+	uint32_t pending_texture_uploads; // Uploads waiting for their turn or for the GPU to finish
+
+} rend_stats_t;
+
+const rend_stats_t *rend_get_stats(void);
+
 //
 // Vertex buffer objects
 //
@@ -54,6 +95,15 @@ shader_object_t rend_create_shader(SHADER_TYPE type, const char **lines, size_t
 // 0 otherwise.
 shader_program_t rend_create_shader_program(shader_object_t *shaders, size_t num_shaders);
 
+// Load a previously linked shader program from the program binary cache. The source code lines
+// are the same ones the shaders of the program are compiled from. Returns 0 if the program is not
+// cached or the cached binary can't be used, in which case the program has to be compiled.
+shader_program_t rend_load_program_binary(const char **lines, size_t num_lines);
+
+// Store a linked shader program into the program binary cache so it can be loaded on the next
+// launch without compiling it.
+void rend_save_program_binary(shader_program_t program, const char **lines, size_t num_lines);
+
 // Destroy a previously compiled shader object.
 void rend_destroy_shader(shader_object_t shader);
 
@@ -63,6 +113,14 @@ void rend_destroy_shader_program(shader_program_t program);
 // Returns the location of a uniform in a shader program, -1 if the uniform is not declared.
 int rend_get_program_uniform_location(shader_program_t program, const char *name);
 
+// Bind a uniform block of a shader program to a binding point. Returns false if the program does
+// not declare the block.
+bool rend_bind_program_uniform_block(shader_program_t program, const char *name, uint32_t binding);
+
+// Assign the sampler uniforms of a shader to the texture units used by the renderer. Called once
+// after the program has been linked and the sampler locations have been cached.
+void rend_bind_program_samplers(shader_t *shader);
+
 // Returns the index of a vertex attribute in a shader program, -1 if the attribute is not declared.
 int rend_get_program_program_attribute_location(shader_program_t program, const char *name);
 
@@ -86,9 +144,40 @@ const char *rend_get_default_shader_source(default_shader_t shader);
 texture_name_t rend_generate_texture(void *image, size_t width, size_t height,
                                      TEX_FORMAT fmt, TEX_FILTER filter);
 
+// Generate a GPU texture object from block compressed data. The data contains num_levels levels of
+// the mip chain of the texture, starting from the largest level.
+texture_name_t rend_generate_compressed_texture(const void *data, size_t width, size_t height,
+                                                uint32_t num_levels, TEX_FORMAT fmt,
+                                                TEX_FILTER filter);
+
 // Destroy a texture on the GPU.
 void rend_delete_texture(texture_name_t texture);
 
+// A texture uploaded in the background over the next frames (see rend_upload_texture()).
+typedef struct texture_upload_t {
+
+	void *image; // Pixels of the largest level
+	void *mip_chain; // The levels 1...num_levels-1 (see mipmap_generate()), can be NULL
+	uint32_t num_levels; // Number of levels in the image and the mip chain
+	size_t width, height;
+	TEX_FORMAT format;
+	TEX_FILTER filter;
+
+	texture_name_t texture; // The texture object, valid once the upload has completed
+	bool is_complete;
+
+} texture_upload_t;
+
+// Queue a texture to be uploaded without stalling the frame. The image and the mip chain are
+// released by the renderer with mem_free() once they have been copied, and the upload must stay
+// valid until rend_is_texture_upload_complete() returns true. Uploads are limited by
+// texture_upload_budget per frame (see mylly.h).
+void rend_upload_texture(texture_upload_t *upload);
+
+// Returns true when the GPU has finished uploading a texture queued with rend_upload_texture().
+// Can be called from any thread.
+bool rend_is_texture_upload_complete(texture_upload_t *upload);
+
 // Draw the splash screen while the engine is loading.
 void rend_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background);
 
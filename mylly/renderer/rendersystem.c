@@ -3,9 +3,13 @@
 #include "renderview.h"
 #include "shader.h"
 #include "texture.h"
+#include "texstream.h"
+#include "mipmap.h"
 #include "buffercache.h"
 #include "material.h"
 #include "debug.h"
+#include "lightgrid.h"
+#include "cmdbuffer.h"
 #include "scene/scene.h"
 #include "scene/object.h"
 #include "scene/model.h"
@@ -15,33 +19,165 @@
 #include "scene/light.h"
 #include "resources/resources.h"
 #include "core/mylly.h"
+#include "core/parallel.h"
+#include "platform/timer.h"
 #include "io/log.h"
 #include "math/math.h"
 #include "mgui/mgui.h"
-#include <stdlib.h>
+
+// -------------------------------------------------------------------------------------------------
+
+// Layout of the sort keys of render meshes. The render queue is stored in the most significant bits.
+// Transparent meshes are sorted back to front so they blend correctly, and by state after that.
+// Other meshes are sorted by shader, material, texture and vertex buffer to minimize state changes,
+// and front to back within the same state to reduce overdraw.
+#define SORT_KEY_QUEUE_SHIFT 61
+#define SORT_KEY_ID_BITS 11 // Bits per shader, material, texture and buffer ID
+#define SORT_KEY_DEPTH_BITS 16 // Bits of quantized view depth
+
+#define SORT_KEY_ID_MASK ((1ull << SORT_KEY_ID_BITS) - 1)
+#define SORT_KEY_DEPTH_MASK ((1ull << SORT_KEY_DEPTH_BITS) - 1)
 
 // -------------------------------------------------------------------------------------------------
 
 static int frames_rendered; // Number of frames rendered so far
 static shader_t *default_shader; // Default shader used for rendering when a mesh has no shader
 
-static arr_t(rlight_t*) lights; // All the lights affecting the scene
-static list_t(rview_t) views; // List of views to be rendered this frame
+typedef arr_t(rlight_t*) light_array_t;
+typedef list_t(rview_t) view_list_t;
+
+static light_array_t lights; // All the lights affecting the scene
+static view_list_t views; // List of views to be rendered this frame
+
+// Views and lights of the previous frame. When the renderer draws on a render thread, the previous
+// frame is drawn while the next one is being built, so its data is released one frame later.
+static light_array_t submitted_lights;
+static view_list_t submitted_views;
 
 static rview_t *ui_view; // A dedicated view for UI widgets due to UI not needing a camera
 static robject_t ui_parent; // A virtual object to be used as the UI parent
 
 static bool is_using_deferred_lighting = false; // Toggle for forward/deferred lighting mode
 
+static float lod_bias = 1.0f; // Multiplier for the screen size of models when selecting LODs
+
+static bool is_sorting_draws = true; // Sort the meshes of each render queue before drawing
+
+// Command buffers reused by the views of every other frame. Two sets are needed, because the
+// previous frame may still be drawn while the commands of the next one are recorded.
+static arr_t(cmdbuf_t*) command_buffers[2];
+static arr_t(rview_t*) recorded_views; // Views whose commands are recorded this frame
+
+// State of the commands recorded into a single command buffer. Only changes are recorded.
+typedef struct record_state_t {
+
+	shader_program_t program;
+	int depth_write;
+	texture_name_t texture;
+	texture_name_t normal_map;
+	vbindex_t vertices;
+	vbindex_t indices;
+	vertex_type_t vertex_type;
+	const material_t *material;
+
+} record_state_t;
+
+// Vertex data and index range drawn for a single mesh.
+typedef struct mesh_draw_t {
+
+	vbindex_t vertices;
+	vbindex_t indices;
+	uint32_t first_index;
+	uint32_t num_indices;
+	cmd_primitive_t primitive;
+
+} mesh_draw_t;
+
+// Adjacent meshes in a render queue which share their material and vertex data are drawn with a
+// single instanced draw, when their shader has an instancing variant. Shorter runs are drawn one
+// by one, because an instanced draw of a single mesh only adds overhead.
+#define MIN_INSTANCES 2
+
+#define OBJECTS_PER_CULL_JOB 64 // Number of scene objects culled against the views by a single job
+
+// Render data added to a single view by a culling job.
+typedef struct cull_view_t {
+
+	list_t(robject_t) objects;
+	list_t(rmesh_t) meshes[NUM_QUEUES];
+
+} cull_view_t;
+
+// A mesh added to a view by a culling job. Uploading the buffers of a mesh and requesting its
+// textures are not thread safe, so they are done after the jobs have completed.
+typedef struct cull_mesh_t {
+
+	mesh_t *mesh;
+	rmesh_t *rmesh;
+	float screen_size; // Portion of the screen height covered by the mesh's object
+
+} cull_mesh_t;
+
+// A range of scene objects culled against every view by a single job. Each job collects its render
+// data separately, and the data is merged into the views in the order of the jobs, so the views
+// end up identical to culling the objects one by one.
+typedef struct cull_job_t {
+
+	uint32_t first_object; // Index of the first culled object in cull_objects
+	uint32_t num_objects; // Number of objects culled by the job
+
+	cull_view_t *views; // Render data of the job for each view in cull_views
+	arr_t(cull_mesh_t) meshes; // Added meshes in the order they were added
+
+	uint32_t triangles_full_detail;
+	uint32_t triangles_submitted;
+
+} cull_job_t;
+
+static arr_t(rview_t*) scene_views; // Views created for the cameras of the scene being rendered
+static arr_t(rview_t*) cull_views; // Views the objects of the scene are added to
+static arr_t(object_t*) cull_objects; // Visible objects of the scene in the order they are culled
+static arr_t(cull_job_t) cull_jobs; // Culling jobs, reused between frames
+
+static rsys_stats_t stats; // Statistics of the previous frame
+static rsys_stats_t frame_stats; // Statistics of the frame being rendered
+
 // -------------------------------------------------------------------------------------------------
 
-static void rsys_cull_object(object_t *object);
-static void rsys_cull_object_meshes(object_t *object, robject_t *parent, rview_t *view);
-static void rsys_add_mesh_to_view(mesh_t *mesh, object_t *object, robject_t *parent, rview_t *view);
+static void rsys_build_view(void *context, uint32_t index);
+static void rsys_cull_scene(scene_t *scene);
+static void rsys_collect_cull_objects(object_t *object);
+static void rsys_cull_objects(void *context, uint32_t index);
+static void rsys_cull_object(object_t *object, cull_job_t *job);
+static void rsys_cull_object_meshes(object_t *object, robject_t *parent, rview_t *view,
+                                    uint32_t view_index, cull_job_t *job);
+static void rsys_add_model_to_view(object_t *object, robject_t *parent, rview_t *view,
+                                   uint32_t view_index, cull_job_t *job);
+static float rsys_get_screen_size(object_t *object, rview_t *view);
+static void rsys_add_mesh_to_view(mesh_t *mesh, robject_t *parent, uint32_t view_index,
+                                  float screen_size, cull_job_t *job);
+static void rsys_merge_cull_job(cull_job_t *job);
+static void rsys_upload_mesh_buffers(mesh_t *mesh);
+static void rsys_collect_view_lights(rview_t *view);
+static void rsys_count_light_fragments(const rview_t *view);
 static rmesh_t *rsys_create_render_mesh(mesh_t *mesh, robject_t *root);
-static void rsys_collect_mesh_lights(rmesh_t *render_mesh, object_t *parent);
-static int rsys_sort_lights_by_distance(const void *p1, const void *p2);
-static void rsys_free_frame_data(void);
+static void rsys_sort_view(rview_t *view);
+static uint64_t rsys_get_sort_key(const rmesh_t *mesh, const rview_t *view);
+static uint32_t rsys_get_mesh_buffer(const rmesh_t *mesh);
+static void rsys_radix_sort(uint64_t *keys, rmesh_t **meshes, uint32_t count);
+static void rsys_record_commands(void);
+static void rsys_record_queue(void *context, uint32_t index);
+static bool rsys_get_mesh_draw(const rmesh_t *mesh, mesh_draw_t *draw);
+static void rsys_record_mesh(cmdbuf_t *buffer, const rmesh_t *mesh, const mesh_draw_t *draw,
+                             record_state_t *state);
+static uint32_t rsys_count_instances(const rmesh_t *mesh, const mesh_draw_t *draw);
+static void rsys_record_instances(cmdbuf_t *buffer, const rmesh_t *mesh, uint32_t count,
+                                  const mesh_draw_t *draw, record_state_t *state);
+static void rsys_record_state(cmdbuf_t *buffer, const rmesh_t *mesh, shader_t *shader,
+                              const mesh_draw_t *draw, record_state_t *state);
+static void rsys_record_uniforms(cmdbuf_t *buffer, const rmesh_t *mesh, shader_t *shader,
+                                 bool program_changed, record_state_t *state);
+static void rsys_free_frame_data(view_list_t *frame_views, light_array_t *frame_lights);
 
 // -------------------------------------------------------------------------------------------------
 
@@ -50,6 +186,8 @@ void rsys_initialize(void)
 	// Initialize renderer backend.
 	rend_initialize();
 	bufcache_initialize();
+	texstream_initialize();
+	mipmap_initialize();
 
 	// Initialize UI parent objects.
 	ui_parent.matrix = mat_identity();
@@ -73,8 +211,36 @@ void rsys_initialize(void)
 
 void rsys_shutdown(void)
 {
+	texstream_shutdown();
 	bufcache_shutdown();
 	rend_shutdown();
+
+	// The renderer has finished drawing, release the data of the last frame.
+	rsys_free_frame_data(&submitted_views, &submitted_lights);
+
+	cmdbuf_t *buffer;
+
+	for (uint32_t i = 0; i < 2; i++) {
+
+		arr_foreach(command_buffers[i], buffer) {
+
+			cmdbuf_destroy(buffer);
+			DESTROY(buffer);
+		}
+
+		arr_clear(command_buffers[i]);
+	}
+
+	arr_clear(recorded_views);
+
+	for (size_t i = 0; i < cull_jobs.count; i++) {
+		arr_clear(cull_jobs.items[i].meshes);
+	}
+
+	arr_clear(cull_jobs);
+	arr_clear(cull_objects);
+	arr_clear(cull_views);
+	arr_clear(scene_views);
 }
 
 void rsys_begin_frame(void)
@@ -120,15 +286,63 @@ void rsys_end_frame(scene_t *scene)
 		debug_end_frame(scene->cameras.items[0]->camera);	
 	}
 	
+	// Sort the meshes of each scene view. UI widgets are drawn in the order they were added.
+	if (is_sorting_draws) {
+
+		rview_t *view;
+
+		list_foreach(views, view) {
+			rsys_sort_view(view);
+		}
+	}
+
 	// Add the UI view to the view list as last.
 	list_push(views, ui_view);
 
+	// Record the draw commands of every view.
+	rsys_record_commands();
+
 	// Finalize by issuing the render views to the renderer backend.
 	rend_draw_views(views.first);
 	rend_end_draw();
 
-	// Release all temporary data.
-	rsys_free_frame_data();
+	const rend_stats_t *draw_stats = rend_get_stats();
+
+	frame_stats.draw_calls = draw_stats->draw_calls;
+	frame_stats.shader_changes = draw_stats->shader_changes;
+	frame_stats.texture_changes = draw_stats->texture_changes;
+	frame_stats.buffer_changes = draw_stats->buffer_changes;
+	frame_stats.gl_calls = draw_stats->gl_calls;
+	frame_stats.gl_calls_skipped = draw_stats->gl_calls_skipped;
+	frame_stats.uniform_calls = draw_stats->uniform_calls;
+	frame_stats.uniform_buffer_bytes = draw_stats->uniform_buffer_bytes;
+	frame_stats.submit_time = draw_stats->submit_time;
+	frame_stats.texture_uploads = draw_stats->texture_uploads;
+	frame_stats.texture_upload_bytes = draw_stats->texture_upload_bytes;
+	frame_stats.pending_texture_uploads = draw_stats->pending_texture_uploads;
+
+	// Load and evict streamed textures based on how large they were drawn this frame.
+	texstream_process();
+
+	// Release all temporary data. When drawing on a render thread, the frame has only been handed
+	// over to it, so the data of the previous frame is released instead.
+	if (rend_is_threaded()) {
+
+		rsys_free_frame_data(&submitted_views, &submitted_lights);
+
+		submitted_views = views;
+		submitted_lights = lights;
+
+		list_init(views);
+		arr_init(lights);
+	}
+	else {
+		rsys_free_frame_data(&views, &lights);
+	}
+
+	// Store the statistics of this frame.
+	stats = frame_stats;
+	frame_stats = (rsys_stats_t){ 0 };
 
 	++frames_rendered;
 }
@@ -139,6 +353,8 @@ void rsys_render_scene(scene_t *scene)
 		return;
 	}
 
+	uint64_t build_start = timer_get_microseconds();
+
 	// Collect info about the objects in the scene before rendering anything and process culling etc.
 	// TODO: Also use a proper temp allocator because this is alloc heavy!
 
@@ -159,12 +375,18 @@ void rsys_render_scene(scene_t *scene)
 		light_get_shader_params(light->light);
 		mat_cpy(&render_light->shader_params, &light->light->shader_params);
 
+		// The views are built in parallel, so update the transform of the light before they read it.
+		obj_get_transform(light);
+
 		arr_push(lights, render_light);
 	}
 
-	// Create a separate render view for every camera in the scene.
+	// Create a separate render view for every camera in the scene. Camera matrices are updated on
+	// demand, so they are copied here before the views are built.
 	object_t *camera;
 
+	scene_views.count = 0;
+
 	arr_foreach(scene->cameras, camera) {
 
 		if (camera == NULL || !camera->is_active) {
@@ -177,27 +399,11 @@ void rsys_render_scene(scene_t *scene)
 		mat_cpy(&view->projection, camera_get_projection_matrix(camera->camera));
 		mat_cpy(&view->view, camera_get_view_matrix(camera->camera));
 
-		// Calculate view-projection matrix for the camera.
-		mat_multiply(
-			view->projection,
-			view->view,
-			&view->view_projection
-		);
-
-		// Calculate inverse matrices.
-		view->view_inv = mat_invert(view->view);
-		view->projection_inv = mat_invert(view->projection);
-		view->view_projection_inv = mat_invert(view->view_projection);
-
 		view->view_position = vec3_to_vec4(obj_get_position(camera));
 		view->ambient_light = col_to_vec4(scene->ambient_light);
 		view->near_plane = camera->camera->clip_near;
 		view->far_plane = camera->camera->clip_far;
 
-		// Initialize a virtual root object.
-		view->root.matrix = mat_identity();
-		view->root.mvp = view->view_projection;
-
 		// Apply post processing effects.
 		shader_t *effect;
 		
@@ -205,40 +411,35 @@ void rsys_render_scene(scene_t *scene)
 			arr_push(view->post_processing_effects, effect);
 		}
 
-		// When rendering in deferred mode, add a list of lights affecting this view.
-		// TODO: Actually check which lights are in the view! For now we're just copying all lights.
-		if (is_using_deferred_lighting) {
+		arr_push(scene_views, view);
+	}
 
-			view->lights = mem_alloc_fast(lights.count * sizeof(rlight_t*));
-			view->num_lights = lights.count;
+	// Build each view as an independent job.
+	parallel_for(rsys_build_view, NULL, scene_views.count);
 
-			int light_index;
+	// Add the views to the list of views to be rendered in the order of the cameras.
+	rview_t *view;
 
-			arr_foreach_iter(lights, light_index) {
-				view->lights[light_index] = lights.items[light_index];
-			}
+	arr_foreach(scene_views, view) {
+
+		if (is_using_deferred_lighting) {
+			rsys_count_light_fragments(view);
 		}
 		else {
-			view->lights = NULL;
-			view->num_lights = 0;
+
+			// In forward mode the lights are assigned to the clusters of the view, and each
+			// fragment only processes the lights of its own cluster. The grids are built after the
+			// view jobs, because building a grid is a parallel_for() of its own.
+			view->light_grid = lightgrid_create(view, lights.items, lights.count);
 		}
 
-		// Add the view to the list of views to be rendered.
 		list_push(views, view);
 	}
 
-	// TODO: Find which scene objects are visible in the current camera (for now add all objects).
-	// TODO: Sort transparent objects by depth! Otherwise if we render a transparent object first
-	// which is in front of other objects, it will render the clear colour! (see fader sprite in the
-	// example project)
-	object_t *object;
-
-	arr_foreach(scene->objects, object) {
+	// Add the visible objects of the scene to the views.
+	rsys_cull_scene(scene);
 
-		if (object != NULL && object->is_active) {
-			rsys_cull_object(object);
-		}
-	}
+	frame_stats.build_time += (uint32_t)(timer_get_microseconds() - build_start);
 }
 
 void rsys_render_mesh(mesh_t *mesh, bool is_ui_mesh)
@@ -299,7 +500,123 @@ void rsys_render_mesh(mesh_t *mesh, bool is_ui_mesh)
 	}
 }
 
-static void rsys_cull_object(object_t *object)
+void rsys_set_lod_bias(float bias)
+{
+	lod_bias = MAX(bias, 0.0f);
+}
+
+float rsys_get_lod_bias(void)
+{
+	return lod_bias;
+}
+
+void rsys_set_draw_sorting(bool enabled)
+{
+	is_sorting_draws = enabled;
+}
+
+bool rsys_get_draw_sorting(void)
+{
+	return is_sorting_draws;
+}
+
+const rsys_stats_t *rsys_get_stats(void)
+{
+	return &stats;
+}
+
+static void rsys_build_view(void *context, uint32_t index)
+{
+	UNUSED(context);
+
+	rview_t *view = scene_views.items[index];
+
+	// Calculate view-projection matrix for the camera.
+	mat_multiply(
+		view->projection,
+		view->view,
+		&view->view_projection
+	);
+
+	// Calculate inverse matrices.
+	view->view_inv = mat_invert(view->view);
+	view->projection_inv = mat_invert(view->projection);
+	view->view_projection_inv = mat_invert(view->view_projection);
+
+	// Initialize a virtual root object.
+	view->root.matrix = mat_identity();
+	view->root.mvp = view->view_projection;
+
+	// When rendering in deferred mode, add a list of lights affecting this view along with the
+	// part of the screen each light can reach.
+	if (is_using_deferred_lighting) {
+		rsys_collect_view_lights(view);
+	}
+	else {
+
+		// Forward lights are assigned to the light grid of the view once the views are built.
+		view->lights = NULL;
+		view->num_lights = 0;
+	}
+}
+
+static void rsys_cull_scene(scene_t *scene)
+{
+	// Objects are added to every view rendered this frame, including the views of earlier scenes.
+	rview_t *view;
+
+	cull_views.count = 0;
+
+	list_foreach(views, view) {
+		arr_push(cull_views, view);
+	}
+
+	// TODO: Find which scene objects are visible in the current camera (for now add all objects).
+	object_t *object;
+
+	cull_objects.count = 0;
+
+	arr_foreach(scene->objects, object) {
+
+		if (object != NULL && object->is_active) {
+			rsys_collect_cull_objects(object);
+		}
+	}
+
+	if (cull_objects.count == 0 || cull_views.count == 0) {
+		return;
+	}
+
+	// Split the objects into chunks which are culled against every view in parallel.
+	uint32_t num_jobs = (cull_objects.count + OBJECTS_PER_CULL_JOB - 1) / OBJECTS_PER_CULL_JOB;
+
+	while (cull_jobs.count < num_jobs) {
+
+		cull_job_t job = { 0 };
+		arr_push(cull_jobs, job);
+	}
+
+	for (uint32_t i = 0; i < num_jobs; i++) {
+
+		cull_job_t *job = &cull_jobs.items[i];
+
+		job->first_object = i * OBJECTS_PER_CULL_JOB;
+		job->num_objects = MIN(OBJECTS_PER_CULL_JOB, cull_objects.count - job->first_object);
+		job->views = mem_alloc(cull_views.count * sizeof(cull_view_t));
+		job->meshes.count = 0;
+		job->triangles_full_detail = 0;
+		job->triangles_submitted = 0;
+	}
+
+	parallel_for(rsys_cull_objects, NULL, num_jobs);
+
+	// Merge the render data of the jobs in order.
+	for (uint32_t i = 0; i < num_jobs; i++) {
+		rsys_merge_cull_job(&cull_jobs.items[i]);
+	}
+}
+
+static void rsys_collect_cull_objects(object_t *object)
 {
 	if (object == NULL) {
 		return;
@@ -310,55 +627,70 @@ static void rsys_cull_object(object_t *object)
 		object->sprite != NULL ||
 		object->emitter != NULL) {
 
-		// Add the scene object to each of the views as a render object.
-		rview_t *view;
+		// Transforms are updated on demand, which is not thread safe. Update the transform here so
+		// the culling jobs only read it.
+		obj_get_transform(object);
 
-		list_foreach(views, view) {
+		arr_push(cull_objects, object);
+	}
 
-			NEW(robject_t, obj);
+	// Add all of the child objects, too.
+	object_t *child;
 
-			// Copy matrices.
-			mat_cpy(&obj->matrix, obj_get_transform(object));
+	arr_foreach(object->children, child) {
+		rsys_collect_cull_objects(child);
+	}
+}
 
-			mat_multiply(
-				view->view_projection,
-				obj->matrix,
-				&obj->mvp);
+static void rsys_cull_objects(void *context, uint32_t index)
+{
+	UNUSED(context);
 
-			list_push(view->objects, obj);
+	cull_job_t *job = &cull_jobs.items[index];
 
-			// Cull object meshes.
-			rsys_cull_object_meshes(object, obj, view);
-		}
+	for (uint32_t i = 0; i < job->num_objects; i++) {
+		rsys_cull_object(cull_objects.items[job->first_object + i], job);
 	}
-	
-	// Add all of the child objects, too.
-	object_t *child;
+}
 
-	arr_foreach(object->children, child) {
-		rsys_cull_object(child);
+static void rsys_cull_object(object_t *object, cull_job_t *job)
+{
+	// Add the scene object to each of the views as a render object.
+	for (uint32_t i = 0; i < cull_views.count; i++) {
+
+		rview_t *view = cull_views.items[i];
+
+		NEW(robject_t, obj);
+
+		// Copy matrices.
+		mat_cpy(&obj->matrix, obj_get_transform(object));
+
+		mat_multiply(
+			view->view_projection,
+			obj->matrix,
+			&obj->mvp);
+
+		list_push(job->views[i].objects, obj);
+
+		// Cull object meshes.
+		rsys_cull_object_meshes(object, obj, view, i, job);
 	}
 }
 
-static void rsys_cull_object_meshes(object_t *object, robject_t *parent, rview_t *view)
+static void rsys_cull_object_meshes(object_t *object, robject_t *parent, rview_t *view,
+                                    uint32_t view_index, cull_job_t *job)
 {
 	// TODO: HANDLE ACTUAL CULLING HERE
 	
 	// 3D model meshes
 	if (object->model != NULL) {
-
-		mesh_t *mesh;
-		arr_foreach(object->model->meshes, mesh) {
-
-			if (mesh != NULL) {
-				rsys_add_mesh_to_view(mesh, object, parent, view);
-			}
-		}
+		rsys_add_model_to_view(object, parent, view, view_index, job);
 	}
 
-	// 2D sprite mesh
+	// 2D sprite mesh. Sprites and particles are not projected, so their textures are requested
+	// at full size.
 	if (object->sprite != NULL && object->sprite->mesh != NULL) {
-		rsys_add_mesh_to_view(object->sprite->mesh, object, parent, view);
+		rsys_add_mesh_to_view(object->sprite->mesh, parent, view_index, 1.0f, job);
 	}
 
 	// Particle emitter mesh(es)
@@ -374,7 +706,7 @@ static void rsys_cull_object_meshes(object_t *object, robject_t *parent, rview_t
 				subemitter->mesh != NULL &&
 				subemitter->mesh->num_indices_to_render != 0) {
 
-				rsys_add_mesh_to_view(subemitter->mesh, object, parent, view);
+				rsys_add_mesh_to_view(subemitter->mesh, parent, view_index, 1.0f, job);
 			}
 		}
 
@@ -382,12 +714,171 @@ static void rsys_cull_object_meshes(object_t *object, robject_t *parent, rview_t
 		if (object->emitter->mesh != NULL &&
 			object->emitter->is_active) {
 
-			rsys_add_mesh_to_view(object->emitter->mesh, object, parent, view);
+			rsys_add_mesh_to_view(object->emitter->mesh, parent, view_index, 1.0f, job);
 		}
 	}
 }
 
-static void rsys_add_mesh_to_view(mesh_t *mesh, object_t *object, robject_t *parent, rview_t *view)
+static void rsys_add_model_to_view(object_t *object, robject_t *parent, rview_t *view,
+                                   uint32_t view_index, cull_job_t *job)
+{
+	model_t *model = object->model;
+
+	// Select a detail level based on how large the model appears in this view. The selected level
+	// is stored for hysteresis, views past the last slot share the last slot. The size also
+	// determines the mip levels needed from the textures of the model.
+	uint32_t lod = 0;
+	float screen_size = rsys_get_screen_size(object, view);
+
+	if (model->num_lods != 0) {
+
+		uint8_t *previous_lod = &object->lod_levels[MIN(view_index, MAX_LOD_VIEWS - 1)];
+
+		lod = model_select_lod(model, screen_size * lod_bias, *previous_lod);
+		*previous_lod = (uint8_t)lod;
+	}
+
+	mesh_t **meshes = model->meshes.items;
+	size_t num_meshes = model->meshes.count;
+	uint32_t num_triangles = model->num_triangles;
+
+	if (lod != 0) {
+
+		meshes = model->lods[lod - 1].meshes.items;
+		num_meshes = model->lods[lod - 1].meshes.count;
+		num_triangles = model->lods[lod - 1].num_triangles;
+	}
+
+	job->triangles_full_detail += model->num_triangles;
+	job->triangles_submitted += num_triangles;
+
+	for (size_t i = 0; i < num_meshes; i++) {
+
+		if (meshes[i] != NULL) {
+			rsys_add_mesh_to_view(meshes[i], parent, view_index, screen_size, job);
+		}
+	}
+}
+
+static float rsys_get_screen_size(object_t *object, rview_t *view)
+{
+	model_t *model = object->model;
+
+	// Calculate the bounding sphere of the model in world space.
+	vec3_t scale = obj_get_scale(object);
+	float max_scale = MAX(ABS(scale.x), MAX(ABS(scale.y), ABS(scale.z)));
+	float radius = model->bounds_radius * max_scale;
+
+	// In an orthographic projection the size of the model does not depend on its distance.
+	if (view->projection.col[3][3] == 1.0f) {
+		return radius * view->projection.col[1][1];
+	}
+
+	// Project the sphere through the view's projection to get the portion of the screen height
+	// it covers.
+	vec3_t centre = mat_multiply3(*obj_get_transform(object), model->bounds_centre);
+	vec3_t view_centre = mat_multiply3(view->view, centre);
+
+	float distance = view_centre.z;
+
+	if (distance <= radius) {
+		return 1.0f;
+	}
+
+	return radius * view->projection.col[1][1] / distance;
+}
+
+static void rsys_add_mesh_to_view(mesh_t *mesh, robject_t *parent, uint32_t view_index,
+                                  float screen_size, cull_job_t *job)
+{
+	// Create a new render mesh as a copy for the renderer.
+	NEW(rmesh_t, rmesh);
+
+	rmesh->parent = parent;
+	rmesh->vertex_type = mesh->vertex_type;
+
+	// Set shader and texture from material.
+	if (mesh->material != NULL) {
+
+		rmesh->shader = mesh->material->shader;
+		rmesh->texture = mesh->material->texture;
+		rmesh->normal_map = mesh->material->normal_map;
+	}
+
+	// If the mesh defines override texture or shader, use them.
+	rmesh->shader = (mesh->shader != NULL ? mesh->shader : rmesh->shader);
+	rmesh->texture = (mesh->texture != NULL ? mesh->texture : rmesh->texture);
+
+	// Use default shader which renders the mesh in purple if no other shader is defined.
+	if (rmesh->shader == NULL) {
+		rmesh->shader = default_shader;
+	}
+
+	// The parameters of the material only apply to the material's own shader.
+	if (mesh->material != NULL && rmesh->shader == mesh->material->shader) {
+		rmesh->material = mesh->material;
+	}
+
+	// Add the mesh to the view to a render queue determined by its shader. The buffers of the mesh
+	// are assigned once they have been uploaded.
+	list_push(job->views[view_index].meshes[rmesh->shader->queue], rmesh);
+
+	cull_mesh_t added = { mesh, rmesh, screen_size };
+	arr_push(job->meshes, added);
+}
+
+static void rsys_merge_cull_job(cull_job_t *job)
+{
+	// Upload the buffers of the added meshes in the order the meshes were added.
+	for (size_t i = 0; i < job->meshes.count; i++) {
+
+		cull_mesh_t *added = &job->meshes.items[i];
+
+		rsys_upload_mesh_buffers(added->mesh);
+
+		added->rmesh->vertices = added->mesh->vertex_buffer;
+		added->rmesh->indices = added->mesh->index_buffer;
+
+		texstream_request(added->rmesh->texture, added->screen_size);
+		texstream_request(added->rmesh->normal_map, added->screen_size);
+
+		// Compile the instancing variant of the shader the first time a mesh which could be
+		// instanced is drawn with it. Commands are recorded in parallel, so this can't be done
+		// while recording.
+		if (added->rmesh->vertex_type == VERTEX_NORMAL && added->rmesh->parent != NULL) {
+			shader_get_instanced_variant(added->rmesh->shader);
+		}
+	}
+
+	// Move the render objects and meshes to the views.
+	for (uint32_t i = 0; i < cull_views.count; i++) {
+
+		rview_t *view = cull_views.items[i];
+		cull_view_t *data = &job->views[i];
+
+		robject_t *obj, *tmp_obj;
+
+		list_foreach_safe(data->objects, obj, tmp_obj) {
+			list_push(view->objects, obj);
+		}
+
+		for (int queue = 0; queue < NUM_QUEUES; queue++) {
+
+			rmesh_t *mesh, *tmp_mesh;
+
+			list_foreach_safe(data->meshes[queue], mesh, tmp_mesh) {
+				list_push(view->meshes[queue], mesh);
+			}
+		}
+	}
+
+	frame_stats.triangles_full_detail += job->triangles_full_detail;
+	frame_stats.triangles_submitted += job->triangles_submitted;
+
+	DESTROY(job->views);
+}
+
+static void rsys_upload_mesh_buffers(mesh_t *mesh)
 {
 	// Upload vertex and data to the GPU. If the data is already copied to buffer objects,
 	// refresh them to avoid automatic cleanup.
@@ -432,43 +923,53 @@ static void rsys_add_mesh_to_view(mesh_t *mesh, object_t *object, robject_t *par
 			mesh->is_index_data_dirty = false;
 		}
 	}
+}
 
-	// Create a new render mesh as a copy for the renderer.
-	NEW(rmesh_t, rmesh);
+static void rsys_collect_view_lights(rview_t *view)
+{
+	view->lights = mem_alloc_fast(lights.count * sizeof(rlight_t*));
+	view->light_rects = mem_alloc_fast(lights.count * sizeof(vec4_t));
+	view->num_lights = 0;
 
-	rmesh->parent = parent;
-	rmesh->vertex_type = mesh->vertex_type;
-	rmesh->vertices = mesh->vertex_buffer;
-	rmesh->indices = mesh->index_buffer;
+	// Cull the lights against the view and store the screen space rectangle of each visible light.
+	rlight_t *light;
 
-	// Set shader and texture from material.
-	if (mesh->material != NULL) {
+	arr_foreach(lights, light) {
 
-		rmesh->shader = mesh->material->shader;
-		rmesh->texture = mesh->material->texture;
-		rmesh->normal_map = mesh->material->normal_map;
-	}
+		vec4_t rect;
+		float min_depth, max_depth;
 
-	// If the mesh defines override texture or shader, use them.
-	rmesh->shader = (mesh->shader != NULL ? mesh->shader : rmesh->shader);
-	rmesh->texture = (mesh->texture != NULL ? mesh->texture : rmesh->texture);
+		if (!lightgrid_get_light_extents(view, light->light, &rect, &min_depth, &max_depth)) {
+			continue;
+		}
 
-	// Use default shader which renders the mesh in purple if no other shader is defined.
-	if (rmesh->shader == NULL) {
-		rmesh->shader = default_shader;
+		view->lights[view->num_lights] = light;
+		view->light_rects[view->num_lights] = rect;
+		view->num_lights++;
 	}
+}
+
+static void rsys_count_light_fragments(const rview_t *view)
+{
+	// Estimate the number of fragments shaded by the lighting passes. The baseline is the cost of
+	// drawing every light in the scene as a full screen pass.
+	uint16_t screen_width, screen_height;
+	mylly_get_resolution(&screen_width, &screen_height);
+
+	float screen_area = (float)screen_width * screen_height;
+
+	frame_stats.deferred_fragments += (uint64_t)screen_area;
+	frame_stats.deferred_fragments_full_screen += (uint64_t)(screen_area * (1 + lights.count));
+
+	for (uint32_t i = 0; i < view->num_lights; i++) {
 
-	// If the material used by the mesh is affected by lighting, collect all the lights contributing
-	// to the mesh. This is only done if the rendering mode is forward - all lights are rendered
-	// as a post process effect in the deferred lighting mode.
-	if (shader_is_affected_by_light(rmesh->shader) &&
-		!is_using_deferred_lighting) {
+		vec4_t rect = view->light_rects[i];
 
-		rsys_collect_mesh_lights(rmesh, object);
+		float area = 0.25f * (rect.z - rect.x) * (rect.w - rect.y);
+		frame_stats.deferred_fragments += (uint64_t)(area * screen_area);
 	}
 
-	// Add the mesh to the view to a render queue determined by its shader.
-	list_push(view->meshes[rmesh->shader->queue], rmesh);
+	frame_stats.deferred_lights_drawn += view->num_lights;
 }
 
 static rmesh_t *rsys_create_render_mesh(mesh_t *mesh, robject_t *root)
@@ -507,93 +1008,502 @@ static rmesh_t *rsys_create_render_mesh(mesh_t *mesh, robject_t *root)
 		rmesh->shader = default_shader;
 	}
 
+	// The parameters of the material only apply to the material's own shader.
+	if (mesh->material != NULL && rmesh->shader == mesh->material->shader) {
+		rmesh->material = mesh->material;
+	}
+
+	// Meshes drawn outside the scenes (UI and debug meshes) need their textures at full size.
+	texstream_request(rmesh->texture, 1.0f);
+	texstream_request(rmesh->normal_map, 1.0f);
+
 	return rmesh;
 }
 
-static void rsys_collect_mesh_lights(rmesh_t *render_mesh, object_t *parent)
+static void rsys_sort_view(rview_t *view)
 {
-	// TODO: This part currently adds all the nearest lights to the mesh. Once the meshes and
-	// objects have bounding boxes, see whether the light even reaches the mesh at all.
-	rlight_t *contributing_lights[100];
-	uint32_t num_lights = 0;
+	for (int queue = 0; queue < NUM_QUEUES; queue++) {
 
-	vec3_t position = obj_get_position(parent);
-	rlight_t *light;
+		// Overlays are drawn in the order they were added.
+		if (queue == QUEUE_OVERLAY) {
+			continue;
+		}
 
-	arr_foreach(lights, light) {
+		uint32_t count = 0;
+		rmesh_t *mesh;
+
+		list_foreach(view->meshes[queue], mesh) {
+			count++;
+		}
+
+		if (count < 2) {
+			continue;
+		}
+
+		// Collect the meshes and their keys into arrays for sorting.
+		uint64_t *keys = mem_alloc_fast(count * sizeof(uint64_t));
+		rmesh_t **meshes = mem_alloc_fast(count * sizeof(rmesh_t *));
+
+		uint32_t index = 0;
 
-		light_t *scene_light = light->light;
+		list_foreach(view->meshes[queue], mesh) {
 
-		if (scene_light->type == LIGHT_DIRECTIONAL) {
+			mesh->sort_key = rsys_get_sort_key(mesh, view);
 
-			// Directional lights will always affect the mesh.
-			light->dist_sq = 0;
+			keys[index] = mesh->sort_key;
+			meshes[index] = mesh;
+			index++;
 		}
-		else {
 
-			// Calculate the (squared) distance of the light to the mesh.
-			// TODO: Take into account the cone of a spotlight!
-			vec3_t light_position = obj_get_position(scene_light->parent);
-			light->dist_sq = vec3_distance_sq(position, light_position);
+		rsys_radix_sort(keys, meshes, count);
+
+		// Rebuild the list in the sorted order.
+		list_init(view->meshes[queue]);
+
+		for (index = 0; index < count; index++) {
+			list_push(view->meshes[queue], meshes[index]);
 		}
-		
-		// If the mesh is within the light's range, add the light to the list of potential
-		// light sources.
-		if (light->dist_sq < SQUARED(scene_light->range)) {
 
-			contributing_lights[num_lights++] = light;
+		mem_free(keys);
+		mem_free(meshes);
+	}
+}
+
+static uint64_t rsys_get_sort_key(const rmesh_t *mesh, const rview_t *view)
+{
+	uint64_t queue = (uint64_t)mesh->shader->queue;
+	uint64_t shader = mesh->shader->program & SORT_KEY_ID_MASK;
+	uint64_t material = (mesh->material != NULL ? mesh->material->id : 0) & SORT_KEY_ID_MASK;
+	uint64_t texture = (mesh->texture != NULL ? mesh->texture->gpu_texture : 0) & SORT_KEY_ID_MASK;
+	uint64_t buffer = rsys_get_mesh_buffer(mesh) & SORT_KEY_ID_MASK;
+
+	// Quantize the view space depth of the parent object between the clip planes.
+	const mat_t *matrix = &mesh->parent->matrix;
+	vec3_t position = vec3(matrix->col[3][0], matrix->col[3][1], matrix->col[3][2]);
+
+	float depth = mat_multiply3(view->view, position).z;
+	float range = MAX(view->far_plane - view->near_plane, 0.001f);
+
+	depth = CLAMP((depth - view->near_plane) / range, 0.0f, 1.0f);
+
+	uint64_t depth_bits = (uint64_t)(depth * SORT_KEY_DEPTH_MASK);
+	uint64_t key = (queue << SORT_KEY_QUEUE_SHIFT);
+
+	if (queue == QUEUE_TRANSPARENT) {
+
+		key |= (SORT_KEY_DEPTH_MASK - depth_bits) << (4 * SORT_KEY_ID_BITS);
+		key |= (shader << (3 * SORT_KEY_ID_BITS));
+		key |= (material << (2 * SORT_KEY_ID_BITS));
+		key |= (texture << SORT_KEY_ID_BITS);
+		key |= buffer;
+	}
+	else {
+
+		key |= (shader << (SORT_KEY_DEPTH_BITS + 3 * SORT_KEY_ID_BITS));
+		key |= (material << (SORT_KEY_DEPTH_BITS + 2 * SORT_KEY_ID_BITS));
+		key |= (texture << (SORT_KEY_DEPTH_BITS + SORT_KEY_ID_BITS));
+		key |= (buffer << SORT_KEY_DEPTH_BITS);
+		key |= depth_bits;
+	}
+
+	return key;
+}
+
+static uint32_t rsys_get_mesh_buffer(const rmesh_t *mesh)
+{
+	if (mesh->handle_vertices != 0) {
+		return bufcache_get(BUFFER_GET_INDEX(mesh->handle_vertices))->vertex_buffer.object;
+	}
+	if (mesh->vertices != NULL) {
+		return mesh->vertices->vbo;
+	}
+
+	return 0;
+}
+
+static void rsys_radix_sort(uint64_t *keys, rmesh_t **meshes, uint32_t count)
+{
+	// Least significant digit first radix sort, 8 bits per pass. The sort is stable, so meshes with
+	// equal keys are kept in the order they were added.
+	uint64_t *tmp_keys = mem_alloc_fast(count * sizeof(uint64_t));
+	rmesh_t **tmp_meshes = mem_alloc_fast(count * sizeof(rmesh_t *));
+
+	uint64_t *src_keys = keys, *dst_keys = tmp_keys;
+	rmesh_t **src_meshes = meshes, **dst_meshes = tmp_meshes;
+
+	for (uint32_t shift = 0; shift < 64; shift += 8) {
+
+		uint32_t offsets[256] = { 0 };
+
+		for (uint32_t i = 0; i < count; i++) {
+			offsets[(src_keys[i] >> shift) & 0xFF]++;
+		}
+
+		// Skip the pass if every key has the same digit.
+		if (offsets[(src_keys[0] >> shift) & 0xFF] == count) {
+			continue;
+		}
+
+		uint32_t offset = 0;
+
+		for (uint32_t digit = 0; digit < 256; digit++) {
+
+			uint32_t digit_count = offsets[digit];
+
+			offsets[digit] = offset;
+			offset += digit_count;
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+
+			uint32_t target = offsets[(src_keys[i] >> shift) & 0xFF]++;
+
+			dst_keys[target] = src_keys[i];
+			dst_meshes[target] = src_meshes[i];
+		}
+
+		uint64_t *swap_keys = src_keys;
+		src_keys = dst_keys;
+		dst_keys = swap_keys;
+
+		rmesh_t **swap_meshes = src_meshes;
+		src_meshes = dst_meshes;
+		dst_meshes = swap_meshes;
+	}
+
+	// Make sure the result ends up in the original arrays.
+	if (src_keys != keys) {
+
+		memcpy(keys, src_keys, count * sizeof(uint64_t));
+		memcpy(meshes, src_meshes, count * sizeof(rmesh_t *));
+	}
+
+	mem_free(tmp_keys);
+	mem_free(tmp_meshes);
+}
+
+static void rsys_record_commands(void)
+{
+	uint64_t record_start = timer_get_microseconds();
+
+	// Each render queue of each view is recorded into its own command buffer, so the buffers can
+	// be recorded in parallel. The buffers keep their memory between frames.
+	rview_t *view;
+
+	recorded_views.count = 0;
+
+	list_foreach(views, view) {
+		arr_push(recorded_views, view);
+	}
+
+	uint32_t num_buffers = recorded_views.count * NUM_QUEUES;
+	uint32_t set = frames_rendered & 1;
+
+	while (command_buffers[set].count < num_buffers) {
+
+		NEW(cmdbuf_t, buffer);
+		cmdbuf_init(buffer);
+
+		arr_push(command_buffers[set], buffer);
+	}
+
+	for (uint32_t i = 0; i < num_buffers; i++) {
+
+		cmdbuf_t *buffer = command_buffers[set].items[i];
+		cmdbuf_reset(buffer);
+
+		recorded_views.items[i / NUM_QUEUES]->commands[i % NUM_QUEUES] = buffer;
+	}
+
+	parallel_for(rsys_record_queue, NULL, num_buffers);
+
+	// Changed material uniforms have been recorded into every buffer using them, so the changes
+	// can be marked as handled.
+	rmesh_t *mesh;
+
+	list_foreach(views, view) {
+		for (int queue = 0; queue < NUM_QUEUES; queue++) {
 
-			if (num_lights >= 100) {
-				break;
+			list_foreach(view->meshes[queue], mesh) {
+
+				if (mesh->shader != NULL) {
+					mesh->shader->dirty_uniforms = 0;
+				}
 			}
+
+			frame_stats.command_bytes += (uint32_t)view->commands[queue]->size;
+			frame_stats.instances_drawn += view->commands[queue]->num_instances;
 		}
 	}
 
-	// No lights contributing to the lighting of the mesh.
-	if (num_lights == 0) {
+	frame_stats.record_time = (uint32_t)(timer_get_microseconds() - record_start);
+}
 
-		render_mesh->num_lights = 0;
-		return;
+static void rsys_record_queue(void *context, uint32_t index)
+{
+	UNUSED(context);
+
+	rview_t *view = recorded_views.items[index / NUM_QUEUES];
+	int queue = index % NUM_QUEUES;
+	cmdbuf_t *buffer = view->commands[queue];
+
+	record_state_t state = { 0 };
+	state.depth_write = -1;
+
+	rmesh_t *mesh = view->meshes[queue].first;
+
+	while (mesh != NULL) {
+
+		mesh_draw_t draw;
+		uint32_t count = 1;
+
+		// Meshes without vertex data are skipped.
+		if (rsys_get_mesh_draw(mesh, &draw)) {
+
+			count = rsys_count_instances(mesh, &draw);
+
+			if (count >= MIN_INSTANCES) {
+				rsys_record_instances(buffer, mesh, count, &draw, &state);
+			}
+			else {
+
+				count = 1;
+				rsys_record_mesh(buffer, mesh, &draw, &state);
+			}
+		}
+
+		for (uint32_t i = 0; i < count; i++) {
+			mesh = list_next(mesh);
+		}
 	}
+}
+
+static bool rsys_get_mesh_draw(const rmesh_t *mesh, mesh_draw_t *draw)
+{
+	draw->primitive = CMD_PRIMITIVE_TRIANGLES;
 
-	// If there are more lights contributing to the lighting of the mesh than our shaders would
-	// support, select only the closest ones.
-	// TODO: Select only the highest intensity ones?
-	if (num_lights > MAX_LIGHTS_PER_MESH) {
+	// Find the vertex and index buffers of the mesh.
+	if (mesh->handle_vertices != 0 && mesh->handle_indices != 0) {
 
-		qsort(contributing_lights,
-		      num_lights,
-		      sizeof(contributing_lights[0]),
-		      rsys_sort_lights_by_distance
-		);
+		// Mesh uses a buffer handle (i.e. only a part of the buffer is drawn).
+		bufcache_t *cache = bufcache_get(BUFFER_GET_INDEX(mesh->handle_vertices));
+
+		draw->vertices = cache->vertex_buffer.object;
+		draw->indices = cache->index_buffer.object;
+
+		draw->first_index = BUFFER_GET_OFFSET(mesh->handle_indices) / sizeof(vindex_t);
+		draw->num_indices = BUFFER_GET_SIZE(mesh->handle_indices) / sizeof(vindex_t);
+
+		if (BUFFER_GET_INDEX(mesh->handle_vertices) == BUFIDX_DEBUG_LINE) {
+			draw->primitive = CMD_PRIMITIVE_LINES;
+		}
 	}
+	else if (mesh->vertices != NULL && mesh->indices != NULL) {
 
-	uint32_t count = MIN(num_lights, MAX_LIGHTS_PER_MESH);
+		// Mesh uses a buffer cache object (i.e. the entire buffer is drawn).
+		draw->vertices = mesh->vertices->vbo;
+		draw->indices = mesh->indices->vbo;
 
-	render_mesh->num_lights = count;
+		draw->first_index = 0;
+		draw->num_indices = mesh->indices->count;
+	}
+	else {
 
-	// Copy references to the contributing render lights to the mesh.
-	for (uint32_t i = 0; i < count; i++) {
-		render_mesh->lights[i] = contributing_lights[i];
+		// Mesh does not contain vertex data, unable to render.
+		return false;
 	}
+
+	return true;
 }
 
-static int rsys_sort_lights_by_distance(const void *p1, const void *p2)
+static void rsys_record_mesh(cmdbuf_t *buffer, const rmesh_t *mesh, const mesh_draw_t *draw,
+                             record_state_t *state)
 {
-	const rlight_t *light1 = *(const rlight_t **)p1;
-	const rlight_t *light2 = *(const rlight_t **)p2;
+	rsys_record_state(buffer, mesh, mesh->shader, draw, state);
 
-	if (light1->dist_sq < light2->dist_sq) return -1;
-	if (light1->dist_sq > light2->dist_sq) return 1;
-	return 0;
+	// Per-object constants are set for every draw.
+	if (mesh->parent != NULL) {
+		cmdbuf_set_object(buffer, &mesh->parent->mvp, &mesh->parent->matrix);
+	}
+	else {
+
+		mat_t identity = mat_identity();
+		cmdbuf_set_object(buffer, &identity, &identity);
+	}
+
+	cmdbuf_draw(buffer, draw->primitive, draw->first_index, draw->num_indices);
 }
 
-static void rsys_free_frame_data(void)
+static uint32_t rsys_count_instances(const rmesh_t *mesh, const mesh_draw_t *draw)
+{
+	// Instances get their model matrix from their parent object, and only shaders with an
+	// instancing variant can draw them.
+	if (mesh->shader == NULL ||
+		mesh->shader->instanced == NULL ||
+		mesh->vertex_type != VERTEX_NORMAL ||
+		mesh->parent == NULL) {
+
+		return 1;
+	}
+
+	uint32_t count = 1;
+	mesh_draw_t next_draw;
+
+	for (rmesh_t *next = list_next(mesh); next != NULL; next = list_next(next)) {
+
+		if (next->shader != mesh->shader ||
+			next->material != mesh->material ||
+			next->texture != mesh->texture ||
+			next->normal_map != mesh->normal_map ||
+			next->vertex_type != mesh->vertex_type ||
+			next->parent == NULL ||
+			!rsys_get_mesh_draw(next, &next_draw) ||
+			next_draw.vertices != draw->vertices ||
+			next_draw.indices != draw->indices ||
+			next_draw.first_index != draw->first_index ||
+			next_draw.num_indices != draw->num_indices) {
+
+			break;
+		}
+
+		count++;
+	}
+
+	return count;
+}
+
+static void rsys_record_instances(cmdbuf_t *buffer, const rmesh_t *mesh, uint32_t count,
+                                  const mesh_draw_t *draw, record_state_t *state)
+{
+	rsys_record_state(buffer, mesh, mesh->shader->instanced, draw, state);
+
+	// The model matrices are stored in the commands. A single command can only store a limited
+	// number of them, so long runs are split into several draws.
+	while (count > 0) {
+
+		uint32_t num_instances = MIN(count, CMD_MAX_INSTANCES);
+
+		mat_t *models = cmdbuf_draw_instanced(buffer, draw->primitive, draw->first_index,
+		                                      draw->num_indices, num_instances);
+
+		for (uint32_t i = 0; i < num_instances; i++) {
+
+			models[i] = mesh->parent->matrix;
+			mesh = list_next(mesh);
+		}
+
+		count -= num_instances;
+	}
+}
+
+static void rsys_record_state(cmdbuf_t *buffer, const rmesh_t *mesh, shader_t *shader,
+                              const mesh_draw_t *draw, record_state_t *state)
+{
+	// Material. Depth writes are disabled for particles.
+	if (shader != NULL) {
+
+		bool depth_write = (mesh->vertex_type != VERTEX_PARTICLE);
+		bool program_changed = (shader->program != state->program);
+
+		if (program_changed ||
+			(int)depth_write != state->depth_write) {
+
+			cmdbuf_set_pipeline(buffer, shader->program, depth_write);
+
+			state->program = shader->program;
+			state->depth_write = (int)depth_write;
+		}
+
+		rsys_record_uniforms(buffer, mesh, shader, program_changed, state);
+
+		// Meshes without a texture keep using the previously bound one.
+		texture_name_t texture = (mesh->texture != NULL ? mesh->texture->gpu_texture : 0);
+		texture_name_t normal_map = (mesh->normal_map != NULL ? mesh->normal_map->gpu_texture : 0);
+
+		if ((texture != 0 && texture != state->texture) ||
+			(normal_map != 0 && normal_map != state->normal_map)) {
+
+			cmdbuf_bind_textures(buffer, texture, normal_map);
+
+			state->texture = (texture != 0 ? texture : state->texture);
+			state->normal_map = (normal_map != 0 ? normal_map : state->normal_map);
+		}
+	}
+
+	// Vertex and index buffers.
+	if (draw->vertices != state->vertices ||
+		draw->indices != state->indices ||
+		mesh->vertex_type != state->vertex_type) {
+
+		cmdbuf_bind_buffers(buffer, draw->vertices, draw->indices, mesh->vertex_type);
+
+		state->vertices = draw->vertices;
+		state->indices = draw->indices;
+		state->vertex_type = mesh->vertex_type;
+	}
+}
+
+static void rsys_record_uniforms(cmdbuf_t *buffer, const rmesh_t *mesh, shader_t *shader,
+                                 bool program_changed, record_state_t *state)
+{
+	const material_t *material = mesh->material;
+
+	// A material sets every custom uniform of its shader from its parameter block, so switching
+	// between materials which share a program only updates the values of the uniforms.
+	if (material != NULL) {
+
+		if (program_changed || material != state->material) {
+
+			// Every variant of the shader stores its uniforms in the same order as the block, but
+			// the variants have their own uniform locations.
+			uint32_t count = MIN(material->uniforms.count, shader->material_uniforms.count);
+
+			for (uint32_t i = 0; i < count; i++) {
+
+				shader_uniform_t uniform = material->uniforms.items[i];
+				uniform.position = shader->material_uniforms.items[i].position;
+
+				if (uniform.position >= 0) {
+					cmdbuf_set_uniform(buffer, &uniform);
+				}
+			}
+		}
+
+		state->material = material;
+		return;
+	}
+
+	// Meshes without a material use the values stored in the shader. Custom uniforms are a part of
+	// the program's state, so only the uniforms which have changed have to be recorded. A shader
+	// with an instancing variant has only one dirty mask for both programs, and programs shared by
+	// materials may hold the values of any material, so all of their uniforms are recorded whenever
+	// the program is selected or a material has overridden them.
+	bool is_shared = (mesh->shader->instanced != NULL || mesh->shader->is_shared_by_materials);
+	uint64_t dirty = 0;
+
+	if ((program_changed && is_shared) || (!program_changed && state->material != NULL)) {
+		dirty = ~0ULL;
+	}
+	else if (program_changed) {
+		dirty = shader->dirty_uniforms;
+	}
+
+	for (uint32_t i = 0; dirty != 0 && i < shader->material_uniforms.count; i++) {
+
+		if ((dirty & (1ULL << i)) != 0 && shader->material_uniforms.items[i].position >= 0) {
+			cmdbuf_set_uniform(buffer, &shader->material_uniforms.items[i]);
+		}
+	}
+
+	state->material = NULL;
+}
+
+static void rsys_free_frame_data(view_list_t *frame_views, light_array_t *frame_lights)
 {
 	// Remove all regular render views.
 	rview_t *view, *tmp_view;
 
-	list_foreach_safe(views, view, tmp_view) {
+	list_foreach_safe(*frame_views, view, tmp_view) {
 
 		// Remove all mesh copies in the view.
 		rmesh_t *mesh, *tmp;
@@ -615,23 +1525,26 @@ static void rsys_free_frame_data(void)
 		arr_clear(view->post_processing_effects);
 
 		mem_free(view->lights);
+		mem_free(view->light_rects);
+		lightgrid_destroy(view->light_grid);
 
 		// Remove the view itself.
 		mem_free(view);
 	}
 
-	list_clear(views);
+	list_init(*frame_views);
 	ui_view = NULL;
 
-	// Clear the UI index buffer for rebuilding during the next frame.
+	// Clear the UI index buffer for rebuilding during the next frame. With a render thread, the
+	// indices of the previous frame have already been copied into the render thread's queue.
 	bufcache_clear_all_indices(BUFIDX_UI);
 
 	// Clear light data.
 	rlight_t *light;
 
-	arr_foreach(lights, light) {
+	arr_foreach(*frame_lights, light) {
 		DESTROY(light);
 	}
 
-	arr_clear(lights);
+	arr_clear(*frame_lights);
 }
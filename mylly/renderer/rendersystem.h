@@ -6,6 +6,37 @@
 
 // -------------------------------------------------------------------------------------------------
 
+// Statistics about a single rendered frame.
+typedef struct rsys_stats_t {
+
+	uint32_t triangles_full_detail; // Model triangles which would have been submitted without LODs
+	uint32_t triangles_submitted; // Model triangles submitted after selecting detail levels
+
+	uint32_t deferred_lights_drawn; // Lights which passed view culling in deferred mode
+	uint64_t deferred_fragments; // Estimated fragments shaded by the deferred lighting passes
+	uint64_t deferred_fragments_full_screen; // The same estimate if every light was a full screen pass
+
+	uint32_t draw_calls; // Number of meshes drawn
+	uint32_t instances_drawn; // Number of meshes drawn by instanced draw calls
+	uint32_t shader_changes; // Number of times the active shader program was changed
+	uint32_t texture_changes; // Number of times a mesh texture or normal map was changed
+	uint32_t buffer_changes; // Number of times the vertex buffer was changed between meshes
+	uint32_t gl_calls; // Number of OpenGL calls made while drawing
+	uint32_t gl_calls_skipped; // Number of redundant OpenGL calls skipped by the state cache
+	uint32_t uniform_calls; // Number of glUniform* calls
+	uint32_t uniform_buffer_bytes; // Amount of shader constants uploaded to uniform buffers
+	uint32_t build_time; // CPU time spent building the views and culling the scenes [us]
+	uint32_t submit_time; // CPU time spent submitting the views to OpenGL [us]
+	uint32_t record_time; // CPU time spent recording the render commands of the views [us]
+	uint32_t command_bytes; // Size of the recorded render commands
+	uint32_t texture_uploads; // Number of textures uploaded through pixel buffers
+	uint32_t texture_upload_bytes; // Amount of texture data uploaded through pixel buffers
+	uint32_t pending_texture_uploads; // Uploads waiting for their turn or for the GPU to finish
+
+} rsys_stats_t;
+
+// -------------------------------------------------------------------------------------------------
+
 BEGIN_DECLARATIONS;
 
 void rsys_initialize(void);
@@ -21,6 +52,19 @@ void rsys_render_scene(scene_t *scene);
 // Report a mesh to be rendered.
 void rsys_render_mesh(mesh_t *mesh, bool is_ui_mesh);
 
+// Global multiplier for the screen size of models when selecting their detail level. Values above
+// 1 keep models in higher detail further away, values below 1 switch to lower detail sooner.
+void rsys_set_lod_bias(float bias);
+float rsys_get_lod_bias(void);
+
+// Toggle sorting the meshes of each render queue by shader, texture, buffer and depth before
+// drawing. Enabled by default, can be disabled to compare the number of state changes.
+void rsys_set_draw_sorting(bool enabled);
+bool rsys_get_draw_sorting(void);
+
+// Get statistics about the previously rendered frame.
+const rsys_stats_t *rsys_get_stats(void);
+
 END_DECLARATIONS;
 
 #endif
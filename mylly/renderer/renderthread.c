@@ -0,0 +1,774 @@
+#include "renderthread.h"
+#include "collections/list.h"
+#include "core/memory.h"
+#include "platform/thread.h"
+#include "io/log.h"
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+typedef void (*rthread_func_t)(void *data);
+
+// A call waiting to be processed by the render thread. The parameters of the call are stored
+// right after the task.
+typedef struct rthread_task_t {
+
+	list_entry(rthread_task_t);
+
+	rthread_func_t execute; // Method which processes the call on the render thread
+	bool is_blocking; // The calling thread waits until the call has been processed
+
+} rthread_task_t;
+
+// -------------------------------------------------------------------------------------------------
+
+static const rend_backend_t *backend; // The backend run on the render thread
+static thread_handle_t render_thread;
+static bool is_thread_running;
+
+static lock_t task_lock; // Controls access to the task queue
+static list_t(rthread_task_t) tasks; // Calls waiting to be processed
+static event_t task_event; // Signaled when a new task is queued
+
+static lock_t call_lock; // Allows only one thread to wait for a blocking call at a time
+static event_t call_event; // Signaled when a blocking call has been processed
+
+static event_t frame_event; // Signaled when the render thread has drawn a frame
+static bool is_frame_pending; // A frame has been handed over but not waited for yet
+
+static rview_t *pending_views; // Views of the frame which is handed over when the frame ends
+static rend_stats_t stats; // Statistics of the most recently drawn frame
+
+// -------------------------------------------------------------------------------------------------
+
+THREAD(rthread_main);
+
+static void *rthread_queue(rthread_func_t execute, size_t size);
+static void rthread_call(rthread_func_t execute, void *data);
+static void rthread_submit(void *params);
+static void rthread_push_task(rthread_task_t *task);
+static void rthread_wait_frame(void);
+
+static bool rthread_initialize(void);
+static void rthread_shutdown(void);
+static void rthread_preload_shaders(void);
+static void rthread_begin_draw(void);
+static void rthread_end_draw(void);
+static void rthread_draw_views(rview_t *first_view);
+static void rthread_execute_commands(const cmdbuf_t *commands);
+static const rend_stats_t *rthread_get_stats(void);
+
+static vbindex_t rthread_generate_buffer(void);
+static void rthread_destroy_buffer(vbindex_t vbo);
+static void rthread_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index,
+                                       bool is_static);
+static void rthread_update_buffer_subdata(vbindex_t vbo, const void *data, size_t offset,
+                                          size_t size, bool is_index);
+
+static shader_object_t rthread_create_shader(SHADER_TYPE type, const char **lines,
+                                             size_t num_lines, const char **compiler_log);
+static shader_program_t rthread_create_shader_program(shader_object_t *shaders,
+                                                      size_t num_shaders);
+static shader_program_t rthread_load_program_binary(const char **lines, size_t num_lines);
+static void rthread_save_program_binary(shader_program_t program, const char **lines,
+                                        size_t num_lines);
+static void rthread_destroy_shader(shader_object_t shader);
+static void rthread_destroy_shader_program(shader_program_t program);
+static int rthread_get_program_uniform_location(shader_program_t program, const char *name);
+static bool rthread_bind_program_uniform_block(shader_program_t program, const char *name,
+                                               uint32_t binding);
+static void rthread_bind_program_samplers(shader_t *shader);
+static int rthread_get_program_attribute_location(shader_program_t program, const char *name);
+static const char *rthread_get_default_shader_source(default_shader_t shader);
+
+static texture_name_t rthread_generate_texture(void *image, size_t width, size_t height,
+                                               TEX_FORMAT fmt, TEX_FILTER filter);
+static texture_name_t rthread_generate_compressed_texture(const void *data, size_t width,
+                                                          size_t height, uint32_t num_levels,
+                                                          TEX_FORMAT fmt, TEX_FILTER filter);
+static void rthread_delete_texture(texture_name_t texture);
+static void rthread_upload_texture(texture_upload_t *upload);
+static bool rthread_is_texture_upload_complete(texture_upload_t *upload);
+
+static void rthread_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background);
+static void rthread_override_draw_gbuffer(gbuffer_component_t buffer);
+
+// -------------------------------------------------------------------------------------------------
+
+const rend_backend_t *rend_threaded_backend(const rend_backend_t *threaded_backend)
+{
+	static const rend_backend_t thread_backend = {
+		"render thread",
+		true,
+		rthread_initialize,
+		rthread_shutdown,
+		rthread_preload_shaders,
+		rthread_begin_draw,
+		rthread_end_draw,
+		rthread_draw_views,
+		rthread_execute_commands,
+		rthread_get_stats,
+		rthread_generate_buffer,
+		rthread_destroy_buffer,
+		rthread_upload_buffer_data,
+		rthread_update_buffer_subdata,
+		rthread_create_shader,
+		rthread_create_shader_program,
+		rthread_load_program_binary,
+		rthread_save_program_binary,
+		rthread_destroy_shader,
+		rthread_destroy_shader_program,
+		rthread_get_program_uniform_location,
+		rthread_bind_program_uniform_block,
+		rthread_bind_program_samplers,
+		rthread_get_program_attribute_location,
+		rthread_get_default_shader_source,
+		rthread_generate_texture,
+		rthread_generate_compressed_texture,
+		rthread_delete_texture,
+		rthread_upload_texture,
+		rthread_is_texture_upload_complete,
+		rthread_draw_splash_screen,
+		rthread_override_draw_gbuffer,
+	};
+
+	if (threaded_backend == NULL || threaded_backend->is_threaded) {
+		return threaded_backend;
+	}
+
+	backend = threaded_backend;
+	return &thread_backend;
+}
+
+THREAD(rthread_main)
+{
+	UNUSED(args);
+
+	while (is_thread_running) {
+
+		// Wait for new calls and process all of them in the order they were queued.
+		thread_wait_event(&task_event);
+
+		for (;;) {
+
+			rthread_task_t *task;
+
+			thread_lock(&task_lock);
+			{
+				task = tasks.first;
+
+				if (task != NULL) {
+					list_remove(tasks, task);
+				}
+			}
+			thread_unlock(&task_lock);
+
+			if (task == NULL) {
+				break;
+			}
+
+			bool is_blocking = task->is_blocking;
+
+			task->execute(task + 1);
+			mem_free(task);
+
+			if (is_blocking) {
+				thread_signal_event(&call_event);
+			}
+		}
+	}
+
+	return 0;
+}
+
+static void *rthread_queue(rthread_func_t execute, size_t size)
+{
+	// The task is not submitted until the caller has filled in the parameters.
+	rthread_task_t *task = mem_alloc_fast(sizeof(rthread_task_t) + size);
+	list_entry_init(task);
+
+	task->execute = execute;
+	task->is_blocking = false;
+
+	return task + 1;
+}
+
+static void rthread_call(rthread_func_t execute, void *data)
+{
+	// Blocking calls can refer to the caller's stack, so the parameters don't have to be copied
+	// into the task. Only a pointer to them is passed.
+	rthread_task_t *task = mem_alloc_fast(sizeof(rthread_task_t) + sizeof(void *));
+	list_entry_init(task);
+
+	task->execute = execute;
+	task->is_blocking = true;
+
+	memcpy(task + 1, &data, sizeof(void *));
+
+	thread_lock(&call_lock);
+	{
+		rthread_push_task(task);
+		thread_wait_event(&call_event);
+	}
+	thread_unlock(&call_lock);
+}
+
+static void rthread_submit(void *params)
+{
+	// Queue a task returned by rthread_queue() once its parameters have been filled in.
+	rthread_push_task((rthread_task_t *)params - 1);
+}
+
+static void rthread_push_task(rthread_task_t *task)
+{
+	thread_lock(&task_lock);
+	{
+		list_push(tasks, task);
+	}
+	thread_unlock(&task_lock);
+
+	thread_signal_event(&task_event);
+}
+
+static void rthread_wait_frame(void)
+{
+	if (!is_frame_pending) {
+		return;
+	}
+
+	thread_wait_event(&frame_event);
+	is_frame_pending = false;
+
+	// The render thread is idle until the next frame is handed over, so it's safe to copy the
+	// statistics of the frame.
+	stats = *backend->get_stats();
+}
+
+// -------------------------------------------------------------------------------------------------
+// Each call below consists of a struct containing the parameters and the result of the call, and a
+// method which processes the call on the render thread. Blocking calls receive a pointer to the
+// struct, queued calls receive the struct itself.
+// -------------------------------------------------------------------------------------------------
+
+#define CALL_PARAMS(data, type) (*(type **)(data))
+#define QUEUED_PARAMS(data, type) ((type *)(data))
+
+typedef struct initialize_call_t { bool result; } initialize_call_t;
+
+static void rthread_do_initialize(void *data)
+{
+	CALL_PARAMS(data, initialize_call_t)->result = backend->initialize();
+}
+
+static void rthread_do_shutdown(void *data)
+{
+	UNUSED(data);
+
+	backend->shutdown();
+	is_thread_running = false;
+}
+
+static void rthread_do_preload_shaders(void *data)
+{
+	UNUSED(data);
+	backend->preload_shaders();
+}
+
+static void rthread_do_draw_frame(void *data)
+{
+	rview_t *first_view = *QUEUED_PARAMS(data, rview_t *);
+
+	backend->begin_draw();
+	backend->draw_views(first_view);
+	backend->end_draw();
+
+	thread_signal_event(&frame_event);
+}
+
+static void rthread_do_execute_commands(void *data)
+{
+	backend->execute_commands(CALL_PARAMS(data, const cmdbuf_t));
+}
+
+typedef struct generate_buffer_call_t { vbindex_t result; } generate_buffer_call_t;
+
+static void rthread_do_generate_buffer(void *data)
+{
+	CALL_PARAMS(data, generate_buffer_call_t)->result = backend->generate_buffer();
+}
+
+static void rthread_do_destroy_buffer(void *data)
+{
+	backend->destroy_buffer(*QUEUED_PARAMS(data, vbindex_t));
+}
+
+typedef struct buffer_data_call_t {
+
+	vbindex_t vbo;
+	size_t offset;
+	size_t size;
+	bool is_index;
+	bool is_static;
+	bool is_update; // Update a part of the buffer instead of replacing all of its data
+
+} buffer_data_call_t;
+
+static void rthread_do_upload_buffer_data(void *data)
+{
+	buffer_data_call_t *call = QUEUED_PARAMS(data, buffer_data_call_t);
+	void *buffer_data = call + 1;
+
+	if (call->is_update) {
+		backend->update_buffer_subdata(call->vbo, buffer_data, call->offset, call->size,
+		                               call->is_index);
+	}
+	else {
+		backend->upload_buffer_data(call->vbo, buffer_data, call->size, call->is_index,
+		                            call->is_static);
+	}
+}
+
+typedef struct create_shader_call_t {
+
+	SHADER_TYPE type;
+	const char **lines;
+	size_t num_lines;
+	const char **compiler_log;
+	shader_object_t result;
+
+} create_shader_call_t;
+
+static void rthread_do_create_shader(void *data)
+{
+	create_shader_call_t *call = CALL_PARAMS(data, create_shader_call_t);
+	call->result = backend->create_shader(call->type, call->lines, call->num_lines,
+	                                      call->compiler_log);
+}
+
+typedef struct create_program_call_t {
+
+	shader_object_t *shaders;
+	size_t num_shaders;
+	shader_program_t result;
+
+} create_program_call_t;
+
+static void rthread_do_create_shader_program(void *data)
+{
+	create_program_call_t *call = CALL_PARAMS(data, create_program_call_t);
+	call->result = backend->create_shader_program(call->shaders, call->num_shaders);
+}
+
+typedef struct program_binary_call_t {
+
+	shader_program_t program; // Loaded program, or the program to save
+	const char **lines;
+	size_t num_lines;
+
+} program_binary_call_t;
+
+static void rthread_do_load_program_binary(void *data)
+{
+	program_binary_call_t *call = CALL_PARAMS(data, program_binary_call_t);
+	call->program = backend->load_program_binary(call->lines, call->num_lines);
+}
+
+static void rthread_do_save_program_binary(void *data)
+{
+	program_binary_call_t *call = CALL_PARAMS(data, program_binary_call_t);
+	backend->save_program_binary(call->program, call->lines, call->num_lines);
+}
+
+static void rthread_do_destroy_shader(void *data)
+{
+	backend->destroy_shader(*QUEUED_PARAMS(data, shader_object_t));
+}
+
+static void rthread_do_destroy_shader_program(void *data)
+{
+	backend->destroy_shader_program(*QUEUED_PARAMS(data, shader_program_t));
+}
+
+typedef struct program_query_call_t {
+
+	shader_program_t program;
+	const char *name;
+	uint32_t binding; // Used by uniform blocks only
+	int result;
+
+} program_query_call_t;
+
+static void rthread_do_get_uniform_location(void *data)
+{
+	program_query_call_t *call = CALL_PARAMS(data, program_query_call_t);
+	call->result = backend->get_program_uniform_location(call->program, call->name);
+}
+
+static void rthread_do_bind_uniform_block(void *data)
+{
+	program_query_call_t *call = CALL_PARAMS(data, program_query_call_t);
+	call->result = backend->bind_program_uniform_block(call->program, call->name, call->binding);
+}
+
+static void rthread_do_get_attribute_location(void *data)
+{
+	program_query_call_t *call = CALL_PARAMS(data, program_query_call_t);
+	call->result = backend->get_program_attribute_location(call->program, call->name);
+}
+
+static void rthread_do_bind_program_samplers(void *data)
+{
+	backend->bind_program_samplers(CALL_PARAMS(data, shader_t));
+}
+
+typedef struct generate_texture_call_t {
+
+	void *image;
+	size_t width, height;
+	TEX_FORMAT format;
+	TEX_FILTER filter;
+	texture_name_t result;
+
+} generate_texture_call_t;
+
+static void rthread_do_generate_texture(void *data)
+{
+	generate_texture_call_t *call = CALL_PARAMS(data, generate_texture_call_t);
+	call->result = backend->generate_texture(call->image, call->width, call->height,
+	                                         call->format, call->filter);
+}
+
+typedef struct generate_compressed_texture_call_t {
+
+	const void *data;
+	size_t width, height;
+	uint32_t num_levels;
+	TEX_FORMAT format;
+	TEX_FILTER filter;
+	texture_name_t result;
+
+} generate_compressed_texture_call_t;
+
+static void rthread_do_generate_compressed_texture(void *data)
+{
+	generate_compressed_texture_call_t *call =
+		CALL_PARAMS(data, generate_compressed_texture_call_t);
+
+	call->result = backend->generate_compressed_texture(call->data, call->width, call->height,
+	                                                    call->num_levels, call->format,
+	                                                    call->filter);
+}
+
+static void rthread_do_delete_texture(void *data)
+{
+	backend->delete_texture(*QUEUED_PARAMS(data, texture_name_t));
+}
+
+static void rthread_do_upload_texture(void *data)
+{
+	backend->upload_texture(*QUEUED_PARAMS(data, texture_upload_t *));
+}
+
+typedef struct splash_call_t {
+
+	texture_t *texture;
+	shader_t *shader;
+	colour_t background;
+
+} splash_call_t;
+
+static void rthread_do_draw_splash_screen(void *data)
+{
+	splash_call_t *call = CALL_PARAMS(data, splash_call_t);
+	backend->draw_splash_screen(call->texture, call->shader, call->background);
+}
+
+static void rthread_do_override_draw_gbuffer(void *data)
+{
+	backend->override_draw_gbuffer(*QUEUED_PARAMS(data, gbuffer_component_t));
+}
+
+// -------------------------------------------------------------------------------------------------
+
+static bool rthread_initialize(void)
+{
+	list_init(tasks);
+
+	thread_init_lock(&task_lock);
+	thread_init_lock(&call_lock);
+
+	thread_init_event(&task_event);
+	thread_init_event(&call_event);
+	thread_init_event(&frame_event);
+
+	is_frame_pending = false;
+	pending_views = NULL;
+
+	// The rendering context is created by the render thread, so it becomes current there.
+	is_thread_running = true;
+	render_thread = thread_create_joinable(rthread_main, NULL);
+
+	initialize_call_t call;
+	rthread_call(rthread_do_initialize, &call);
+
+	log_message("Renderer", "Drawing on a render thread using %s backend.", backend->name);
+
+	return call.result;
+}
+
+static void rthread_shutdown(void)
+{
+	rthread_wait_frame();
+	rthread_call(rthread_do_shutdown, NULL);
+
+	// Wait for the render thread to exit before destroying the sync objects it uses.
+	thread_join(render_thread);
+
+	thread_destroy_event(&frame_event);
+	thread_destroy_event(&call_event);
+	thread_destroy_event(&task_event);
+
+	thread_destroy_lock(&call_lock);
+	thread_destroy_lock(&task_lock);
+}
+
+static void rthread_preload_shaders(void)
+{
+	rthread_call(rthread_do_preload_shaders, NULL);
+}
+
+static void rthread_begin_draw(void)
+{
+	// The frame is started by the render thread when the frame is handed over to it.
+}
+
+static void rthread_end_draw(void)
+{
+	// Wait until the previous frame has been drawn before handing over the next one. After this
+	// the render system is free to release the data of the previous frame.
+	rthread_wait_frame();
+
+	rview_t **views = rthread_queue(rthread_do_draw_frame, sizeof(rview_t *));
+	*views = pending_views;
+
+	rthread_submit(views);
+
+	is_frame_pending = true;
+	pending_views = NULL;
+}
+
+static void rthread_draw_views(rview_t *first_view)
+{
+	// The views are handed over when the frame ends.
+	pending_views = first_view;
+}
+
+static void rthread_execute_commands(const cmdbuf_t *commands)
+{
+	rthread_call(rthread_do_execute_commands, (void *)commands);
+}
+
+static const rend_stats_t *rthread_get_stats(void)
+{
+	return &stats;
+}
+
+static vbindex_t rthread_generate_buffer(void)
+{
+	generate_buffer_call_t call;
+	rthread_call(rthread_do_generate_buffer, &call);
+
+	return call.result;
+}
+
+static void rthread_destroy_buffer(vbindex_t vbo)
+{
+	vbindex_t *params = rthread_queue(rthread_do_destroy_buffer, sizeof(vbindex_t));
+	*params = vbo;
+
+	rthread_submit(params);
+}
+
+static void rthread_upload_buffer_data(vbindex_t vbo, void *data, size_t size, bool is_index,
+                                       bool is_static)
+{
+	buffer_data_call_t *call = rthread_queue(rthread_do_upload_buffer_data,
+	                                         sizeof(buffer_data_call_t) + size);
+
+	call->vbo = vbo;
+	call->offset = 0;
+	call->size = size;
+	call->is_index = is_index;
+	call->is_static = is_static;
+	call->is_update = false;
+
+	if (data != NULL && size != 0) {
+		memcpy(call + 1, data, size);
+	}
+
+	rthread_submit(call);
+}
+
+static void rthread_update_buffer_subdata(vbindex_t vbo, const void *data, size_t offset,
+                                          size_t size, bool is_index)
+{
+	buffer_data_call_t *call = rthread_queue(rthread_do_upload_buffer_data,
+	                                         sizeof(buffer_data_call_t) + size);
+
+	call->vbo = vbo;
+	call->offset = offset;
+	call->size = size;
+	call->is_index = is_index;
+	call->is_static = false;
+	call->is_update = true;
+
+	if (data != NULL && size != 0) {
+		memcpy(call + 1, data, size);
+	}
+
+	rthread_submit(call);
+}
+
+static shader_object_t rthread_create_shader(SHADER_TYPE type, const char **lines,
+                                             size_t num_lines, const char **compiler_log)
+{
+	create_shader_call_t call = { type, lines, num_lines, compiler_log, 0 };
+	rthread_call(rthread_do_create_shader, &call);
+
+	return call.result;
+}
+
+static shader_program_t rthread_create_shader_program(shader_object_t *shaders,
+                                                      size_t num_shaders)
+{
+	create_program_call_t call = { shaders, num_shaders, 0 };
+	rthread_call(rthread_do_create_shader_program, &call);
+
+	return call.result;
+}
+
+static shader_program_t rthread_load_program_binary(const char **lines, size_t num_lines)
+{
+	program_binary_call_t call = { 0, lines, num_lines };
+	rthread_call(rthread_do_load_program_binary, &call);
+
+	return call.program;
+}
+
+static void rthread_save_program_binary(shader_program_t program, const char **lines,
+                                        size_t num_lines)
+{
+	// Blocks because the source lines are owned by the caller.
+	program_binary_call_t call = { program, lines, num_lines };
+	rthread_call(rthread_do_save_program_binary, &call);
+}
+
+static void rthread_destroy_shader(shader_object_t shader)
+{
+	shader_object_t *params = rthread_queue(rthread_do_destroy_shader, sizeof(shader_object_t));
+	*params = shader;
+
+	rthread_submit(params);
+}
+
+static void rthread_destroy_shader_program(shader_program_t program)
+{
+	shader_program_t *params = rthread_queue(rthread_do_destroy_shader_program,
+	                                         sizeof(shader_program_t));
+	*params = program;
+
+	rthread_submit(params);
+}
+
+static int rthread_get_program_uniform_location(shader_program_t program, const char *name)
+{
+	program_query_call_t call = { program, name, 0, -1 };
+	rthread_call(rthread_do_get_uniform_location, &call);
+
+	return call.result;
+}
+
+static bool rthread_bind_program_uniform_block(shader_program_t program, const char *name,
+                                               uint32_t binding)
+{
+	program_query_call_t call = { program, name, binding, 0 };
+	rthread_call(rthread_do_bind_uniform_block, &call);
+
+	return (call.result != 0);
+}
+
+static void rthread_bind_program_samplers(shader_t *shader)
+{
+	rthread_call(rthread_do_bind_program_samplers, shader);
+}
+
+static int rthread_get_program_attribute_location(shader_program_t program, const char *name)
+{
+	program_query_call_t call = { program, name, 0, -1 };
+	rthread_call(rthread_do_get_attribute_location, &call);
+
+	return call.result;
+}
+
+static const char *rthread_get_default_shader_source(default_shader_t shader)
+{
+	// Shader sources are constant data, so they can be read from any thread.
+	return backend->get_default_shader_source(shader);
+}
+
+static texture_name_t rthread_generate_texture(void *image, size_t width, size_t height,
+                                               TEX_FORMAT fmt, TEX_FILTER filter)
+{
+	generate_texture_call_t call = { image, width, height, fmt, filter, 0 };
+	rthread_call(rthread_do_generate_texture, &call);
+
+	return call.result;
+}
+
+static texture_name_t rthread_generate_compressed_texture(const void *data, size_t width,
+                                                          size_t height, uint32_t num_levels,
+                                                          TEX_FORMAT fmt, TEX_FILTER filter)
+{
+	generate_compressed_texture_call_t call = { data, width, height, num_levels, fmt, filter, 0 };
+	rthread_call(rthread_do_generate_compressed_texture, &call);
+
+	return call.result;
+}
+
+static void rthread_delete_texture(texture_name_t texture)
+{
+	texture_name_t *params = rthread_queue(rthread_do_delete_texture, sizeof(texture_name_t));
+	*params = texture;
+
+	rthread_submit(params);
+}
+
+static void rthread_upload_texture(texture_upload_t *upload)
+{
+	// The upload stays valid until it has completed, so it's queued without blocking.
+	texture_upload_t **params = rthread_queue(rthread_do_upload_texture, sizeof(upload));
+	*params = upload;
+
+	rthread_submit(params);
+}
+
+static bool rthread_is_texture_upload_complete(texture_upload_t *upload)
+{
+	// Backends guard the completion of uploads themselves, so this can be called directly.
+	return backend->is_texture_upload_complete(upload);
+}
+
+static void rthread_draw_splash_screen(texture_t *texture, shader_t *shader, colour_t background)
+{
+	splash_call_t call = { texture, shader, background };
+	rthread_call(rthread_do_draw_splash_screen, &call);
+}
+
+static void rthread_override_draw_gbuffer(gbuffer_component_t buffer)
+{
+	gbuffer_component_t *params = rthread_queue(rthread_do_override_draw_gbuffer,
+	                                            sizeof(gbuffer_component_t));
+	*params = buffer;
+
+	rthread_submit(params);
+}
@@ -0,0 +1,39 @@
+#pragma once
+#ifndef __RENDERTHREAD_H
+#define __RENDERTHREAD_H
+
+#include "renderer/rendbackend.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Render thread
+
+	A renderer backend which runs another backend on a dedicated render thread. The render thread
+	creates and owns the rendering context, and every call to the backend is passed to it through
+	a queue, in the order the calls were made.
+
+	Calls which return a value (creating buffers, textures and shaders, querying uniforms) block
+	until the render thread has processed them. Calls which don't (uploading data, destroying
+	objects) are queued and return immediately. Uploaded data is copied into the queue, so the
+	caller may modify or release it right away.
+
+	Ending a frame hands the views of the frame over to the render thread. The frame is drawn
+	while the main thread builds the views of the next frame, so the render system must keep the
+	views and everything they refer to unchanged until the next frame has ended. Before a frame is
+	handed over, the main thread waits until the previous frame has been drawn, so at most one
+	frame is ever waiting to be drawn.
+
+	Enable by setting use_render_thread in the engine parameters.
+
+====================================================================================================
+*/
+
+// Returns a backend which runs the given backend on the render thread.
+const rend_backend_t *rend_threaded_backend(const rend_backend_t *backend);
+
+END_DECLARATIONS;
+
+#endif
@@ -6,14 +6,11 @@
 #include "collections/list.h"
 #include "math/matrix.h"
 #include "renderer/shader.h"
+#include "renderer/material.h"
 #include "renderer/vertex.h"
 #include "renderer/buffercache.h"
-
-// -------------------------------------------------------------------------------------------------
-
-// The maximum number of lights that can affect a single mesh at a time.
-// NOTE: If this value is changed, it has to be changed in the shader code as well (mylly.cging)!
-#define MAX_LIGHTS_PER_MESH 4
+#include "renderer/lightgrid.h"
+#include "renderer/cmdbuffer.h"
 
 // -------------------------------------------------------------------------------------------------
 // robject_t is a structure which contains data about an object which is visible
@@ -35,9 +32,8 @@ typedef struct rlight_t {
 
 	mat_t shader_params; // Light parameters to be sent to the shader
 
-	// These are used to find the objects affected by the light and are not used by the renderer.
+	// Used to assign the light to the clusters of each view, not used by the renderer.
 	light_t *light; // The light component in the scene
-	float dist_sq; // Squared distance to a mesh being processed
 
 } rlight_t;
 
@@ -58,12 +54,11 @@ typedef struct rmesh_t {
 	buffer_handle_t handle_indices; // Handle to index data
 	
 	shader_t *shader; // The shader used for rendering this mesh
+	const material_t *material; // Material whose parameter block is applied to the shader, or NULL
 	texture_t *texture; // The texture applied to the mesh
 	texture_t *normal_map; // Normal map applied to the mesh
 
-	// Lights affecting this mesh
-	uint32_t num_lights;
-	rlight_t *lights[MAX_LIGHTS_PER_MESH];
+	uint64_t sort_key; // Key for ordering the meshes of a render queue to minimize state changes
 
 } rmesh_t;
 
@@ -93,10 +88,18 @@ typedef struct rview_t {
 	// List of all the meshes to be rendered in the view, sorted by render queues
 	list_t(rmesh_t) meshes[NUM_QUEUES];
 
-	// All lights affecting to this view.
+	// Draw commands recorded from the meshes of each render queue. The renderer backend draws the
+	// view by replaying these. The buffers are owned by the render system.
+	cmdbuf_t *commands[NUM_QUEUES];
+
+	// All lights affecting to this view (deferred lighting).
 	rlight_t **lights;
+	vec4_t *light_rects; // Screen space area affected by each light in normalized device coordinates
 	uint32_t num_lights;
 
+	// Lights assigned to the clusters of the view (forward lighting).
+	light_grid_t *light_grid;
+
 	// A virtual root object placed at the origin. Used for custom meshes placed in the scene
 	// (for example debug meshes).
 	robject_t root;
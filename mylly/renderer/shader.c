@@ -3,12 +3,28 @@
 #include "core/memory.h"
 #include "core/string.h"
 #include "io/log.h"
+#include "math/math.h"
+#include <stdio.h>
+#include <string.h>
 
 // -------------------------------------------------------------------------------------------------
 
+static bool shader_compile(shader_t *shader, size_t num_lines, const char **lines,
+                           size_t num_uniforms, const char **uniforms,
+                           UNIFORM_TYPE *uniform_types);
+static shader_t *shader_compile_variant(shader_t *base, uint64_t key);
+static bool shader_build_variant(shader_t *base, shader_t *variant, uint64_t key);
+static uint64_t shader_remap_key(const shader_t *shader, uint64_t key,
+                                 char **previous_keywords, uint32_t num_previous_keywords);
+static void shader_parse_keywords(shader_t *shader, size_t num_lines, const char **lines);
+static void shader_destroy_variants(shader_t *shader);
 static void shader_destroy_program(shader_t *shader);
 static void shader_add_uniform(shader_t *shader, const char *name, UNIFORM_TYPE type);
-static shader_uniform_t *shader_get_uniform(shader_t *shader, const char *name);
+static shader_uniform_handle_t shader_resolve_uniform(shader_t *shader, const char *name);
+static shader_uniform_t *shader_get_uniform_for_update(shader_t *shader,
+                                                      shader_uniform_handle_t handle,
+                                                      UNIFORM_TYPE type);
+static const char *shader_get_uniform_type_name(UNIFORM_TYPE type);
 
 // -------------------------------------------------------------------------------------------------
 
@@ -22,15 +38,27 @@ static const char *shader_attribute_names[NUM_SHADER_ATTRIBUTES] = {
 	"ParticleEmitPosition",
 	"ParticleRotation",
 	"ParticleSize",
-	"Tangent"
+	"Tangent",
+	"InstanceModel"
+};
+
+// Shader uniform block names.
+static const char *shader_uniform_block_names[NUM_UNIFORM_BLOCKS] = {
+	"FrameData",
+	"ViewData",
+	"ObjectData"
 };
 
 // Shader uniform array names.
-#define MATRIX_ARRAY_NAME "MatrixArr"
-#define VECTOR_ARRAY_NAME "VectorArr"
 #define SAMPLER_ARRAY_NAME "SamplerArr"
 #define LIGHT_ARRAY_NAME "LightArr"
 #define NUM_LIGHTS_NAME "NumLights"
+#define LIGHT_GRID_NAME "LightGrid"
+#define LIGHT_INDICES_NAME "LightIndices"
+#define LIGHT_DATA_NAME "LightData"
+
+#define KEYWORDS_PRAGMA "#pragma keywords "
+#define INSTANCING_KEYWORD "INSTANCING"
 
 // -------------------------------------------------------------------------------------------------
 
@@ -49,15 +77,19 @@ shader_t *shader_create(const char *name, const char *path)
 	shader->fragment = 0;
 	shader->program = 0;
 
-	shader->matrix_array = -1;
-	shader->vector_array = -1;
 	shader->sampler_array = -1;
 
 	shader->light_array = -1;
 	shader->num_lights_position = -1;
 
+	shader->light_grid = -1;
+	shader->light_indices = -1;
+	shader->light_data = -1;
+
 	arr_init(shader->material_uniforms);
 	arr_init(shader->source);
+	arr_init(shader->keywords);
+	arr_init(shader->variants);
 
 	return shader;
 }
@@ -78,6 +110,7 @@ shader_t *shader_clone(shader_t *original)
 		for (size_t i = 0; i < original->material_uniforms.count; i++) {
 
 			shader_uniform_t *uniform = &original->material_uniforms.items[i];
+
 			shader_add_uniform(shader, uniform->name, uniform->type);
 		}
 	}
@@ -92,8 +125,9 @@ void shader_destroy(shader_t *shader)
 		return;
 	}
 
-	// Destroy the GPU objects.
+	// Destroy the GPU objects and the variants compiled from the shader.
 	shader_destroy_program(shader);
+	shader_destroy_variants(shader);
 
 	for (uint32_t i = 0; i < shader->material_uniforms.count; i++) {
 		DESTROY(shader->material_uniforms.items[i].name);
@@ -107,93 +141,212 @@ void shader_destroy(shader_t *shader)
 }
 
 void shader_set_uniform_int(shader_t *shader, const char *name, int value)
+{
+	shader_set_uniform_int_by_handle(shader, shader_resolve_uniform(shader, name), value);
+}
+
+void shader_set_uniform_float(shader_t *shader, const char *name, float value)
+{
+	shader_set_uniform_float_by_handle(shader, shader_resolve_uniform(shader, name), value);
+}
+
+void shader_set_uniform_vector(shader_t *shader, const char *name, vec4_t value)
+{
+	shader_set_uniform_vector_by_handle(shader, shader_resolve_uniform(shader, name), value);
+}
+
+void shader_set_uniform_colour(shader_t *shader, const char *name, colour_t value)
+{
+	// Convenience method for setting a colour to a vec4 type uniform field.
+	shader_set_uniform_vector(shader, name, col_to_vec4(value));
+}
+
+shader_uniform_handle_t shader_get_uniform_handle(shader_t *shader, const char *name)
 {
 	if (shader == NULL || string_is_null_or_empty(name)) {
-		return;
+		return SHADER_UNIFORM_INVALID;
+	}
+
+	for (uint32_t i = 0; i < shader->material_uniforms.count; i++) {
+
+		if (string_equals(shader->material_uniforms.items[i].name, name)) {
+			return (shader_uniform_handle_t)i;
+		}
 	}
 
-	shader_uniform_t *uniform = shader_get_uniform(shader, name);
+	return SHADER_UNIFORM_INVALID;
+}
 
-	if (uniform == NULL) {
+void shader_set_uniform_int_by_handle(shader_t *shader, shader_uniform_handle_t handle, int value)
+{
+	if (shader == NULL) {
 		return;
 	}
 
-	if (uniform->type != UNIFORM_TYPE_INT) {
+	// Keep the variants in sync.
+	for (uint32_t i = 0; i < shader->variants.count; i++) {
+		shader_set_uniform_int_by_handle(shader->variants.items[i].shader, handle, value);
+	}
+
+	shader_uniform_t *uniform = shader_get_uniform_for_update(shader, handle, UNIFORM_TYPE_INT);
 
-		log_warning("Shader", "Uniform '%s' in shader %s is not of type int.",
-			name, shader->resource.name);
+	if (uniform != NULL) {
+		uniform->value.i = value;
+	}
+}
 
+void shader_set_uniform_float_by_handle(shader_t *shader, shader_uniform_handle_t handle,
+                                        float value)
+{
+	if (shader == NULL) {
 		return;
 	}
 
-	// Update the value and flag the shader to be updated before rendering the next frame.
-	uniform->value.i = value;
-	shader->has_updated_uniforms = true;
+	// Keep the variants in sync.
+	for (uint32_t i = 0; i < shader->variants.count; i++) {
+		shader_set_uniform_float_by_handle(shader->variants.items[i].shader, handle, value);
+	}
+
+	shader_uniform_t *uniform = shader_get_uniform_for_update(shader, handle, UNIFORM_TYPE_FLOAT);
+
+	if (uniform != NULL) {
+		uniform->value.f = value;
+	}
 }
 
-void shader_set_uniform_float(shader_t *shader, const char *name, float value)
+void shader_set_uniform_vector_by_handle(shader_t *shader, shader_uniform_handle_t handle,
+                                         vec4_t value)
 {
-	if (shader == NULL || string_is_null_or_empty(name)) {
+	if (shader == NULL) {
 		return;
 	}
 
-	shader_uniform_t *uniform = shader_get_uniform(shader, name);
+	// Keep the variants in sync.
+	for (uint32_t i = 0; i < shader->variants.count; i++) {
+		shader_set_uniform_vector_by_handle(shader->variants.items[i].shader, handle, value);
+	}
+
+	shader_uniform_t *uniform = shader_get_uniform_for_update(shader, handle, UNIFORM_TYPE_VECTOR4);
+
+	if (uniform != NULL) {
+		uniform->value.vec = value;
+	}
+}
+
+void shader_set_uniform_colour_by_handle(shader_t *shader, shader_uniform_handle_t handle,
+                                         colour_t value)
+{
+	shader_set_uniform_vector_by_handle(shader, handle, col_to_vec4(value));
+}
 
-	if (uniform == NULL) {
+void shader_set_render_queue(shader_t *shader, SHADER_QUEUE queue)
+{
+	if (shader == NULL || queue < 0 || queue >= NUM_QUEUES) {
 		return;
 	}
 
-	if (uniform->type != UNIFORM_TYPE_FLOAT) {
+	shader->queue = queue;
 
-		log_warning("Shader", "Uniform '%s' in shader %s is not of type float.",
-			name, shader->resource.name);
+	for (uint32_t i = 0; i < shader->variants.count; i++) {
 
-		return;
+		if (shader->variants.items[i].shader != NULL) {
+			shader->variants.items[i].shader->queue = queue;
+		}
+	}
+}
+
+uint64_t shader_get_keyword(const shader_t *shader, const char *keyword)
+{
+	if (shader == NULL || string_is_null_or_empty(keyword)) {
+		return 0;
 	}
 
-	// Update the value and flag the shader to be updated before rendering the next frame.
-	uniform->value.f = value;
-	shader->has_updated_uniforms = true;
+	// Keywords are declared by the base shader.
+	if (shader->base != NULL) {
+		shader = shader->base;
+	}
+
+	for (uint32_t i = 0; i < shader->keywords.count; i++) {
+
+		if (string_equals(shader->keywords.items[i], keyword)) {
+			return (1ull << i);
+		}
+	}
+
+	return 0;
 }
 
-void shader_set_uniform_vector(shader_t *shader, const char *name, vec4_t value)
+shader_t *shader_get_variant(shader_t *shader, uint64_t keywords)
 {
-	if (shader == NULL || string_is_null_or_empty(name)) {
-		return;
+	if (shader == NULL) {
+		return NULL;
 	}
 
-	shader_uniform_t *uniform = shader_get_uniform(shader, name);
+	shader_t *base = (shader->base != NULL ? shader->base : shader);
+	uint64_t key = shader->key | keywords;
 
-	if (uniform == NULL) {
-		return;
+	if (key == shader->key) {
+		return shader;
 	}
 
-	if (uniform->type != UNIFORM_TYPE_VECTOR4) {
+	if (key == 0) {
+		return base;
+	}
 
-		log_warning("Shader", "Uniform '%s' in shader %s is not of type vec4.",
-			name, shader->resource.name);
+	// Find a previously compiled variant.
+	for (uint32_t i = 0; i < base->variants.count; i++) {
 
-		return;
+		shader_variant_t *variant = &base->variants.items[i];
+
+		if (variant->key == key) {
+			return (variant->shader != NULL ? variant->shader : shader);
+		}
 	}
 
-	// Update the value and flag the shader to be updated before rendering the next frame.
-	uniform->value.vec = value;
-	shader->has_updated_uniforms = true;
+	// Compile the variant the first time it is needed. Variants which fail to compile are cached
+	// as well, so they are only attempted once.
+	shader_variant_t variant;
+
+	variant.key = key;
+	variant.shader = shader_compile_variant(base, key);
+
+	arr_push(base->variants, variant);
+
+	return (variant.shader != NULL ? variant.shader : shader);
 }
 
-void shader_set_uniform_colour(shader_t *shader, const char *name, colour_t value)
+shader_t *shader_get_instanced_variant(shader_t *shader)
 {
-	// Convenience method for setting a colour to a vec4 type uniform field.
-	shader_set_uniform_vector(shader, name, col_to_vec4(value));
+	if (shader == NULL) {
+		return NULL;
+	}
+
+	if (shader->instanced != NULL) {
+		return shader->instanced;
+	}
+
+	uint64_t instancing = shader_get_keyword(shader, INSTANCING_KEYWORD);
+
+	if (instancing == 0 || (shader->key & instancing) != 0) {
+		return NULL;
+	}
+
+	shader_t *variant = shader_get_variant(shader, instancing);
+
+	if (variant != shader) {
+		shader->instanced = variant;
+	}
+
+	return shader->instanced;
 }
 
-void shader_set_render_queue(shader_t *shader, SHADER_QUEUE queue)
+const char *shader_get_attribute_name(SHADER_ATTRIBUTE attribute)
 {
-	if (shader == NULL || queue < 0 || queue >= NUM_QUEUES) {
-		return;
+	if (attribute < 0 || attribute >= NUM_SHADER_ATTRIBUTES) {
+		return NULL;
 	}
 
-	shader->queue = queue;
+	return shader_attribute_names[attribute];
 }
 
 bool shader_load_from_source(
@@ -205,53 +358,136 @@ bool shader_load_from_source(
 		return false;
 	}
 
-	// Destroy previously created program first.
+	// Destroy previously created programs first.
 	shader_destroy_program(shader);
 
-	const char *log;
+	// The variants of a reloaded shader may be referenced by materials, so they are recompiled in
+	// place instead of destroyed. The keywords are parsed again, which may change their bits.
+	char *previous_keywords[MAX_SHADER_KEYWORDS];
+	uint32_t num_previous_keywords = shader->keywords.count;
 
-	// Compile the vertex shader.
-	shader->vertex = rend_create_shader(SHADER_VERTEX, lines, num_lines, &log);
+	for (uint32_t i = 0; i < num_previous_keywords; i++) {
+		previous_keywords[i] = shader->keywords.items[i];
+	}
 
-	if (shader->vertex == 0) {
+	shader->keywords.count = 0;
+	shader->instanced = NULL;
 
-		log_warning("Renderer", "Failed to compile vertex shader '%s':\n%s",
-			shader->resource.res_name, log);
-		
-		return false;
-	}
+	// Only the base program is compiled here. Variants are compiled when they are first needed.
+	shader_parse_keywords(shader, num_lines, lines);
 
-	// Compile the fragment shader.
-	shader->fragment = rend_create_shader(SHADER_FRAGMENT, lines, num_lines, &log);
+	bool success = shader_compile(shader, num_lines, lines, num_uniforms, uniforms, uniform_types);
+	shader->dirty_uniforms = ~0ULL;
 
-	if (shader->fragment == 0) {
+	for (uint32_t i = 0; i < shader->variants.count; i++) {
 
-		log_warning("Renderer", "Failed to compile fragment shader '%s':\n%s",
-			shader->resource.res_name, log);
+		shader_variant_t *variant = &shader->variants.items[i];
 
-		return false;
+		variant->key = shader_remap_key(shader, variant->key,
+		                                previous_keywords, num_previous_keywords);
+
+		if (variant->shader != NULL) {
+			variant->shader->key = variant->key;
+		}
+
+		// Variants keep their previous programs if the base shader can't be compiled.
+		if (!success) {
+			continue;
+		}
+
+		if (variant->shader != NULL) {
+
+			shader_destroy_program(variant->shader);
+			shader_build_variant(shader, variant->shader, variant->key);
+
+			variant->shader->instanced = NULL;
+		}
+		else {
+			variant->shader = shader_compile_variant(shader, variant->key);
+		}
 	}
 
-	// Link the shader objects into a shader program.
-	shader_object_t shaders[2] = { shader->vertex, shader->fragment };
+	for (uint32_t i = 0; i < num_previous_keywords; i++) {
+		DESTROY(previous_keywords[i]);
+	}
 
-	shader->program = rend_create_shader_program(shaders, 2);
+	return success;
+}
+
+static bool shader_compile(shader_t *shader, size_t num_lines, const char **lines,
+                           size_t num_uniforms, const char **uniforms,
+                           UNIFORM_TYPE *uniform_types)
+{
+	// Skip compiling when the linked program is in the program binary cache. The shader objects are
+	// only needed for linking, so they are left empty.
+	shader->program = rend_load_program_binary(lines, num_lines);
 
 	if (shader->program == 0) {
 
-		log_warning("Renderer", "Failed to link shader program '%s'", shader->resource.res_name);
-		return false;
+		const char *log;
+
+		// Compile the vertex shader.
+		shader->vertex = rend_create_shader(SHADER_VERTEX, lines, num_lines, &log);
+
+		if (shader->vertex == 0) {
+
+			log_warning("Renderer", "Failed to compile vertex shader '%s':\n%s",
+				shader->resource.res_name, log);
+
+			return false;
+		}
+
+		// Compile the fragment shader.
+		shader->fragment = rend_create_shader(SHADER_FRAGMENT, lines, num_lines, &log);
+
+		if (shader->fragment == 0) {
+
+			log_warning("Renderer", "Failed to compile fragment shader '%s':\n%s",
+				shader->resource.res_name, log);
+
+			return false;
+		}
+
+		// Link the shader objects into a shader program.
+		shader_object_t shaders[2] = { shader->vertex, shader->fragment };
+
+		shader->program = rend_create_shader_program(shaders, 2);
+
+		if (shader->program == 0) {
+
+			log_warning("Renderer", "Failed to link shader program '%s'",
+				shader->resource.res_name);
+
+			return false;
+		}
+
+		rend_save_program_binary(shader->program, lines, num_lines);
+	}
+
+	// Bind the built-in uniform blocks used by the program to their binding points.
+	for (uint32_t i = 0; i < NUM_UNIFORM_BLOCKS; ++i) {
+		rend_bind_program_uniform_block(shader->program, shader_uniform_block_names[i], i);
 	}
 
 	// Get and cache shader uniform locations.
-	shader->matrix_array = rend_get_program_uniform_location(shader->program, MATRIX_ARRAY_NAME);
-	shader->vector_array = rend_get_program_uniform_location(shader->program, VECTOR_ARRAY_NAME);
 	shader->sampler_array = rend_get_program_uniform_location(shader->program, SAMPLER_ARRAY_NAME);
 
 	shader->light_array = rend_get_program_uniform_location(shader->program, LIGHT_ARRAY_NAME);
 	shader->num_lights_position = rend_get_program_uniform_location(shader->program, NUM_LIGHTS_NAME);
 
-	// Custom material uniforms.
+	shader->light_grid = rend_get_program_uniform_location(shader->program, LIGHT_GRID_NAME);
+	shader->light_indices = rend_get_program_uniform_location(shader->program, LIGHT_INDICES_NAME);
+	shader->light_data = rend_get_program_uniform_location(shader->program, LIGHT_DATA_NAME);
+
+	// Samplers always read the same texture units, so they are assigned once.
+	rend_bind_program_samplers(shader);
+
+	// Custom material uniforms. When the shader is reloaded, the uniforms of the previous program
+	// which the new source no longer declares are kept for their handles, but never set.
+	for (size_t i = 0; i < shader->material_uniforms.count; i++) {
+		shader->material_uniforms.items[i].position = -1;
+	}
+
 	for (size_t i = 0; i < num_uniforms; i++) {
 		shader_add_uniform(shader, uniforms[i], uniform_types[i]);
 	}
@@ -298,6 +534,174 @@ bool shader_load_from_source(
 	return true;
 }
 
+static shader_t *shader_compile_variant(shader_t *base, uint64_t key)
+{
+	shader_t *variant = shader_create(base->resource.res_name, NULL);
+
+	if (!shader_build_variant(base, variant, key)) {
+
+		shader_destroy(variant);
+		variant = NULL;
+	}
+
+	return variant;
+}
+
+static bool shader_build_variant(shader_t *base, shader_t *variant, uint64_t key)
+{
+	// Insert the defines of the keywords after the first line, which is reserved for the defines
+	// of the renderer.
+	size_t num_defines = 0;
+	char defines[MAX_SHADER_KEYWORDS][64];
+
+	for (uint32_t i = 0; i < base->keywords.count; i++) {
+
+		if (key & (1ull << i)) {
+			snprintf(defines[num_defines++], sizeof(defines[0]), "#define %s\n",
+			         base->keywords.items[i]);
+		}
+	}
+
+	size_t num_lines = base->source.count + num_defines;
+	const char **lines = mem_alloc_fast(num_lines * sizeof(const char *));
+
+	lines[0] = NULL;
+
+	for (size_t i = 0; i < num_defines; i++) {
+		lines[i + 1] = defines[i];
+	}
+
+	for (size_t i = 1; i < base->source.count; i++) {
+		lines[i + num_defines] = base->source.items[i];
+	}
+
+	// Declare the same custom uniforms as the base shader, so the uniforms have the same index in
+	// every variant.
+	size_t num_uniforms = base->material_uniforms.count;
+
+	const char **uniforms = mem_alloc_fast((num_uniforms + 1) * sizeof(const char *));
+	UNIFORM_TYPE *uniform_types = mem_alloc_fast((num_uniforms + 1) * sizeof(UNIFORM_TYPE));
+
+	for (size_t i = 0; i < num_uniforms; i++) {
+
+		uniforms[i] = base->material_uniforms.items[i].name;
+		uniform_types[i] = base->material_uniforms.items[i].type;
+	}
+
+	// A recompiled variant keeps the values of its existing uniforms.
+	size_t num_existing_uniforms = variant->material_uniforms.count;
+
+	variant->base = base;
+	variant->key = key;
+
+	bool success = shader_compile(variant, num_lines, lines, num_uniforms, uniforms, uniform_types);
+
+	if (success) {
+
+		variant->queue = base->queue;
+
+		// Start with the uniform values of the base shader.
+		for (size_t i = num_existing_uniforms; i < num_uniforms; i++) {
+			variant->material_uniforms.items[i].value = base->material_uniforms.items[i].value;
+		}
+
+		variant->dirty_uniforms = ~0ULL;
+	}
+	else {
+
+		log_warning("Shader", "Could not compile variant %016llx of shader %s.",
+			(unsigned long long)key, base->resource.res_name);
+	}
+
+	mem_free(lines);
+	mem_free(uniforms);
+	mem_free(uniform_types);
+
+	return success;
+}
+
+static uint64_t shader_remap_key(const shader_t *shader, uint64_t key,
+                                 char **previous_keywords, uint32_t num_previous_keywords)
+{
+	// Find the bits of the previously enabled keywords by name. Keywords which the shader no longer
+	// declares are dropped.
+	uint64_t remapped = 0;
+
+	for (uint32_t i = 0; i < num_previous_keywords; i++) {
+
+		if (key & (1ull << i)) {
+			remapped |= shader_get_keyword(shader, previous_keywords[i]);
+		}
+	}
+
+	return remapped;
+}
+
+static void shader_parse_keywords(shader_t *shader, size_t num_lines, const char **lines)
+{
+	for (size_t i = 0; i < num_lines; i++) {
+
+		if (lines[i] == NULL ||
+			!string_starts_with(lines[i], KEYWORDS_PRAGMA, sizeof(KEYWORDS_PRAGMA) - 1)) {
+
+			continue;
+		}
+
+		// The keywords are separated by white space.
+		const char *s = &lines[i][sizeof(KEYWORDS_PRAGMA) - 1];
+
+		while (*s != 0) {
+
+			while (*s == ' ' || *s == '\t' || *s == '\r' || *s == '\n') {
+				s++;
+			}
+
+			const char *start = s;
+
+			while (*s != 0 && *s != ' ' && *s != '\t' && *s != '\r' && *s != '\n') {
+				s++;
+			}
+
+			if (s == start) {
+				break;
+			}
+
+			if (shader->keywords.count >= MAX_SHADER_KEYWORDS) {
+
+				log_warning("Shader", "Shader %s declares more than %u keywords.",
+					shader->resource.res_name, MAX_SHADER_KEYWORDS);
+
+				return;
+			}
+
+			char keyword[64];
+			size_t length = MIN((size_t)(s - start), sizeof(keyword) - 1);
+
+			memcpy(keyword, start, length);
+			keyword[length] = 0;
+
+			arr_push(shader->keywords, string_duplicate(keyword));
+		}
+	}
+}
+
+static void shader_destroy_variants(shader_t *shader)
+{
+	for (uint32_t i = 0; i < shader->variants.count; i++) {
+		shader_destroy(shader->variants.items[i].shader);
+	}
+
+	arr_clear(shader->variants);
+
+	for (uint32_t i = 0; i < shader->keywords.count; i++) {
+		DESTROY(shader->keywords.items[i]);
+	}
+
+	arr_clear(shader->keywords);
+
+	shader->instanced = NULL;
+}
+
 static void shader_destroy_program(shader_t *shader)
 {
 	if (shader == NULL) {
@@ -318,7 +722,7 @@ static void shader_destroy_program(shader_t *shader)
 
 	if (shader->program != 0) {
 
-		rend_destroy_shader(shader->program);
+		rend_destroy_shader_program(shader->program);
 		shader->program = 0;
 	}
 
@@ -338,15 +742,32 @@ static void shader_add_uniform(shader_t *shader, const char *name, UNIFORM_TYPE
 		return;
 	}
 
-	int position = rend_get_program_uniform_location(shader->program, name);
+	// When a shader is reloaded, the uniforms declared again keep their handles and values.
+	shader_uniform_handle_t handle = shader_get_uniform_handle(shader, name);
+
+	if (handle != SHADER_UNIFORM_INVALID) {
+
+		shader->material_uniforms.items[handle].type = type;
+		shader->material_uniforms.items[handle].position =
+			rend_get_program_uniform_location(shader->program, name);
+
+		return;
+	}
 
-	if (position < 0) {
+	// Each uniform needs a bit in the dirty mask.
+	if (shader->material_uniforms.count >= MAX_MATERIAL_UNIFORMS) {
+
+		log_warning("Shader", "Shader %s declares too many custom uniforms, ignoring '%s'.",
+			shader->resource.res_name, name);
 
-		// If the uniform has no position in the compiled program, it is not used and the
-		// compiler has optimized it away. Ignore the uniform.
 		return;
 	}
 
+	// If the uniform has no position in the compiled program, it is not used and the compiler has
+	// optimized it away. The uniform is stored anyway, so every variant of the shader stores its
+	// uniforms in the same order. Uniforms without a position are never set.
+	int position = rend_get_program_uniform_location(shader->program, name);
+
 	// Store the uniform into the shader.
 	shader_uniform_t uniform;
 
@@ -360,17 +781,50 @@ static void shader_add_uniform(shader_t *shader, const char *name, UNIFORM_TYPE
 	arr_push(shader->material_uniforms, uniform);
 }
 
-static shader_uniform_t *shader_get_uniform(shader_t *shader, const char *name)
+static shader_uniform_handle_t shader_resolve_uniform(shader_t *shader, const char *name)
 {
-	for (uint32_t i = 0; i < shader->material_uniforms.count; i++) {
+	shader_uniform_handle_t handle = shader_get_uniform_handle(shader, name);
 
-		shader_uniform_t *uniform = &shader->material_uniforms.items[i];
+	if (handle == SHADER_UNIFORM_INVALID && shader != NULL && !string_is_null_or_empty(name)) {
 
-		if (string_equals(uniform->name, name)) {
-			return uniform;
-		}
+		log_warning("Shader", "Uniform '%s' does not exist in shader %s.",
+			name, shader->resource.name);
 	}
 
-	log_warning("Shader", "Uniform '%s' does not exist in shader %s.", name, shader->resource.name);
-	return NULL;
+	return handle;
+}
+
+static shader_uniform_t *shader_get_uniform_for_update(shader_t *shader,
+                                                      shader_uniform_handle_t handle,
+                                                      UNIFORM_TYPE type)
+{
+	if (handle < 0 || (uint32_t)handle >= shader->material_uniforms.count) {
+		return NULL;
+	}
+
+	shader_uniform_t *uniform = &shader->material_uniforms.items[handle];
+
+	if (uniform->type != type) {
+
+		log_warning("Shader", "Uniform '%s' in shader %s is not of type %s.",
+			uniform->name, shader->resource.name, shader_get_uniform_type_name(type));
+
+		return NULL;
+	}
+
+	// Flag the uniform to be updated before rendering the next frame.
+	shader->dirty_uniforms |= (1ULL << handle);
+
+	return uniform;
+}
+
+static const char *shader_get_uniform_type_name(UNIFORM_TYPE type)
+{
+	switch (type) {
+		case UNIFORM_TYPE_INT: return "int";
+		case UNIFORM_TYPE_FLOAT: return "float";
+		case UNIFORM_TYPE_VECTOR4: return "vec4";
+		case UNIFORM_TYPE_COLOUR: return "colour";
+		default: return "unknown";
+	}
 }
@@ -50,6 +50,7 @@ typedef enum {
 	ATTR_ROTATION,
 	ATTR_SIZE,
 	ATTR_TANGENT,
+	ATTR_INSTANCE_MODEL, // Model matrix of an instance, uses four consecutive locations
 	NUM_SHADER_ATTRIBUTES
 
 } SHADER_ATTRIBUTE;
@@ -67,31 +68,19 @@ typedef enum {
 
 // -------------------------------------------------------------------------------------------------
 
-// Built-in uniform array indices.
-// NOTE: When adding these, the values should also be updated to mylly.cging!
+// Built-in uniform blocks. Each block is bound to the binding point of the same index.
+// NOTE: The layout of the blocks is declared in mylly.glinc and has to match the renderer!
 
 enum {
-	UNIFORM_MAT_MVP = 0, // Model-view-projection matrix
-	UNIFORM_MAT_MODEL = 1, // Model matrix
-	UNIFORM_MAT_VIEW = 2, // View matrix
-	UNIFORM_MAT_VIEW_INV = 3, // Inverse view matrix
-	UNIFORM_MAT_PROJECTION = 4, // Projection matrix
-	UNIFORM_MAT_PROJECTION_INV = 5, // Inverse projection matrix
-	UNIFORM_MAT_VIEWPROJ = 6, // View-projection matrix
-	UNIFORM_MAT_VIEWPROJ_INV = 7, // Inverse view-projection matrix
-
-	NUM_MAT_UNIFORMS
-};
+	UNIFORM_BLOCK_FRAME = 0, // Constants which change once per frame (time)
+	UNIFORM_BLOCK_VIEW = 1, // Constants of the rendered view (matrices, screen, ambient light etc.)
+	UNIFORM_BLOCK_OBJECT = 2, // Constants of a single drawn object (model and MVP matrices)
 
-enum {
-	UNIFORM_VEC_VIEW_POSITION = 0, // The position of the rendered view (camera)
-	UNIFORM_VEC_TIME = 1, // 4-element vector containing time (see core/time.h)
-	UNIFORM_VEC_SCREEN = 2, // Screen size in pixels
-	UNIFORM_VEC_COLOUR = 3, // Colour of the mesh. For lit materials this is the ambient colour
-	
-	NUM_VEC_UNIFORMS
+	NUM_UNIFORM_BLOCKS
 };
 
+// Built-in sampler array indices. Each sampler always reads the texture unit of the same index.
+
 enum {
 	UNIFORM_SAMPLER_MAIN = 0, // Main sampler (usually input/output)
 	UNIFORM_SAMPLER_NORMAL = 1, // Normal map texture
@@ -118,6 +107,27 @@ typedef struct shader_uniform_t {
 
 } shader_uniform_t;
 
+// A custom uniform resolved by its name with shader_get_uniform_handle(). The handle is the index
+// of the uniform in the material_uniforms array, so setting a value through it doesn't have to look
+// up the name. Variants and clones of a shader store their uniforms in the same order, so a handle
+// is valid for each of them.
+typedef int shader_uniform_handle_t;
+
+#define SHADER_UNIFORM_INVALID -1 // Handle of a uniform the shader doesn't declare
+
+// Each custom uniform has a bit in the dirty mask of its shader.
+#define MAX_MATERIAL_UNIFORMS 64
+
+// A variant of a shader compiled with a set of keywords enabled.
+#define MAX_SHADER_KEYWORDS 64 // One bit in a variant key per keyword
+
+typedef struct shader_variant_t {
+
+	uint64_t key; // Bit mask of the enabled keywords
+	struct shader_t *shader; // The compiled variant, NULL if the variant failed to compile
+
+} shader_variant_t;
+
 // -------------------------------------------------------------------------------------------------
 
 typedef struct shader_t {
@@ -131,19 +141,38 @@ typedef struct shader_t {
 	int queue; // Render queue used by this shader - see enum SHADER_QUEUE above
 	int attributes[NUM_SHADER_ATTRIBUTES]; // List of vertex attributes used by the program
 
-	// Positions for built-in renderer uniform arrays.
-	int matrix_array; // Matrix data
-	int vector_array; // Vector data
+	// Positions for built-in renderer uniform arrays. Matrices and vectors are passed to the program
+	// in uniform blocks.
 	int sampler_array; // Textures
 	int light_array; // Lights
 	int num_lights_position;
 
+	// Positions for light grid samplers (forward lighting).
+	int light_grid; // Light list offset and length of each cluster
+	int light_indices; // Light lists of all clusters
+	int light_data; // Parameters of each light
+
 	// Positions and values for custom material uniforms.
 	arr_t(shader_uniform_t) material_uniforms;
-	bool has_updated_uniforms; // A flag indicating whether the custom uniforms need updating
+	uint64_t dirty_uniforms; // A bit for each custom uniform which has changed since it was recorded
+	bool is_shared_by_materials; // Materials set the custom uniforms from their parameter blocks
 
 	arr_t(const char *) source; // An array consisting of source code lines of the shader
 
+	// Feature keywords declared by the source with '#pragma keywords'. Each keyword is a bit in the
+	// key of a variant, and a variant is compiled with the keywords of its key defined. Variants
+	// are compiled when they are first needed and cached by their key in the base shader. Material
+	// uniform values and the render queue set on the base shader are passed on to its variants.
+	arr_t(char *) keywords;
+	arr_t(shader_variant_t) variants;
+
+	struct shader_t *base; // The shader this is a variant of, NULL for the base shader
+	uint64_t key; // Keywords enabled in this variant
+
+	// The variant for drawing several instances of a mesh with a single draw call, i.e. this
+	// variant with the INSTANCING keyword enabled. Set by shader_get_instanced_variant().
+	struct shader_t *instanced;
+
 } shader_t;
 
 // -------------------------------------------------------------------------------------------------
@@ -158,8 +187,35 @@ void shader_set_uniform_float(shader_t *shader, const char *name, float value);
 void shader_set_uniform_vector(shader_t *shader, const char *name, vec4_t value);
 void shader_set_uniform_colour(shader_t *shader, const char *name, colour_t value);
 
+// Returns the handle of a custom uniform, or SHADER_UNIFORM_INVALID if the shader has no such
+// uniform. Resolve the handles of uniforms which are set often once and use the methods below.
+shader_uniform_handle_t shader_get_uniform_handle(shader_t *shader, const char *name);
+
+void shader_set_uniform_int_by_handle(shader_t *shader, shader_uniform_handle_t handle, int value);
+void shader_set_uniform_float_by_handle(shader_t *shader, shader_uniform_handle_t handle,
+                                        float value);
+void shader_set_uniform_vector_by_handle(shader_t *shader, shader_uniform_handle_t handle,
+                                         vec4_t value);
+void shader_set_uniform_colour_by_handle(shader_t *shader, shader_uniform_handle_t handle,
+                                         colour_t value);
+
 void shader_set_render_queue(shader_t *shader, SHADER_QUEUE queue);
 
+// Returns the bit of a keyword declared by the shader, or 0 if the shader doesn't declare it.
+uint64_t shader_get_keyword(const shader_t *shader, const char *keyword);
+
+// Returns the variant of the shader with the given keywords enabled in addition to the keywords of
+// the shader itself. The variant is compiled if it hasn't been used before, so this must be called
+// from the main thread. Returns the shader itself if the variant could not be compiled.
+shader_t *shader_get_variant(shader_t *shader, uint64_t keywords);
+
+// Returns the instancing variant of the shader, compiling it if needed. Returns NULL if the shader
+// doesn't support instancing.
+shader_t *shader_get_instanced_variant(shader_t *shader);
+
+// Returns the name of a vertex attribute in shader source code.
+const char *shader_get_attribute_name(SHADER_ATTRIBUTE attribute);
+
 // -------------------------------------------------------------------------------------------------
 
 bool shader_load_from_source(
@@ -176,7 +232,7 @@ bool shader_load_from_source(
 	((shader)->attributes[(attribute)])
 
 #define shader_is_affected_by_light(shader)\
-	((shader)->light_array >= 0 && (shader)->num_lights_position >= 0)
+	((shader)->light_array >= 0 || (shader)->light_grid >= 0)
 
 END_DECLARATIONS;
 
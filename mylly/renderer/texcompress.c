@@ -0,0 +1,511 @@
+#include "texcompress.h"
+#include "math/math.h"
+#include <stdlib.h>
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+#define BLOCK_PIXELS 16 // Pixels in a 4x4 block
+#define POWER_ITERATIONS 8 // Iterations used to find the principal axis of the colours of a block
+
+// -------------------------------------------------------------------------------------------------
+
+static void texcomp_fetch_block(const uint8_t *image, size_t width, size_t height, size_t channels,
+                                size_t block_x, size_t block_y, uint8_t pixels[BLOCK_PIXELS][4]);
+static void texcomp_store_block(uint8_t *image, size_t width, size_t height, size_t channels,
+                                size_t block_x, size_t block_y, uint8_t pixels[BLOCK_PIXELS][4]);
+
+static void texcomp_encode_colour_block(uint8_t pixels[BLOCK_PIXELS][4], uint8_t *dst);
+static void texcomp_encode_value_block(uint8_t pixels[BLOCK_PIXELS][4], size_t channel,
+                                       uint8_t *dst);
+static void texcomp_decode_colour_block(const uint8_t *src, bool is_bc1,
+                                        uint8_t pixels[BLOCK_PIXELS][4]);
+static void texcomp_decode_value_block(const uint8_t *src, size_t channel,
+                                       uint8_t pixels[BLOCK_PIXELS][4]);
+
+static uint32_t texcomp_fit_colour_indices(uint8_t pixels[BLOCK_PIXELS][4], uint16_t *endpoint0,
+                                           uint16_t *endpoint1, uint32_t *indices);
+static void texcomp_get_colour_palette(uint16_t endpoint0, uint16_t endpoint1, bool is_bc1,
+                                       int palette[4][3]);
+static void texcomp_get_value_palette(uint8_t endpoint0, uint8_t endpoint1, int palette[8]);
+static uint16_t texcomp_quantize_colour(const float colour[3]);
+static void texcomp_expand_colour(uint16_t colour, int rgb[3]);
+
+// -------------------------------------------------------------------------------------------------
+
+bool texcomp_is_compressed(TEX_FORMAT format)
+{
+	return (format == TEX_FORMAT_BC1 || format == TEX_FORMAT_BC3 ||
+	        format == TEX_FORMAT_BC4 || format == TEX_FORMAT_BC5);
+}
+
+size_t texcomp_get_channels(TEX_FORMAT format)
+{
+	switch (format) {
+		case TEX_FORMAT_BC1: return 3;
+		case TEX_FORMAT_BC3: return 4;
+		case TEX_FORMAT_BC4: return 1;
+		case TEX_FORMAT_BC5: return 2;
+		default: return 0;
+	}
+}
+
+size_t texcomp_get_size(TEX_FORMAT format, size_t width, size_t height)
+{
+	size_t block_size = (format == TEX_FORMAT_BC1 || format == TEX_FORMAT_BC4 ? 8 : 16);
+	return ((width + 3) / 4) * ((height + 3) / 4) * block_size;
+}
+
+void texcomp_encode(const uint8_t *image, size_t width, size_t height, size_t channels,
+                    TEX_FORMAT format, uint8_t *dst)
+{
+	uint8_t pixels[BLOCK_PIXELS][4];
+
+	for (size_t y = 0; y < height; y += 4) {
+		for (size_t x = 0; x < width; x += 4) {
+
+			texcomp_fetch_block(image, width, height, channels, x, y, pixels);
+
+			switch (format) {
+
+				case TEX_FORMAT_BC1:
+					texcomp_encode_colour_block(pixels, dst);
+					dst += 8;
+					break;
+
+				case TEX_FORMAT_BC3:
+					texcomp_encode_value_block(pixels, 3, dst);
+					texcomp_encode_colour_block(pixels, dst + 8);
+					dst += 16;
+					break;
+
+				case TEX_FORMAT_BC4:
+					texcomp_encode_value_block(pixels, 0, dst);
+					dst += 8;
+					break;
+
+				case TEX_FORMAT_BC5:
+					texcomp_encode_value_block(pixels, 0, dst);
+					texcomp_encode_value_block(pixels, 1, dst + 8);
+					dst += 16;
+					break;
+
+				default:
+					return;
+			}
+		}
+	}
+}
+
+void texcomp_decode(const uint8_t *data, size_t width, size_t height, TEX_FORMAT format,
+                    uint8_t *dst)
+{
+	uint8_t pixels[BLOCK_PIXELS][4];
+	size_t channels = texcomp_get_channels(format);
+
+	for (size_t y = 0; y < height; y += 4) {
+		for (size_t x = 0; x < width; x += 4) {
+
+			switch (format) {
+
+				case TEX_FORMAT_BC1:
+					texcomp_decode_colour_block(data, true, pixels);
+					data += 8;
+					break;
+
+				case TEX_FORMAT_BC3:
+					texcomp_decode_value_block(data, 3, pixels);
+					texcomp_decode_colour_block(data + 8, false, pixels);
+					data += 16;
+					break;
+
+				case TEX_FORMAT_BC4:
+					texcomp_decode_value_block(data, 0, pixels);
+					data += 8;
+					break;
+
+				case TEX_FORMAT_BC5:
+					texcomp_decode_value_block(data, 0, pixels);
+					texcomp_decode_value_block(data + 8, 1, pixels);
+					data += 16;
+					break;
+
+				default:
+					return;
+			}
+
+			texcomp_store_block(dst, width, height, channels, x, y, pixels);
+		}
+	}
+}
+
+uint64_t texcomp_hash(const void *data, size_t size)
+{
+	const uint8_t *bytes = data;
+	uint64_t hash = 0xCBF29CE484222325ULL;
+
+	for (size_t i = 0; i < size; ++i) {
+
+		hash ^= bytes[i];
+		hash *= 0x100000001B3ULL;
+	}
+
+	return hash;
+}
+
+static void texcomp_fetch_block(const uint8_t *image, size_t width, size_t height, size_t channels,
+                                size_t block_x, size_t block_y, uint8_t pixels[BLOCK_PIXELS][4])
+{
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		// Pixels outside the image repeat the last row or column.
+		size_t x = MIN(block_x + i % 4, width - 1);
+		size_t y = MIN(block_y + i / 4, height - 1);
+
+		const uint8_t *pixel = &image[(y * width + x) * channels];
+
+		// Grayscale images are encoded as gray colours, missing alpha is opaque.
+		pixels[i][0] = pixel[0];
+		pixels[i][1] = (channels >= 2 ? pixel[1] : pixel[0]);
+		pixels[i][2] = (channels >= 3 ? pixel[2] : pixel[0]);
+		pixels[i][3] = (channels >= 4 ? pixel[3] : 255);
+	}
+}
+
+static void texcomp_store_block(uint8_t *image, size_t width, size_t height, size_t channels,
+                                size_t block_x, size_t block_y, uint8_t pixels[BLOCK_PIXELS][4])
+{
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		size_t x = block_x + i % 4;
+		size_t y = block_y + i / 4;
+
+		if (x < width && y < height) {
+			memcpy(&image[(y * width + x) * channels], pixels[i], channels);
+		}
+	}
+}
+
+static void texcomp_encode_colour_block(uint8_t pixels[BLOCK_PIXELS][4], uint8_t *dst)
+{
+	// Find the principal axis of the colours with power iteration on their covariance matrix.
+	float mean[3] = { 0, 0, 0 };
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+		for (size_t c = 0; c < 3; c++) {
+			mean[c] += pixels[i][c] / (float)BLOCK_PIXELS;
+		}
+	}
+
+	float covariance[3][3] = { { 0 } };
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+		for (size_t a = 0; a < 3; a++) {
+			for (size_t b = 0; b < 3; b++) {
+				covariance[a][b] += (pixels[i][a] - mean[a]) * (pixels[i][b] - mean[b]);
+			}
+		}
+	}
+
+	float axis[3] = { 1, 1, 1 };
+
+	for (int iteration = 0; iteration < POWER_ITERATIONS; iteration++) {
+
+		float next[3];
+		float largest = 0;
+
+		for (size_t a = 0; a < 3; a++) {
+
+			next[a] = covariance[a][0] * axis[0] + covariance[a][1] * axis[1] +
+			          covariance[a][2] * axis[2];
+
+			largest = MAX(largest, fabsf(next[a]));
+		}
+
+		// A block of a single colour has no axis, any direction will do.
+		if (largest < 1e-6f) {
+			break;
+		}
+
+		for (size_t a = 0; a < 3; a++) {
+			axis[a] = next[a] / largest;
+		}
+	}
+
+	// Use the colours furthest away from the mean along the axis as endpoints.
+	float length = axis[0] * axis[0] + axis[1] * axis[1] + axis[2] * axis[2];
+	float min_t = 0, max_t = 0;
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		float t = ((pixels[i][0] - mean[0]) * axis[0] +
+		           (pixels[i][1] - mean[1]) * axis[1] +
+		           (pixels[i][2] - mean[2]) * axis[2]) / length;
+
+		min_t = MIN(min_t, t);
+		max_t = MAX(max_t, t);
+	}
+
+	float colour0[3], colour1[3];
+
+	for (size_t c = 0; c < 3; c++) {
+
+		colour0[c] = mean[c] + axis[c] * max_t;
+		colour1[c] = mean[c] + axis[c] * min_t;
+	}
+
+	uint16_t endpoint0 = texcomp_quantize_colour(colour0);
+	uint16_t endpoint1 = texcomp_quantize_colour(colour1);
+	uint32_t indices;
+	uint32_t error = texcomp_fit_colour_indices(pixels, &endpoint0, &endpoint1, &indices);
+
+	// Refine the endpoints with a least squares fit to the selected palette entries.
+	static const float weights[4] = { 1.0f, 0.0f, 2.0f / 3.0f, 1.0f / 3.0f };
+
+	float aa = 0, bb = 0, ab = 0;
+	float ax[3] = { 0, 0, 0 }, bx[3] = { 0, 0, 0 };
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		float a = weights[(indices >> (2 * i)) & 3];
+		float b = 1 - a;
+
+		aa += a * a;
+		bb += b * b;
+		ab += a * b;
+
+		for (size_t c = 0; c < 3; c++) {
+
+			ax[c] += a * pixels[i][c];
+			bx[c] += b * pixels[i][c];
+		}
+	}
+
+	float determinant = aa * bb - ab * ab;
+
+	if (fabsf(determinant) > 1e-6f) {
+
+		for (size_t c = 0; c < 3; c++) {
+
+			colour0[c] = CLAMP((ax[c] * bb - bx[c] * ab) / determinant, 0, 255);
+			colour1[c] = CLAMP((bx[c] * aa - ax[c] * ab) / determinant, 0, 255);
+		}
+
+		uint16_t refined0 = texcomp_quantize_colour(colour0);
+		uint16_t refined1 = texcomp_quantize_colour(colour1);
+		uint32_t refined_indices;
+		uint32_t refined_error = texcomp_fit_colour_indices(pixels, &refined0, &refined1,
+		                                                    &refined_indices);
+
+		if (refined_error < error) {
+
+			endpoint0 = refined0;
+			endpoint1 = refined1;
+			indices = refined_indices;
+		}
+	}
+
+	dst[0] = (uint8_t)(endpoint0 & 0xFF);
+	dst[1] = (uint8_t)(endpoint0 >> 8);
+	dst[2] = (uint8_t)(endpoint1 & 0xFF);
+	dst[3] = (uint8_t)(endpoint1 >> 8);
+	dst[4] = (uint8_t)(indices & 0xFF);
+	dst[5] = (uint8_t)((indices >> 8) & 0xFF);
+	dst[6] = (uint8_t)((indices >> 16) & 0xFF);
+	dst[7] = (uint8_t)(indices >> 24);
+}
+
+static uint32_t texcomp_fit_colour_indices(uint8_t pixels[BLOCK_PIXELS][4], uint16_t *endpoint0,
+                                           uint16_t *endpoint1, uint32_t *indices)
+{
+	// The first endpoint has to be larger to use the four colour mode in BC1.
+	if (*endpoint0 < *endpoint1) {
+
+		uint16_t swap = *endpoint0;
+		*endpoint0 = *endpoint1;
+		*endpoint1 = swap;
+	}
+
+	int palette[4][3];
+	texcomp_get_colour_palette(*endpoint0, *endpoint1, false, palette);
+
+	// Equal endpoints use the three colour mode, where only the first entry is the same colour.
+	size_t num_entries = (*endpoint0 == *endpoint1 ? 1 : 4);
+	uint32_t total_error = 0;
+
+	*indices = 0;
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		uint32_t best_error = UINT32_MAX;
+		uint32_t best_index = 0;
+
+		for (size_t j = 0; j < num_entries; j++) {
+
+			int dr = pixels[i][0] - palette[j][0];
+			int dg = pixels[i][1] - palette[j][1];
+			int db = pixels[i][2] - palette[j][2];
+
+			uint32_t error = (uint32_t)(dr * dr + dg * dg + db * db);
+
+			if (error < best_error) {
+
+				best_error = error;
+				best_index = (uint32_t)j;
+			}
+		}
+
+		*indices |= (best_index << (2 * i));
+		total_error += best_error;
+	}
+
+	return total_error;
+}
+
+static void texcomp_encode_value_block(uint8_t pixels[BLOCK_PIXELS][4], size_t channel,
+                                       uint8_t *dst)
+{
+	uint8_t min_value = 255, max_value = 0;
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		min_value = MIN(min_value, pixels[i][channel]);
+		max_value = MAX(max_value, pixels[i][channel]);
+	}
+
+	// The first endpoint is larger to use the mode with eight interpolated values. A block of a
+	// single value uses only the first entry.
+	int palette[8];
+	texcomp_get_value_palette(max_value, min_value, palette);
+
+	size_t num_entries = (max_value == min_value ? 1 : 8);
+	uint64_t indices = 0;
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		int best_error = INT32_MAX;
+		uint64_t best_index = 0;
+
+		for (size_t j = 0; j < num_entries; j++) {
+
+			int error = abs(pixels[i][channel] - palette[j]);
+
+			if (error < best_error) {
+
+				best_error = error;
+				best_index = j;
+			}
+		}
+
+		indices |= (best_index << (3 * i));
+	}
+
+	dst[0] = max_value;
+	dst[1] = min_value;
+
+	for (size_t i = 0; i < 6; i++) {
+		dst[2 + i] = (uint8_t)((indices >> (8 * i)) & 0xFF);
+	}
+}
+
+static void texcomp_decode_colour_block(const uint8_t *src, bool is_bc1,
+                                        uint8_t pixels[BLOCK_PIXELS][4])
+{
+	uint16_t endpoint0 = (uint16_t)(src[0] | (src[1] << 8));
+	uint16_t endpoint1 = (uint16_t)(src[2] | (src[3] << 8));
+	uint32_t indices = (uint32_t)src[4] | ((uint32_t)src[5] << 8) |
+	                   ((uint32_t)src[6] << 16) | ((uint32_t)src[7] << 24);
+
+	int palette[4][3];
+	texcomp_get_colour_palette(endpoint0, endpoint1, is_bc1, palette);
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+
+		uint32_t index = (indices >> (2 * i)) & 3;
+
+		pixels[i][0] = (uint8_t)palette[index][0];
+		pixels[i][1] = (uint8_t)palette[index][1];
+		pixels[i][2] = (uint8_t)palette[index][2];
+	}
+}
+
+static void texcomp_decode_value_block(const uint8_t *src, size_t channel,
+                                       uint8_t pixels[BLOCK_PIXELS][4])
+{
+	int palette[8];
+	texcomp_get_value_palette(src[0], src[1], palette);
+
+	uint64_t indices = 0;
+
+	for (size_t i = 0; i < 6; i++) {
+		indices |= ((uint64_t)src[2 + i] << (8 * i));
+	}
+
+	for (size_t i = 0; i < BLOCK_PIXELS; i++) {
+		pixels[i][channel] = (uint8_t)palette[(indices >> (3 * i)) & 7];
+	}
+}
+
+static void texcomp_get_colour_palette(uint16_t endpoint0, uint16_t endpoint1, bool is_bc1,
+                                       int palette[4][3])
+{
+	texcomp_expand_colour(endpoint0, palette[0]);
+	texcomp_expand_colour(endpoint1, palette[1]);
+
+	for (size_t c = 0; c < 3; c++) {
+
+		// BC1 uses three colours and black when the first endpoint is not larger.
+		if (is_bc1 && endpoint0 <= endpoint1) {
+
+			palette[2][c] = (palette[0][c] + palette[1][c]) / 2;
+			palette[3][c] = 0;
+		}
+		else {
+
+			palette[2][c] = (2 * palette[0][c] + palette[1][c]) / 3;
+			palette[3][c] = (palette[0][c] + 2 * palette[1][c]) / 3;
+		}
+	}
+}
+
+static void texcomp_get_value_palette(uint8_t endpoint0, uint8_t endpoint1, int palette[8])
+{
+	palette[0] = endpoint0;
+	palette[1] = endpoint1;
+
+	if (endpoint0 > endpoint1) {
+
+		for (int i = 2; i < 8; i++) {
+			palette[i] = ((8 - i) * endpoint0 + (i - 1) * endpoint1 + 3) / 7;
+		}
+	}
+	else {
+
+		for (int i = 2; i < 6; i++) {
+			palette[i] = ((6 - i) * endpoint0 + (i - 1) * endpoint1 + 2) / 5;
+		}
+
+		palette[6] = 0;
+		palette[7] = 255;
+	}
+}
+
+static uint16_t texcomp_quantize_colour(const float colour[3])
+{
+	int r = (int)(CLAMP(colour[0], 0, 255) * 31 / 255 + 0.5f);
+	int g = (int)(CLAMP(colour[1], 0, 255) * 63 / 255 + 0.5f);
+	int b = (int)(CLAMP(colour[2], 0, 255) * 31 / 255 + 0.5f);
+
+	return (uint16_t)((r << 11) | (g << 5) | b);
+}
+
+static void texcomp_expand_colour(uint16_t colour, int rgb[3])
+{
+	int r = (colour >> 11) & 31;
+	int g = (colour >> 5) & 63;
+	int b = colour & 31;
+
+	rgb[0] = (r << 3) | (r >> 2);
+	rgb[1] = (g << 2) | (g >> 4);
+	rgb[2] = (b << 3) | (b >> 2);
+}
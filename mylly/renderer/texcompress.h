@@ -0,0 +1,57 @@
+#pragma once
+#ifndef __TEXCOMPRESS_H
+#define __TEXCOMPRESS_H
+
+#include "core/defines.h"
+#include "renderer/texture.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Block texture compression
+
+	A CPU encoder and decoder for the block compressed texture formats BC1, BC3, BC4 and BC5 (also
+	known as DXT1, DXT5, RGTC1 and RGTC2). Each format stores the pixels in 4x4 blocks of 8 or 16
+	bytes. The blocks on the right and bottom edges of images which are not a multiple of 4 pixels
+	in size repeat the last column and row of the image.
+
+	The colour endpoints of a block are fitted along the principal axis of the colours of the block
+	and refined once with a least squares fit. Single channel blocks use the minimum and maximum
+	value of the block as endpoints.
+
+	Source images are 8-bit images with 1 to 4 channels. BC1 encodes the first three channels (or
+	the first channel of a grayscale image), BC3 encodes four channels, BC4 encodes the first
+	channel and BC5 the first two channels. Images are decoded into the channels of the format.
+
+	The methods don't use any renderer state, so they can be tested without a GPU.
+
+====================================================================================================
+*/
+
+// Returns true if the format is one of the block compressed formats.
+bool texcomp_is_compressed(TEX_FORMAT format);
+
+// Returns the number of channels encoded by a format.
+size_t texcomp_get_channels(TEX_FORMAT format);
+
+// Returns the size of an image in a compressed format in bytes.
+size_t texcomp_get_size(TEX_FORMAT format, size_t width, size_t height);
+
+// Encode an image into a compressed format. The destination must have room for the size returned
+// by texcomp_get_size().
+void texcomp_encode(const uint8_t *image, size_t width, size_t height, size_t channels,
+                    TEX_FORMAT format, uint8_t *dst);
+
+// Decode a compressed image. The destination must have room for width * height pixels of the
+// channels of the format.
+void texcomp_decode(const uint8_t *data, size_t width, size_t height, TEX_FORMAT format,
+                    uint8_t *dst);
+
+// Calculate a 64-bit FNV-1a hash of a block of data, for example the source file of a texture.
+uint64_t texcomp_hash(const void *data, size_t size);
+
+END_DECLARATIONS;
+
+#endif
@@ -0,0 +1,385 @@
+#include "texstream.h"
+#include "renderer/mipmap.h"
+#include "collections/array.h"
+#include "core/memory.h"
+#include "core/mylly.h"
+#include "io/log.h"
+#include "math/math.h"
+#include <math.h>
+#include <stdlib.h>
+
+// -------------------------------------------------------------------------------------------------
+
+static size_t texstream_get_size(const texstream_entry_t *entry, uint32_t level);
+static size_t texstream_get_resident_size(const texstream_entry_t *entry);
+static uint8_t texstream_get_eviction_level(const texstream_entry_t *entry);
+static int texstream_compare_loads(const void *a, const void *b);
+static void texstream_destroy_entry(texstream_entry_t *entry);
+static bool texstream_evict(const texstream_entry_t *loaded, size_t *resident);
+static bool texstream_load(texstream_entry_t *entry, uint8_t level);
+
+// -------------------------------------------------------------------------------------------------
+
+static arr_t(texstream_entry_t*) entries;
+static size_t budget; // Memory budget of the resident levels
+static uint32_t frame; // Number of processed frames
+static uint32_t num_loads; // Number of textures loaded at a larger size
+static uint32_t num_evictions; // Number of textures evicted to a smaller size
+
+// -------------------------------------------------------------------------------------------------
+
+void texstream_initialize(void)
+{
+	arr_init(entries);
+
+	budget = mylly_get_parameters()->renderer.texture_streaming_budget;
+	frame = 0;
+	num_loads = 0;
+	num_evictions = 0;
+}
+
+void texstream_shutdown(void)
+{
+	texstream_entry_t *entry;
+
+	arr_foreach(entries, entry) {
+
+		entry->texture->stream = NULL;
+		texstream_destroy_entry(entry);
+	}
+
+	arr_clear(entries);
+}
+
+bool texstream_add_texture(texture_t *texture, void *data, size_t data_length, TEX_FILTER filter)
+{
+	if (texture == NULL || data == NULL || texture->stream != NULL) {
+		return false;
+	}
+
+	if (!texture_read_info(texture, data, data_length)) {
+		return false;
+	}
+
+	// Find the largest level which fits the base size.
+	uint32_t num_levels = mipmap_get_num_levels(texture->width, texture->height);
+	uint8_t base_level = 0;
+
+	while (base_level + 1u < num_levels &&
+		   MAX(texture->width >> base_level, texture->height >> base_level) > TEXSTREAM_BASE_SIZE) {
+		base_level++;
+	}
+
+	if (!texture_load_async(texture, data, data_length, filter, base_level)) {
+		return false;
+	}
+
+	NEW(texstream_entry_t, entry);
+
+	entry->texture = texture;
+	entry->filter = filter;
+	entry->base_level = base_level;
+	entry->requested_level = base_level;
+	entry->frame_level = base_level;
+	entry->loading_level = base_level;
+	entry->last_used = frame;
+
+	texture->stream = entry;
+
+	arr_push(entries, entry);
+
+	return true;
+}
+
+void texstream_remove_texture(texture_t *texture)
+{
+	if (texture == NULL || texture->stream == NULL) {
+		return;
+	}
+
+	texstream_entry_t *entry = texture->stream;
+
+	arr_remove(entries, entry);
+	texstream_destroy_entry(entry);
+
+	texture->stream = NULL;
+}
+
+void texstream_request(texture_t *texture, float screen_size)
+{
+	if (texture == NULL || texture->stream == NULL) {
+		return;
+	}
+
+	texstream_entry_t *entry = texture->stream;
+
+	// The texture is assumed to be mapped once over the mesh, so one texel per pixel is needed
+	// when the mesh covers as many pixels as the texture is wide.
+	uint16_t screen_width, screen_height;
+	mylly_get_resolution(&screen_width, &screen_height);
+
+	float pixels = MAX(screen_size * screen_height, 1.0f);
+	float texels = MAX(texture->width, texture->height);
+
+	uint8_t level = 0;
+
+	if (texels > pixels) {
+		level = (uint8_t)MIN(floorf(log2f(texels / pixels)), entry->base_level);
+	}
+
+	entry->frame_level = MIN(entry->frame_level, level);
+	entry->last_used = frame;
+}
+
+void texstream_process(void)
+{
+	// Update the requested levels from the requests of the frame. Textures which haven't been
+	// requested for a while are no longer needed at all.
+	texstream_entry_t *entry;
+
+	arr_foreach(entries, entry) {
+
+		if (entry->last_used == frame) {
+			entry->requested_level = entry->frame_level;
+		}
+		else if (frame - entry->last_used > TEXSTREAM_UNUSED_FRAMES) {
+			entry->requested_level = entry->base_level;
+		}
+
+		entry->frame_level = entry->base_level;
+	}
+
+	// Count the memory used by the resident levels and the levels being loaded.
+	size_t resident = 0;
+	uint32_t num_loading = 0;
+
+	arr_foreach(entries, entry) {
+
+		resident += texstream_get_resident_size(entry);
+
+		if (texture_is_loading(entry->texture)) {
+			num_loading++;
+		}
+	}
+
+	// Collect the textures which need larger levels, starting from the most recently used ones.
+	arr_t(texstream_entry_t*) loads;
+	arr_init(loads);
+
+	arr_foreach(entries, entry) {
+
+		if (!texture_is_loading(entry->texture) &&
+			entry->requested_level < entry->texture->first_level) {
+
+			arr_push(loads, entry);
+		}
+	}
+
+	qsort(loads.items, loads.count, sizeof(loads.items[0]), texstream_compare_loads);
+
+	// Load the textures until the number of loads in progress is used up. Smaller levels are
+	// loaded if the requested levels don't fit into the budget, and textures for which nothing
+	// larger fits are skipped in favour of the next ones.
+	arr_foreach(loads, entry) {
+
+		if (num_loading >= TEXSTREAM_MAX_LOADS) {
+			break;
+		}
+
+		// The texture may have been evicted to make room for another one.
+		if (texture_is_loading(entry->texture)) {
+			continue;
+		}
+
+		uint8_t level = entry->requested_level;
+		size_t current_size = texstream_get_resident_size(entry);
+
+		// Evictions count against the loads in progress, leaving room for this texture's load.
+		while (num_loading + 1 < TEXSTREAM_MAX_LOADS &&
+		       resident - current_size + texstream_get_size(entry, level) > budget) {
+
+			if (!texstream_evict(entry, &resident)) {
+				break;
+			}
+
+			num_loading++;
+		}
+
+		while (level < entry->texture->first_level &&
+		       resident - current_size + texstream_get_size(entry, level) > budget) {
+			level++;
+		}
+
+		// Nothing larger fits into the budget.
+		if (level == entry->texture->first_level || !texstream_load(entry, level)) {
+			continue;
+		}
+
+		resident = resident - current_size + texstream_get_size(entry, level);
+		num_loading++;
+		num_loads++;
+	}
+
+	arr_clear(loads);
+
+	frame++;
+}
+
+void texstream_get_stats(texstream_stats_t *stats)
+{
+	if (stats == NULL) {
+		return;
+	}
+
+	*stats = (texstream_stats_t){ 0 };
+
+	stats->num_textures = (uint32_t)entries.count;
+	stats->budget = budget;
+	stats->loads = num_loads;
+	stats->evictions = num_evictions;
+
+	texstream_entry_t *entry;
+
+	arr_foreach(entries, entry) {
+
+		stats->resident_bytes += texstream_get_size(entry, entry->texture->first_level);
+		stats->requested_bytes += texstream_get_size(entry, entry->requested_level);
+
+		if (texture_is_loading(entry->texture)) {
+			stats->num_loading++;
+		}
+	}
+}
+
+void texstream_log_report(void)
+{
+	texstream_stats_t stats;
+	texstream_get_stats(&stats);
+
+	log_message("Renderer", "Streamed textures: %u (%u loading), resident %zu KiB, "
+	            "requested %zu KiB, budget %zu KiB, %u loads, %u evictions",
+	            stats.num_textures, stats.num_loading, stats.resident_bytes / 1024,
+	            stats.requested_bytes / 1024, stats.budget / 1024, stats.loads, stats.evictions);
+
+	texstream_entry_t *entry;
+
+	arr_foreach(entries, entry) {
+
+		texture_t *texture = entry->texture;
+
+		log_message("Renderer", "  %s (%ux%u): resident level %u (%zu KiB), "
+		            "requested level %u (%zu KiB), last used %u frames ago%s",
+		            texture->resource.name, texture->width, texture->height,
+		            texture->first_level, texstream_get_size(entry, texture->first_level) / 1024,
+		            entry->requested_level,
+		            texstream_get_size(entry, entry->requested_level) / 1024,
+		            frame - entry->last_used,
+		            (texture_is_loading(texture) ? ", loading" : ""));
+	}
+}
+
+static size_t texstream_get_size(const texstream_entry_t *entry, uint32_t level)
+{
+	// Every texture is stored with 4 bytes per pixel on the GPU.
+	size_t width, height;
+	mipmap_get_level_size(entry->texture->width, entry->texture->height, level, &width, &height);
+
+	size_t size = width * height * 4;
+
+	if (entry->filter == TEX_FILTER_TRILINEAR || entry->filter == TEX_FILTER_ANISOTROPIC) {
+		size += mipmap_get_chain_size(width, height, 4, mipmap_get_num_levels(width, height));
+	}
+
+	return size;
+}
+
+static size_t texstream_get_resident_size(const texstream_entry_t *entry)
+{
+	// Textures being loaded are counted at the size they are loaded at, so the budget is not
+	// spent twice. The previous levels stay resident until the new ones have been uploaded.
+	uint32_t level = (texture_is_loading(entry->texture) ? entry->loading_level :
+	                                                       entry->texture->first_level);
+
+	return texstream_get_size(entry, level);
+}
+
+static uint8_t texstream_get_eviction_level(const texstream_entry_t *entry)
+{
+	// Textures which are still being used are only evicted down to their requested level.
+	return (entry->last_used == frame ? entry->requested_level : entry->base_level);
+}
+
+static int texstream_compare_loads(const void *a, const void *b)
+{
+	const texstream_entry_t *entry1 = *(const texstream_entry_t **)a;
+	const texstream_entry_t *entry2 = *(const texstream_entry_t **)b;
+
+	// Prefer the most recently used texture, and of those the one needing the largest level.
+	if (entry1->last_used > entry2->last_used) return -1;
+	if (entry1->last_used < entry2->last_used) return 1;
+	if (entry1->requested_level < entry2->requested_level) return -1;
+	if (entry1->requested_level > entry2->requested_level) return 1;
+
+	return 0;
+}
+
+static bool texstream_evict(const texstream_entry_t *loaded, size_t *resident)
+{
+	// Find the least recently used texture which has more levels resident than it needs.
+	texstream_entry_t *entry, *victim = NULL;
+
+	arr_foreach(entries, entry) {
+
+		if (entry == loaded ||
+			texture_is_loading(entry->texture) ||
+			texstream_get_eviction_level(entry) <= entry->texture->first_level) {
+			continue;
+		}
+
+		if (victim == NULL || entry->last_used < victim->last_used) {
+			victim = entry;
+		}
+	}
+
+	if (victim == NULL) {
+		return false;
+	}
+
+	// The smaller levels are uploaded from the copy of the base level, or reloaded from the
+	// source file if the texture is still used at a larger level.
+	size_t size = texstream_get_size(victim, victim->texture->first_level);
+	uint8_t level = texstream_get_eviction_level(victim);
+
+	if (!texstream_load(victim, level)) {
+		return false;
+	}
+
+	*resident = *resident - size + texstream_get_size(victim, level);
+	num_evictions++;
+
+	return true;
+}
+
+static bool texstream_load(texstream_entry_t *entry, uint8_t level)
+{
+	if (level == entry->base_level && entry->base_image != NULL) {
+
+		if (!texture_upload_levels_async(entry->texture, entry->base_image, entry->base_mip_chain,
+		                                 entry->base_num_levels, entry->filter, level)) {
+			return false;
+		}
+	}
+	else if (!texture_load_async(entry->texture, NULL, 0, entry->filter, level)) {
+		return false;
+	}
+
+	entry->loading_level = level;
+	return true;
+}
+
+static void texstream_destroy_entry(texstream_entry_t *entry)
+{
+	DESTROY(entry->base_image);
+	DESTROY(entry->base_mip_chain);
+	DESTROY(entry);
+}
@@ -0,0 +1,95 @@
+#pragma once
+#ifndef __TEXSTREAM_H
+#define __TEXSTREAM_H
+
+#include "core/defines.h"
+#include "renderer/texture.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Texture streaming
+
+	Keeps only the levels of the mip chain which are visible on screen resident on the GPU.
+	While the render lists are built, each streamed texture is requested at the mip level which
+	matches the size its meshes are projected to on screen. Once per frame the textures whose
+	requested level is larger than the resident one are reloaded from their source files in the
+	background, starting from the requested level.
+
+	The resident levels of all streamed textures must fit into a memory budget. When a texture
+	doesn't fit, the least recently used textures are evicted down to their smallest levels
+	(or to their requested levels, if they are still being used) to make room for it. Evictions
+	are uploads as well, so they count against the loads in progress.
+
+	Every streamed texture keeps at least its levels below TEXSTREAM_BASE_SIZE resident, so
+	something can always be drawn. A copy of these levels is kept in memory, so evicting a texture
+	to them doesn't decode the source file again.
+
+====================================================================================================
+*/
+
+#define TEXSTREAM_BASE_SIZE 64 // Largest size of the level which is always resident
+#define TEXSTREAM_MAX_LOADS 2 // Number of textures loaded or evicted at the same time
+#define TEXSTREAM_UNUSED_FRAMES 120 // Frames until an unrequested texture can be evicted
+
+// -------------------------------------------------------------------------------------------------
+
+// Streaming state of a single texture.
+typedef struct texstream_entry_t {
+
+	texture_t *texture;
+	TEX_FILTER filter; // Filter the texture is sampled with
+	uint8_t base_level; // Smallest resident level, the largest level below TEXSTREAM_BASE_SIZE
+	uint8_t requested_level; // Level requested by the meshes drawn during the last frame
+	uint8_t frame_level; // Level requested during the current frame
+	uint8_t loading_level; // Level being loaded, valid while the texture is loading
+	uint32_t last_used; // Frame on which the texture was last requested
+	void *base_image; // Copy of the base level, so evicting doesn't decode the source file again
+	void *base_mip_chain; // Copy of the levels below the base level, can be NULL
+	uint32_t base_num_levels; // Number of levels in the base image and its mip chain
+
+} texstream_entry_t;
+
+// Memory usage of the streamed textures for debugging.
+typedef struct texstream_stats_t {
+
+	uint32_t num_textures; // Number of streamed textures
+	uint32_t num_loading; // Number of textures being loaded
+	size_t budget; // Memory budget of the streamed textures
+	size_t resident_bytes; // Size of the levels resident on the GPU
+	size_t requested_bytes; // Size of the levels requested by the last frame
+	uint32_t loads; // Number of textures loaded at a larger size since initialization
+	uint32_t evictions; // Number of textures evicted to a smaller size since initialization
+
+} texstream_stats_t;
+
+// -------------------------------------------------------------------------------------------------
+
+void texstream_initialize(void);
+void texstream_shutdown(void);
+
+// Stream a texture from the contents of its source file. The smallest levels are loaded
+// immediately in the background, the rest when they are requested. Takes the ownership of the
+// file data if successful.
+bool texstream_add_texture(texture_t *texture, void *data, size_t data_length, TEX_FILTER filter);
+
+// Stop streaming a texture. The resident levels stay loaded.
+void texstream_remove_texture(texture_t *texture);
+
+// Request the level of a streamed texture which matches a mesh covering the given portion of the
+// screen height. Should be called from the main thread while building the render lists.
+void texstream_request(texture_t *texture, float screen_size);
+
+// Load and evict textures according to the levels requested during the frame.
+void texstream_process(void);
+
+void texstream_get_stats(texstream_stats_t *stats);
+
+// Write the resident and requested levels of every streamed texture into the log.
+void texstream_log_report(void);
+
+END_DECLARATIONS;
+
+#endif
@@ -2,7 +2,14 @@
 #include "core/memory.h"
 #include "core/string.h"
 #include "renderer/renderer.h"
+#include "renderer/mipmap.h"
+#include "renderer/texcompress.h"
+#include "renderer/texstream.h"
+#include "core/parallel.h"
+#include "core/mylly.h"
+#include "math/math.h"
 #include "resources/resource.h"
+#include "io/file.h"
 #include "io/log.h"
 #include <png.h>
 #include <jpeglib.h>
@@ -11,10 +18,54 @@
 
 // -------------------------------------------------------------------------------------------------
 
+#define TEXTURE_COOKED_MAGIC 0x58455443 // "CTEX"
+#define TEXTURE_COOKED_VERSION 1
+
+// -------------------------------------------------------------------------------------------------
+
+// Pixels and properties of a decoded image.
+typedef struct texture_image_t {
+
+	uint8_t *pixels; // Decoded rows, NULL if only the header was read
+	uint32_t width;
+	uint32_t height;
+	TEX_FORMAT format;
+
+} texture_image_t;
+
+// A texture which is being decoded on a worker thread or uploaded by the renderer.
+typedef struct texture_load_t {
+
+	texture_t *texture; // The texture being loaded, NULL if it was destroyed during loading
+	char *path; // Path of the texture for log messages
+	void *data; // Contents of the image file, released after decoding
+	size_t data_length;
+	TEX_FILTER filter;
+	uint32_t first_level; // Largest level of the source image to upload
+	uint32_t num_levels; // Number of levels to upload, starting from the first level
+	bool is_srgb; // The colour channels of the mip chain are averaged in linear space
+	texture_upload_t upload; // Decoded pixels and the result of the upload
+
+} texture_load_t;
+
+// -------------------------------------------------------------------------------------------------
+
+// Asynchronous loader helpers.
+static void texture_load_execute(void *context);
+static void texture_load_completed(void *context);
+static void texture_prepare_upload(texture_load_t *load, texture_image_t *image);
+static void texture_get_upload_sizes(const texture_upload_t *upload,
+                                     size_t *image_size, size_t *chain_size);
+static void *texture_copy_pixels(const void *pixels, size_t size);
+
 // PNG loader helpers.
+static bool texture_decode_png(const char *path, void *data, size_t data_length,
+                               bool header_only, texture_image_t *image);
 static void texture_read_png_data(png_structp ptr, png_bytep data, png_size_t length);
 
 // JPEG loader helpers.
+static bool texture_decode_jpeg(const char *path, void *data, size_t data_length,
+                                bool header_only, texture_image_t *image);
 static boolean texture_jpeg_loader_fill_input_buffer(j_decompress_ptr cinfo);
 static void texture_jpeg_loader_skip_input_data(j_decompress_ptr cinfo, long num_bytes);
 static void texture_jpeg_loader_no_op(j_decompress_ptr cinfo);
@@ -30,6 +81,28 @@ typedef struct {
 
 } png_file_t;
 
+// File header of a cooked texture. The header is followed by each level of the mip chain, starting
+// from the largest level.
+typedef struct texture_cooked_header_t {
+
+	uint32_t magic; // Always TEXTURE_COOKED_MAGIC
+	uint32_t version; // Version of the file format
+	uint64_t source_hash; // Hash of the source file the texture was cooked from
+	uint32_t format; // Block compressed format of the pixels (see TEX_FORMAT)
+	uint16_t width; // Size of the largest level in pixels
+	uint16_t height;
+	uint32_t num_levels; // Number of levels in the mip chain
+	uint32_t size; // Size of all the levels in bytes
+
+} texture_cooked_header_t;
+
+STATIC_ASSERT(sizeof(texture_cooked_header_t) == 32, texture_cooked_header_size);
+
+// -------------------------------------------------------------------------------------------------
+
+static texture_name_t placeholder_texture; // 1x1 white texture drawn while textures are loading
+static arr_t(texture_load_t*) pending_loads = arr_initializer; // Textures waiting for uploads
+
 // -------------------------------------------------------------------------------------------------
 
 texture_t *texture_create(const char *name, const char *path)
@@ -56,8 +129,17 @@ void texture_destroy(texture_t *texture)
 		return;
 	}
 
-	// Release GPU resources.
-	rend_delete_texture(texture->gpu_texture);
+	texstream_remove_texture(texture);
+
+	// Leave a texture which is still loading to be deleted once it has been loaded.
+	if (texture->load != NULL) {
+		texture->load->texture = NULL;
+	}
+
+	// Release GPU resources. The placeholder is shared by all loading textures.
+	if (texture->gpu_texture != placeholder_texture || placeholder_texture == 0) {
+		rend_delete_texture(texture->gpu_texture);
+	}
 
 	arr_clear(texture->sprites);
 
@@ -73,8 +155,363 @@ bool texture_load_png(texture_t *texture, void *data, size_t data_length, TEX_FI
 		return false;
 	}
 
+	texture_image_t image;
+
+	if (!texture_decode_png(texture->resource.path, data, data_length, false, &image)) {
+		return false;
+	}
+
+	return texture_load_bitmap(texture, image.pixels, image.width, image.height,
+	                           image.format, filter);
+}
+
+bool texture_load_jpeg(texture_t *texture, void *data, size_t data_length, TEX_FILTER filter)
+{
+	if (texture == NULL || data == NULL) {
+		return false;
+	}
+
+	texture_image_t image;
+
+	if (!texture_decode_jpeg(texture->resource.path, data, data_length, false, &image)) {
+		return false;
+	}
+
+	return texture_load_bitmap(texture, image.pixels, image.width, image.height,
+	                           image.format, filter);
+}
+
+bool texture_read_info(texture_t *texture, void *data, size_t data_length)
+{
+	if (texture == NULL || data == NULL) {
+		return false;
+	}
+
+	texture_image_t image;
+
+	if (!texture_decode_png(texture->resource.path, data, data_length, true, &image) &&
+		!texture_decode_jpeg(texture->resource.path, data, data_length, true, &image)) {
+		return false;
+	}
+
+	texture->width = (uint16_t)image.width;
+	texture->height = (uint16_t)image.height;
+	texture->format = image.format;
+
+	return true;
+}
+
+bool texture_load_async(texture_t *texture, void *data, size_t data_length, TEX_FILTER filter,
+                        uint32_t first_level)
+{
+	if (texture == NULL || texture->load != NULL) {
+		return false;
+	}
+
+	if (data != NULL) {
+
+		// Read the size and format of the image right away, so the texture can be used (e.g. for
+		// creating sprites) before its pixels have been decoded.
+		if (!texture_read_info(texture, data, data_length)) {
+			return false;
+		}
+
+		// Remove old texture data. The pixels are not kept in memory after they have been
+		// uploaded.
+		DESTROY(texture->data);
+
+		// Draw the placeholder until the upload has completed.
+		if (placeholder_texture == 0) {
+
+			uint8_t *pixel = mem_alloc_fast(4);
+			memset(pixel, 0xFF, 4);
+
+			placeholder_texture = rend_generate_texture(pixel, 1, 1, TEX_FORMAT_RGBA,
+			                                            TEX_FILTER_POINT);
+			mem_free(pixel);
+		}
+
+		if (texture->gpu_texture != placeholder_texture) {
+			rend_delete_texture(texture->gpu_texture);
+		}
+
+		texture->gpu_texture = placeholder_texture;
+	}
+
+	// Reloading requires the source file and a texture which has been loaded before. The current
+	// texture is drawn until the reloaded one has been uploaded.
+	else if (texture->resource.path == NULL || texture->width == 0 || texture->height == 0) {
+		return false;
+	}
+
+	NEW(texture_load_t, load);
+
+	load->texture = texture;
+	load->path = string_duplicate(texture->resource.path != NULL ?
+	                              texture->resource.path : texture->resource.name);
+	load->data = data;
+	load->data_length = data_length;
+	load->filter = filter;
+	load->is_srgb = !texture->is_linear;
+	load->first_level = MIN(first_level, mipmap_get_num_levels(texture->width,
+	                                                           texture->height) - 1);
+
+	// Limit the mip chain the same way the renderer does, so levels which would not be used are
+	// not generated. Only filters which sample a mip chain need one.
+	if (filter == TEX_FILTER_TRILINEAR || filter == TEX_FILTER_ANISOTROPIC) {
+
+		uint8_t max_levels = mylly_get_parameters()->renderer.max_texture_mip_levels;
+
+		size_t width, height;
+		mipmap_get_level_size(texture->width, texture->height, load->first_level,
+		                      &width, &height);
+
+		load->num_levels = mipmap_get_num_levels(width, height);
+		load->num_levels = (max_levels != 0 ? MIN(load->num_levels, max_levels) :
+		                                      load->num_levels);
+	}
+	else {
+		load->num_levels = 1;
+	}
+
+	texture->load = load;
+
+	parallel_submit_job(texture_load_execute, texture_load_completed, load);
+
+	return true;
+}
+
+bool texture_upload_levels_async(texture_t *texture, const void *image, const void *mip_chain,
+                                 uint32_t num_levels, TEX_FILTER filter, uint32_t first_level)
+{
+	if (texture == NULL || image == NULL || texture->load != NULL) {
+		return false;
+	}
+
+	NEW(texture_load_t, load);
+
+	load->texture = texture;
+	load->path = string_duplicate(texture->resource.path != NULL ?
+	                              texture->resource.path : texture->resource.name);
+	load->filter = filter;
+	load->first_level = first_level;
+	load->num_levels = num_levels;
+
+	mipmap_get_level_size(texture->width, texture->height, first_level,
+	                      &load->upload.width, &load->upload.height);
+
+	load->upload.format = texture->format;
+	load->upload.filter = filter;
+	load->upload.num_levels = (mip_chain != NULL ? num_levels : 1);
+
+	// The renderer releases the pixels it uploads, so the caller's pixels are copied.
+	size_t image_size, chain_size;
+	texture_get_upload_sizes(&load->upload, &image_size, &chain_size);
+
+	load->upload.image = texture_copy_pixels(image, image_size);
+
+	if (mip_chain != NULL) {
+		load->upload.mip_chain = texture_copy_pixels(mip_chain, chain_size);
+	}
+
+	texture->load = load;
+
+	rend_upload_texture(&load->upload);
+	arr_push(pending_loads, load);
+
+	return true;
+}
+
+bool texture_is_loading(texture_t *texture)
+{
+	return (texture != NULL && texture->load != NULL);
+}
+
+void texture_process_uploads(void)
+{
+	for (size_t i = 0; i < pending_loads.count;) {
+
+		texture_load_t *load = pending_loads.items[i];
+
+		if (!rend_is_texture_upload_complete(&load->upload)) {
+			i++;
+			continue;
+		}
+
+		// Replace the placeholder or the previous levels with the uploaded texture. If the
+		// texture was destroyed while it was being uploaded, the GPU texture is no longer needed.
+		if (load->texture != NULL) {
+
+			if (load->texture->gpu_texture != placeholder_texture) {
+				rend_delete_texture(load->texture->gpu_texture);
+			}
+
+			load->texture->gpu_texture = load->upload.texture;
+			load->texture->first_level = (uint8_t)load->first_level;
+			load->texture->load = NULL;
+		}
+		else {
+			rend_delete_texture(load->upload.texture);
+		}
+
+		DESTROY(load->path);
+		DESTROY(load);
+
+		arr_remove_at(pending_loads, i);
+	}
+}
+
+static void texture_load_execute(void *context)
+{
+	texture_load_t *load = context;
+	texture_image_t image;
+
+	// Reloaded textures are read from their source file.
+	if (load->data == NULL &&
+		!file_read_all_data(load->path, &load->data, &load->data_length)) {
+		return;
+	}
+
+	// Decode the image and generate its mip chain on the worker thread.
+	if (texture_decode_png(load->path, load->data, load->data_length, false, &image) ||
+		texture_decode_jpeg(load->path, load->data, load->data_length, false, &image)) {
+
+		texture_prepare_upload(load, &image);
+	}
+
+	mem_free(load->data);
+	load->data = NULL;
+}
+
+static void texture_prepare_upload(texture_load_t *load, texture_image_t *image)
+{
+	size_t channels = (image->format == TEX_FORMAT_RGB ? 3 : 4);
+	uint32_t first_level = MIN(load->first_level,
+	                           mipmap_get_num_levels(image->width, image->height) - 1);
+
+	// Generate the levels down to the first uploaded level, and the mip chain below it.
+	uint8_t *chain = mipmap_generate(image->pixels, image->width, image->height, channels,
+	                                 load->is_srgb, first_level + load->num_levels);
+
+	size_t width, height;
+	mipmap_get_level_size(image->width, image->height, first_level, &width, &height);
+
+	load->upload.width = width;
+	load->upload.height = height;
+	load->upload.format = image->format;
+	load->upload.filter = load->filter;
+
+	if (first_level == 0) {
+
+		load->upload.image = image->pixels;
+		load->upload.mip_chain = chain;
+		load->upload.num_levels = (chain != NULL ? load->num_levels : 1);
+		return;
+	}
+
+	// Copy the first uploaded level and the levels after it out of the generated chain. Levels
+	// larger than the first level are discarded.
+	uint8_t *level = chain + mipmap_get_chain_size(image->width, image->height, channels,
+	                                               first_level);
+
+	size_t level_size = width * height * channels;
+	size_t rest_size = mipmap_get_chain_size(width, height, channels, load->num_levels);
+
+	load->upload.image = mem_alloc_fast(level_size);
+	memcpy(load->upload.image, level, level_size);
+
+	if (rest_size != 0) {
+
+		load->upload.mip_chain = mem_alloc_fast(rest_size);
+		memcpy(load->upload.mip_chain, level + level_size, rest_size);
+	}
+
+	load->upload.num_levels = (rest_size != 0 ? load->num_levels : 1);
+	load->first_level = first_level;
+
+	mem_free(image->pixels);
+	mem_free(chain);
+}
+
+static void texture_load_completed(void *context)
+{
+	texture_load_t *load = context;
+
+	// The image could not be decoded or the texture was destroyed while it was being decoded.
+	if (load->upload.image == NULL || load->texture == NULL) {
+
+		if (load->upload.image == NULL) {
+			log_warning("Resources", "Could not decode texture %s.", load->path);
+		}
+		else {
+
+			mem_free(load->upload.image);
+
+			if (load->upload.mip_chain != NULL) {
+				mem_free(load->upload.mip_chain);
+			}
+		}
+
+		if (load->texture != NULL) {
+			load->texture->load = NULL;
+		}
+
+		DESTROY(load->path);
+		DESTROY(load);
+		return;
+	}
+
+	// Keep a copy of the smallest levels of a streamed texture, so the texture can be evicted back
+	// to them without decoding its source file again.
+	texstream_entry_t *stream = load->texture->stream;
+
+	if (stream != NULL && stream->base_image == NULL && load->first_level == stream->base_level) {
+
+		size_t image_size, chain_size;
+		texture_get_upload_sizes(&load->upload, &image_size, &chain_size);
+
+		stream->base_image = texture_copy_pixels(load->upload.image, image_size);
+		stream->base_num_levels = load->upload.num_levels;
+
+		if (load->upload.mip_chain != NULL) {
+			stream->base_mip_chain = texture_copy_pixels(load->upload.mip_chain, chain_size);
+		}
+	}
+
+	// Queue the pixels for uploading. The renderer releases them once they have been copied.
+	rend_upload_texture(&load->upload);
+	arr_push(pending_loads, load);
+}
+
+static void texture_get_upload_sizes(const texture_upload_t *upload,
+                                     size_t *image_size, size_t *chain_size)
+{
+	// Decoded images are uploaded with 3 channels for RGB and 4 channels for everything else.
+	size_t channels = (upload->format == TEX_FORMAT_RGB ? 3 : 4);
+
+	*image_size = upload->width * upload->height * channels;
+	*chain_size = mipmap_get_chain_size(upload->width, upload->height, channels,
+	                                    upload->num_levels);
+}
+
+static void *texture_copy_pixels(const void *pixels, size_t size)
+{
+	void *copy = mem_alloc_fast(size);
+	memcpy(copy, pixels, size);
+
+	return copy;
+}
+
+static bool texture_decode_png(const char *path, void *data, size_t data_length,
+                               bool header_only, texture_image_t *image)
+{
 	// Read the PNG file header.
 	png_byte header[8];
+
+	if (data_length < sizeof(header)) {
+		return false;
+	}
+
 	memcpy(header, data, sizeof(header));
 
 	// Make sure the file is a PNG.
@@ -103,16 +540,26 @@ bool texture_load_png(texture_t *texture, void *data, size_t data_length, TEX_FI
 		png_destroy_read_struct(&png, (png_infopp)info, (png_infopp)NULL);
 		return false;
 	}
+
+	// The pixels are allocated after the jump point is set, so they are freed on errors.
+	png_byte *volatile tex_data = NULL;
+	png_bytep *volatile row_pointers = NULL;
+
 	// Set jump point for handling future errors.
     if (setjmp(png_jmpbuf(png))) {
 
+		if (tex_data != NULL) {
+			mem_free(tex_data);
+		}
+
+		if (row_pointers != NULL) {
+			mem_free(row_pointers);
+		}
+
 		png_destroy_read_struct(&png, &info, &end);
 		return false;
 	}
 
-	// Remove old texture data.
-	DESTROY(texture->data);
-
 	// Create a temporary read struct for reading the PNG from an in-memory block instead of a file.
 	png_file_t file = {
 		.buffer = data,
@@ -150,23 +597,29 @@ bool texture_load_png(texture_t *texture, void *data, size_t data_length, TEX_FI
 
 	bool has_alpha = (colour_type == PNG_COLOR_TYPE_RGB_ALPHA);
 
-	texture->width = (uint16_t)width;
-	texture->height = (uint16_t)height;
+	image->width = width;
+	image->height = height;
+	image->format = (has_alpha ? TEX_FORMAT_RGBA : TEX_FORMAT_RGB);
+	image->pixels = NULL;
+
+	if (header_only) {
+
+		png_destroy_read_struct(&png, &info, &end);
+		return true;
+	}
 	
 	// Update the PNG info.
 	png_read_update_info(png, info);
 
-	// Get texture row size (in bytes).
+	// Get texture row size (in bytes). Rows are stored without padding, the same way as the
+	// other loaders store them, and uploaded with an unpack alignment of 1.
 	int row_bytes = png_get_rowbytes(png, info);
 
-	// Adjust the row size to OpenGL format (4 byte alignment).
-	row_bytes += 3 - ((row_bytes - 1) % 4);
-
 	// Allocate memory for the texture data and texture row pointers.
-	png_byte *tex_data = mem_alloc_fast(row_bytes * height * sizeof(png_byte) + 15);
-	png_bytep *row_pointers = mem_alloc_fast(height * sizeof(png_bytep));
+	tex_data = mem_alloc_fast(row_bytes * height * sizeof(png_byte) + 15);
+	row_pointers = mem_alloc_fast(height * sizeof(png_bytep));
 
-    // Store pointers to each texture row (this is because of the 4-byte alignment).
+    // Store pointers to each texture row (the rows are stored bottom-up).
     for (uint32_t i = 0; i < height; i++) {
 		row_pointers[height - 1 - i] = tex_data + i * row_bytes;
 	}
@@ -175,16 +628,13 @@ bool texture_load_png(texture_t *texture, void *data, size_t data_length, TEX_FI
 	png_read_image(png, row_pointers);
 	png_read_end(png, NULL);
 
-	texture->data = tex_data;
+	image->pixels = tex_data;
 
 	// Do cleanup.
 	png_destroy_read_struct(&png, &info, &end);
 	mem_free(row_pointers);
 
-	// Load the texture onto the GPU.
-	texture->gpu_texture = rend_generate_texture(texture->data, texture->width, texture->height,
-                                            has_alpha ? TEX_FORMAT_RGBA : TEX_FORMAT_RGB, filter);
-
+	UNUSED(path);
 	return true;
 }
 
@@ -192,13 +642,26 @@ static void texture_read_png_data(png_structp ptr, png_bytep data, png_size_t le
 {
 	png_file_t *file = (png_file_t *)png_get_io_ptr(ptr);
 
+	// Raise a libpng error instead of reading past the end of a truncated file.
+	if (file->offset + length > file->length) {
+		png_error(ptr, "Unexpected end of PNG data");
+	}
+
 	memcpy(data, (const void *)((const char *)file->buffer + file->offset), length);
 
 	file->offset += length;
 }
 
-bool texture_load_jpeg(texture_t *texture, void *data, size_t data_length, TEX_FILTER filter)
+static bool texture_decode_jpeg(const char *path, void *data, size_t data_length,
+                                bool header_only, texture_image_t *image)
 {
+	// Make sure the file is a JPEG before handing it to the decompressor, which exits on errors.
+	const uint8_t *bytes = data;
+
+	if (data_length < 2 || bytes[0] != 0xFF || bytes[1] != 0xD8) {
+		return false;
+	}
+
 	// Create a jpeg decompressor struct with the default error handler.
 	// TODO: The default handler uses exit() on certain issues, so this may have to be replaced
 	// with a custom error handler in the future.
@@ -227,24 +690,55 @@ bool texture_load_jpeg(texture_t *texture, void *data, size_t data_length, TEX_F
 	// Read the jpeg header to ensure the data in the memory is from a valid jpeg file.
 	if (jpeg_read_header(&cinfo, true) != 1) {
 		
-		log_warning("Resources", "File %s is not a normal JPEG.", texture->resource.path);
+		log_warning("Resources", "File %s is not a normal JPEG.", path);
+
+		jpeg_destroy_decompress(&cinfo);
 		return false;
 	}
 
+	// Figure out texture format from the pixel size of the bitmap.
+	int bytes_per_pixel = cinfo.num_components;
+
+	switch (bytes_per_pixel) {
+		case 3:
+			image->format = TEX_FORMAT_RGB;
+			break;
+
+		case 4:
+			image->format = TEX_FORMAT_RGBA;
+			break;
+
+		default:
+			log_warning("Resources", "Unsupported pixel size %d in JPEG file %s.",
+			             bytes_per_pixel, path);
+
+			jpeg_destroy_decompress(&cinfo);
+			return false;
+	}
+
+	image->width = cinfo.image_width;
+	image->height = cinfo.image_height;
+	image->pixels = NULL;
+
+	if (header_only) {
+
+		jpeg_destroy_decompress(&cinfo);
+		return true;
+	}
+
 	// Decompress the jpeg data and allocate buffers for the decompressed bitmap.
 	jpeg_start_decompress(&cinfo);
 
-	texture->width = cinfo.output_width;
-	texture->height = cinfo.output_height;
+	image->width = cinfo.output_width;
+	image->height = cinfo.output_height;
 
-	int bytes_per_pixel = cinfo.output_components;
-	size_t texture_size = texture->width * texture->height * bytes_per_pixel;
+	size_t texture_size = image->width * image->height * bytes_per_pixel;
 
-	texture->data = mem_alloc(texture_size);
+	image->pixels = mem_alloc(texture_size);
 
 	// Read the scanlines of the jpeg into the bitmap.
-	uint8_t *bitmap_buffer = texture->data;
-	int row_stride = texture->width * bytes_per_pixel;
+	uint8_t *bitmap_buffer = image->pixels;
+	int row_stride = image->width * bytes_per_pixel;
 
 	while (cinfo.output_scanline < cinfo.output_height) {
 
@@ -258,28 +752,6 @@ bool texture_load_jpeg(texture_t *texture, void *data, size_t data_length, TEX_F
 	jpeg_finish_decompress(&cinfo);
 	jpeg_destroy_decompress(&cinfo);
 
-	// Figure out texture format from the pixel size of the bitmap.
-	TEX_FORMAT format;
-
-	switch (bytes_per_pixel) {
-		case 3:
-			format = TEX_FORMAT_RGB;
-			break;
-
-		case 4:
-			format = TEX_FORMAT_RGBA;
-			break;
-
-		default:
-			log_warning("Resources", "Unsupported pixel size %d in JPEG file %s.",
-			             bytes_per_pixel, texture->resource.path);
-			return false;
-	}
-
-	// Load the texture onto the GPU.
-	texture->gpu_texture = rend_generate_texture(texture->data, texture->width, texture->height,
-                                                 format, filter);
-
 	return true;
 }
 
@@ -317,6 +789,7 @@ bool texture_load_bitmap(texture_t *texture, uint8_t *data, uint16_t width, uint
 
 	texture->width = width;
 	texture->height = height;
+	texture->format = format;
 	texture->data = data;
 
 	// Generate a GPU object for this texture.
@@ -325,3 +798,172 @@ bool texture_load_bitmap(texture_t *texture, uint8_t *data, uint16_t width, uint
 
 	return true;
 }
+
+bool texture_load_cooked(texture_t *texture, const char *path, uint64_t source_hash,
+                         TEX_FILTER filter)
+{
+	if (texture == NULL || path == NULL || !file_exists(path)) {
+		return false;
+	}
+
+	void *buffer;
+	size_t length;
+
+	if (!file_read_all_data(path, &buffer, &length)) {
+		return false;
+	}
+
+	// Validate the header and the size of the levels before accepting the file.
+	const texture_cooked_header_t *header = (const texture_cooked_header_t *)buffer;
+	size_t size = 0;
+
+	if (length >= sizeof(texture_cooked_header_t) &&
+		header->magic == TEXTURE_COOKED_MAGIC &&
+		header->version == TEXTURE_COOKED_VERSION &&
+		texcomp_is_compressed((TEX_FORMAT)header->format) &&
+		header->num_levels >= 1 &&
+		header->num_levels <= mipmap_get_num_levels(header->width, header->height)) {
+
+		for (uint32_t level = 0; level < header->num_levels; level++) {
+
+			size_t level_width, level_height;
+			mipmap_get_level_size(header->width, header->height, level,
+			                      &level_width, &level_height);
+
+			size += texcomp_get_size((TEX_FORMAT)header->format, level_width, level_height);
+		}
+	}
+
+	if (size == 0 ||
+		header->size != size ||
+		sizeof(texture_cooked_header_t) + size > length) {
+
+		log_warning("Resources", "%s is not a valid cooked texture.", path);
+
+		mem_free(buffer);
+		return false;
+	}
+
+	// The source has changed since the texture was cooked.
+	if (header->source_hash != source_hash) {
+
+		mem_free(buffer);
+		return false;
+	}
+
+	// Remove old texture data.
+	DESTROY(texture->data);
+
+	texture->width = header->width;
+	texture->height = header->height;
+	texture->format = (TEX_FORMAT)header->format;
+	texture->data = mem_alloc_fast(size);
+
+	memcpy(texture->data, (uint8_t *)buffer + sizeof(texture_cooked_header_t), size);
+
+	uint32_t num_levels = header->num_levels;
+	mem_free(buffer);
+
+	// Load the texture onto the GPU.
+	texture->gpu_texture = rend_generate_compressed_texture(texture->data, texture->width,
+	                                                        texture->height, num_levels,
+	                                                        texture->format, filter);
+
+	return true;
+}
+
+bool texture_cook(texture_t *texture, const char *path, uint64_t source_hash, TEX_FILTER filter)
+{
+	if (texture == NULL || path == NULL || texture->data == NULL) {
+		return false;
+	}
+
+	// Select a compressed format which has the channels of the texture.
+	TEX_FORMAT format;
+	size_t channels;
+
+	switch (texture->format) {
+
+		case TEX_FORMAT_RGB:
+			format = TEX_FORMAT_BC1;
+			channels = 3;
+			break;
+
+		case TEX_FORMAT_RGBA:
+			format = TEX_FORMAT_BC3;
+			channels = 4;
+			break;
+
+		case TEX_FORMAT_GRAYSCALE:
+			format = TEX_FORMAT_BC4;
+			channels = 1;
+			break;
+
+		default:
+			return false;
+	}
+
+	// Generate the mip chain if the texture is sampled from one.
+	uint32_t num_levels = 1;
+
+	if (filter == TEX_FILTER_TRILINEAR || filter == TEX_FILTER_ANISOTROPIC) {
+		num_levels = mipmap_get_num_levels(texture->width, texture->height);
+	}
+
+	bool is_srgb = (texture->format != TEX_FORMAT_GRAYSCALE && !texture->is_linear);
+	uint8_t *chain = mipmap_generate(texture->data, texture->width, texture->height, channels,
+	                                 is_srgb, num_levels);
+
+	size_t size = 0;
+
+	for (uint32_t level = 0; level < num_levels; level++) {
+
+		size_t level_width, level_height;
+		mipmap_get_level_size(texture->width, texture->height, level, &level_width, &level_height);
+
+		size += texcomp_get_size(format, level_width, level_height);
+	}
+
+	texture_cooked_header_t header = { 0 };
+
+	header.magic = TEXTURE_COOKED_MAGIC;
+	header.version = TEXTURE_COOKED_VERSION;
+	header.source_hash = source_hash;
+	header.format = (uint32_t)format;
+	header.width = texture->width;
+	header.height = texture->height;
+	header.num_levels = num_levels;
+	header.size = (uint32_t)size;
+
+	uint8_t *data = mem_alloc_fast(sizeof(header) + size);
+	memcpy(data, &header, sizeof(header));
+
+	// Encode each level of the chain.
+	const uint8_t *level_pixels = texture->data;
+	uint8_t *level_blocks = data + sizeof(header);
+
+	for (uint32_t level = 0; level < num_levels; level++) {
+
+		size_t level_width, level_height;
+		mipmap_get_level_size(texture->width, texture->height, level, &level_width, &level_height);
+
+		texcomp_encode(level_pixels, level_width, level_height, channels, format, level_blocks);
+
+		level_pixels = (level == 0 ? chain : level_pixels + level_width * level_height * channels);
+		level_blocks += texcomp_get_size(format, level_width, level_height);
+	}
+
+	bool success = file_write_all_data(path, data, sizeof(header) + size);
+
+	if (!success) {
+		log_warning("Resources", "Could not write cooked texture %s.", path);
+	}
+
+	mem_free(data);
+
+	if (chain != NULL) {
+		mem_free(chain);
+	}
+
+	return success;
+}
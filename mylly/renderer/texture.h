@@ -18,6 +18,10 @@ typedef enum {
 	TEX_FORMAT_RGB,
 	TEX_FORMAT_RGBA,
 	TEX_FORMAT_GRAYSCALE,
+	TEX_FORMAT_BC1, // Block compressed RGB (see texcompress.h)
+	TEX_FORMAT_BC3, // Block compressed RGBA
+	TEX_FORMAT_BC4, // Block compressed single channel
+	TEX_FORMAT_BC5, // Block compressed two channels
 	
 } TEX_FORMAT;
 
@@ -28,6 +32,8 @@ typedef enum {
 
 	TEX_FILTER_POINT,
 	TEX_FILTER_BILINEAR,
+	TEX_FILTER_TRILINEAR, // Bilinear filtering between the two nearest levels of a mip chain
+	TEX_FILTER_ANISOTROPIC, // Trilinear filtering with anisotropic sampling for oblique surfaces
 	
 } TEX_FILTER;
 
@@ -39,7 +45,12 @@ typedef struct texture_t {
 	uint16_t width; // Texture width in pixels
 	uint16_t height; // Texture height in pixels
 	texture_name_t gpu_texture; // GPU texture name
-	void *data; // Texture pixels
+	TEX_FORMAT format; // Format of the pixels
+	bool is_linear; // The pixels store linear data (i.e. normals) instead of sRGB colours
+	void *data; // Texture pixels, every level of the mip chain for compressed textures
+	struct texture_load_t *load; // Asynchronous load in progress, NULL when the texture is loaded
+	struct texstream_entry_t *stream; // Streaming state, NULL if the texture is not streamed
+	uint8_t first_level; // Largest level of the mip chain resident on the GPU
 
 	arr_t(sprite_t*) sprites; // List of sprites onthis texture
 
@@ -58,6 +69,42 @@ bool texture_load_jpeg(texture_t *texture, void *data, size_t data_length, TEX_F
 bool texture_load_bitmap(texture_t *texture, uint8_t *data, uint16_t width, uint16_t height,
                          TEX_FORMAT format, TEX_FILTER filter);
 
+// Read the size and format of a PNG or JPEG file into the texture without decoding its pixels.
+bool texture_read_info(texture_t *texture, void *data, size_t data_length);
+
+// Decode a PNG or JPEG file on a worker thread and upload it in the background. The size and
+// format of the texture are available immediately, but a placeholder texture is drawn until the
+// upload has completed. Takes the ownership of the file data if successful. The decoded pixels
+// are not kept in the texture's data.
+// Levels of the mip chain larger than the first level are not uploaded. When the data is NULL,
+// a previously loaded texture is reloaded from its source file and the current levels are drawn
+// until the reloaded levels have been uploaded.
+bool texture_load_async(texture_t *texture, void *data, size_t data_length, TEX_FILTER filter,
+                        uint32_t first_level);
+
+// Upload levels of the mip chain which have already been decoded, e.g. the smallest levels kept
+// in memory by the texture streaming. The pixels are copied, and the current levels are drawn
+// until the upload has completed.
+bool texture_upload_levels_async(texture_t *texture, const void *image, const void *mip_chain,
+                                 uint32_t num_levels, TEX_FILTER filter, uint32_t first_level);
+
+// Returns true while the texture is being loaded asynchronously.
+bool texture_is_loading(texture_t *texture);
+
+// Replace the placeholders of textures whose uploads have completed. Called once per frame from
+// the main thread.
+void texture_process_uploads(void);
+
+// Load a block compressed texture from a file written by texture_cook(). Fails if the file
+// doesn't exist, is not valid or was cooked from another version of the source file, identified
+// by the hash of its contents (see texcomp_hash()).
+bool texture_load_cooked(texture_t *texture, const char *path, uint64_t source_hash,
+                         TEX_FILTER filter);
+
+// Encode the pixels of a loaded texture into a block compressed format and save them with the
+// hash of the source file. When the filter samples a mip chain, the chain is saved as well.
+bool texture_cook(texture_t *texture, const char *path, uint64_t source_hash, TEX_FILTER filter);
+
 END_DECLARATIONS;
 
 #endif
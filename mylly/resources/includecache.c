@@ -0,0 +1,454 @@
+#include "includecache.h"
+#include "core/memory.h"
+#include "core/string.h"
+#include "io/file.h"
+#include "io/log.h"
+#include "math/math.h"
+#include <stdio.h>
+#include <string.h>
+
+// -------------------------------------------------------------------------------------------------
+
+static inccache_file_t *inccache_get_file(const char *path);
+static void inccache_read_file(inccache_file_t *file);
+static void inccache_clear_file(inccache_file_t *file);
+static bool inccache_has_include_guard(const char *text);
+static const char *inccache_get_line_end(const char *line);
+static const char *inccache_skip_white_space(const char *text);
+static char *inccache_copy_text(const char *prefix, const char *start, const char *end);
+static void inccache_collect(inccache_shader_t *shader, inccache_file_t *file);
+static bool inccache_depends_on(const inccache_shader_t *shader, const inccache_file_t *file);
+static uint64_t inccache_get_modified_time(const char *path);
+
+// -------------------------------------------------------------------------------------------------
+
+static arr_t(inccache_file_t*) files; // Cached include files
+static arr_t(inccache_shader_t*) shaders; // Dependencies of each loaded shader
+static arr_t(const char*) expansion; // Text parts of the include being expanded, in order
+
+// -------------------------------------------------------------------------------------------------
+
+void inccache_initialize(void)
+{
+	arr_init(files);
+	arr_init(shaders);
+	arr_init(expansion);
+}
+
+void inccache_shutdown(void)
+{
+	inccache_file_t *file;
+
+	arr_foreach(files, file) {
+
+		inccache_clear_file(file);
+
+		DESTROY(file->path);
+		DESTROY(file);
+	}
+
+	inccache_shader_t *shader;
+
+	arr_foreach(shaders, shader) {
+
+		arr_clear(shader->includes);
+
+		DESTROY(shader->path);
+		DESTROY(shader);
+	}
+
+	arr_clear(files);
+	arr_clear(shaders);
+	arr_clear(expansion);
+}
+
+inccache_shader_t *inccache_begin_shader(const char *path)
+{
+	if (path == NULL) {
+		return NULL;
+	}
+
+	inccache_shader_t *shader = NULL, *existing;
+
+	arr_foreach(shaders, existing) {
+
+		if (string_equals(existing->path, path)) {
+
+			shader = existing;
+			break;
+		}
+	}
+
+	if (shader == NULL) {
+
+		shader = mem_alloc(sizeof(*shader));
+		shader->path = string_duplicate(path);
+
+		arr_init(shader->includes);
+		arr_push(shaders, shader);
+	}
+
+	shader->includes.count = 0;
+	shader->modified_time = inccache_get_modified_time(path);
+	shader->is_dirty = false;
+
+	return shader;
+}
+
+char *inccache_expand(inccache_shader_t *shader, const char *path)
+{
+	if (shader == NULL || path == NULL) {
+		return NULL;
+	}
+
+	inccache_file_t *file = inccache_get_file(path);
+
+	if (!file->is_valid) {
+
+		// Record the missing file anyway, so the shader is marked dirty once the file exists.
+		if (!inccache_depends_on(shader, file)) {
+			arr_push(shader->includes, file);
+		}
+
+		return NULL;
+	}
+
+	// Collect the text parts of the file and its includes in order, and join them.
+	expansion.count = 0;
+	inccache_collect(shader, file);
+
+	size_t length = 0;
+	const char *text;
+
+	arr_foreach(expansion, text) {
+		length += strlen(text);
+	}
+
+	char *source = mem_alloc_fast(length + 1);
+	char *dst = source;
+
+	arr_foreach(expansion, text) {
+
+		size_t text_length = strlen(text);
+
+		memcpy(dst, text, text_length);
+		dst += text_length;
+	}
+
+	*dst = 0;
+
+	return source;
+}
+
+uint32_t inccache_check_changes(void)
+{
+	// Read modified include files again and mark the shaders which include them dirty. New files
+	// may be added to the cache while the list is processed, but those are always up to date.
+	for (size_t i = 0; i < files.count; i++) {
+
+		inccache_file_t *file = files.items[i];
+
+		if (inccache_get_modified_time(file->path) == file->modified_time) {
+			continue;
+		}
+
+		inccache_read_file(file);
+
+		inccache_shader_t *shader;
+
+		arr_foreach(shaders, shader) {
+
+			if (inccache_depends_on(shader, file)) {
+				shader->is_dirty = true;
+			}
+		}
+	}
+
+	// Mark the shaders whose own source has been modified dirty as well.
+	uint32_t num_dirty = 0;
+	inccache_shader_t *shader;
+
+	arr_foreach(shaders, shader) {
+
+		if (inccache_get_modified_time(shader->path) != shader->modified_time) {
+			shader->is_dirty = true;
+		}
+
+		if (shader->is_dirty) {
+			num_dirty++;
+		}
+	}
+
+	return num_dirty;
+}
+
+bool inccache_is_shader_dirty(const char *path)
+{
+	inccache_shader_t *shader;
+
+	arr_foreach(shaders, shader) {
+
+		if (string_equals(shader->path, path)) {
+			return shader->is_dirty;
+		}
+	}
+
+	return false;
+}
+
+static inccache_file_t *inccache_get_file(const char *path)
+{
+	inccache_file_t *file;
+
+	arr_foreach(files, file) {
+
+		if (string_equals(file->path, path)) {
+			return file;
+		}
+	}
+
+	// The file is added to the cache before it is read, so circular includes find it.
+	file = mem_alloc(sizeof(*file));
+	file->path = string_duplicate(path);
+
+	arr_init(file->parts);
+	arr_push(files, file);
+
+	inccache_read_file(file);
+
+	return file;
+}
+
+static void inccache_read_file(inccache_file_t *file)
+{
+	inccache_clear_file(file);
+
+	file->modified_time = inccache_get_modified_time(file->path);
+
+	char *text;
+	size_t length;
+
+	if (!file_read_all_text(file->path, &text, &length)) {
+		return;
+	}
+
+	file->is_valid = true;
+	file->is_guarded = inccache_has_include_guard(text);
+
+	// Split the file at its include directives. The text after an include starts with a line
+	// directive to keep error line numbers matching the included file.
+	const char *part_start = text;
+	char line_directive[32] = "";
+	uint32_t line_number = 1;
+
+	for (char *line = text; *line != 0; line_number++) {
+
+		char *line_end = (char *)inccache_get_line_end(line);
+		const char *directive = inccache_skip_white_space(line);
+
+		if (string_starts_with(directive, "#pragma include ", 16)) {
+
+			char name[260], file_name[260];
+			size_t name_length = (size_t)(line_end - directive) - 16;
+
+			string_copy(name, directive + 16, MIN(sizeof(name), name_length + 1));
+
+			char *include = name;
+			string_strip(&include);
+			string_strip_end(&include);
+
+			snprintf(file_name, sizeof(file_name), "./shaders/%s", include);
+
+			inccache_part_t part;
+			part.text = inccache_copy_text(line_directive, part_start, line);
+			part.include = inccache_get_file(file_name);
+
+			if (!part.include->is_valid) {
+				log_warning("Resources", "Could not include a shader named '%s' in %s.",
+				            include, file->path);
+			}
+
+			arr_push(file->parts, part);
+
+			// The included file may not end in a line break.
+			snprintf(line_directive, sizeof(line_directive), "\n#line %u\n", line_number + 1);
+			part_start = line_end;
+		}
+		else if (string_starts_with(directive, "#pragma once", 12)) {
+
+			// The directive is not understood by the shader compiler. Blank it out instead of
+			// removing the line, so the line numbers don't change.
+			for (char *c = line; c < line_end && *c != '\n' && *c != '\r'; c++) {
+				*c = ' ';
+			}
+		}
+
+		line = line_end;
+	}
+
+	inccache_part_t last = {
+		inccache_copy_text(line_directive, part_start, part_start + strlen(part_start)),
+		NULL
+	};
+
+	arr_push(file->parts, last);
+
+	mem_free(text);
+}
+
+static void inccache_clear_file(inccache_file_t *file)
+{
+	for (size_t i = 0; i < file->parts.count; i++) {
+		DESTROY(file->parts.items[i].text);
+	}
+
+	arr_clear(file->parts);
+
+	file->is_valid = false;
+	file->is_guarded = false;
+}
+
+static bool inccache_has_include_guard(const char *text)
+{
+	// Files starting with #pragma once are guarded.
+	if (string_starts_with(inccache_skip_white_space(text), "#pragma once", 12)) {
+		return true;
+	}
+
+	// A traditional include guard is an #ifndef and a #define of the same macro before any other
+	// directive, and an #endif as the last directive of the file.
+	char guard[128] = "";
+	uint32_t num_directives = 0;
+	bool is_guarded = false;
+
+	for (const char *line = text; *line != 0; line = inccache_get_line_end(line)) {
+
+		const char *directive = inccache_skip_white_space(line);
+
+		if (*directive != '#') {
+			continue;
+		}
+
+		const char *end = inccache_get_line_end(directive);
+		char macro[128];
+
+		if (num_directives == 0) {
+
+			if (!string_starts_with(directive, "#ifndef ", 8)) {
+				return false;
+			}
+
+			string_copy(guard, directive + 8, MIN(sizeof(guard), (size_t)(end - directive) - 7));
+
+			char *name = guard;
+			string_strip(&name);
+			string_strip_end(&name);
+			memmove(guard, name, strlen(name) + 1);
+		}
+		else if (num_directives == 1) {
+
+			if (!string_starts_with(directive, "#define ", 8)) {
+				return false;
+			}
+
+			string_copy(macro, directive + 8, MIN(sizeof(macro), (size_t)(end - directive) - 7));
+
+			char *name = macro;
+			string_strip(&name);
+			string_strip_end(&name);
+
+			if (!string_equals(name, guard)) {
+				return false;
+			}
+		}
+
+		is_guarded = string_starts_with(directive, "#endif", 6);
+		num_directives++;
+	}
+
+	return is_guarded;
+}
+
+static const char *inccache_get_line_end(const char *line)
+{
+	const char *end = strchr(line, '\n');
+	return (end != NULL ? end + 1 : line + strlen(line));
+}
+
+static const char *inccache_skip_white_space(const char *text)
+{
+	while (*text == ' ' || *text == '\t') {
+		text++;
+	}
+
+	return text;
+}
+
+static char *inccache_copy_text(const char *prefix, const char *start, const char *end)
+{
+	size_t prefix_length = strlen(prefix);
+	size_t length = (size_t)(end - start);
+
+	char *text = mem_alloc_fast(prefix_length + length + 1);
+
+	memcpy(text, prefix, prefix_length);
+	memcpy(text + prefix_length, start, length);
+	text[prefix_length + length] = 0;
+
+	return text;
+}
+
+static void inccache_collect(inccache_shader_t *shader, inccache_file_t *file)
+{
+	bool is_included = inccache_depends_on(shader, file);
+
+	if (!is_included) {
+		arr_push(shader->includes, file);
+	}
+
+	// Guarded files are expanded only once per shader.
+	if (!file->is_valid || (file->is_guarded && is_included)) {
+		return;
+	}
+
+	if (file->is_expanding) {
+
+		log_warning("Resources", "Shader include %s includes itself.", file->path);
+		return;
+	}
+
+	file->is_expanding = true;
+
+	for (size_t i = 0; i < file->parts.count; i++) {
+
+		inccache_part_t *part = &file->parts.items[i];
+		arr_push(expansion, part->text);
+
+		if (part->include != NULL) {
+			inccache_collect(shader, part->include);
+		}
+	}
+
+	file->is_expanding = false;
+}
+
+static bool inccache_depends_on(const inccache_shader_t *shader, const inccache_file_t *file)
+{
+	inccache_file_t *include;
+
+	arr_foreach(shader->includes, include) {
+
+		if (include == file) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
+static uint64_t inccache_get_modified_time(const char *path)
+{
+	// Missing files have a modification time of 0, so creating them is detected as a change.
+	uint64_t time;
+	return (file_get_modified_time(path, &time) ? time : 0);
+}
@@ -0,0 +1,85 @@
+#pragma once
+#ifndef __INCLUDECACHE_H
+#define __INCLUDECACHE_H
+
+#include "core/defines.h"
+#include "collections/array.h"
+
+// -------------------------------------------------------------------------------------------------
+
+/*
+====================================================================================================
+
+	Shader include cache
+
+	Shader source files include common headers with #pragma include <file>. Each included file
+	is read and split at its own include directives only once, and cached with the time it was
+	modified. Expanding an include into a shader joins the cached text of the file and the files
+	it includes without touching the disk.
+
+	Files which start with #pragma once or are wrapped into an #ifndef/#define/#endif guard are
+	expanded only once per shader, however many times they are included.
+
+	The files each shader includes (directly or through other files) are recorded, so when a
+	header is modified only the shaders which depend on it are marked dirty.
+
+====================================================================================================
+*/
+
+// A part of an include file: the text before an include directive and the included file.
+typedef struct inccache_part_t {
+
+	char *text; // Lines before the include directive
+	struct inccache_file_t *include; // The included file, NULL for the text after the last include
+
+} inccache_part_t;
+
+// A cached include file.
+typedef struct inccache_file_t {
+
+	char *path;
+	uint64_t modified_time; // Modification time of the file when it was cached
+	bool is_valid; // The file could be read
+	bool is_guarded; // The file is expanded only once per shader
+	bool is_expanding; // The file is being expanded, used for detecting circular includes
+	arr_t(inccache_part_t) parts;
+
+} inccache_file_t;
+
+// The files a shader source depends on.
+typedef struct inccache_shader_t {
+
+	char *path; // Path of the shader source file
+	uint64_t modified_time; // Modification time of the shader source when it was loaded
+	bool is_dirty; // The shader source or one of its includes has changed since it was loaded
+	arr_t(inccache_file_t*) includes; // Every file the shader includes, directly or indirectly
+
+} inccache_shader_t;
+
+// -------------------------------------------------------------------------------------------------
+
+BEGIN_DECLARATIONS;
+
+void inccache_initialize(void);
+void inccache_shutdown(void);
+
+// Start recording the dependencies of a shader source file. Dependencies recorded the previous
+// time the shader was loaded are cleared.
+inccache_shader_t *inccache_begin_shader(const char *path);
+
+// Expand an included file into the source of a shader. Returns the text of the file and the files
+// it includes, which must be freed with mem_free(), or NULL if the file could not be read.
+char *inccache_expand(inccache_shader_t *shader, const char *path);
+
+// Check the modification times of the cached files and the shader sources. Modified include files
+// are read again, and the shaders which depend on them or whose source has been modified are
+// marked dirty. Returns the number of dirty shaders.
+uint32_t inccache_check_changes(void);
+
+// Returns true if a shader has been marked dirty. The flag is cleared when the dependencies of the
+// shader are recorded again.
+bool inccache_is_shader_dirty(const char *path);
+
+END_DECLARATIONS;
+
+#endif
@@ -17,6 +17,7 @@ typedef enum {
 	RES_MATERIAL,
 	RES_EMITTER,
 	RES_SOUND,
+	RES_PREFAB,
 
 } res_type_t;
 
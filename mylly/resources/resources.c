@@ -1,14 +1,19 @@
 #include "resources.h"
 #include "resourceparser.h"
+#include "includecache.h"
 #include "objparser.h"
 #include "mtlparser.h"
 #include "emitterparser.h"
 #include "collections/array.h"
 #include "core/string.h"
+#include "core/mylly.h"
 #include "io/file.h"
 #include "io/log.h"
 #include "renderer/renderer.h"
 #include "renderer/texture.h"
+#include "renderer/texcompress.h"
+#include "renderer/texstream.h"
+#include "renderer/atlas.h"
 #include "renderer/shader.h"
 #include "renderer/font.h"
 #include "renderer/fontpacker.h"
@@ -17,6 +22,7 @@
 #include "scene/sprite.h"
 #include "scene/spriteanimation.h"
 #include "scene/emitter.h"
+#include "scene/prefab.h"
 #include "math/math.h"
 #include "audio/sound.h"
 #include <ft2build.h>
@@ -32,6 +38,7 @@ struct shader_contents_t {
 	arr_t(char*) uniforms;
 	arr_t(UNIFORM_TYPE) uniform_types;
 	uint32_t num_lines;
+	inccache_shader_t *dependencies; // Files included into the shader
 };
 
 // -------------------------------------------------------------------------------------------------
@@ -45,22 +52,32 @@ static arr_t(model_t*) models;
 static arr_t(material_t*) materials;
 static arr_t(emitter_t*) emitters;
 static arr_t(sound_t*) sounds;
+static arr_t(prefab_t*) prefabs;
 
 static const char *parsed_file_name;
 
+static atlas_t *sprite_atlas; // Atlas of all sprite sheets, when enabled
+
 // -------------------------------------------------------------------------------------------------
 
 static void res_load_all_in_directory(const char *path, const char *extension, res_type_t type);
 
 static void res_load_texture(const char *file_name);
+static bool res_is_linear_texture(const char *name);
 
 static void res_load_sprite_sheet(const char *file_name);
+static void res_build_sprite_atlas(void);
 static void res_load_sprite(texture_t *texture, int pixels_per_unit,
                             res_parser_t *parser, int *next_token);
 
 static void res_load_shader(const char *file_name);
+static bool res_read_shader_source(const char *file_name, struct shader_contents_t *contents);
+static bool res_compile_shader(shader_t *shader, struct shader_contents_t *contents);
+static void res_free_shader_source(struct shader_contents_t *contents);
 static void res_parse_shader_line(char *line, size_t length, void *context);
 static void res_parse_shader_uniform(struct shader_contents_t *contents, char *line);
+static void res_load_shader_variants(void);
+static void res_parse_shader_variant_entry(char *line, size_t length, void *context);
 
 static void res_load_animation_group(const char *file_name);
 static void res_load_animation(res_parser_t *parser, int *next_token, const char *group_name);
@@ -73,6 +90,8 @@ static void res_load_font(FT_Library freetype, const char *file_name,
                           uint8_t font_size, uint32_t first_glyph, uint32_t last_glyph);
 
 static void res_load_obj_model(const char *file_name);
+static model_t *res_parse_obj_model(const char *file_name, const char *name);
+static void res_load_model_lods(model_t *model);
 static void res_parse_obj_model_line(char *line, size_t length, void *context);
 
 static void res_load_material(const char *file_name);
@@ -83,6 +102,9 @@ static void res_load_emitter_references(emitter_t *emitter);
 
 static void res_load_sound(const char *file_name);
 
+static void res_load_prefab(const char *file_name);
+static bool res_load_prefab_node(res_parser_t *parser, int *next_token, prefab_t *prefab);
+
 // -------------------------------------------------------------------------------------------------
 
 static int res_compare(const void *a, const void *b)
@@ -105,6 +127,7 @@ STATIC_ASSERT(offsetof(emitter_t, resource) == 0, res_struct_offset_zero);
 STATIC_ASSERT(offsetof(font_t, resource) == 0, res_struct_offset_zero);
 STATIC_ASSERT(offsetof(material_t, resource) == 0, res_struct_offset_zero);
 STATIC_ASSERT(offsetof(model_t, resource) == 0, res_struct_offset_zero);
+STATIC_ASSERT(offsetof(prefab_t, resource) == 0, res_struct_offset_zero);
 STATIC_ASSERT(offsetof(shader_t, resource) == 0, res_struct_offset_zero);
 STATIC_ASSERT(offsetof(sound_t, resource) == 0, res_struct_offset_zero);
 STATIC_ASSERT(offsetof(sprite_t, resource) == 0, res_struct_offset_zero);
@@ -114,6 +137,8 @@ STATIC_ASSERT(offsetof(texture_t, resource) == 0, res_struct_offset_zero);
 
 void res_initialize(void)
 {
+	inccache_initialize();
+
 	// Create default resources here (for resource types which are applicable).
 
 	// Default shader which draws everything in purple.
@@ -153,17 +178,21 @@ void res_initialize(void)
 	// - Textures should be loaded before materials and sprites
 	// - Materials should be loaded before shaders and models
 	// - Sprites should be loaded before animations
+	// - Models, sprites and effects should be loaded before prefabs
 	res_load_all_in_directory("./shaders", ".glsl", RES_SHADER);
+	res_load_shader_variants();
 	res_load_all_in_directory("./textures", ".png", RES_TEXTURE);
 	res_load_all_in_directory("./textures", ".jpg", RES_TEXTURE);
 	res_load_all_in_directory("./textures", ".jpeg", RES_TEXTURE);
 	res_load_all_in_directory("./models", ".mtl", RES_MATERIAL);
 	res_load_all_in_directory("./textures", ".sprite", RES_SPRITE);
+	res_build_sprite_atlas();
 	res_load_all_in_directory("./animations", ".anim", RES_ANIMATION);
 	res_load_all_in_directory("./models", ".obj", RES_MODEL);
 	res_load_all_in_directory("./effects", ".fx", RES_EMITTER);
 	res_load_all_in_directory("./sounds", ".wav", RES_SOUND);
 	res_load_all_in_directory("./sounds", ".mp3", RES_SOUND);
+	res_load_all_in_directory("./prefabs", ".prefab", RES_PREFAB);
 	
 	// Initialize FreeType.
 	FT_Library freetype;
@@ -189,10 +218,15 @@ void res_initialize(void)
 	qsort(materials.items, materials.count, sizeof(materials.items[0]), res_compare);
 	qsort(emitters.items, emitters.count, sizeof(emitters.items[0]), res_compare);
 	qsort(sounds.items, sounds.count, sizeof(sounds.items[0]), res_compare);
+	qsort(prefabs.items, prefabs.count, sizeof(prefabs.items[0]), res_compare);
 }
 
 void res_shutdown(void)
 {
+	// Destroy the sprite atlas while the sprites on it still exist.
+	atlas_destroy(sprite_atlas);
+	sprite_atlas = NULL;
+
 	// Unload all resources.
 	shader_t *shader;
 	arr_foreach(shaders, shader) {
@@ -287,6 +321,16 @@ void res_shutdown(void)
 		}
 	}
 
+	prefab_t *prefab;
+	arr_foreach(prefabs, prefab) {
+
+		if (prefab != NULL) {
+
+			// TODO: Add reference counting to resources.
+			prefab_destroy(prefab);
+		}
+	}
+
 	arr_clear(shaders);
 	arr_clear(sprites);
 	arr_clear(textures);
@@ -296,6 +340,9 @@ void res_shutdown(void)
 	arr_clear(materials);
 	arr_clear(emitters);
 	arr_clear(sounds);
+	arr_clear(prefabs);
+
+	inccache_shutdown();
 }
 
 // TODO: Load unloaded resources when requested.
@@ -454,6 +501,63 @@ sound_t *res_get_sound(const char *name)
 	return NULL;
 }
 
+prefab_t *res_get_prefab(const char *name)
+{
+	prefab_t *prefab;
+	arr_foreach(prefabs, prefab) {
+
+		if (string_equals(prefab->resource.res_name, name)) {
+
+			// TODO: Add reference counting to resources.
+			return prefab;
+		}
+	}
+
+	log_warning("Resources", "Could not find a prefab named '%s'.", name);
+
+	return NULL;
+}
+
+resource_t *res_get_by_name_hash(res_type_t type, uint32_t name_hash)
+{
+	resource_t **list = NULL;
+	size_t count = 0;
+
+	// All resource types begin with the resource info, so the lists can be searched the same way.
+	switch (type) {
+
+		case RES_TEXTURE: list = (resource_t **)textures.items; count = textures.count; break;
+		case RES_SPRITE: list = (resource_t **)sprites.items; count = sprites.count; break;
+		case RES_SHADER: list = (resource_t **)shaders.items; count = shaders.count; break;
+		case RES_ANIMATION: list = (resource_t **)animations.items; count = animations.count; break;
+		case RES_FONT: list = (resource_t **)fonts.items; count = fonts.count; break;
+		case RES_MODEL: list = (resource_t **)models.items; count = models.count; break;
+		case RES_MATERIAL: list = (resource_t **)materials.items; count = materials.count; break;
+		case RES_EMITTER: list = (resource_t **)emitters.items; count = emitters.count; break;
+		case RES_SOUND: list = (resource_t **)sounds.items; count = sounds.count; break;
+		case RES_PREFAB: list = (resource_t **)prefabs.items; count = prefabs.count; break;
+
+		default:
+			log_warning("Resources", "Unhandled resource type %u.", type);
+			return NULL;
+	}
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (list[i] != NULL &&
+			string_hash(list[i]->res_name) == name_hash) {
+
+			// TODO: Add reference counting to resources.
+			return list[i];
+		}
+	}
+
+	log_warning("Resources", "Could not find a resource of type %u with name hash %08x.",
+		type, name_hash);
+
+	return NULL;
+}
+
 sprite_t *res_add_empty_sprite(texture_t *texture, const char *name)
 {
 	// Create the empty sprite container.
@@ -484,6 +588,31 @@ void res_foreach_emitter(void (*method)(emitter_t *))
 	}
 }
 
+void res_reload_changed_shaders(void)
+{
+	if (inccache_check_changes() == 0) {
+		return;
+	}
+
+	shader_t *shader;
+
+	arr_foreach(shaders, shader) {
+
+		if (shader->resource.path == NULL || !inccache_is_shader_dirty(shader->resource.path)) {
+			continue;
+		}
+
+		// Recompile the shader in place, so materials referencing it don't need to be updated.
+		struct shader_contents_t contents;
+
+		if (res_read_shader_source(shader->resource.path, &contents)) {
+
+			log_message("Resources", "Reloading shader %s.", shader->resource.name);
+			shader->resource.is_loaded = res_compile_shader(shader, &contents);
+		}
+	}
+}
+
 static void res_load_all_in_directory(const char *path, const char *extension, res_type_t type)
 {
 	switch (type) {
@@ -506,6 +635,13 @@ static void res_load_all_in_directory(const char *path, const char *extension, r
 
 		case RES_MODEL:
 			file_for_each_in_directory(path, extension, res_load_obj_model);
+
+			// Load lower detail levels of the models (i.e. model.lod1.obj).
+			model_t *model;
+
+			arr_foreach(models, model) {
+				res_load_model_lods(model);
+			}
 			break;
 
 		case RES_MATERIAL:
@@ -523,6 +659,10 @@ static void res_load_all_in_directory(const char *path, const char *extension, r
 			file_for_each_in_directory(path, extension, res_load_sound);
 			break;
 
+		case RES_PREFAB:
+			file_for_each_in_directory(path, extension, res_load_prefab);
+			break;
+
 		default:
 			log_warning("Resources", "Unhandled resource type %u.", type);
 			break;
@@ -546,16 +686,64 @@ static void res_load_texture(const char *file_name)
 
 	texture_t *texture = texture_create(name, file_name);
 
+	// Normal maps and other textures which don't store colours are named with a suffix, so their
+	// mip chains are not generated as sRGB colours.
+	texture->is_linear = res_is_linear_texture(name);
+
 	// Check whether the texture is a spritesheet and use a different filtering method depending
-	// on whether it is.
+	// on whether it is. Other textures are sampled from a mip chain, so they don't alias when
+	// minified.
 	char sprite_sheet_file[260];
 	snprintf(sprite_sheet_file, sizeof(sprite_sheet_file), "./textures/%s.sprite", name);
 
 	bool is_sprite_sheet = file_exists(sprite_sheet_file);
-	TEX_FILTER filter = (is_sprite_sheet ? TEX_FILTER_POINT : TEX_FILTER_BILINEAR);
+	TEX_FILTER filter = (is_sprite_sheet ? TEX_FILTER_POINT : TEX_FILTER_TRILINEAR);
+
+	// Block compressed textures are cooked into a file next to the source (texture.ctex) which
+	// stores the hash of the source file. Sprite sheets are pixel art and are never compressed.
+	bool use_cooked_texture =
+		(mylly_get_parameters()->renderer.use_compressed_textures && !is_sprite_sheet);
+
+	char cooked_file[260];
+	uint64_t source_hash = 0;
+
+	if (use_cooked_texture) {
+
+		size_t path_length = strlen(file_name) - (extension[0] != 0 ? strlen(extension) + 1 : 0);
+		snprintf(cooked_file, sizeof(cooked_file), "%.*s.ctex", (int)path_length, file_name);
+
+		source_hash = texcomp_hash(buffer, length);
+	}
+
+	// Textures which don't have to be cooked or packed into the sprite atlas can be decoded and
+	// uploaded in the background, and streamed if streaming is enabled. The texture takes the
+	// control of the file data.
+	bool load_async = (mylly_get_parameters()->renderer.load_textures_async &&
+	                   !use_cooked_texture && !is_sprite_sheet);
+
+	bool use_streaming = (mylly_get_parameters()->renderer.texture_streaming_budget != 0 &&
+	                      !use_cooked_texture && !is_sprite_sheet);
+
+	if (use_streaming && texstream_add_texture(texture, buffer, length, filter)) {
+
+		texture->resource.is_loaded = true;
+		buffer = NULL;
+	}
+	else if (load_async && texture_load_async(texture, buffer, length, filter, 0)) {
+
+		texture->resource.is_loaded = true;
+		buffer = NULL;
+	}
+
+	// Prefer the cooked texture if it is up to date.
+	else if (use_cooked_texture &&
+		texture_load_cooked(texture, cooked_file, source_hash, filter)) {
+
+		texture->resource.is_loaded = true;
+	}
 
 	// Load the texture from the file data, assuming the file format is supported.
-	if (string_equals(extension, "png") &&
+	else if (string_equals(extension, "png") &&
 		texture_load_png(texture, buffer, length, filter)) {
 
 		texture->resource.is_loaded = true;
@@ -569,8 +757,16 @@ static void res_load_texture(const char *file_name)
 		log_warning("Resources", "Could not load texture %s.", file_name);
 	}
 
-	// Note that the control of the temporary buffer is given to the sound loader.
-	mem_free(buffer);
+	// Cook a compressed version of a decoded texture for the next time the texture is loaded.
+	if (use_cooked_texture && texture->resource.is_loaded &&
+		!texcomp_is_compressed(texture->format)) {
+
+		texture_cook(texture, cooked_file, source_hash, filter);
+	}
+
+	if (buffer != NULL) {
+		mem_free(buffer);
+	}
 
 	// Add the texture to resource list.
 	arr_push(textures, texture);
@@ -593,6 +789,25 @@ static void res_load_texture(const char *file_name)
 	}
 }
 
+static bool res_is_linear_texture(const char *name)
+{
+	static const char *suffixes[] = { "_normal", "_linear" };
+
+	size_t length = strlen(name);
+
+	for (size_t i = 0; i < LENGTH(suffixes); i++) {
+
+		size_t suffix_length = strlen(suffixes[i]);
+
+		if (length >= suffix_length &&
+			string_equals(&name[length - suffix_length], suffixes[i])) {
+			return true;
+		}
+	}
+
+	return false;
+}
+
 static void res_load_sprite_sheet(const char *file_name)
 {
 	// Store the name of the file for possible error messages.
@@ -689,6 +904,38 @@ static void res_load_sprite_sheet(const char *file_name)
 	mem_free(text);
 }
 
+static void res_build_sprite_atlas(void)
+{
+	if (!mylly_get_parameters()->renderer.use_sprite_atlas) {
+		return;
+	}
+
+	// Pack the sprite sheets into shared pages so sprites and UI images can be drawn without
+	// switching textures. Other textures are sampled by models with repeating texture
+	// coordinates, so they can't be packed. The layout is saved so the pages stay the same
+	// between runs.
+	const char *layout_file = "./textures/sprites.atlas";
+
+	sprite_atlas = atlas_create("sprite-atlas", 2048, 2, TEX_FILTER_POINT);
+	atlas_load_layout(sprite_atlas, layout_file);
+
+	texture_t *texture;
+
+	arr_foreach(textures, texture) {
+
+		char sprite_sheet_file[260];
+		snprintf(sprite_sheet_file, sizeof(sprite_sheet_file), "./textures/%s.sprite",
+		         texture->resource.res_name);
+
+		if (texture->resource.is_loaded && file_exists(sprite_sheet_file)) {
+			atlas_add_texture(sprite_atlas, texture);
+		}
+	}
+
+	atlas_commit(sprite_atlas);
+	atlas_save_layout(sprite_atlas, layout_file);
+}
+
 static void res_load_sprite(texture_t *texture, int pixels_per_unit,
                             res_parser_t *parser, int *next_token)
 {
@@ -807,15 +1054,7 @@ static void res_load_shader(const char *file_name)
 	// in the source file.
 	struct shader_contents_t contents;
 
-	arr_init(contents.lines);
-	arr_init(contents.uniforms);
-	arr_init(contents.uniform_types);
-	contents.num_lines = 0;
-
-	// Add an empty line for defines. This is a requirement for the shader compiler.
-	arr_push(contents.lines, NULL);
-
-	if (!file_for_each_line(file_name, res_parse_shader_line, &contents, true)) {
+	if (!res_read_shader_source(file_name, &contents)) {
 		return;
 	}
 
@@ -824,34 +1063,63 @@ static void res_load_shader(const char *file_name)
 	string_get_file_name_without_extension(file_name, name, sizeof(name));
 
 	shader_t *shader = shader_create(name, file_name);
-
-	if (shader_load_from_source(shader, contents.lines.count,
-		                        (const char **)contents.lines.items,
-	                            contents.uniforms.count,
-	                            (const char **)contents.uniforms.items,
-	                            (UNIFORM_TYPE *)contents.uniform_types.items)) {
-		
-		shader->resource.is_loaded = true;
-	}
+	shader->resource.is_loaded = res_compile_shader(shader, &contents);
 
 	// Add to resource list.
 	arr_push(shaders, shader);
 	shader->resource.index = arr_last_index(shaders);
+}
+
+static bool res_read_shader_source(const char *file_name, struct shader_contents_t *contents)
+{
+	arr_init(contents->lines);
+	arr_init(contents->uniforms);
+	arr_init(contents->uniform_types);
+	contents->num_lines = 0;
+
+	// Start recording the files the shader includes.
+	contents->dependencies = inccache_begin_shader(file_name);
+
+	// Add an empty line for defines. This is a requirement for the shader compiler.
+	arr_push(contents->lines, NULL);
+
+	if (!file_for_each_line(file_name, res_parse_shader_line, contents, true)) {
+
+		res_free_shader_source(contents);
+		return false;
+	}
 
+	return true;
+}
+
+static bool res_compile_shader(shader_t *shader, struct shader_contents_t *contents)
+{
+	bool success = shader_load_from_source(shader, contents->lines.count,
+	                                       (const char **)contents->lines.items,
+	                                       contents->uniforms.count,
+	                                       (const char **)contents->uniforms.items,
+	                                       (UNIFORM_TYPE *)contents->uniform_types.items);
+
+	res_free_shader_source(contents);
+	return success;
+}
+
+static void res_free_shader_source(struct shader_contents_t *contents)
+{
 	// Remove all temporarily allocated memory.
 	char *line, *uniform;
 
-	arr_foreach(contents.lines, line) {
+	arr_foreach(contents->lines, line) {
 		mem_free(line);
 	}
 
-	arr_foreach(contents.uniforms, uniform) {
+	arr_foreach(contents->uniforms, uniform) {
 		mem_free(uniform);
 	}
 
-	arr_clear(contents.lines);
-	arr_clear(contents.uniforms);
-	arr_clear(contents.uniform_types);
+	arr_clear(contents->lines);
+	arr_clear(contents->uniforms);
+	arr_clear(contents->uniform_types);
 }
 
 static void res_parse_shader_line(char *line, size_t length, void *context)
@@ -866,7 +1134,7 @@ static void res_parse_shader_line(char *line, size_t length, void *context)
 	// Check the source code for #pragma include directives.
 	if (string_starts_with(line, "#pragma include ", 16)) {
 
-		// Attempt to read the include file.
+		// Expand the include file and the files it includes from the include cache.
 		char *include = &line[16];
 		char file_name[260];
 
@@ -875,14 +1143,12 @@ static void res_parse_shader_line(char *line, size_t length, void *context)
 
 		snprintf(file_name, sizeof(file_name), "./shaders/%s", include);
 
-		char *include_buffer;
-		size_t include_length;
+		char *include_buffer = inccache_expand(contents->dependencies, file_name);
 
-		if (file_read_all_text(file_name, &include_buffer, &include_length)) {
+		if (include_buffer != NULL) {
 
 			// Push the contents of the include file to the line list.
-			arr_push(contents->lines, string_duplicate(include_buffer));
-			mem_free(include_buffer);
+			arr_push(contents->lines, include_buffer);
 
 			// Add a line directive to keep error line numbers matching the shader source file.
 			char line_directive[32];
@@ -953,6 +1219,55 @@ static void res_parse_shader_uniform(struct shader_contents_t *contents, char *l
 	arr_push(contents->uniform_types, uni_type);
 }
 
+static void res_load_shader_variants(void)
+{
+	// Shader variants are compiled when they are first needed. Variants listed in the optional
+	// variant list are compiled ahead of time to avoid compiling them in the middle of the game.
+	if (file_exists("./shaders/variants.txt")) {
+		file_for_each_line("./shaders/variants.txt", res_parse_shader_variant_entry, NULL, false);
+	}
+}
+
+static void res_parse_shader_variant_entry(char *line, size_t length, void *context)
+{
+	UNUSED(length);
+	UNUSED(context);
+
+	string_strip(&line);
+
+	// Ignore comments and empty lines.
+	if (*line == '#' || *line == 0) {
+		return;
+	}
+
+	// Parse the contents of the file.
+	// Format: <shader name> <keyword> [<keyword> ...]
+	char name[128], keyword[64];
+
+	string_tokenize_filter(line, ' ', name, sizeof(name), true);
+
+	shader_t *shader = res_get_shader(name);
+
+	if (shader == NULL) {
+		return;
+	}
+
+	uint64_t keywords = 0;
+
+	while (string_tokenize_filter(NULL, ' ', keyword, sizeof(keyword), true) != 0) {
+
+		uint64_t bit = shader_get_keyword(shader, keyword);
+
+		if (bit == 0) {
+			log_warning("Resources", "Shader %s does not declare keyword %s.", name, keyword);
+		}
+
+		keywords |= bit;
+	}
+
+	shader_get_variant(shader, keywords);
+}
+
 static void res_load_animation_group(const char *file_name)
 {
 	// Store the name of the file for possible error messages.
@@ -1314,18 +1629,15 @@ static void res_load_font(FT_Library freetype, const char *file_name,
 
 static void res_load_obj_model(const char *file_name)
 {
-	// Set up a parser for .obj files.
-	obj_parser_t parser;
-	obj_parser_init(&parser);
-
-	// Read the file line by line and feed it to the parser.
-	file_for_each_line(file_name, res_parse_obj_model_line, &parser, false);
+	// Lower detail levels are loaded along with the full detail model.
+	if (strstr(file_name, ".lod") != NULL) {
+		return;
+	}
 
-	// Create a model from the parser's data.
 	char name[260];
 	string_get_file_name_without_extension(file_name, name, sizeof(name));
 
-	model_t *model = obj_parser_create_model(&parser, name, file_name);
+	model_t *model = res_parse_obj_model(file_name, name);
 
 	// Add the model to the resource handler.
 	if (model != NULL) {
@@ -1335,9 +1647,64 @@ static void res_load_obj_model(const char *file_name)
 
 		arr_push(models, model);
 	}
+}
+
+static model_t *res_parse_obj_model(const char *file_name, const char *name)
+{
+	// Set up a parser for .obj files.
+	obj_parser_t parser;
+	obj_parser_init(&parser);
+
+	// Read the file line by line and feed it to the parser.
+	file_for_each_line(file_name, res_parse_obj_model_line, &parser, false);
+
+	// Create a model from the parser's data.
+	model_t *model = obj_parser_create_model(&parser, name, file_name);
 
 	// Release the temporary parser data.
 	obj_parser_destroy(&parser);
+
+	return model;
+}
+
+static void res_load_model_lods(model_t *model)
+{
+	const char *path = model->resource.path;
+
+	if (path == NULL) {
+		return;
+	}
+
+	// Lower detail levels are stored next to the model as model.lod1.obj, model.lod2.obj etc.
+	// Each level is used once the model covers less than half of the screen size of the
+	// previous level.
+	size_t path_length = strlen(path) - strlen(".obj");
+	float screen_size = 0.5f;
+
+	for (uint32_t level = 1; level <= MAX_MODEL_LODS; level++) {
+
+		char lod_path[260];
+
+		snprintf(lod_path, sizeof(lod_path), "%.*s.lod%u.obj",
+		         (int)path_length, path, level);
+
+		if (!file_exists(lod_path)) {
+			break;
+		}
+
+		model_t *lod = res_parse_obj_model(lod_path, model->resource.res_name);
+
+		if (lod == NULL || !model_add_lod(model, lod, screen_size)) {
+
+			log_warning("Resources", "Could not load detail level %u of model %s.",
+			            level, model->resource.res_name);
+
+			model_destroy(lod);
+			break;
+		}
+
+		screen_size *= 0.5f;
+	}
 }
 
 static void res_parse_obj_model_line(char *line, size_t length, void *context)
@@ -1371,20 +1738,17 @@ static void res_load_material(const char *file_name)
 		material->resource.is_loaded = true;
 
 		// TODO: Add shader definitions to materials as an extension of .mtl file.
-		// For now just use the default textured material shader.
+		// For now just use the default textured material shader, and its normal mapped variant for
+		// materials with a normal map.
+		material->shader = res_get_shader("default-lit");
+
 		if (material->normal_map != NULL) {
-			material->shader = res_get_shader("default-lit-normal");
-		}
-		else {
-			material->shader = res_get_shader("default-lit");
-		}
 
-		// Create a copy of the shader program for each material.
-		if (material->shader != NULL) {
-			material->shader = shader_clone(material->shader);
+			material->shader = shader_get_variant(material->shader,
+			                                      shader_get_keyword(material->shader, "NORMAL_MAP"));
 		}
 
-		// Apply shader parameters.
+		// Materials share the shader program and keep their own values in a parameter block.
 		material_apply_parameters(material);
 		
 		arr_push(materials, material);
@@ -1518,3 +1882,205 @@ static void res_load_sound(const char *file_name)
 	arr_push(sounds, sound);
 	sound->resource.index = arr_last_index(sounds);
 }
+
+static void res_load_prefab(const char *file_name)
+{
+	// Store the name of the file for possible error messages.
+	parsed_file_name = file_name;
+
+	char *text;
+	size_t length;
+
+	// Read the contents of the .prefab file to a buffer.
+	if (!file_read_all_text(file_name, &text, &length)) {
+		return;
+	}
+
+	// Initialize a resource parser object.
+	res_parser_t parser;
+	
+	// Parse the text from the file.
+	if (!res_parser_init(&parser, text, length)) {
+
+		// Resource could not be parsed (syntax error or not a JSON resource file).
+		log_warning("Resources", "Failed to load prefab '%s'.", file_name);
+
+		mem_free(text);
+		return;
+	}
+
+	// Use the name of the file as the name of the prefab.
+	char name[260];
+	string_get_file_name_without_extension(file_name, name, sizeof(name));
+
+	prefab_t *prefab = prefab_create(name, file_name);
+
+	for (int token = 1; token < parser.num_tokens; token++) {
+
+		// Key should always be a string or a primitive!
+		if (!res_parser_is_valid_key_type(&parser, token)) {
+			continue;
+		}
+
+		// Process each field based on its name and value type.
+		if (res_parser_field_equals(&parser, token, "version", JSMN_PRIMITIVE)) {
+
+			// Ignore version checks for now (they're for future proofing).
+			++token;
+		}
+		else if (res_parser_field_equals(&parser, token, "nodes", JSMN_ARRAY)) {
+
+			// Skip the start of the array and move right on to the first node.
+			token += 2;
+
+			// Loop for as long as there are node objects in the array.
+			while (res_parser_is_object(&parser, token)) {
+
+				++token;
+
+				if (!res_load_prefab_node(&parser, &token, prefab)) {
+					break;
+				}
+			}
+
+			// Decrement the current token index due to the increment in this loop.
+			--token;
+		}
+		else {
+			// Unknown field name or type, skip it (unless it's an object of unknown size => abort).
+			char key[100];
+			res_parser_get_text(&parser, token, key, sizeof(key));
+
+			log_warning("Resources", "Unknown prefab field '%s' in resource file %s.",
+				key, file_name);
+
+			if (!res_parser_is_valid_key_type(&parser, ++token)) {
+				break;
+			}
+		}
+	}
+
+	// Add the prefab to the resource list if it contains any objects.
+	if (!arr_is_empty(prefab->nodes)) {
+
+		prefab->resource.is_loaded = true;
+
+		arr_push(prefabs, prefab);
+		prefab->resource.index = arr_last_index(prefabs);
+	}
+	else {
+		log_warning("Resources", "Prefab %s does not define any nodes.", file_name);
+		prefab_destroy(prefab);
+	}
+
+	// Free the temporary file content buffer.
+	mem_free(text);
+}
+
+static bool res_load_prefab_node(res_parser_t *parser, int *next_token, prefab_t *prefab)
+{
+	char name[100];
+	int token = *next_token;
+
+	prefab_node_t node;
+	prefab_init_node(&node);
+
+	for (; token < parser->num_tokens; ++token) {
+
+		// Key should always be a string or a primitive! If this is something else,
+		// then likely we've passed the node object and should return to the main parser.
+		if (!res_parser_is_valid_key_type(parser, token)) {
+			break;
+		}
+
+		// Read the value based on the name and type of the field.
+		if (res_parser_field_equals(parser, token, "parent", JSMN_PRIMITIVE)) {
+			node.parent = res_parser_get_int(parser, ++token);
+		}
+		else if (res_parser_field_equals(parser, token, "position", JSMN_ARRAY)) {
+			node.position = res_parser_get_vector(parser, (++token, &token));
+		}
+		else if (res_parser_field_equals(parser, token, "rotation", JSMN_ARRAY)) {
+
+			// Rotation is defined as euler angles in degrees.
+			vec3_t euler = res_parser_get_vector(parser, (++token, &token));
+			node.rotation = quat_from_euler_deg(euler.x, euler.y, euler.z);
+		}
+		else if (res_parser_field_equals(parser, token, "scale", JSMN_ARRAY)) {
+			node.scale = res_parser_get_vector(parser, (++token, &token));
+		}
+		else if (res_parser_field_equals(parser, token, "model", JSMN_STRING)) {
+
+			res_parser_get_text(parser, ++token, name, sizeof(name));
+			node.model = res_get_model(name);
+		}
+		else if (res_parser_field_equals(parser, token, "sprite", JSMN_STRING)) {
+
+			res_parser_get_text(parser, ++token, name, sizeof(name));
+			node.sprite = res_get_sprite(name);
+		}
+		else if (res_parser_field_equals(parser, token, "emitter", JSMN_STRING)) {
+
+			res_parser_get_text(parser, ++token, name, sizeof(name));
+			node.emitter = res_get_emitter(name);
+		}
+		else if (res_parser_field_equals(parser, token, "light", JSMN_STRING)) {
+
+			res_parser_get_text(parser, ++token, name, sizeof(name));
+			node.has_light = true;
+
+			if (string_equals(name, "directional")) {
+				node.light_type = LIGHT_DIRECTIONAL;
+			}
+			else if (string_equals(name, "spot")) {
+				node.light_type = LIGHT_SPOT;
+			}
+			else {
+				node.light_type = LIGHT_POINT;
+			}
+		}
+		else if (res_parser_field_equals(parser, token, "light_colour", JSMN_ARRAY)) {
+			node.light_colour = res_parser_get_colour(parser, (++token, &token));
+		}
+		else if (res_parser_field_equals(parser, token, "light_intensity", JSMN_PRIMITIVE)) {
+			node.light_intensity = res_parser_get_float(parser, ++token);
+		}
+		else if (res_parser_field_equals(parser, token, "light_range", JSMN_PRIMITIVE)) {
+			node.light_range = res_parser_get_float(parser, ++token);
+		}
+		else if (res_parser_field_equals(parser, token, "light_direction", JSMN_ARRAY)) {
+			node.light_direction = res_parser_get_vector(parser, (++token, &token));
+		}
+		else if (res_parser_field_equals(parser, token, "light_cutoff_angle", JSMN_PRIMITIVE)) {
+			node.light_cutoff_angle = res_parser_get_float(parser, ++token);
+		}
+		else if (res_parser_field_equals(parser, token, "light_cutoff_angle_outer", JSMN_PRIMITIVE)) {
+			node.light_cutoff_angle_outer = res_parser_get_float(parser, ++token);
+		}
+		else if (res_parser_field_equals(parser, token, "camera", JSMN_PRIMITIVE)) {
+			node.has_camera = res_parser_get_bool(parser, ++token);
+		}
+		else if (res_parser_field_equals(parser, token, "animator", JSMN_PRIMITIVE)) {
+			node.has_animator = res_parser_get_bool(parser, ++token);
+		}
+		else if (res_parser_field_equals(parser, token, "audio_source", JSMN_PRIMITIVE)) {
+			node.has_audio_source = res_parser_get_bool(parser, ++token);
+		}
+		else {
+			// Unknown field, return to main parser.
+			char key[100];
+			res_parser_get_text(parser, token, key, sizeof(key));
+
+			log_warning("Resources", "Unknown prefab node field '%s' in resource file %s.",
+                        key, parsed_file_name);
+
+			*next_token = token;
+			return false;
+		}
+	}
+
+	*next_token = token;
+
+	// Add the node to the hierarchy.
+	return (prefab_add_node(prefab, &node) >= 0);
+}
@@ -26,12 +26,19 @@ model_t *res_get_model(const char *name);
 material_t *res_get_material(const char *name);
 emitter_t *res_get_emitter(const char *name);
 sound_t *res_get_sound(const char *name);
+prefab_t *res_get_prefab(const char *name);
+
+// Find a resource by the hash of its full name (see string_hash()).
+resource_t *res_get_by_name_hash(res_type_t type, uint32_t name_hash);
 
 sprite_t *res_add_empty_sprite(texture_t *texture, const char *name);
 
 // Methods useful for i.e. collecting a list of available resources.
 void res_foreach_emitter(void (*method)(emitter_t *));
 
+// Recompile the shaders whose source files or included files have been modified since loading.
+void res_reload_changed_shaders(void);
+
 END_DECLARATIONS;
 
 #endif
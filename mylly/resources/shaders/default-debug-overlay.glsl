@@ -8,12 +8,15 @@ varying vec4 colour;
 attribute vec3 Vertex;
 attribute vec4 Colour;
 
-// To avoid having to include the entire engine include file, we'll define the matrix array here.
-uniform mat4 MatrixArr[1];
+// To avoid having to include the entire engine include file, we'll define the object constants here.
+layout(std140) uniform ObjectData {
+	mat4 ObjectMVP;
+	mat4 ObjectModel;
+};
 
 void main()
 {
-	gl_Position = MatrixArr[0] * vec4(Vertex, 1);
+	gl_Position = ObjectMVP * vec4(Vertex, 1);
 	gl_Position.z = -1.0; // Render the line on top of everything.
 
 	colour = Colour;
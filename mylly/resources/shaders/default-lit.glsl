@@ -1,4 +1,5 @@
 #pragma include inc/mylly.glinc
+#pragma keywords NORMAL_MAP INSTANCING
 
 uniform vec4 DiffuseColour;
 uniform vec4 SpecularColour;
@@ -6,7 +7,58 @@ uniform float Shininess;
 uniform float Opacity;
 
 varying vec2 texCoord;
+
+#ifdef NORMAL_MAP
+varying mat3 tangentMatrix;
+#else
 varying vec3 normal;
+#endif
+
+#if defined(VERTEX_SHADER)
+
+// Calculates the varyings used for the surface normal of a fragment.
+void computenormal()
+{
+#ifdef NORMAL_MAP
+
+	// Calculate world space tangent matrix for normal map calculations.
+	vec3 tangentVec = normalize(vec3(MatrixModel() * vec4(Tangent, 0)));
+	vec3 normalVec = normalize(vec3(MatrixModel() * vec4(Normal, 0)));
+	tangentVec = normalize(tangentVec - dot(tangentVec, normalVec) * normalVec);
+	vec3 biTangentVec = cross(tangentVec, normalVec);
+
+	tangentMatrix = mat3(tangentVec, biTangentVec, normalVec);
+
+#else
+
+	// Calculate world space normal.
+	mat3 normalMatrix = transpose(inverse(mat3(MatrixModel())));
+	normal = normalize(normalMatrix * Normal);
+
+#endif
+}
+
+#elif defined(FRAGMENT_SHADER)
+
+// Returns the world space surface normal of a fragment.
+vec3 surfacenormal()
+{
+#ifdef NORMAL_MAP
+
+	// Retrieve surface normal from the normal map and transform it to world space coordinates.
+	vec3 mapped = texture2D(TextureNormal(), texCoord).rgb;
+	mapped = normalize(mapped * 2.0 - 1.0);
+
+	return normalize(tangentMatrix * mapped);
+
+#else
+
+	return normalize(normal);
+
+#endif
+}
+
+#endif
 
 #ifndef DEFERRED_LIGHTING
 
@@ -17,7 +69,6 @@ varying vec3 normal;
 #pragma include inc/lighting.glinc
 
 varying vec3 worldPosition;
-varying vec3 worldNormal;
 
 #if defined(VERTEX_SHADER)
 
@@ -30,9 +81,7 @@ void main()
 	worldPosition = (MatrixModel() * vec4(Vertex, 1)).xyz;
 	texCoord = TexCoord;
 
-	// Calculate world space normal.
-	mat3 normalMatrix = transpose(inverse(mat3(MatrixModel())));
-	worldNormal = normalize(normalMatrix * Normal);
+	computenormal();
 }
 
 #elif defined(FRAGMENT_SHADER)
@@ -41,11 +90,14 @@ void main()
 {
 	// Apply ambient lighting.
 	vec3 colour = ApplyAmbientLight(DiffuseColour.rgb);
+	vec3 worldNormal = surfacenormal();
 
-	// Apply each light affecting this fragment.
-	for (int i = 0; i < NumLights; i++) {
+	// Apply each light affecting the cluster of this fragment.
+	uvec2 lights = LightClusterRange(worldPosition);
 
-		colour += ApplyPhongLight(i, worldPosition, normalize(worldNormal),
+	for (uint i = 0u; i < lights.y; i++) {
+
+		colour += ApplyPhongLight(LightClusterLight(lights.x + i), worldPosition, worldNormal,
 		                          DiffuseColour.rgb, SpecularColour.rgb, Shininess);
 	}
 
@@ -69,9 +121,7 @@ void main()
 	gl_Position = toclipspace(Vertex);
 	texCoord = TexCoord;
 
-	// Calculate world space normal.
-	mat3 normalMatrix = transpose(inverse(mat3(MatrixModel())));
-	normal = normalize(normalMatrix * Normal);
+	computenormal();
 }
 
 #elif defined(FRAGMENT_SHADER)
@@ -80,7 +130,7 @@ void main()
 {
 	emit(
 		texture2D(TextureMain(), texCoord) * vec4(DiffuseColour.rgb, 1),
-		encodenormal(normal),
+		encodenormal(surfacenormal()),
 		vec4(SpecularColour.rgb, encodeshininess(Shininess))
 	);
 }
@@ -1,4 +1,5 @@
 #pragma include inc/mylly.glinc
+#pragma keywords INSTANCING
 
 varying vec2 texCoord;
 
@@ -3,6 +3,7 @@
 #pragma include inc/lighting.glinc
 
 varying vec2 texCoord;
+varying float lightIndex;
 
 #if defined(VERTEX_SHADER)
 
@@ -10,6 +11,9 @@ void main()
 {
 	gl_Position = vec4(Vertex, 0, 1);
 	texCoord = TexCoord;
+
+	// The index of the light in the light array is stored in the red channel of the vertex colour.
+	lightIndex = Colour.r * 255.0;
 }
 
 #elif defined(FRAGMENT_SHADER)
@@ -21,12 +25,10 @@ void main()
 	if (normalData.a == 0) {
 		
 		// Fragment is not affected by lighting.
-		emit(texture2D(TextureMain(), texCoord));
-		return;
+		discard;
 	}
 
 	// Fetch material properties from G-buffer data.
-	vec3 source = texture2D(TextureMain(), texCoord).rgb;
 	vec3 worldPosition = decodeworldpos(texCoord);
 	vec3 normal = decodenormal(normalData.rgb);
 	vec3 diffuse = texture2D(TextureDiffuse(), texCoord).rgb;
@@ -34,10 +36,11 @@ void main()
 	vec3 specular = specularData.rgb;
 	float shininess = decodeshininess(specularData.a);
 
-	// Apply the effect of the light.
-	vec3 colour = source + ApplyPhongLight(0, worldPosition, normal, diffuse, specular, shininess);
+	// Output the effect of the light. The result is added on top of the previous passes by blending.
+	int light = int(lightIndex + 0.5);
+	vec3 colour = ApplyPhongLight(light, worldPosition, normal, diffuse, specular, shininess);
 
-	emit(vec4(colour, 1));
+	emit(vec4(colour, 0));
 }
 
 #endif
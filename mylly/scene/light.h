@@ -17,6 +17,8 @@ typedef enum light_type_t {
 	LIGHT_POINT,
 	LIGHT_SPOT,
 
+	NUM_LIGHT_TYPES
+
 } light_type_t;
 
 // -------------------------------------------------------------------------------------------------
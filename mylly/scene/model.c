@@ -1,5 +1,10 @@
 #include "model.h"
 #include "core/string.h"
+#include "math/math.h"
+
+// -------------------------------------------------------------------------------------------------
+
+static void model_include_mesh(model_t *model, const mesh_t *mesh);
 
 // -------------------------------------------------------------------------------------------------
 //
@@ -121,6 +126,7 @@ mesh_t *model_add_mesh(
 
 	// Add the mesh to the model.
 	arr_push(model->meshes, mesh);
+	model_include_mesh(model, mesh);
 
 	return mesh;
 }
@@ -139,6 +145,25 @@ void model_remove_meshes(model_t *model)
 	}
 	
 	arr_clear(model->meshes);
+
+	// Remove lower detail levels as well.
+	for (uint32_t i = 0; i < model->num_lods; i++) {
+
+		arr_foreach(model->lods[i].meshes, mesh) {
+			mesh_destroy(mesh);
+		}
+
+		arr_clear(model->lods[i].meshes);
+	}
+
+	model->num_lods = 0;
+	model->num_triangles = 0;
+
+	model->bounds_min = vec3_zero();
+	model->bounds_max = vec3_zero();
+	model->bounds_centre = vec3_zero();
+	model->bounds_radius = 0;
+	model->has_bounds = false;
 }
 
 void model_setup_primitive(model_t *model, PRIMITIVE_TYPE type)
@@ -161,6 +186,7 @@ void model_setup_primitive(model_t *model, PRIMITIVE_TYPE type)
 			mesh_set_indices(mesh, quad_indices, LENGTH(quad_indices));
 
 			arr_push(model->meshes, mesh);
+			model_include_mesh(model, mesh);
 			break;
 
 		case PRIMITIVE_CUBE:
@@ -170,9 +196,94 @@ void model_setup_primitive(model_t *model, PRIMITIVE_TYPE type)
 			mesh_set_indices(mesh, cube_indices, LENGTH(cube_indices));
 
 			arr_push(model->meshes, mesh);
+			model_include_mesh(model, mesh);
 			break;
 
 		default:
 			break;
 	}
 }
+
+bool model_add_lod(model_t *model, model_t *source, float screen_size)
+{
+	if (model == NULL || source == NULL) {
+		return false;
+	}
+
+	if (model->num_lods >= MAX_MODEL_LODS) {
+		return false;
+	}
+
+	model_lod_t *lod = &model->lods[model->num_lods++];
+
+	// Take the ownership of the source model's meshes.
+	lod->meshes.items = source->meshes.items;
+	lod->meshes.count = source->meshes.count;
+	lod->meshes.capacity = source->meshes.capacity;
+	lod->num_triangles = source->num_triangles;
+	lod->screen_size = screen_size;
+
+	arr_init(source->meshes);
+	model_destroy(source);
+
+	return true;
+}
+
+uint32_t model_select_lod(const model_t *model, float screen_size, uint32_t previous_lod)
+{
+	if (model == NULL || model->num_lods == 0) {
+		return 0;
+	}
+
+	uint32_t lod = MIN(previous_lod, model->num_lods);
+
+	// Switch to a lower detail level only once the model is clearly smaller than the threshold of
+	// the level, and back to a higher detail level once it's clearly larger. This keeps the level
+	// from changing every frame when the model is right at the threshold.
+	while (lod < model->num_lods &&
+		   screen_size < model->lods[lod].screen_size * (1.0f - LOD_HYSTERESIS)) {
+		lod++;
+	}
+
+	while (lod > 0 &&
+		   screen_size > model->lods[lod - 1].screen_size * (1.0f + LOD_HYSTERESIS)) {
+		lod--;
+	}
+
+	return lod;
+}
+
+static void model_include_mesh(model_t *model, const mesh_t *mesh)
+{
+	if (mesh->vertex_type != VERTEX_NORMAL || mesh->num_vertices == 0) {
+		return;
+	}
+
+	model->num_triangles += (uint32_t)(mesh->num_indices / 3);
+
+	// Start the bounding box from the first vertex of the first mesh included in the bounds.
+	if (!model->has_bounds) {
+
+		model->bounds_min = mesh->vertices[0].pos;
+		model->bounds_max = mesh->vertices[0].pos;
+		model->has_bounds = true;
+	}
+
+	for (size_t i = 0; i < mesh->num_vertices; i++) {
+
+		vec3_t pos = mesh->vertices[i].pos;
+
+		model->bounds_min.x = MIN(model->bounds_min.x, pos.x);
+		model->bounds_min.y = MIN(model->bounds_min.y, pos.y);
+		model->bounds_min.z = MIN(model->bounds_min.z, pos.z);
+		model->bounds_max.x = MAX(model->bounds_max.x, pos.x);
+		model->bounds_max.y = MAX(model->bounds_max.y, pos.y);
+		model->bounds_max.z = MAX(model->bounds_max.z, pos.z);
+	}
+
+	// The bounding sphere encloses the bounding box.
+	vec3_t extents = vec3_multiply(vec3_subtract(model->bounds_max, model->bounds_min), 0.5f);
+
+	model->bounds_centre = vec3_add(model->bounds_min, extents);
+	model->bounds_radius = math_sqrt(vec3_dot(extents, extents));
+}
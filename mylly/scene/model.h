@@ -19,10 +19,36 @@ typedef enum {
 
 // -------------------------------------------------------------------------------------------------
 
+#define MAX_MODEL_LODS 4 // Maximum number of lower detail levels in addition to the full model
+
+// How much the screen size of a model has to go past a LOD threshold before the detail level is
+// changed. Prevents models from popping back and forth between levels near the threshold.
+#define LOD_HYSTERESIS 0.1f
+
+// -------------------------------------------------------------------------------------------------
+
+typedef struct model_lod_t {
+
+	arr_t(mesh_t*) meshes; // Meshes used at this detail level
+	float screen_size; // The level is used when the model covers less than this part of the screen
+	uint32_t num_triangles; // Total number of triangles in the meshes
+
+} model_lod_t;
+
 typedef struct model_t {
 
 	resource_t resource; // Resource info
-	arr_t(mesh_t*) meshes;
+	arr_t(mesh_t*) meshes; // Meshes of the full detail model
+	uint32_t num_triangles; // Total number of triangles in the full detail meshes
+
+	model_lod_t lods[MAX_MODEL_LODS]; // Lower detail levels, from most to least detailed
+	uint32_t num_lods; // Number of lower detail levels
+
+	vec3_t bounds_min; // Model space bounding box of the full detail meshes
+	vec3_t bounds_max;
+	vec3_t bounds_centre; // Model space bounding sphere of the full detail meshes
+	float bounds_radius;
+	bool has_bounds; // At least one mesh has been included in the bounds
 
 } model_t;
 
@@ -39,6 +65,14 @@ void model_remove_meshes(model_t *model);
 
 void model_setup_primitive(model_t *model, PRIMITIVE_TYPE type);
 
+// Move the meshes of another model into a new lower detail level of this model. The source model
+// is destroyed. Levels should be added from the most detailed to the least detailed.
+bool model_add_lod(model_t *model, model_t *source, float screen_size);
+
+// Select a detail level for a model covering the given portion of the screen height. Level 0 is
+// the full detail model. The previously selected level is used for hysteresis.
+uint32_t model_select_lod(const model_t *model, float screen_size, uint32_t previous_lod);
+
 END_DECLARATIONS;
 
 #endif
@@ -12,6 +12,10 @@
 
 // -------------------------------------------------------------------------------------------------
 
+static void obj_initialize(object_t *obj, scene_t *scene);
+
+// -------------------------------------------------------------------------------------------------
+
 object_t *obj_create(scene_t *scene, object_t *parent)
 {
 	// Make sure the object is created to a scene to avoid leaking objects.
@@ -22,20 +26,7 @@ object_t *obj_create(scene_t *scene, object_t *parent)
 
 	// Create the object.
 	NEW(object_t, obj);
-
-	obj->parent = NULL;
-	obj->scene = scene;
-	obj->scene_index = INVALID_INDEX;
-	obj->is_active = true;
-
-	// Move the object to the world origin.
-	obj->local_position = vec3_zero();
-	obj->local_scale = vec3_one();
-	obj->local_rotation = quat_identity();
-
-	obj->is_transform_dirty = true;
-	obj->is_local_transform_dirty = true;
-	obj->is_rotation_dirty = true;
+	obj_initialize(obj, scene);
 
 	// Attach the object to a parent.
 	if (parent != NULL) {
@@ -45,6 +36,34 @@ object_t *obj_create(scene_t *scene, object_t *parent)
 	return obj;
 }
 
+object_t *obj_create_block(scene_t *scene, uint32_t count)
+{
+	// Make sure the objects are created to a scene to avoid leaking objects.
+	if (scene == NULL) {
+		log_error("Scene", "Can't create objects without a scene.");
+		return NULL;
+	}
+
+	if (count == 0) {
+		return NULL;
+	}
+
+	// Allocate all the objects at once. Each object holds a reference to the block, so the block
+	// is freed along with the last remaining object.
+	obj_block_t *block = mem_alloc(sizeof(obj_block_t) + count * sizeof(object_t));
+	ref_init(block, mem_free);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		object_t *obj = &block->objects[i];
+
+		obj_initialize(obj, scene);
+		obj->block = (i == 0 ? block : ref_inc(block));
+	}
+
+	return block->objects;
+}
+
 void obj_destroy(object_t *obj)
 {
 	if (obj == NULL) {
@@ -98,7 +117,89 @@ void obj_destroy(object_t *obj)
 		audio_set_listener(NULL);
 	}
 
-	DESTROY(obj);
+	// Objects created in bulk are released along with the rest of their block.
+	if (obj->block != NULL) {
+
+		obj_block_t *block = obj->block;
+		ref_dec(block);
+	}
+	else {
+		DESTROY(obj);
+	}
+}
+
+void obj_destroy_batch(object_t **objects, size_t count)
+{
+	if (objects == NULL || count == 0) {
+		return;
+	}
+
+	// Destroy components one type at a time.
+	for (size_t i = 0; i < count; i++) {
+
+		if (objects[i]->camera != NULL) {
+			camera_destroy(objects[i]->camera);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (objects[i]->light != NULL) {
+			light_destroy(objects[i]->light);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (objects[i]->animator != NULL) {
+			animator_destroy(objects[i]->animator);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (objects[i]->emitter != NULL) {
+			emitter_destroy(objects[i]->emitter);
+		}
+	}
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (objects[i]->ai != NULL) {
+			ai_destroy(objects[i]->ai);
+		}
+	}
+
+	object_t *listener = audio_get_listener();
+
+	for (size_t i = 0; i < count; i++) {
+
+		if (objects[i]->audio_source != NULL) {
+			audiosrc_destroy(objects[i]->audio_source);
+		}
+
+		// If the object is the current audio listener, set listener to nothing.
+		if (objects[i] == listener) {
+			audio_set_listener(NULL);
+		}
+	}
+
+	// Release the objects themselves.
+	for (size_t i = 0; i < count; i++) {
+
+		object_t *obj = objects[i];
+
+		arr_clear(obj->children);
+
+		if (obj->block != NULL) {
+
+			obj_block_t *block = obj->block;
+			ref_dec(block);
+		}
+		else {
+			DESTROY(obj);
+		}
+	}
 }
 
 void obj_set_parent(object_t *obj, object_t *parent)
@@ -162,9 +263,10 @@ void obj_process(object_t *obj)
 		ai_process(obj->ai);
 	}
 
-	// The object should be destroyed as soon as possible.
+	// The object should be destroyed as soon as possible. Queue it to be destroyed at the end of
+	// the frame, since the scene is still iterating its objects.
 	if (obj->destroy_immediately) {
-		obj_destroy(obj);
+		scene_destroy_object(obj->scene, obj);
 	}
 }
 
@@ -295,6 +397,9 @@ void obj_set_model(object_t *obj, model_t *model)
 	// Set the model of the object. Models are shared between different scene objects.
 	// TODO: Add reference counting to shared resources!
 	obj->model = model;
+
+	// Detail levels selected for the previous model do not apply to the new one.
+	memset(obj->lod_levels, 0, sizeof(obj->lod_levels));
 }
 
 void obj_set_sprite(object_t *obj, sprite_t *sprite)
@@ -439,53 +544,8 @@ void obj_update_local_transform(object_t *obj)
 		return;
 	}
 	
-	float rx = obj->local_rotation.x;
-	float ry = obj->local_rotation.y;
-	float rz = obj->local_rotation.z;
-	float rw = obj->local_rotation.w;
-	float wx, wy, wz;
-	float xx, yy, yz;
-	float xy, xz, zz;
-	float x2, y2, z2;
-
-	x2 = rx + rx;
-	y2 = ry + ry;
-	z2 = rz + rz;
-
-	xx = rx * x2;
-	xy = rx * y2;
-	xz = rx * z2;
-
-	yy = ry * y2;
-	yz = ry * z2;
-	zz = rz * z2;
-
-	wx = rw * x2;
-	wy = rw * y2;
-	wz = rw * z2;
-
-	mat_set(&obj->local_transform,
-
-		obj->local_scale.x * (1.0f - (yy + zz)),
-		obj->local_scale.x * (xy + wz),
-		obj->local_scale.x * (xz - wy),
-		0,
-
-		obj->local_scale.y * (xy - wz),
-		obj->local_scale.y * (1.0f - (xx + zz)),
-		obj->local_scale.y * (yz + wx),
-		0,
-
-		obj->local_scale.z * (xz + wy),
-		obj->local_scale.z * (yz - wx),
-		obj->local_scale.z * (1.0f - (xx + yy)),
-		0,
-
-		obj->local_position.x,
-		obj->local_position.y,
-		obj->local_position.z,
-		1
-	);
+	mat_from_trs(&obj->local_transform,
+		obj->local_position, obj->local_rotation, obj->local_scale);
 
 	obj->is_local_transform_dirty = false;
 }
@@ -512,3 +572,20 @@ void obj_update_rotation(object_t *obj)
 
 	obj->is_rotation_dirty = false;
 }
+
+static void obj_initialize(object_t *obj, scene_t *scene)
+{
+	obj->parent = NULL;
+	obj->scene = scene;
+	obj->scene_index = INVALID_INDEX;
+	obj->is_active = true;
+
+	// Move the object to the world origin.
+	obj->local_position = vec3_zero();
+	obj->local_scale = vec3_one();
+	obj->local_rotation = quat_identity();
+
+	obj->is_transform_dirty = true;
+	obj->is_local_transform_dirty = true;
+	obj->is_rotation_dirty = true;
+}
@@ -8,18 +8,27 @@
 #include "math/matrix.h"
 #include "math/quaternion.h"
 #include "core/defines.h"
+#include "core/ref.h"
+
+// -------------------------------------------------------------------------------------------------
+
+// Number of render views for which an object remembers its selected model detail level.
+#define MAX_LOD_VIEWS 4
 
 // -------------------------------------------------------------------------------------------------
 
 typedef struct object_t {
 
 	struct object_t *parent; // The parent of this object
+	struct obj_block_t *block; // Shared allocation the object is a part of, NULL if allocated alone
 
 	scene_t *scene; // The scene this object is a part of
 	uint32_t scene_index; // Index in the scene
 
 	bool is_active; // Set to true when the object is processed and rendered normally
 	bool destroy_immediately; // When set to true, the object is destroyed at the end of the frame
+	bool is_destroy_queued; // Set to true when the object is waiting in the scene's destroy queue
+	bool has_destroyed_children; // Used by the scene to unlink destroyed children in one pass
 
 	arr_t(struct object_t*) children; // A list of children attached to this object
 
@@ -50,9 +59,20 @@ typedef struct object_t {
 	light_t *light; // Light attached to the object
 	ai_t *ai; // An AI attached to this object, executing a behaviour tree
 	audiosrc_t *audio_source; // Audio source. Required for positional sound effects
+
+	uint8_t lod_levels[MAX_LOD_VIEWS]; // Model detail level selected in each view last frame
 	
 } object_t;
 
+// A single allocation shared by several objects which are created in bulk (i.e. prefab instances).
+// The block is released after every object in it has been destroyed.
+typedef struct obj_block_t {
+
+	ref_counted();
+	object_t objects[];
+
+} obj_block_t;
+
 // -------------------------------------------------------------------------------------------------
 
 BEGIN_DECLARATIONS;
@@ -60,8 +80,18 @@ BEGIN_DECLARATIONS;
 // Create a new object.
 // NOTE: Please do not use this method directly, use scene_create_object() instead.
 object_t *obj_create(scene_t *scene, object_t *parent);
+
+// Create a contiguous block of parentless objects with a single allocation.
+// NOTE: Please do not use this method directly, use scene_instantiate_prefab() instead.
+object_t *obj_create_block(scene_t *scene, uint32_t count);
+
 void obj_destroy(object_t *obj);
 
+// Destroy a list of objects which have already been removed from their scene and unlinked from any
+// surviving parents. Components are released one type at a time instead of one object at a time.
+// NOTE: Please do not use this method directly, use scene_destroy_object() instead.
+void obj_destroy_batch(object_t **objects, size_t count);
+
 void obj_set_parent(object_t *obj, object_t *parent);
 void obj_set_active(object_t *obj, bool active);
 
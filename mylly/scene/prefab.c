@@ -0,0 +1,116 @@
+#include "prefab.h"
+#include "core/memory.h"
+#include "core/string.h"
+#include "io/log.h"
+
+// -------------------------------------------------------------------------------------------------
+
+prefab_t *prefab_create(const char *name, const char *path)
+{
+	NEW(prefab_t, prefab);
+
+	prefab->resource.res_name = string_duplicate(name);
+	prefab->resource.name = prefab->resource.res_name;
+
+	if (path != NULL) {
+		prefab->resource.path = string_duplicate(path);
+	}
+
+	arr_init(prefab->nodes);
+
+	return prefab;
+}
+
+void prefab_destroy(prefab_t *prefab)
+{
+	if (prefab == NULL) {
+		return;
+	}
+
+	// Models, sprites and emitter templates are references to other resources, so the nodes
+	// don't own anything.
+	arr_clear(prefab->nodes);
+
+	DESTROY(prefab->resource.res_name);
+	DESTROY(prefab->resource.path);
+
+	DESTROY(prefab);
+}
+
+void prefab_init_node(prefab_node_t *node)
+{
+	if (node == NULL) {
+		return;
+	}
+
+	*node = (prefab_node_t){ 0 };
+
+	node->parent = -1;
+	node->position = vec3_zero();
+	node->rotation = quat_identity();
+	node->scale = vec3_one();
+	node->local_transform = mat_identity();
+
+	node->light_type = LIGHT_POINT;
+	node->light_colour = COL_WHITE;
+	node->light_intensity = 1.0f;
+	node->light_range = 1.0f;
+	node->light_direction = vec3_up();
+}
+
+int prefab_add_node(prefab_t *prefab, const prefab_node_t *node)
+{
+	if (prefab == NULL || node == NULL) {
+		return -1;
+	}
+
+	// Ensure the parent exists already so parents always precede their children. Only the first
+	// node can be the root of the hierarchy.
+	if (node->parent >= (int)prefab->nodes.count ||
+		(node->parent < 0 && !arr_is_empty(prefab->nodes)) ||
+		(node->parent >= 0 && arr_is_empty(prefab->nodes))) {
+
+		log_warning("Prefab", "Invalid parent %d for a node in prefab '%s'.",
+			node->parent, prefab->resource.res_name);
+
+		return -1;
+	}
+
+	arr_push(prefab->nodes, *node);
+
+	prefab_node_t *added = &arr_last(prefab->nodes);
+	added->num_children = 0;
+
+	mat_from_trs(&added->local_transform, added->position, added->rotation, added->scale);
+
+	if (added->parent >= 0) {
+		prefab->nodes.items[added->parent].num_children++;
+	}
+
+	return (int)arr_last_index(prefab->nodes);
+}
+
+prefab_node_t *prefab_get_node(prefab_t *prefab, int index)
+{
+	if (prefab == NULL || index < 0 || index >= (int)prefab->nodes.count) {
+		return NULL;
+	}
+
+	return &prefab->nodes.items[index];
+}
+
+void prefab_bake(prefab_t *prefab)
+{
+	if (prefab == NULL) {
+		return;
+	}
+
+	// Calculate the local transform of each node once, so instantiating the prefab only needs to
+	// copy the matrices instead of building them for every object separately.
+	for (size_t i = 0; i < prefab->nodes.count; i++) {
+
+		prefab_node_t *node = &prefab->nodes.items[i];
+
+		mat_from_trs(&node->local_transform, node->position, node->rotation, node->scale);
+	}
+}
@@ -0,0 +1,88 @@
+#pragma once
+#ifndef __PREFAB_H
+#define __PREFAB_H
+
+#include "core/types.h"
+#include "collections/array.h"
+#include "math/vector.h"
+#include "math/quaternion.h"
+#include "math/matrix.h"
+#include "renderer/colour.h"
+#include "resources/resource.h"
+#include "scene/light.h"
+
+BEGIN_DECLARATIONS;
+
+// -------------------------------------------------------------------------------------------------
+
+// A template for a single object in a prefab hierarchy.
+typedef struct prefab_node_t {
+
+	int parent; // Index of the parent node, or -1 for a root node
+	uint32_t num_children; // Number of nodes which have this node as their parent
+
+	vec3_t position; // Local position in relation to the parent node
+	quat_t rotation; // Local rotation in relation to the parent node
+	vec3_t scale; // Local scale in relation to the parent node
+	mat_t local_transform; // Local transform matrix, pre-baked from the values above
+
+	model_t *model; // 3D render model, shared with the instances
+	sprite_t *sprite; // 2D sprite, shared with the instances
+	emitter_t *emitter; // Particle emitter template, copied to the instances
+
+	bool has_light; // Set to true when the instances should have a light attached
+	light_type_t light_type; // Light properties, copied to the instances
+	colour_t light_colour;
+	float light_intensity;
+	float light_range;
+	vec3_t light_direction;
+	float light_cutoff_angle;
+	float light_cutoff_angle_outer;
+
+	bool has_camera; // Set to true when the instances should have a camera attached
+	bool has_animator; // Set to true when the instances should have an animator attached
+	bool has_audio_source; // Set to true when the instances should have an audio source attached
+
+} prefab_node_t;
+
+// -------------------------------------------------------------------------------------------------
+
+typedef struct prefab_t {
+
+	resource_t resource; // Resource info
+
+	// A list of object templates in the hierarchy. A parent node always precedes its children, and
+	// the first node is the root of the hierarchy.
+	arr_t(prefab_node_t) nodes;
+
+} prefab_t;
+
+// Transform for the root object of a prefab instance.
+typedef struct prefab_transform_t {
+
+	vec3_t position;
+	quat_t rotation;
+	vec3_t scale;
+
+} prefab_transform_t;
+
+// -------------------------------------------------------------------------------------------------
+
+prefab_t *prefab_create(const char *name, const char *path);
+void prefab_destroy(prefab_t *prefab);
+
+// Reset an object template to default values (a parentless object at the origin).
+void prefab_init_node(prefab_node_t *node);
+
+// Add a copy of an object template into the hierarchy. The parent index of the node must refer to
+// an already added node (or be -1 for the root node). Returns the index of the new node or -1 if
+// the node could not be added.
+int prefab_add_node(prefab_t *prefab, const prefab_node_t *node);
+prefab_node_t *prefab_get_node(prefab_t *prefab, int index);
+
+// Bake local transforms for all nodes. Must be called after the node TRS values are modified.
+void prefab_bake(prefab_t *prefab);
+
+END_DECLARATIONS;
+
+#endif
@@ -2,7 +2,20 @@
 #include "object.h"
 #include "camera.h"
 #include "light.h"
+#include "emitter.h"
+#include "animator.h"
+#include "prefab.h"
 #include "io/log.h"
+#include "audio/audiosource.h"
+
+// -------------------------------------------------------------------------------------------------
+
+typedef arr_t(object_t*) object_list_t;
+
+// -------------------------------------------------------------------------------------------------
+
+static void scene_queue_hierarchy(object_t *object);
+static bool scene_collect_hierarchy(scene_t *scene, object_t *object, object_list_t *batch);
 
 // -------------------------------------------------------------------------------------------------
 
@@ -13,7 +26,9 @@ scene_t *scene_create(void)
 	arr_init(scene->objects);
 	arr_init(scene->cameras);
 	arr_init(scene->lights);
+	arr_init(scene->destroy_queue);
 
+	scene->destroy_budget = DEFAULT_DESTROY_BUDGET;
 	scene->ambient_light = col(25, 25, 25);
 
 	return scene;
@@ -43,6 +58,9 @@ void scene_destroy(scene_t *scene)
 	arr_clear(scene->cameras);
 	arr_clear(scene->lights);
 
+	// Queued objects were destroyed along with the rest of the objects.
+	arr_clear(scene->destroy_queue);
+
 	// Destroy the scene.
 	DESTROY(scene);
 }
@@ -94,6 +112,227 @@ object_t *scene_create_object(scene_t *scene, object_t *parent)
 	return object;
 }
 
+uint32_t scene_instantiate_prefab(scene_t *scene, prefab_t *prefab, uint32_t count,
+                                  const prefab_transform_t *transforms, object_t **instances)
+{
+	if (scene == NULL || prefab == NULL || count == 0 || arr_is_empty(prefab->nodes)) {
+		return 0;
+	}
+
+	uint32_t num_nodes = prefab->nodes.count;
+	uint32_t num_lights = 0;
+
+	for (uint32_t i = 0; i < num_nodes; i++) {
+
+		if (prefab->nodes.items[i].has_light) {
+			num_lights++;
+		}
+	}
+
+	// Allocate every object of every instance at once.
+	object_t *objects = obj_create_block(scene, count * num_nodes);
+
+	if (objects == NULL) {
+		return 0;
+	}
+
+	// Reserve space for the new objects and lights beforehand. The objects are appended to the
+	// end of the lists instead of searching for free indices one object at a time.
+	arr_reserve(scene->objects, count * num_nodes);
+	arr_reserve(scene->lights, count * num_lights);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		object_t *instance = &objects[i * num_nodes];
+
+		for (uint32_t j = 0; j < num_nodes; j++) {
+
+			prefab_node_t *node = &prefab->nodes.items[j];
+			object_t *obj = &instance[j];
+
+			// Parent nodes precede their children, so the parent object has been set up already.
+			if (node->parent >= 0) {
+
+				obj->parent = &instance[node->parent];
+				arr_push(obj->parent->children, obj);
+			}
+
+			if (node->num_children != 0) {
+				arr_reserve(obj->children, node->num_children);
+			}
+
+			// Copy the pre-baked local transform. The root of each instance uses its own
+			// transform if one is given.
+			if (j == 0 && transforms != NULL) {
+
+				obj->local_position = transforms[i].position;
+				obj->local_rotation = transforms[i].rotation;
+				obj->local_scale = transforms[i].scale;
+
+				mat_from_trs(&obj->local_transform,
+					obj->local_position, obj->local_rotation, obj->local_scale);
+			}
+			else {
+
+				obj->local_position = node->position;
+				obj->local_rotation = node->rotation;
+				obj->local_scale = node->scale;
+				obj->local_transform = node->local_transform;
+			}
+
+			obj->is_local_transform_dirty = false;
+
+			// Add the object to the scene.
+			arr_push(scene->objects, obj);
+			obj->scene_index = arr_last_index(scene->objects);
+
+			// Create components. Models and sprites are shared, the rest are copied from the
+			// templates in the prefab.
+			obj->model = node->model;
+			obj->sprite = node->sprite;
+
+			if (node->emitter != NULL) {
+				obj->emitter = emitter_create(obj, node->emitter, false);
+			}
+
+			if (node->has_light) {
+
+				obj->light = light_create(obj);
+
+				light_set_type(obj->light, node->light_type);
+				light_set_colour(obj->light, node->light_colour);
+				light_set_intensity(obj->light, node->light_intensity);
+				light_set_range(obj->light, node->light_range);
+				light_set_direction(obj->light, node->light_direction);
+
+				if (node->light_type == LIGHT_SPOT) {
+
+					light_set_spotlight_cutoff_angle(obj->light,
+						node->light_cutoff_angle, node->light_cutoff_angle_outer);
+				}
+
+				// The light is new, so it can be registered without checking for duplicates.
+				arr_push(scene->lights, obj);
+				obj->light->scene_index = arr_last_index(scene->lights);
+			}
+
+			if (node->has_camera) {
+
+				obj->camera = camera_create(obj);
+				scene_register_camera(scene, obj);
+			}
+
+			if (node->has_animator) {
+				obj->animator = animator_create(obj);
+			}
+
+			if (node->has_audio_source) {
+				obj->audio_source = audiosrc_create(obj);
+			}
+		}
+
+		if (instances != NULL) {
+			instances[i] = instance;
+		}
+	}
+
+	return count;
+}
+
+void scene_destroy_object(scene_t *scene, object_t *object)
+{
+	if (scene == NULL || object == NULL || object->is_destroy_queued) {
+		return;
+	}
+
+	// Ensure the object is in this scene.
+	if (object->scene != scene) {
+
+		log_warning("Scene", "Failed to destroy an object: the object is in a different scene.");
+		return;
+	}
+
+	// Deactivate the object and its children so they're no longer processed or rendered.
+	scene_queue_hierarchy(object);
+
+	arr_push(scene->destroy_queue, object);
+}
+
+void scene_flush_destroy_queue(scene_t *scene)
+{
+	if (scene == NULL || arr_is_empty(scene->destroy_queue)) {
+		return;
+	}
+
+	object_list_t batch;
+	object_list_t parents;
+
+	arr_init(batch);
+	arr_init(parents);
+
+	// Collect queued hierarchies into a flat list until the budget for this frame has been used.
+	// Collecting an object also removes its references from the scene. A hierarchy which doesn't
+	// fit into the budget stays in the queue and the rest of it is collected on the next frame.
+	size_t processed = 0;
+
+	for (; processed < scene->destroy_queue.count; processed++) {
+
+		if (!scene_collect_hierarchy(scene, scene->destroy_queue.items[processed], &batch)) {
+			break;
+		}
+	}
+
+	arr_remove_range(scene->destroy_queue, 0, processed);
+
+	// Find the surviving parents of the destroyed objects. Collected objects have no scene index,
+	// so any other parent will outlive the batch.
+	object_t *obj;
+
+	arr_foreach(batch, obj) {
+
+		object_t *parent = obj->parent;
+
+		if (parent != NULL &&
+			parent->scene_index != INVALID_INDEX &&
+			!parent->has_destroyed_children) {
+
+			parent->has_destroyed_children = true;
+			arr_push(parents, parent);
+		}
+	}
+
+	// Unlink the destroyed children from each surviving parent in a single pass per parent.
+	arr_foreach(parents, obj) {
+
+		size_t count = 0;
+
+		for (size_t i = 0; i < obj->children.count; i++) {
+
+			if (obj->children.items[i]->scene_index != INVALID_INDEX) {
+				obj->children.items[count++] = obj->children.items[i];
+			}
+		}
+
+		obj->children.count = count;
+		obj->has_destroyed_children = false;
+	}
+
+	// Release the components and the objects.
+	obj_destroy_batch(batch.items, batch.count);
+
+	arr_clear(batch);
+	arr_clear(parents);
+}
+
+void scene_set_destroy_budget(scene_t *scene, uint32_t max_objects_per_frame)
+{
+	if (scene == NULL) {
+		return;
+	}
+
+	scene->destroy_budget = max_objects_per_frame;
+}
+
 void scene_register_camera(scene_t *scene, object_t *object)
 {
 	if (scene == NULL || object == NULL || object->camera == NULL) {
@@ -195,6 +434,11 @@ void scene_remove_references_to_object(scene_t *scene, object_t *object)
 
 	// Remove reference to the object itself.
 	arr_set(scene->objects, object->scene_index, NULL);
+
+	// Objects which are destroyed directly can't be left in the destroy queue.
+	if (object->is_destroy_queued) {
+		arr_remove(scene->destroy_queue, object);
+	}
 }
 
 camera_t *scene_get_main_camera(scene_t *scene)
@@ -218,3 +462,62 @@ void scene_set_ambient_light(scene_t *scene, colour_t light_colour)
 
 	scene->ambient_light = light_colour;
 }
+
+static void scene_queue_hierarchy(object_t *object)
+{
+	object->is_active = false;
+	object->is_destroy_queued = true;
+
+	object_t *child;
+
+	arr_foreach(object->children, child) {
+
+		// Children queued earlier have had their own hierarchy flagged already.
+		if (!child->is_destroy_queued) {
+			scene_queue_hierarchy(child);
+		}
+	}
+}
+
+static bool scene_collect_hierarchy(scene_t *scene, object_t *object, object_list_t *batch)
+{
+	// Objects without a scene index have already been collected as part of another hierarchy.
+	if (object->scene_index == INVALID_INDEX) {
+		return true;
+	}
+
+	// Collect the children before their parent, so that when the budget runs out partway through
+	// the hierarchy, the destroyed children are unlinked from a parent which still exists.
+	object_t *child;
+
+	arr_foreach(object->children, child) {
+
+		if (!scene_collect_hierarchy(scene, child, batch)) {
+			return false;
+		}
+	}
+
+	if (scene->destroy_budget != 0 && batch->count >= scene->destroy_budget) {
+		return false;
+	}
+
+	// Remove references to special components if they exist.
+	if (object->camera != NULL &&
+		object->camera->scene_index != INVALID_INDEX) {
+
+		arr_set(scene->cameras, object->camera->scene_index, NULL);
+	}
+
+	if (object->light != NULL &&
+		object->light->scene_index != INVALID_INDEX) {
+
+		arr_set(scene->lights, object->light->scene_index, NULL);
+	}
+
+	// Remove reference to the object itself and mark it collected.
+	arr_set(scene->objects, object->scene_index, NULL);
+	object->scene_index = INVALID_INDEX;
+
+	arr_push(*batch, object);
+	return true;
+}
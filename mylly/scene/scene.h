@@ -4,6 +4,7 @@
 
 #include "collections/array.h"
 #include "renderer/colour.h"
+#include "scene/prefab.h"
 
 // -------------------------------------------------------------------------------------------------
 
@@ -13,10 +14,16 @@ typedef struct scene_t {
 	arr_t(object_t*) cameras; // List of all scene objects with a camera
 	arr_t(object_t*) lights; // List of all scene objects with a light
 
+	arr_t(object_t*) destroy_queue; // Objects waiting to be destroyed at the end of the frame
+	uint32_t destroy_budget; // Maximum number of objects destroyed per frame (0 = no limit)
+
 	colour_t ambient_light; // Ambient light colour in this scene
 
 } scene_t;
 
+// The default number of objects destroyed per frame before the rest are left for the next frame.
+#define DEFAULT_DESTROY_BUDGET 500
+
 // -------------------------------------------------------------------------------------------------
 
 BEGIN_DECLARATIONS;
@@ -27,6 +34,22 @@ void scene_destroy(scene_t *scene);
 void scene_process_objects(scene_t *scene);
 
 object_t *scene_create_object(scene_t *scene, object_t *parent);
+
+// Create a number of instances of a prefab hierarchy with a single allocation. The root of each
+// instance is placed using the corresponding transform (or the prefab's own transform when the
+// transform list is NULL). The root objects are stored into the optional instance list, which must
+// have room for at least 'count' items. Returns the number of instances created.
+uint32_t scene_instantiate_prefab(scene_t *scene, prefab_t *prefab, uint32_t count,
+                                  const prefab_transform_t *transforms, object_t **instances);
+
+// Queue an object and its children to be destroyed at the end of the frame. The objects are
+// deactivated immediately.
+void scene_destroy_object(scene_t *scene, object_t *object);
+
+// Destroy queued objects, up to the destroy budget. Called once per frame after rendering.
+void scene_flush_destroy_queue(scene_t *scene);
+void scene_set_destroy_budget(scene_t *scene, uint32_t max_objects_per_frame);
+
 void scene_register_camera(scene_t *scene, object_t *object);
 void scene_register_light(scene_t *scene, object_t *object);
 
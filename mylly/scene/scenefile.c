@@ -0,0 +1,422 @@
+#include "scenefile.h"
+#include "scene.h"
+#include "object.h"
+#include "camera.h"
+#include "light.h"
+#include "emitter.h"
+#include "animator.h"
+#include "model.h"
+#include "sprite.h"
+#include "audio/audiosource.h"
+#include "collections/array.h"
+#include "core/string.h"
+#include "io/file.h"
+#include "io/log.h"
+#include "resources/resources.h"
+
+// -------------------------------------------------------------------------------------------------
+
+typedef arr_t(scene_file_resource_t) resource_table_t;
+typedef arr_t(scene_file_object_t) object_records_t;
+
+STATIC_ASSERT(sizeof(scene_file_header_t) == 28, scene_file_header_size);
+STATIC_ASSERT(sizeof(scene_file_object_t) == 116, scene_file_object_size);
+
+// -------------------------------------------------------------------------------------------------
+
+static void scene_file_write_object(object_t *object, uint32_t parent_index,
+                                    object_records_t *records, resource_table_t *resources);
+
+static uint32_t scene_file_add_resource(resource_table_t *resources, res_type_t type,
+                                        const char *name);
+
+static void *scene_file_get_resource(const scene_file_header_t *header, const uint8_t *data,
+                                     void **resources, uint32_t index, res_type_t type);
+
+static bool scene_file_validate_objects(const scene_file_object_t *records, uint32_t num_objects);
+
+// -------------------------------------------------------------------------------------------------
+
+bool scene_save(scene_t *scene, const char *path)
+{
+	if (scene == NULL || string_is_null_or_empty(path)) {
+		return false;
+	}
+
+	resource_table_t resources;
+	object_records_t records;
+
+	arr_init(resources);
+	arr_init(records);
+
+	arr_reserve(records, scene->objects.count);
+
+	// Write each hierarchy starting from the root objects, so that parents always precede their
+	// children in the file.
+	object_t *object;
+
+	arr_foreach(scene->objects, object) {
+
+		if (object != NULL &&
+			object->parent == NULL &&
+			!object->is_destroy_queued) {
+
+			scene_file_write_object(object, INVALID_INDEX, &records, &resources);
+		}
+	}
+
+	// Lay out the file into a single buffer.
+	scene_file_header_t header = { 0 };
+
+	header.magic = SCENE_FILE_MAGIC;
+	header.version = SCENE_FILE_VERSION;
+	header.num_resources = resources.count;
+	header.resources_offset = sizeof(header);
+	header.num_objects = records.count;
+	header.objects_offset =
+		header.resources_offset + resources.count * sizeof(scene_file_resource_t);
+	header.ambient_light = scene->ambient_light;
+
+	size_t size = header.objects_offset + records.count * sizeof(scene_file_object_t);
+	NEW_ARRAY(uint8_t, buffer, size);
+
+	memcpy(buffer, &header, sizeof(header));
+
+	if (resources.count != 0) {
+
+		memcpy(&buffer[header.resources_offset], resources.items,
+			resources.count * sizeof(scene_file_resource_t));
+	}
+
+	if (records.count != 0) {
+
+		memcpy(&buffer[header.objects_offset], records.items,
+			records.count * sizeof(scene_file_object_t));
+	}
+
+	bool success = file_write_all_data(path, buffer, size);
+
+	if (!success) {
+		log_warning("Scene", "Could not write scene file %s.", path);
+	}
+
+	mem_free(buffer);
+	arr_clear(resources);
+	arr_clear(records);
+
+	return success;
+}
+
+scene_t *scene_load(const char *path)
+{
+	size_t size;
+	uint8_t *data = file_map(path, &size);
+
+	if (data == NULL) {
+
+		log_warning("Scene", "Could not open scene file %s.", path);
+		return NULL;
+	}
+
+	// Validate the header and make sure all the data it refers to is within the file.
+	const scene_file_header_t *header = (const scene_file_header_t *)data;
+
+	if (size < sizeof(scene_file_header_t) ||
+		header->magic != SCENE_FILE_MAGIC ||
+		header->version != SCENE_FILE_VERSION ||
+		header->resources_offset + (uint64_t)header->num_resources *
+			sizeof(scene_file_resource_t) > size ||
+		header->objects_offset + (uint64_t)header->num_objects *
+			sizeof(scene_file_object_t) > size ||
+		!scene_file_validate_objects(
+			(const scene_file_object_t *)&data[header->objects_offset], header->num_objects)) {
+
+		log_warning("Scene", "%s is not a valid scene file.", path);
+
+		file_unmap(data, size);
+		return NULL;
+	}
+
+	const scene_file_object_t *records =
+		(const scene_file_object_t *)&data[header->objects_offset];
+
+	// Resolve the referenced resources once.
+	void **resources = NULL;
+
+	if (header->num_resources != 0) {
+
+		const scene_file_resource_t *resource_table =
+			(const scene_file_resource_t *)&data[header->resources_offset];
+
+		resources = mem_alloc_fast(header->num_resources * sizeof(void *));
+
+		for (uint32_t i = 0; i < header->num_resources; i++) {
+
+			resources[i] = res_get_by_name_hash(
+				(res_type_t)resource_table[i].type, resource_table[i].name_hash);
+		}
+	}
+
+	scene_t *scene = scene_create();
+	scene->ambient_light = header->ambient_light;
+
+	// Create all the objects with a single allocation and build them from the records.
+	uint32_t num_objects = header->num_objects;
+	object_t *objects = obj_create_block(scene, num_objects);
+
+	arr_reserve(scene->objects, num_objects);
+
+	for (uint32_t i = 0; i < num_objects; i++) {
+
+		const scene_file_object_t *record = &records[i];
+		object_t *obj = &objects[i];
+
+		// Link the object to its parent, which has been created already.
+		if (record->parent_offset != 0 && record->parent_offset <= i) {
+
+			obj->parent = &objects[i - record->parent_offset];
+			arr_push(obj->parent->children, obj);
+		}
+
+		if (record->num_children != 0) {
+			arr_reserve(obj->children, record->num_children);
+		}
+
+		obj->is_active = ((record->flags & SCENEOBJ_ACTIVE) != 0);
+
+		obj->local_position = record->position;
+		obj->local_rotation = record->rotation;
+		obj->local_scale = record->scale;
+
+		// Add the object to the scene.
+		arr_push(scene->objects, obj);
+		obj->scene_index = arr_last_index(scene->objects);
+
+		// Create components.
+		obj->model = scene_file_get_resource(header, data, resources, record->model, RES_MODEL);
+		obj->sprite = scene_file_get_resource(header, data, resources, record->sprite, RES_SPRITE);
+
+		emitter_t *emitter =
+			scene_file_get_resource(header, data, resources, record->emitter, RES_EMITTER);
+
+		if (emitter != NULL) {
+			obj->emitter = emitter_create(obj, emitter, false);
+		}
+
+		if (record->flags & SCENEOBJ_LIGHT) {
+
+			obj->light = light_create(obj);
+
+			light_set_type(obj->light, (light_type_t)record->light_type);
+			light_set_colour(obj->light, record->light_colour);
+			light_set_intensity(obj->light, record->light_intensity);
+			light_set_range(obj->light, record->light_range);
+			light_set_direction(obj->light, record->light_direction);
+
+			// The light stores the cosines of the cutoff angles, which are saved as they are.
+			if (record->light_type == LIGHT_SPOT) {
+
+				obj->light->cutoff_angle = record->light_cutoff_angle;
+				obj->light->cutoff_angle_outer = record->light_cutoff_angle_outer;
+			}
+
+			// The light is new, so it can be registered without checking for duplicates.
+			arr_push(scene->lights, obj);
+			obj->light->scene_index = arr_last_index(scene->lights);
+		}
+
+		if (record->flags & SCENEOBJ_CAMERA) {
+
+			obj->camera = camera_create(obj);
+
+			if (record->flags & SCENEOBJ_CAMERA_ORTHO) {
+
+				camera_set_orthographic_projection(obj->camera,
+					record->camera_size, record->camera_near, record->camera_far);
+			}
+			else {
+				camera_set_perspective_projection(obj->camera,
+					record->camera_fov, record->camera_near, record->camera_far);
+			}
+
+			// Keep the parameters of the unused projection type as well.
+			obj->camera->size = record->camera_size;
+			obj->camera->fov = record->camera_fov;
+
+			scene_register_camera(scene, obj);
+		}
+
+		if (record->flags & SCENEOBJ_ANIMATOR) {
+			obj->animator = animator_create(obj);
+		}
+
+		if (record->flags & SCENEOBJ_AUDIO_SOURCE) {
+			obj->audio_source = audiosrc_create(obj);
+		}
+	}
+
+	if (resources != NULL) {
+		mem_free(resources);
+	}
+
+	file_unmap(data, size);
+
+	return scene;
+}
+
+static void scene_file_write_object(object_t *object, uint32_t parent_index,
+                                    object_records_t *records, resource_table_t *resources)
+{
+	scene_file_object_t record = { 0 };
+	uint32_t index = records->count;
+
+	record.parent_offset = (parent_index != INVALID_INDEX ? index - parent_index : 0);
+
+	if (object->is_active) {
+		record.flags |= SCENEOBJ_ACTIVE;
+	}
+
+	record.position = object->local_position;
+	record.rotation = object->local_rotation;
+	record.scale = object->local_scale;
+
+	// Store resource references.
+	record.model = (object->model != NULL ?
+		scene_file_add_resource(resources, RES_MODEL, object->model->resource.res_name) :
+		SCENE_FILE_NO_RESOURCE);
+
+	record.sprite = (object->sprite != NULL ?
+		scene_file_add_resource(resources, RES_SPRITE, object->sprite->resource.res_name) :
+		SCENE_FILE_NO_RESOURCE);
+
+	// Emitter instances carry the name of the template they were created from.
+	record.emitter = (object->emitter != NULL ?
+		scene_file_add_resource(resources, RES_EMITTER, object->emitter->resource.name) :
+		SCENE_FILE_NO_RESOURCE);
+
+	// Store component parameters.
+	if (object->light != NULL) {
+
+		light_t *light = object->light;
+
+		record.flags |= SCENEOBJ_LIGHT;
+		record.light_type = light->type;
+		record.light_colour = light->colour;
+		record.light_intensity = light->intensity;
+		record.light_range = light->range;
+		record.light_direction = light->direction;
+		record.light_cutoff_angle = light->cutoff_angle;
+		record.light_cutoff_angle_outer = light->cutoff_angle_outer;
+	}
+
+	if (object->camera != NULL) {
+
+		camera_t *camera = object->camera;
+
+		record.flags |= SCENEOBJ_CAMERA;
+
+		if (camera->is_orthographic) {
+			record.flags |= SCENEOBJ_CAMERA_ORTHO;
+		}
+
+		record.camera_near = camera->clip_near;
+		record.camera_far = camera->clip_far;
+		record.camera_size = camera->size;
+		record.camera_fov = camera->fov;
+	}
+
+	if (object->animator != NULL) {
+		record.flags |= SCENEOBJ_ANIMATOR;
+	}
+
+	if (object->audio_source != NULL) {
+		record.flags |= SCENEOBJ_AUDIO_SOURCE;
+	}
+
+	// Count the children which will be saved.
+	object_t *child;
+
+	arr_foreach(object->children, child) {
+
+		if (!child->is_destroy_queued) {
+			record.num_children++;
+		}
+	}
+
+	arr_push(*records, record);
+
+	// Write the children right after their parent.
+	arr_foreach(object->children, child) {
+
+		if (!child->is_destroy_queued) {
+			scene_file_write_object(child, index, records, resources);
+		}
+	}
+}
+
+static uint32_t scene_file_add_resource(resource_table_t *resources, res_type_t type,
+                                        const char *name)
+{
+	if (name == NULL) {
+		return SCENE_FILE_NO_RESOURCE;
+	}
+
+	uint32_t hash = string_hash(name);
+
+	// Reuse an existing entry if the resource has been referenced already.
+	for (uint32_t i = 0; i < resources->count; i++) {
+
+		if (resources->items[i].type == (uint32_t)type &&
+			resources->items[i].name_hash == hash) {
+
+			return i;
+		}
+	}
+
+	scene_file_resource_t resource;
+	resource.type = type;
+	resource.name_hash = hash;
+
+	arr_push(*resources, resource);
+
+	return arr_last_index(*resources);
+}
+
+static void *scene_file_get_resource(const scene_file_header_t *header, const uint8_t *data,
+                                     void **resources, uint32_t index, res_type_t type)
+{
+	if (resources == NULL || index >= header->num_resources) {
+		return NULL;
+	}
+
+	// Make sure the reference points to a resource of the expected type.
+	const scene_file_resource_t *resource_table =
+		(const scene_file_resource_t *)&data[header->resources_offset];
+
+	if (resource_table[index].type != (uint32_t)type) {
+		return NULL;
+	}
+
+	return resources[index];
+}
+
+static bool scene_file_validate_objects(const scene_file_object_t *records, uint32_t num_objects)
+{
+	// Check every value which is used to size or index something before any object is created.
+	for (uint32_t i = 0; i < num_objects; i++) {
+
+		const scene_file_object_t *record = &records[i];
+
+		// Parents are stored before their children, and the children after their parent.
+		if (record->parent_offset > i ||
+			record->num_children > num_objects - i - 1) {
+			return false;
+		}
+
+		if ((record->flags & SCENEOBJ_LIGHT) && record->light_type >= NUM_LIGHT_TYPES) {
+			return false;
+		}
+	}
+
+	return true;
+}
@@ -0,0 +1,105 @@
+#pragma once
+#ifndef __SCENEFILE_H
+#define __SCENEFILE_H
+
+#include "core/defines.h"
+#include "math/vector.h"
+#include "math/quaternion.h"
+#include "renderer/colour.h"
+
+BEGIN_DECLARATIONS;
+
+/*
+====================================================================================================
+
+	Scene file
+
+	A versioned binary snapshot of a scene. The file consists of a header followed by a table of
+	referenced resources and a list of fixed size object records. Objects are stored parents
+	first, and each object refers to its parent by a relative record offset so the hierarchy can
+	be rebuilt in a single pass. Resources are referenced by the hash of their full name.
+
+====================================================================================================
+*/
+
+#define SCENE_FILE_MAGIC 0x4E435359 // "YSCN"
+#define SCENE_FILE_VERSION 1
+
+#define SCENE_FILE_NO_RESOURCE 0xFFFFFFFF
+
+// -------------------------------------------------------------------------------------------------
+
+typedef enum scene_file_flags_t {
+
+	SCENEOBJ_ACTIVE = 0x01, // The object is active
+	SCENEOBJ_LIGHT = 0x02, // The object has a light attached to it
+	SCENEOBJ_CAMERA = 0x04, // The object has a camera attached to it
+	SCENEOBJ_CAMERA_ORTHO = 0x08, // The camera uses an orthographic projection
+	SCENEOBJ_ANIMATOR = 0x10, // The object has an animator attached to it
+	SCENEOBJ_AUDIO_SOURCE = 0x20, // The object has an audio source attached to it
+
+} scene_file_flags_t;
+
+// -------------------------------------------------------------------------------------------------
+
+typedef struct scene_file_header_t {
+
+	uint32_t magic; // Always SCENE_FILE_MAGIC
+	uint32_t version; // Version of the file format
+
+	uint32_t num_resources; // Number of entries in the resource table
+	uint32_t resources_offset; // Offset of the resource table from the start of the file
+	uint32_t num_objects; // Number of object records
+	uint32_t objects_offset; // Offset of the first object record from the start of the file
+
+	colour_t ambient_light; // Ambient light colour of the scene
+
+} scene_file_header_t;
+
+typedef struct scene_file_resource_t {
+
+	uint32_t type; // Type of the resource (res_type_t)
+	uint32_t name_hash; // Hash of the full name of the resource
+
+} scene_file_resource_t;
+
+typedef struct scene_file_object_t {
+
+	uint32_t parent_offset; // Number of records back to the parent, 0 for root objects
+	uint32_t num_children; // Number of direct children of this object
+	uint32_t flags; // Object and component flags (scene_file_flags_t)
+
+	vec3_t position; // Local position
+	quat_t rotation; // Local rotation
+	vec3_t scale; // Local scale
+
+	uint32_t model; // Index of the model in the resource table
+	uint32_t sprite; // Index of the sprite in the resource table
+	uint32_t emitter; // Index of the emitter template in the resource table
+
+	uint32_t light_type; // Light properties
+	colour_t light_colour;
+	float light_intensity;
+	float light_range;
+	vec3_t light_direction;
+	float light_cutoff_angle;
+	float light_cutoff_angle_outer;
+
+	float camera_near; // Camera properties
+	float camera_far;
+	float camera_size;
+	float camera_fov;
+
+} scene_file_object_t;
+
+// -------------------------------------------------------------------------------------------------
+
+// Write a snapshot of the scene into a file. Objects waiting to be destroyed are not saved.
+bool scene_save(scene_t *scene, const char *path);
+
+// Create a new scene from a snapshot file. Returns NULL if the file is not a valid snapshot.
+scene_t *scene_load(const char *path);
+
+END_DECLARATIONS;
+
+#endif
@@ -0,0 +1,257 @@
+#include "scenemanager.h"
+#include "scene.h"
+#include "object.h"
+#include "collections/array.h"
+#include "core/parallel.h"
+#include "io/log.h"
+
+// -------------------------------------------------------------------------------------------------
+
+typedef enum preload_state_t {
+
+	PRELOAD_NONE, // Nothing is being preloaded
+	PRELOAD_BUILDING, // The scene is being built on the worker thread
+	PRELOAD_READY, // The scene has been built and can be activated
+
+} preload_state_t;
+
+// -------------------------------------------------------------------------------------------------
+
+static scene_t *active_scene; // The scene which is processed and rendered
+static scene_t *next_scene; // A scene to be activated at the start of the next frame
+static bool has_next_scene; // Set to true when the active scene should be swapped
+
+static struct {
+
+	preload_state_t state; // Current state of the preloaded scene
+	scene_t *scene; // The preloaded scene
+	scene_build_t build; // Method for building the scene on the worker thread
+	scene_ready_t ready; // Callback to be called on the main thread once the scene is ready
+	void *context; // User context passed to the methods above
+
+	bool activate_when_ready; // Activate the scene as soon as it's ready
+	bool unload_previous; // Unload the active scene when the preloaded one is activated
+
+} preload;
+
+static arr_t(scene_t*) unloading_scenes; // Scenes being destroyed over several frames
+static uint32_t unload_budget = DEFAULT_UNLOAD_BUDGET; // Objects destroyed per frame when unloading
+
+// -------------------------------------------------------------------------------------------------
+
+static void scenemgr_activate(scene_t *scene, bool unload_previous);
+static void scenemgr_build_scene(void *context);
+static void scenemgr_scene_built(void *context);
+
+// -------------------------------------------------------------------------------------------------
+
+void scenemgr_initialize(void)
+{
+	arr_init(unloading_scenes);
+}
+
+void scenemgr_shutdown(void)
+{
+	// Finish unloading the remaining scenes right away.
+	scene_t *scene;
+
+	arr_foreach(unloading_scenes, scene) {
+		scene_destroy(scene);
+	}
+
+	arr_clear(unloading_scenes);
+
+	// A scene which was preloaded but never used is owned by the manager.
+	if (preload.state == PRELOAD_READY) {
+		scene_destroy(preload.scene);
+	}
+	else if (preload.state == PRELOAD_BUILDING) {
+		log_warning("Scene", "Scene manager shut down while a scene was still being preloaded.");
+	}
+
+	preload.state = PRELOAD_NONE;
+	preload.scene = NULL;
+
+	active_scene = NULL;
+}
+
+void scenemgr_process(void)
+{
+	// Activate a preloaded scene which was requested to be activated before it was ready.
+	if (preload.state == PRELOAD_READY && preload.activate_when_ready) {
+
+		scenemgr_activate(preload.scene, preload.unload_previous);
+
+		preload.state = PRELOAD_NONE;
+		preload.scene = NULL;
+	}
+
+	// Swap the active scene.
+	if (has_next_scene) {
+
+		active_scene = next_scene;
+
+		next_scene = NULL;
+		has_next_scene = false;
+	}
+
+	// Destroy a portion of each unloaded scene.
+	for (int i = unloading_scenes.count; i > 0; --i) {
+
+		scene_t *scene = unloading_scenes.items[i - 1];
+
+		scene->destroy_budget = unload_budget;
+		scene_flush_destroy_queue(scene);
+
+		// Once every object has been destroyed, the scene itself can be destroyed. A partially
+		// destroyed hierarchy is kept in the queue until all of its objects are gone.
+		if (arr_is_empty(scene->destroy_queue)) {
+
+			scene_destroy(scene);
+			arr_remove_at(unloading_scenes, (uint32_t)i - 1);
+		}
+	}
+}
+
+scene_t *scenemgr_get_active_scene(void)
+{
+	return active_scene;
+}
+
+void scenemgr_set_active_scene(scene_t *scene)
+{
+	next_scene = scene;
+	has_next_scene = true;
+}
+
+bool scenemgr_preload(scene_build_t build, scene_ready_t ready, void *context)
+{
+	if (build == NULL) {
+		return false;
+	}
+
+	if (preload.state != PRELOAD_NONE) {
+
+		log_warning("Scene", "Another scene is being preloaded already.");
+		return false;
+	}
+
+	preload.state = PRELOAD_BUILDING;
+	preload.scene = NULL;
+	preload.build = build;
+	preload.ready = ready;
+	preload.context = context;
+	preload.activate_when_ready = false;
+	preload.unload_previous = false;
+
+	parallel_submit_job(scenemgr_build_scene, scenemgr_scene_built, NULL);
+
+	return true;
+}
+
+scene_t *scenemgr_get_preloaded_scene(void)
+{
+	return (preload.state == PRELOAD_READY ? preload.scene : NULL);
+}
+
+bool scenemgr_is_preloading(void)
+{
+	return (preload.state == PRELOAD_BUILDING);
+}
+
+void scenemgr_activate_preloaded(bool unload_previous)
+{
+	if (preload.state == PRELOAD_NONE) {
+
+		log_warning("Scene", "There is no preloaded scene to activate.");
+		return;
+	}
+
+	// The scene is activated at the start of the next frame after it's ready.
+	preload.activate_when_ready = true;
+	preload.unload_previous = unload_previous;
+}
+
+void scenemgr_unload_scene(scene_t *scene)
+{
+	if (scene == NULL) {
+		return;
+	}
+
+	// A scene which is already being unloaded must not be queued (and destroyed) twice.
+	int index;
+	arr_find(unloading_scenes, scene, index);
+
+	if (index != -1) {
+		return;
+	}
+
+	if (scene == active_scene) {
+		active_scene = NULL;
+	}
+
+	// Cancel a pending swap to the scene, so the currently active scene is kept.
+	if (scene == next_scene) {
+
+		next_scene = NULL;
+		has_next_scene = false;
+	}
+
+	// Queue all the objects in the scene to be destroyed. The destroy queue is then flushed a bit
+	// at a time at the start of each frame.
+	object_t *object;
+
+	arr_foreach(scene->objects, object) {
+
+		if (object != NULL && object->parent == NULL) {
+			scene_destroy_object(scene, object);
+		}
+	}
+
+	arr_push(unloading_scenes, scene);
+}
+
+void scenemgr_set_unload_budget(uint32_t max_objects_per_frame)
+{
+	unload_budget = max_objects_per_frame;
+}
+
+static void scenemgr_activate(scene_t *scene, bool unload_previous)
+{
+	scene_t *previous = (has_next_scene ? next_scene : active_scene);
+
+	scenemgr_set_active_scene(scene);
+
+	if (unload_previous && previous != NULL && previous != scene) {
+		scenemgr_unload_scene(previous);
+	}
+}
+
+static void scenemgr_build_scene(void *context)
+{
+	UNUSED(context);
+
+	// Executed on the worker thread.
+	preload.scene = preload.build(preload.context);
+}
+
+static void scenemgr_scene_built(void *context)
+{
+	UNUSED(context);
+
+	// Executed on the main thread.
+	if (preload.scene == NULL) {
+
+		log_warning("Scene", "Failed to preload a scene.");
+
+		preload.state = PRELOAD_NONE;
+		return;
+	}
+
+	// Let the game do work which requires the main thread (i.e. uploading data to the GPU).
+	if (preload.ready != NULL) {
+		preload.ready(preload.scene, preload.context);
+	}
+
+	preload.state = PRELOAD_READY;
+}
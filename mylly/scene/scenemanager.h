@@ -0,0 +1,53 @@
+#pragma once
+#ifndef __SCENEMANAGER_H
+#define __SCENEMANAGER_H
+
+#include "core/defines.h"
+
+// -------------------------------------------------------------------------------------------------
+
+// Method for building a scene on the worker thread. The method should only create the scene, its
+// objects and resolve resources; anything touching the renderer must be done in the ready callback.
+typedef scene_t *(*scene_build_t)(void *context);
+
+// Called on the main thread once a preloaded scene has been built.
+typedef void (*scene_ready_t)(scene_t *scene, void *context);
+
+// The default number of objects destroyed per frame when unloading a scene.
+#define DEFAULT_UNLOAD_BUDGET 1000
+
+// -------------------------------------------------------------------------------------------------
+
+BEGIN_DECLARATIONS;
+
+void scenemgr_initialize(void);
+void scenemgr_shutdown(void);
+
+// Swap scenes and continue unloading old ones. Called by the engine at the start of each frame.
+void scenemgr_process(void);
+
+// Get the scene which is currently processed and rendered.
+scene_t *scenemgr_get_active_scene(void);
+
+// Set the active scene. The scene is swapped in at the start of the next frame.
+void scenemgr_set_active_scene(scene_t *scene);
+
+// Start building a new scene on the worker thread. Only one scene can be preloaded at a time.
+bool scenemgr_preload(scene_build_t build, scene_ready_t ready, void *context);
+
+// Returns the preloaded scene once it has been built and is ready for use, otherwise NULL.
+scene_t *scenemgr_get_preloaded_scene(void);
+bool scenemgr_is_preloading(void);
+
+// Make the preloaded scene active at the start of the next frame. If the preload is still in
+// progress, the scene is activated as soon as it's ready. The previously active scene is unloaded
+// when unload_previous is set.
+void scenemgr_activate_preloaded(bool unload_previous);
+
+// Destroy a scene gradually over several frames. The scene can't be used after this call.
+void scenemgr_unload_scene(scene_t *scene);
+void scenemgr_set_unload_budget(uint32_t max_objects_per_frame);
+
+END_DECLARATIONS;
+
+#endif
@@ -9,7 +9,7 @@
 
 // -------------------------------------------------------------------------------------------------
 
-static void sprite_create_mesh(sprite_t *sprite);
+static void sprite_update_mesh(sprite_t *sprite);
 
 // -------------------------------------------------------------------------------------------------
 
@@ -96,10 +96,12 @@ void sprite_set(sprite_t *sprite, texture_t *texture,
 
 	// Create a mesh for the sprite.
 	if (sprite->mesh != NULL) {
+
 		mesh_destroy(sprite->mesh);
+		sprite->mesh = NULL;
 	}
 
-	sprite_create_mesh(sprite);
+	sprite_update_mesh(sprite);
 
 	// Sprites don't have a material by default, so shader and texture need to be set separately.
 	shader_t *shader = res_get_shader("default-sprite");
@@ -157,7 +159,44 @@ void sprite_set_shader(sprite_t *sprite, shader_t *shader)
 	shader_set_uniform_colour(shader, "Colour", COL_WHITE);
 }
 
-static void sprite_create_mesh(sprite_t *sprite)
+void sprite_set_atlas_region(sprite_t *sprite, texture_t *texture, vec2_t offset)
+{
+	if (sprite == NULL || texture == NULL) {
+		return;
+	}
+
+	sprite->texture = texture;
+
+	// Calculate texture coordinates on the new texture.
+	sprite->uv1 = vector2(
+		(offset.x + sprite->position.x) / texture->width,
+		(offset.y + sprite->position.y) / texture->height
+	);
+
+	sprite->uv2 = vector2(
+		(offset.x + sprite->position.x + sprite->size.x) / texture->width,
+		(offset.y + sprite->position.y + sprite->size.y) / texture->height
+	);
+
+	sprite->slice_uv1 = vector2(
+		(offset.x + sprite->slice_position.x) / texture->width,
+		(offset.y + sprite->slice_position.y) / texture->height
+	);
+
+	sprite->slice_uv2 = vector2(
+		(offset.x + sprite->slice_position.x + sprite->slice_size.x) / texture->width,
+		(offset.y + sprite->slice_position.y + sprite->slice_size.y) / texture->height
+	);
+
+	// Update the texture coordinates of the existing mesh, so its shader is kept.
+	if (sprite->mesh != NULL) {
+
+		sprite_update_mesh(sprite);
+		mesh_set_texture(sprite->mesh, texture);
+	}
+}
+
+static void sprite_update_mesh(sprite_t *sprite)
 {
 	if (sprite == NULL) {
 		return;
@@ -198,8 +237,10 @@ static void sprite_create_mesh(sprite_t *sprite)
 		2, 1, 3
 	};
 
-	// Create a mesh with the quad vertex data.
-	sprite->mesh = mesh_create();
+	// Create a mesh with the quad vertex data, or update the vertices of the existing mesh.
+	if (sprite->mesh == NULL) {
+		sprite->mesh = mesh_create();
+	}
 
 	mesh_set_vertices(sprite->mesh, vertices, LENGTH(vertices));
 	mesh_set_indices(sprite->mesh, indices, LENGTH(indices));
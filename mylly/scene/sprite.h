@@ -44,6 +44,11 @@ void sprite_set_nine_slice(sprite_t *sprite, vec2_t slice_position, vec2_t slice
 
 void sprite_set_shader(sprite_t *sprite, shader_t *shader);
 
+// Move the sprite onto a region of another texture, e.g. an atlas page (see renderer/atlas.h).
+// The offset is the position of the sprite's original texture on the new texture in pixels. The
+// position and size of the sprite stay relative to its original texture.
+void sprite_set_atlas_region(sprite_t *sprite, texture_t *texture, vec2_t offset);
+
 END_DECLARATIONS;
 
 #endif
@@ -0,0 +1,109 @@
+#include "core/defines.h"
+#include "scene/scene.h"
+#include "scene/scenefile.h"
+#include "scene/prefab.h"
+#include "renderer/texcompress.h"
+#include "core/memory.h"
+#include <stdio.h>
+#include <time.h>
+
+// Timings of engine systems which are too dependent on the machine to be checked by unit tests.
+// Build and run with 'make benchmark'.
+
+#define BENCH_SCENE_INSTANCES 1000
+#define BENCH_SCENE_NODES 50 // The root and 49 children, 50k objects in total
+#define BENCH_SCENE_PATH "benchmark.scn"
+
+#define BENCH_TEXTURE_SIZE 512
+
+// -------------------------------------------------------------------------------------------------
+
+static double bench_seconds_since(clock_t start)
+{
+	return (double)(clock() - start) / CLOCKS_PER_SEC;
+}
+
+static void bench_scene_file(void)
+{
+	prefab_t *prefab = prefab_create("benchmark", NULL);
+
+	for (int i = 0; i < BENCH_SCENE_NODES; i++) {
+
+		prefab_node_t node;
+		prefab_init_node(&node);
+
+		node.parent = (i == 0 ? -1 : 0);
+		node.position = vec3((float)i, 0, 0);
+		node.has_light = (i == 0);
+		node.light_type = LIGHT_POINT;
+		node.light_range = 10;
+
+		prefab_add_node(prefab, &node);
+	}
+
+	prefab_bake(prefab);
+
+	// Build the scene through the API.
+	scene_t *original = scene_create();
+
+	clock_t start = clock();
+	scene_instantiate_prefab(original, prefab, BENCH_SCENE_INSTANCES, NULL, NULL);
+	double build_seconds = bench_seconds_since(start);
+
+	// Load the same scene from a snapshot.
+	scene_save(original, BENCH_SCENE_PATH);
+
+	start = clock();
+	scene_t *loaded = scene_load(BENCH_SCENE_PATH);
+	double load_seconds = bench_seconds_since(start);
+
+	remove(BENCH_SCENE_PATH);
+
+	printf("Scene with %u objects: built in %.1f ms, loaded in %.1f ms\n",
+	       BENCH_SCENE_INSTANCES * BENCH_SCENE_NODES, 1000 * build_seconds, 1000 * load_seconds);
+
+	if (loaded != NULL) {
+		scene_destroy(loaded);
+	}
+
+	scene_destroy(original);
+	prefab_destroy(prefab);
+}
+
+static void bench_texture_compression(void)
+{
+	// Encode a 512x512 RGBA gradient with a little noise, similar to a typical texture.
+	enum { SIZE = BENCH_TEXTURE_SIZE };
+
+	uint8_t *image = mem_alloc_fast(SIZE * SIZE * 4);
+	uint8_t *blocks = mem_alloc_fast(texcomp_get_size(TEX_FORMAT_BC3, SIZE, SIZE));
+	uint32_t seed = 12345;
+
+	for (size_t i = 0; i < SIZE * SIZE * 4; i++) {
+
+		seed = seed * 1103515245 + 12345;
+		image[i] = (uint8_t)(((i / 4) % SIZE) * 250 / SIZE + (seed >> 16) % 5);
+	}
+
+	clock_t start = clock();
+	texcomp_encode(image, SIZE, SIZE, 4, TEX_FORMAT_BC3, blocks);
+	double seconds = bench_seconds_since(start);
+
+	printf("BC3 encoder: %.1f megapixels per second\n",
+	       SIZE * SIZE / 1000000.0 / (seconds > 0 ? seconds : 1e-6));
+
+	mem_free(image);
+	mem_free(blocks);
+}
+
+// -------------------------------------------------------------------------------------------------
+
+int main(void)
+{
+	printf("Running benchmarks for Mylly...\n");
+
+	bench_scene_file();
+	bench_texture_compression();
+
+	return 0;
+}
@@ -0,0 +1,103 @@
+#include "resources/includecache.h"
+#include "io/file.h"
+#include "core/memory.h"
+#include <stdio.h>
+#include <string.h>
+#include <utime.h>
+
+// Included files are looked up from the shaders directory, shader sources can be anywhere.
+#define INCCACHE_TEST_COMMON "./shaders/inccache-test-common.glinc"
+#define INCCACHE_TEST_HEADER "./shaders/inccache-test-header.glinc"
+#define INCCACHE_TEST_OTHER "./shaders/inccache-test-other.glinc"
+#define INCCACHE_TEST_SHADER_A "inccache-test-a.glsl"
+#define INCCACHE_TEST_SHADER_B "inccache-test-b.glsl"
+
+static void inccache_write_file(const char *path, const char *text)
+{
+	file_write_all_data(path, text, strlen(text));
+}
+
+// Modification times are stored in seconds, so a file modified during the test would often keep
+// its time. Move the time forward instead.
+static void inccache_touch_file(const char *path)
+{
+	uint64_t time = 0;
+	file_get_modified_time(path, &time);
+
+	struct utimbuf times = { (time_t)time + 10, (time_t)time + 10 };
+	utime(path, &times);
+}
+
+// Expand an include into a shader and check whether the expanded text contains a string.
+static bool inccache_expands_to(inccache_shader_t *shader, const char *path, const char *text)
+{
+	char *source = inccache_expand(shader, path);
+	bool contains = (source != NULL && strstr(source, text) != NULL);
+
+	if (source != NULL) {
+		mem_free(source);
+	}
+
+	return contains;
+}
+
+MU_TEST(test_inccache_dependents)
+{
+	inccache_initialize();
+
+	// Shader A includes the header, which includes the common file. Shader B includes a file which
+	// is not related to the others.
+	inccache_write_file(INCCACHE_TEST_COMMON, "float Common() { return 1.0; }\n");
+	inccache_write_file(INCCACHE_TEST_HEADER,
+		"#pragma once\n#pragma include inccache-test-common.glinc\nfloat Header();\n");
+	inccache_write_file(INCCACHE_TEST_OTHER, "float Other();\n");
+	inccache_write_file(INCCACHE_TEST_SHADER_A, "void main() {}\n");
+	inccache_write_file(INCCACHE_TEST_SHADER_B, "void main() {}\n");
+
+	inccache_shader_t *shader_a = inccache_begin_shader(INCCACHE_TEST_SHADER_A);
+	inccache_shader_t *shader_b = inccache_begin_shader(INCCACHE_TEST_SHADER_B);
+
+	mu_check(inccache_expands_to(shader_a, INCCACHE_TEST_HEADER, "return 1.0;"));
+	mu_check(inccache_expands_to(shader_b, INCCACHE_TEST_OTHER, "Other"));
+
+	// Nothing has changed yet.
+	mu_check(inccache_check_changes() == 0);
+	mu_check(!inccache_is_shader_dirty(INCCACHE_TEST_SHADER_A));
+
+	// Modifying a file included through another file invalidates only the shader depending on it.
+	inccache_write_file(INCCACHE_TEST_COMMON, "float Common() { return 2.0; }\n");
+	inccache_touch_file(INCCACHE_TEST_COMMON);
+
+	mu_check(inccache_check_changes() == 1);
+	mu_check(inccache_is_shader_dirty(INCCACHE_TEST_SHADER_A));
+	mu_check(!inccache_is_shader_dirty(INCCACHE_TEST_SHADER_B));
+
+	// Recording the dependencies again picks up the modified text and clears the flag.
+	shader_a = inccache_begin_shader(INCCACHE_TEST_SHADER_A);
+
+	mu_check(inccache_expands_to(shader_a, INCCACHE_TEST_HEADER, "return 2.0;"));
+	mu_check(!inccache_is_shader_dirty(INCCACHE_TEST_SHADER_A));
+	mu_check(inccache_check_changes() == 0);
+
+	// Modifying a shader source invalidates the shader itself.
+	inccache_touch_file(INCCACHE_TEST_SHADER_B);
+
+	mu_check(inccache_check_changes() == 1);
+	mu_check(inccache_is_shader_dirty(INCCACHE_TEST_SHADER_B));
+	mu_check(!inccache_is_shader_dirty(INCCACHE_TEST_SHADER_A));
+
+	inccache_shutdown();
+
+	remove(INCCACHE_TEST_COMMON);
+	remove(INCCACHE_TEST_HEADER);
+	remove(INCCACHE_TEST_OTHER);
+	remove(INCCACHE_TEST_SHADER_A);
+	remove(INCCACHE_TEST_SHADER_B);
+}
+
+void run_includecache(void)
+{
+	file_create_directory("./shaders");
+
+	MU_RUN_TEST(test_inccache_dependents);
+}
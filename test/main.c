@@ -9,6 +9,11 @@ object_t *object;
 
 #include "quaternion.c"
 #include "object.c"
+#include "mipmap.c"
+#include "texcompress.c"
+#include "render.c"
+#include "scenefile.c"
+#include "includecache.c"
 
 static void test_setup(void)
 {
@@ -28,6 +33,11 @@ MU_TEST_SUITE(test_suite)
 
 	run_quaternion();
 	run_object();
+	run_mipmap();
+	run_texcompress();
+	run_render();
+	run_scenefile();
+	run_includecache();
 }	
 
 int main(void)
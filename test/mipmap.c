@@ -0,0 +1,162 @@
+#include "renderer/mipmap.h"
+#include "core/memory.h"
+#include <math.h>
+
+// Reference implementation of a gamma-correct 2x2 box filter, computed in double precision.
+static double reference_srgb_to_linear(double value)
+{
+	return (value <= 0.04045 ? value / 12.92 : pow((value + 0.055) / 1.055, 2.4));
+}
+
+static double reference_linear_to_srgb(double value)
+{
+	return (value <= 0.0031308 ? value * 12.92 : 1.055 * pow(value, 1 / 2.4) - 0.055);
+}
+
+static void reference_downsample(const uint8_t *src, size_t width, size_t height, size_t channels,
+                                 bool is_srgb, uint8_t *dst)
+{
+	size_t dst_width = (width > 1 ? width / 2 : 1);
+	size_t dst_height = (height > 1 ? height / 2 : 1);
+
+	for (size_t y = 0; y < dst_height; y++) {
+		for (size_t x = 0; x < dst_width; x++) {
+			for (size_t c = 0; c < channels; c++) {
+
+				size_t xs[2] = { 2 * x, (2 * x + 1 < width ? 2 * x + 1 : width - 1) };
+				size_t ys[2] = { 2 * y, (2 * y + 1 < height ? 2 * y + 1 : height - 1) };
+				bool is_colour = (is_srgb && c < 3);
+				double sum = 0;
+
+				for (int i = 0; i < 4; i++) {
+
+					double value = src[(ys[i / 2] * width + xs[i % 2]) * channels + c] / 255.0;
+					sum += (is_colour ? reference_srgb_to_linear(value) : value);
+				}
+
+				double result = (is_colour ? reference_linear_to_srgb(sum / 4) : sum / 4);
+				dst[(y * dst_width + x) * channels + c] = (uint8_t)(255 * result + 0.5);
+			}
+		}
+	}
+}
+
+static bool bytes_equal(const uint8_t *a, const uint8_t *b, size_t count, int tolerance)
+{
+	for (size_t i = 0; i < count; i++) {
+
+		if (abs((int)a[i] - (int)b[i]) > tolerance) {
+			return false;
+		}
+	}
+
+	return true;
+}
+
+MU_TEST(test_mipmap_levels)
+{
+	size_t width, height;
+
+	mu_check(mipmap_get_num_levels(1, 1) == 1);
+	mu_check(mipmap_get_num_levels(2, 1) == 2);
+	mu_check(mipmap_get_num_levels(256, 256) == 9);
+	mu_check(mipmap_get_num_levels(256, 16) == 9);
+	mu_check(mipmap_get_num_levels(5, 3) == 3);
+
+	mipmap_get_level_size(5, 3, 1, &width, &height);
+	mu_check(width == 2 && height == 1);
+
+	mipmap_get_level_size(5, 3, 2, &width, &height);
+	mu_check(width == 1 && height == 1);
+
+	mipmap_get_level_size(256, 16, 8, &width, &height);
+	mu_check(width == 1 && height == 1);
+
+	// Levels 1 and 2 of a 4x4 RGBA image.
+	mu_check(mipmap_get_chain_size(4, 4, 4, 3) == (4 + 1) * 4);
+}
+
+MU_TEST(test_mipmap_linear)
+{
+	// Images which are not sRGB are averaged as they are.
+	const uint8_t image[4 * 2] = {
+		0, 255, 10, 20,
+		255, 0, 30, 41,
+	};
+
+	const uint8_t expected[2] = { 128, 25 };
+	uint8_t result[2];
+
+	mipmap_downsample(image, 4, 2, 1, false, result);
+	mu_check(bytes_equal(result, expected, 2, 0));
+}
+
+MU_TEST(test_mipmap_gamma_correct)
+{
+	// Averaging black and white in linear space results in 188 instead of 128. Alpha is linear.
+	const uint8_t image[2 * 4] = {
+		0, 0, 0, 0,
+		255, 255, 255, 255,
+	};
+
+	const uint8_t expected[4] = { 188, 188, 188, 128 };
+	uint8_t result[4];
+
+	mipmap_downsample(image, 2, 1, 4, true, result);
+	mu_check(bytes_equal(result, expected, 4, 0));
+}
+
+MU_TEST(test_mipmap_reference)
+{
+	// Compare each level of the chain of a pseudo-random odd sized image to the reference filter.
+	enum { WIDTH = 13, HEIGHT = 6, CHANNELS = 4 };
+
+	uint8_t image[WIDTH * HEIGHT * CHANNELS];
+	uint32_t seed = 12345;
+
+	for (size_t i = 0; i < sizeof(image); i++) {
+
+		seed = seed * 1103515245 + 12345;
+		image[i] = (uint8_t)(seed >> 16);
+	}
+
+	uint32_t num_levels = mipmap_get_num_levels(WIDTH, HEIGHT);
+	uint8_t *chain = mipmap_generate(image, WIDTH, HEIGHT, CHANNELS, true, num_levels);
+
+	mu_check(num_levels == 4);
+	mu_check(chain != NULL);
+
+	uint8_t expected[WIDTH * HEIGHT * CHANNELS];
+	const uint8_t *src = image;
+	const uint8_t *level = chain;
+
+	for (uint32_t i = 1; i < num_levels; i++) {
+
+		size_t src_width, src_height, width, height;
+
+		mipmap_get_level_size(WIDTH, HEIGHT, i - 1, &src_width, &src_height);
+		mipmap_get_level_size(WIDTH, HEIGHT, i, &width, &height);
+
+		// Downsample the previous level of the chain, so rounding errors don't accumulate.
+		reference_downsample(src, src_width, src_height, CHANNELS, true, expected);
+		mu_check(bytes_equal(level, expected, width * height * CHANNELS, 1));
+
+		src = level;
+		level += width * height * CHANNELS;
+	}
+
+	mem_free(chain);
+
+	// A single pixel image has no other levels.
+	mu_check(mipmap_generate(image, 1, 1, CHANNELS, true, 8) == NULL);
+}
+
+void run_mipmap(void)
+{
+	mipmap_initialize();
+
+	MU_RUN_TEST(test_mipmap_levels);
+	MU_RUN_TEST(test_mipmap_linear);
+	MU_RUN_TEST(test_mipmap_gamma_correct);
+	MU_RUN_TEST(test_mipmap_reference);
+}
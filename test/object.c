@@ -27,8 +27,50 @@ MU_TEST(test_object_directions)
 	mu_check(quat_equals(obj_get_rotation(object), rotation));
 }
 
+static uint32_t object_count_alive(void)
+{
+	uint32_t count = 0;
+	object_t *obj;
+
+	arr_foreach(scene->objects, obj) {
+
+		if (obj != NULL) {
+			count++;
+		}
+	}
+
+	return count;
+}
+
+MU_TEST(test_object_destroy_budget)
+{
+	// The parent, the object and its 10 children form a hierarchy of 12 objects.
+	for (int i = 0; i < 10; i++) {
+		scene_create_object(scene, object);
+	}
+
+	scene_set_destroy_budget(scene, 5);
+	scene_destroy_object(scene, parent);
+
+	// The budget is counted per object, so the hierarchy is destroyed over three frames. The root
+	// of the hierarchy is destroyed last.
+	scene_flush_destroy_queue(scene);
+	mu_check(object_count_alive() == 7);
+	mu_check(parent->scene_index != INVALID_INDEX);
+	mu_check(!arr_is_empty(scene->destroy_queue));
+
+	scene_flush_destroy_queue(scene);
+	mu_check(object_count_alive() == 2);
+	mu_check(object->children.count == 0);
+
+	scene_flush_destroy_queue(scene);
+	mu_check(object_count_alive() == 0);
+	mu_check(arr_is_empty(scene->destroy_queue));
+}
+
 void run_object(void)
 {
 	MU_RUN_TEST(test_object_identity);
 	MU_RUN_TEST(test_object_directions);
+	MU_RUN_TEST(test_object_destroy_budget);
 }
@@ -0,0 +1,385 @@
+#include "renderer/null/nullrenderer.h"
+#include "renderer/rendbackend.h"
+#include "renderer/rendersystem.h"
+#include "renderer/renderer.h"
+#include "renderer/cmdbuffer.h"
+#include "renderer/shader.h"
+#include "renderer/mesh.h"
+#include "scene/model.h"
+#include "scene/camera.h"
+#include "core/parallel.h"
+#include "core/memory.h"
+#include <string.h>
+#include <stdio.h>
+
+// Number of objects drawn with each of the two test shaders.
+#define RENDER_TEST_OBJECTS 3
+
+// Number of instances in the recorded instanced draw, and the file the recorded buffer is saved to.
+#define RENDER_TEST_INSTANCES 4
+#define RENDER_TEST_CAPTURE "render-test.cmd"
+
+// Number of identical objects drawn with and without instancing.
+#define RENDER_TEST_IDENTICAL_OBJECTS 10000
+
+static shader_t *render_shaders[2];
+static model_t *render_models[2];
+
+// The null backend accepts any source, so the shaders only differ by their program names and
+// by whether they have an instancing variant.
+static shader_t *render_create_shader(const char *name, bool has_instancing)
+{
+	const char *source[] = { NULL, "void main() {}\n" };
+	const char *instanced_source[] = { NULL, "#pragma keywords INSTANCING\n", "void main() {}\n" };
+
+	shader_t *shader = shader_create(name, NULL);
+
+	if (has_instancing) {
+		shader_load_from_source(shader, LENGTH(instanced_source), instanced_source, 0, NULL, NULL);
+	}
+	else {
+		shader_load_from_source(shader, LENGTH(source), source, 0, NULL, NULL);
+	}
+
+	return shader;
+}
+
+static model_t *render_create_model(const char *name, shader_t *shader)
+{
+	const vertex_t vertices[3] = {
+		vertex(vec3(0, 0, 0), vec3(0, 0, -1), vec2(0, 0)),
+		vertex(vec3(1, 0, 0), vec3(0, 0, -1), vec2(1, 0)),
+		vertex(vec3(0, 1, 0), vec3(0, 0, -1), vec2(0, 1))
+	};
+
+	const vindex_t indices[3] = { 0, 1, 2 };
+
+	model_t *model = model_create(name, NULL);
+	mesh_t *mesh = model_add_mesh(model, vertices, 3, indices, 3);
+
+	mesh_set_shader(mesh, shader);
+
+	return model;
+}
+
+// Add a camera and objects which alternate between the two models to the scene. Each model is
+// added further away from the camera than the previous one.
+static void render_create_scene(void)
+{
+	object_t *camera = scene_create_object(scene, NULL);
+	camera_set_perspective_projection(obj_add_camera(camera), 60, 0.1f, 100);
+
+	for (int i = 0; i < 2 * RENDER_TEST_OBJECTS; i++) {
+
+		object_t *object = scene_create_object(scene, NULL);
+
+		obj_set_model(object, render_models[i % 2]);
+		obj_set_position(object, vec3(0, 0, 5.0f + 10.0f * (2 * RENDER_TEST_OBJECTS - i)));
+	}
+}
+
+// Add a camera and a number of objects with the same model at the same position to the scene.
+static void render_create_identical_objects(model_t *model, uint32_t count)
+{
+	object_t *camera = scene_create_object(scene, NULL);
+	camera_set_perspective_projection(obj_add_camera(camera), 60, 0.1f, 100);
+
+	for (uint32_t i = 0; i < count; i++) {
+
+		object_t *object = scene_create_object(scene, NULL);
+
+		obj_set_model(object, model);
+		obj_set_position(object, vec3(0, 0, 10));
+	}
+}
+
+static void render_frame(void)
+{
+	nullrend_clear_commands();
+
+	rsys_begin_frame();
+	rsys_render_scene(scene);
+	rsys_end_frame(scene);
+}
+
+MU_TEST(test_render_draw_count)
+{
+	render_create_scene();
+	render_frame();
+
+	size_t num_commands;
+	const nullrend_command_t *commands = nullrend_get_commands(&num_commands);
+
+	mu_check(num_commands >= 2);
+	mu_check(commands[0].type == NULLREND_BEGIN_FRAME);
+	mu_check(commands[num_commands - 1].type == NULLREND_END_FRAME);
+
+	mu_check(nullrend_count_commands(NULLREND_DRAW) == 2 * RENDER_TEST_OBJECTS);
+	mu_check(rsys_get_stats()->draw_calls == 2 * RENDER_TEST_OBJECTS);
+}
+
+MU_TEST(test_render_state_filtering)
+{
+	render_create_scene();
+
+	// Sorted meshes are grouped by shader and buffer, so each is bound once.
+	render_frame();
+
+	mu_check(nullrend_count_commands(NULLREND_SET_SHADER) == 2);
+	mu_check(nullrend_count_commands(NULLREND_SET_BUFFER) == 2);
+	mu_check(nullrend_count_commands(NULLREND_SET_DEPTH_WRITE) == 1);
+
+	// Without sorting the shaders alternate, and every change is recorded.
+	rsys_set_draw_sorting(false);
+	render_frame();
+	rsys_set_draw_sorting(true);
+
+	mu_check(nullrend_count_commands(NULLREND_SET_SHADER) == 2 * RENDER_TEST_OBJECTS);
+	mu_check(nullrend_count_commands(NULLREND_SET_BUFFER) == 2 * RENDER_TEST_OBJECTS);
+	mu_check(nullrend_count_commands(NULLREND_DRAW) == 2 * RENDER_TEST_OBJECTS);
+}
+
+MU_TEST(test_render_order)
+{
+	render_create_scene();
+	render_frame();
+
+	size_t num_commands;
+	const nullrend_command_t *commands = nullrend_get_commands(&num_commands);
+
+	// The draws of one shader are followed by the draws of the other, front to back, and each
+	// draw is preceded by the constants of its object.
+	shader_program_t program = 0;
+	uint32_t num_programs = 0, num_draws = 0;
+	float previous_depth = 0;
+
+	for (size_t i = 0; i < num_commands; i++) {
+
+		const nullrend_command_t *command = &commands[i];
+
+		if (command->type == NULLREND_SET_SHADER) {
+
+			mu_check(command->params.shader.program != program);
+
+			program = command->params.shader.program;
+			previous_depth = 0;
+			num_programs++;
+		}
+		else if (command->type == NULLREND_DRAW) {
+
+			mu_check(i > 0 && commands[i - 1].type == NULLREND_SET_OBJECT);
+			mu_check(program != 0);
+
+			float depth = commands[i - 1].params.object.model.col[3][2];
+
+			mu_check(depth > previous_depth);
+
+			previous_depth = depth;
+			num_draws++;
+		}
+	}
+
+	mu_check(num_programs == 2);
+	mu_check(num_draws == 2 * RENDER_TEST_OBJECTS);
+}
+
+MU_TEST(test_render_instancing)
+{
+	shader_t *shader = render_create_shader("render-test-instanced", true);
+	model_t *model = render_create_model("render-test-instanced", shader);
+
+	render_create_identical_objects(model, RENDER_TEST_IDENTICAL_OBJECTS);
+	render_frame();
+
+	// The objects are split into draws of at most CMD_MAX_INSTANCES instances.
+	uint32_t num_draws = (RENDER_TEST_IDENTICAL_OBJECTS + CMD_MAX_INSTANCES - 1) / CMD_MAX_INSTANCES;
+
+	mu_check(nullrend_count_commands(NULLREND_DRAW) == num_draws);
+	mu_check(rsys_get_stats()->instances_drawn == RENDER_TEST_IDENTICAL_OBJECTS);
+
+	model_destroy(model);
+	shader_destroy(shader);
+}
+
+MU_TEST(test_render_without_instancing)
+{
+	// The shader of the model has no instancing variant, so every object is drawn separately.
+	render_create_identical_objects(render_models[0], RENDER_TEST_IDENTICAL_OBJECTS);
+	render_frame();
+
+	mu_check(nullrend_count_commands(NULLREND_DRAW) == RENDER_TEST_IDENTICAL_OBJECTS);
+	mu_check(rsys_get_stats()->instances_drawn == 0);
+}
+
+// Record a command buffer which uses every command type.
+static void render_record_commands(cmdbuf_t *buffer)
+{
+	shader_program_t program = render_shaders[0]->program;
+
+	mat_t mvp = mat_identity();
+	mat_t model = mat_identity();
+	model.col[3][0] = 1;
+	model.col[3][1] = 2;
+	model.col[3][2] = 3;
+
+	shader_uniform_t uniform = { .name = "Tint", .type = UNIFORM_TYPE_VECTOR4, .position = 7 };
+	uniform.value.vec = vec4(0.25f, 0.5f, 0.75f, 1);
+
+	cmdbuf_set_pipeline(buffer, program, true);
+	cmdbuf_bind_textures(buffer, 11, 12);
+	cmdbuf_bind_buffers(buffer, 21, 22, VERTEX_NORMAL);
+	cmdbuf_set_uniform(buffer, &uniform);
+	cmdbuf_set_object(buffer, &mvp, &model);
+	cmdbuf_draw(buffer, CMD_PRIMITIVE_TRIANGLES, 0, 3);
+
+	mat_t *instances = cmdbuf_draw_instanced(buffer, CMD_PRIMITIVE_TRIANGLES, 3, 6,
+	                                         RENDER_TEST_INSTANCES);
+
+	for (int i = 0; i < RENDER_TEST_INSTANCES; i++) {
+
+		instances[i] = mat_identity();
+		instances[i].col[3][0] = (float)i;
+	}
+}
+
+// Replay a command buffer through the null backend and return a copy of the recorded stream.
+static nullrend_command_t *render_replay_commands(const cmdbuf_t *buffer, size_t *num_commands)
+{
+	nullrend_clear_commands();
+
+	rend_begin_draw();
+	rend_execute_commands(buffer);
+	rend_end_draw();
+
+	const nullrend_command_t *commands = nullrend_get_commands(num_commands);
+	NEW_ARRAY(nullrend_command_t, copy, *num_commands);
+
+	memcpy(copy, commands, *num_commands * sizeof(nullrend_command_t));
+
+	return copy;
+}
+
+static bool render_commands_equal(const nullrend_command_t *a, const nullrend_command_t *b)
+{
+	if (a->type != b->type) {
+		return false;
+	}
+
+	switch (a->type) {
+
+	case NULLREND_SET_SHADER:
+		return a->params.shader.program == b->params.shader.program;
+
+	case NULLREND_SET_TEXTURE:
+		return a->params.texture.unit == b->params.texture.unit &&
+		       a->params.texture.texture == b->params.texture.texture;
+
+	case NULLREND_SET_BUFFER:
+		return a->params.buffer.vertices == b->params.buffer.vertices &&
+		       a->params.buffer.indices == b->params.buffer.indices;
+
+	case NULLREND_SET_BLEND:
+	case NULLREND_SET_DEPTH_WRITE:
+		return a->params.enabled == b->params.enabled;
+
+	case NULLREND_SET_UNIFORM:
+		return a->params.uniform.program == b->params.uniform.program &&
+		       a->params.uniform.location == b->params.uniform.location &&
+		       a->params.uniform.type == b->params.uniform.type &&
+		       memcmp(&a->params.uniform.value.vec, &b->params.uniform.value.vec,
+		              sizeof(vec4_t)) == 0;
+
+	case NULLREND_SET_OBJECT:
+		return memcmp(&a->params.object, &b->params.object, sizeof(a->params.object)) == 0;
+
+	case NULLREND_DRAW:
+		return a->params.draw.primitive == b->params.draw.primitive &&
+		       a->params.draw.first_index == b->params.draw.first_index &&
+		       a->params.draw.num_indices == b->params.draw.num_indices &&
+		       a->params.draw.num_instances == b->params.draw.num_instances;
+
+	default:
+		return true;
+	}
+}
+
+MU_TEST(test_render_command_capture)
+{
+	cmdbuf_t recorded, loaded;
+
+	cmdbuf_init(&recorded);
+	cmdbuf_init(&loaded);
+
+	render_record_commands(&recorded);
+
+	mu_check(recorded.num_commands == 7);
+	mu_check(recorded.num_objects == 1);
+	mu_check(recorded.num_instances == RENDER_TEST_INSTANCES);
+
+	// The loaded buffer should be an exact copy of the saved one.
+	mu_check(cmdbuf_save(&recorded, RENDER_TEST_CAPTURE));
+	mu_check(cmdbuf_load(&loaded, RENDER_TEST_CAPTURE));
+
+	remove(RENDER_TEST_CAPTURE);
+
+	mu_check(loaded.size == recorded.size);
+	mu_check(loaded.num_commands == recorded.num_commands);
+	mu_check(loaded.num_objects == recorded.num_objects);
+	mu_check(loaded.num_instances == recorded.num_instances);
+	mu_check(loaded.size == recorded.size &&
+	         memcmp(loaded.data, recorded.data, recorded.size) == 0);
+
+	// Replaying either buffer should produce the same stream of backend commands.
+	size_t num_recorded, num_loaded;
+	nullrend_command_t *recorded_stream = render_replay_commands(&recorded, &num_recorded);
+	nullrend_command_t *loaded_stream = render_replay_commands(&loaded, &num_loaded);
+
+	mu_check(num_recorded == num_loaded);
+
+	for (size_t i = 0; i < num_recorded && i < num_loaded; i++) {
+		mu_check(render_commands_equal(&recorded_stream[i], &loaded_stream[i]));
+	}
+
+	// Both draws and all the recorded state should have reached the backend.
+	mu_check(nullrend_count_commands(NULLREND_SET_SHADER) == 1);
+	mu_check(nullrend_count_commands(NULLREND_SET_TEXTURE) == 2);
+	mu_check(nullrend_count_commands(NULLREND_SET_BUFFER) == 1);
+	mu_check(nullrend_count_commands(NULLREND_SET_UNIFORM) == 1);
+	mu_check(nullrend_count_commands(NULLREND_SET_OBJECT) == 1);
+	mu_check(nullrend_count_commands(NULLREND_DRAW) == 2);
+
+	mem_free(recorded_stream);
+	mem_free(loaded_stream);
+
+	cmdbuf_destroy(&recorded);
+	cmdbuf_destroy(&loaded);
+}
+
+void run_render(void)
+{
+	rend_set_backend(rend_null_backend());
+
+	parallel_initialize();
+	rsys_initialize();
+
+	render_shaders[0] = render_create_shader("render-test-a", false);
+	render_shaders[1] = render_create_shader("render-test-b", false);
+	render_models[0] = render_create_model("render-test-a", render_shaders[0]);
+	render_models[1] = render_create_model("render-test-b", render_shaders[1]);
+
+	MU_RUN_TEST(test_render_draw_count);
+	MU_RUN_TEST(test_render_state_filtering);
+	MU_RUN_TEST(test_render_order);
+	MU_RUN_TEST(test_render_instancing);
+	MU_RUN_TEST(test_render_without_instancing);
+	MU_RUN_TEST(test_render_command_capture);
+
+	for (int i = 0; i < 2; i++) {
+
+		model_destroy(render_models[i]);
+		shader_destroy(render_shaders[i]);
+	}
+
+	rsys_shutdown();
+	parallel_shutdown();
+}
@@ -0,0 +1,250 @@
+#include "scene/scenefile.h"
+#include "scene/light.h"
+#include "scene/prefab.h"
+#include "io/file.h"
+#include "core/memory.h"
+#include <stdio.h>
+#include <string.h>
+
+// Number of objects in the round trip scene, and in the large scene built from prefab instances.
+#define SCENEFILE_TEST_OBJECTS 200
+#define SCENEFILE_LARGE_INSTANCES 1000
+#define SCENEFILE_LARGE_NODES 50 // The root and 49 children, 50k objects in total
+#define SCENEFILE_TEST_PATH "scene-test.scn"
+
+// Build a scene with varied transforms and lights. Each group of five objects is a root with three
+// children, the first of which has a child of its own. The objects are created in the same order
+// the snapshot stores them, so the loaded objects have the same indices as the original ones.
+static void scenefile_build_scene(scene_t *target, uint32_t num_objects)
+{
+	object_t *root = NULL, *child = NULL;
+
+	for (uint32_t i = 0; i < num_objects; i++) {
+
+		uint32_t slot = i % 5;
+		object_t *parent = (slot == 0 ? NULL : slot == 2 ? child : root);
+		object_t *obj = scene_create_object(target, parent);
+
+		obj_set_local_position(obj, vec3((float)(i % 7), (float)i, -0.5f * i));
+		obj_set_local_rotation(obj, quat_from_euler_deg((float)i, 2.0f * i, 0));
+		obj_set_local_scale(obj, vec3(1, 1 + 0.25f * (i % 4), 2));
+
+		if (i % 3 == 0) {
+			obj_set_active(obj, false);
+		}
+
+		if (i % 4 == 0) {
+
+			light_t *light = obj_add_light(obj);
+
+			light_set_type(light, (light_type_t)((i / 4) % NUM_LIGHT_TYPES));
+			light_set_colour(light, col(i % 256, 128, 255 - i % 256));
+			light_set_intensity(light, 0.5f + i);
+			light_set_range(light, 2.0f * i);
+			light_set_direction(light, vec3(0, -1, (float)i));
+
+			if (light->type == LIGHT_SPOT) {
+				light_set_spotlight_cutoff_angle(light, 20, 30 + (float)(i % 10));
+			}
+		}
+
+		if (slot == 0) {
+			root = obj;
+		}
+		else if (slot == 1) {
+			child = obj;
+		}
+	}
+}
+
+static bool scenefile_lights_equal(const light_t *a, const light_t *b)
+{
+	if (a == NULL || b == NULL) {
+		return (a == b);
+	}
+
+	return a->type == b->type &&
+	       memcmp(&a->colour, &b->colour, sizeof(colour_t)) == 0 &&
+	       a->intensity == b->intensity &&
+	       a->range == b->range &&
+	       memcmp(&a->direction, &b->direction, sizeof(vec3_t)) == 0 &&
+	       a->cutoff_angle == b->cutoff_angle &&
+	       a->cutoff_angle_outer == b->cutoff_angle_outer;
+}
+
+static bool scenefile_objects_equal(object_t *a, object_t *b)
+{
+	// Parents are compared by their index in the scene.
+	if ((a->parent == NULL) != (b->parent == NULL) ||
+		(a->parent != NULL && a->parent->scene_index != b->parent->scene_index)) {
+		return false;
+	}
+
+	vec3_t position_a = obj_get_local_position(a), position_b = obj_get_local_position(b);
+	quat_t rotation_a = obj_get_local_rotation(a), rotation_b = obj_get_local_rotation(b);
+	vec3_t scale_a = obj_get_local_scale(a), scale_b = obj_get_local_scale(b);
+
+	return a->is_active == b->is_active &&
+	       a->children.count == b->children.count &&
+	       memcmp(&position_a, &position_b, sizeof(vec3_t)) == 0 &&
+	       memcmp(&rotation_a, &rotation_b, sizeof(quat_t)) == 0 &&
+	       memcmp(&scale_a, &scale_b, sizeof(vec3_t)) == 0 &&
+	       scenefile_lights_equal(a->light, b->light);
+}
+
+// Save a valid snapshot, let the callback modify it and check that the modified file is rejected.
+static bool scenefile_is_rejected(void (*modify)(uint8_t *data, size_t *size))
+{
+	scene_t *original = scene_create();
+	scenefile_build_scene(original, 10);
+
+	void *data = NULL;
+	size_t size = 0;
+	bool is_rejected = false;
+
+	if (scene_save(original, SCENEFILE_TEST_PATH) &&
+		file_read_all_data(SCENEFILE_TEST_PATH, &data, &size)) {
+
+		modify(data, &size);
+		file_write_all_data(SCENEFILE_TEST_PATH, data, size);
+
+		scene_t *loaded = scene_load(SCENEFILE_TEST_PATH);
+		is_rejected = (loaded == NULL);
+
+		if (loaded != NULL) {
+			scene_destroy(loaded);
+		}
+
+		mem_free(data);
+	}
+
+	remove(SCENEFILE_TEST_PATH);
+	scene_destroy(original);
+
+	return is_rejected;
+}
+
+static scene_file_object_t *scenefile_get_record(uint8_t *data, uint32_t index)
+{
+	const scene_file_header_t *header = (const scene_file_header_t *)data;
+	return (scene_file_object_t *)&data[header->objects_offset] + index;
+}
+
+static void scenefile_truncate(uint8_t *data, size_t *size)
+{
+	UNUSED(data);
+	*size -= sizeof(scene_file_object_t) / 2;
+}
+
+static void scenefile_corrupt_magic(uint8_t *data, size_t *size)
+{
+	UNUSED(size);
+	((scene_file_header_t *)data)->magic = 0;
+}
+
+static void scenefile_corrupt_children(uint8_t *data, size_t *size)
+{
+	UNUSED(size);
+	scenefile_get_record(data, 0)->num_children = 0x7FFFFFFF;
+}
+
+static void scenefile_corrupt_parent(uint8_t *data, size_t *size)
+{
+	UNUSED(size);
+	scenefile_get_record(data, 1)->parent_offset = 2;
+}
+
+static void scenefile_corrupt_light_type(uint8_t *data, size_t *size)
+{
+	UNUSED(size);
+
+	// The first object has a light.
+	scenefile_get_record(data, 0)->light_type = 1000;
+}
+
+MU_TEST(test_scenefile_round_trip)
+{
+	scene_t *original = scene_create();
+	scenefile_build_scene(original, SCENEFILE_TEST_OBJECTS);
+
+	mu_check(scene_save(original, SCENEFILE_TEST_PATH));
+
+	scene_t *loaded = scene_load(SCENEFILE_TEST_PATH);
+	remove(SCENEFILE_TEST_PATH);
+
+	mu_check(loaded != NULL);
+
+	if (loaded != NULL) {
+
+		mu_check(loaded->objects.count == original->objects.count);
+		mu_check(loaded->lights.count == original->lights.count);
+
+		for (uint32_t i = 0; i < loaded->objects.count && i < original->objects.count; i++) {
+			mu_check(scenefile_objects_equal(original->objects.items[i], loaded->objects.items[i]));
+		}
+
+		scene_destroy(loaded);
+	}
+
+	scene_destroy(original);
+}
+
+MU_TEST(test_scenefile_invalid)
+{
+	mu_check(scenefile_is_rejected(scenefile_truncate));
+	mu_check(scenefile_is_rejected(scenefile_corrupt_magic));
+	mu_check(scenefile_is_rejected(scenefile_corrupt_children));
+	mu_check(scenefile_is_rejected(scenefile_corrupt_parent));
+	mu_check(scenefile_is_rejected(scenefile_corrupt_light_type));
+}
+
+MU_TEST(test_scenefile_large)
+{
+	// Build a large scene from prefab instances, which appends the objects in a single batch
+	// instead of searching for a free index for each object.
+	prefab_t *prefab = prefab_create("scenefile-test", NULL);
+
+	for (int i = 0; i < SCENEFILE_LARGE_NODES; i++) {
+
+		prefab_node_t node;
+		prefab_init_node(&node);
+
+		node.parent = (i == 0 ? -1 : 0);
+		node.position = vec3((float)i, 0, 0);
+		node.has_light = (i == 0);
+		node.light_type = LIGHT_POINT;
+		node.light_range = 10;
+
+		prefab_add_node(prefab, &node);
+	}
+
+	prefab_bake(prefab);
+
+	scene_t *original = scene_create();
+	scene_instantiate_prefab(original, prefab, SCENEFILE_LARGE_INSTANCES, NULL, NULL);
+
+	mu_check(scene_save(original, SCENEFILE_TEST_PATH));
+
+	scene_t *loaded = scene_load(SCENEFILE_TEST_PATH);
+	remove(SCENEFILE_TEST_PATH);
+
+	mu_check(loaded != NULL);
+
+	if (loaded != NULL) {
+
+		mu_check(loaded->objects.count == SCENEFILE_LARGE_INSTANCES * SCENEFILE_LARGE_NODES);
+		mu_check(loaded->lights.count == SCENEFILE_LARGE_INSTANCES);
+
+		scene_destroy(loaded);
+	}
+
+	scene_destroy(original);
+	prefab_destroy(prefab);
+}
+
+void run_scenefile(void)
+{
+	MU_RUN_TEST(test_scenefile_round_trip);
+	MU_RUN_TEST(test_scenefile_invalid);
+	MU_RUN_TEST(test_scenefile_large);
+}
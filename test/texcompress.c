@@ -0,0 +1,139 @@
+#include "renderer/texcompress.h"
+#include "core/memory.h"
+#include <math.h>
+#include <string.h>
+
+// Size of the images used for measuring the quality of the encoder.
+#define TEXCOMP_TEST_SIZE 64
+
+// Generate a smooth test image: horizontal, vertical and diagonal gradients in separate channels
+// with a little pseudo-random noise, similar to the colour variation of a typical texture.
+static void texcomp_generate_image(uint8_t *image, size_t width, size_t height, size_t channels)
+{
+	uint32_t seed = 12345;
+
+	for (size_t y = 0; y < height; y++) {
+		for (size_t x = 0; x < width; x++) {
+			for (size_t c = 0; c < channels; c++) {
+
+				seed = seed * 1103515245 + 12345;
+				int noise = (int)((seed >> 16) % 5) - 2;
+
+				int value = (c % 3 == 0 ? (int)(255 * x / width) :
+				             c % 3 == 1 ? (int)(255 * y / height) :
+				             (int)(255 * (x + y) / (width + height)));
+
+				value = (c == 3 ? 255 - value : value) + noise;
+				image[(y * width + x) * channels + c] = (uint8_t)(value < 0 ? 0 :
+				                                                  value > 255 ? 255 : value);
+			}
+		}
+	}
+}
+
+// Peak signal-to-noise ratio of the given channel of the decoded image, in decibels.
+static double texcomp_psnr(const uint8_t *image, size_t image_channels,
+                           const uint8_t *decoded, size_t decoded_channels,
+                           size_t num_pixels, size_t channel)
+{
+	double error = 0;
+
+	for (size_t i = 0; i < num_pixels; i++) {
+
+		double difference = (double)image[i * image_channels + channel] -
+		                    (double)decoded[i * decoded_channels + channel];
+
+		error += difference * difference;
+	}
+
+	error /= num_pixels;
+
+	return (error == 0 ? 100 : 10 * log10(255.0 * 255.0 / error));
+}
+
+// Encode and decode a test image and return the lowest PSNR of the given channels.
+static double texcomp_measure(TEX_FORMAT format, size_t channels, size_t first_channel,
+                              size_t num_channels)
+{
+	enum { SIZE = TEXCOMP_TEST_SIZE };
+
+	uint8_t image[SIZE * SIZE * 4];
+	uint8_t decoded[SIZE * SIZE * 4];
+	uint8_t blocks[SIZE * SIZE];
+
+	texcomp_generate_image(image, SIZE, SIZE, channels);
+	texcomp_encode(image, SIZE, SIZE, channels, format, blocks);
+	texcomp_decode(blocks, SIZE, SIZE, format, decoded);
+
+	double result = 100;
+
+	for (size_t c = first_channel; c < first_channel + num_channels; c++) {
+
+		double psnr = texcomp_psnr(image, channels, decoded, texcomp_get_channels(format),
+		                           SIZE * SIZE, c);
+
+		result = (psnr < result ? psnr : result);
+	}
+
+	return result;
+}
+
+MU_TEST(test_texcomp_sizes)
+{
+	mu_check(texcomp_get_size(TEX_FORMAT_BC1, 4, 4) == 8);
+	mu_check(texcomp_get_size(TEX_FORMAT_BC3, 4, 4) == 16);
+	mu_check(texcomp_get_size(TEX_FORMAT_BC4, 1, 1) == 8);
+	mu_check(texcomp_get_size(TEX_FORMAT_BC5, 5, 3) == 2 * 16);
+	mu_check(texcomp_get_size(TEX_FORMAT_BC1, 256, 128) == 64 * 32 * 8);
+
+	mu_check(texcomp_is_compressed(TEX_FORMAT_BC4));
+	mu_check(!texcomp_is_compressed(TEX_FORMAT_RGBA));
+}
+
+MU_TEST(test_texcomp_bc1_quality)
+{
+	mu_check(texcomp_measure(TEX_FORMAT_BC1, 3, 0, 3) > 35);
+}
+
+MU_TEST(test_texcomp_bc3_quality)
+{
+	// The colour channels are encoded like BC1, the alpha channel like BC4.
+	mu_check(texcomp_measure(TEX_FORMAT_BC3, 4, 0, 3) > 35);
+	mu_check(texcomp_measure(TEX_FORMAT_BC3, 4, 3, 1) > 40);
+}
+
+MU_TEST(test_texcomp_bc4_bc5_quality)
+{
+	mu_check(texcomp_measure(TEX_FORMAT_BC4, 1, 0, 1) > 40);
+	mu_check(texcomp_measure(TEX_FORMAT_BC5, 2, 0, 2) > 40);
+}
+
+MU_TEST(test_texcomp_solid_block)
+{
+	// A block of a single colour is encoded without any error.
+	uint8_t image[4 * 4 * 4];
+	uint8_t decoded[4 * 4 * 4];
+	uint8_t blocks[16];
+
+	for (size_t i = 0; i < 16; i++) {
+
+		image[4 * i + 0] = 255;
+		image[4 * i + 1] = 0;
+		image[4 * i + 2] = 255;
+		image[4 * i + 3] = 77;
+	}
+
+	texcomp_encode(image, 4, 4, 4, TEX_FORMAT_BC3, blocks);
+	texcomp_decode(blocks, 4, 4, TEX_FORMAT_BC3, decoded);
+
+	mu_check(memcmp(image, decoded, sizeof(image)) == 0);
+}
+
+void run_texcompress(void)
+{
+	MU_RUN_TEST(test_texcomp_sizes);
+	MU_RUN_TEST(test_texcomp_bc1_quality);
+	MU_RUN_TEST(test_texcomp_bc3_quality);
+	MU_RUN_TEST(test_texcomp_bc4_bc5_quality);
+	MU_RUN_TEST(test_texcomp_solid_block);
+}